@@ -66,3 +66,43 @@ function(build_samtools SAMTOOLS_URL BUILD_DIR)
 
     add_dependencies(deps samtools-lib)
 endfunction(build_samtools SAMTOOLS_URL BUILD_DIR)
+
+# Picks the deflate implementation used to inflate bgzf blocks (see
+# src/lib/io/BgzfInflater.hpp). BD_INFLATE_BACKEND is one of
+#   auto       - libdeflate if it is installed, zlib otherwise (the default)
+#   zlib       - zlib only
+#   libdeflate - libdeflate, failing if it is not installed
+# zlib is always linked for samtools.
+function(find_inflate_backend)
+    if (NOT BD_INFLATE_BACKEND)
+        set(BD_INFLATE_BACKEND auto)
+    endif (NOT BD_INFLATE_BACKEND)
+    if (NOT BD_INFLATE_BACKEND MATCHES "^(auto|zlib|libdeflate)$")
+        message(FATAL_ERROR
+            "Unknown BD_INFLATE_BACKEND '${BD_INFLATE_BACKEND}'."
+            " It must be auto, zlib or libdeflate")
+    endif ()
+
+    set(Inflate_LIBRARIES "")
+    if (NOT BD_INFLATE_BACKEND STREQUAL "zlib")
+        find_path(LIBDEFLATE_INCLUDE_DIR libdeflate.h)
+        find_library(LIBDEFLATE_LIBRARY deflate)
+        if (LIBDEFLATE_INCLUDE_DIR AND LIBDEFLATE_LIBRARY)
+            add_definitions(-DBD_HAVE_LIBDEFLATE)
+            include_directories(${LIBDEFLATE_INCLUDE_DIR})
+            set(Inflate_LIBRARIES ${LIBDEFLATE_LIBRARY})
+        elseif (BD_INFLATE_BACKEND STREQUAL "libdeflate")
+            message(FATAL_ERROR
+                "BD_INFLATE_BACKEND is libdeflate, but libdeflate was not found."
+                " On Debian-based distributions, you can install it with"
+                " sudo apt-get install libdeflate-dev")
+        endif ()
+    endif (NOT BD_INFLATE_BACKEND STREQUAL "zlib")
+
+    if (Inflate_LIBRARIES)
+        message("Inflate backends: zlib libdeflate")
+    else (Inflate_LIBRARIES)
+        message("Inflate backends: zlib")
+    endif (Inflate_LIBRARIES)
+    set(Inflate_LIBRARIES ${Inflate_LIBRARIES} PARENT_SCOPE)
+endfunction(find_inflate_backend)
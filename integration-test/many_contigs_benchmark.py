@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Times breakdancer-max on a synthetic reference with many small contigs.
+
+Draft assemblies and references with decoys or alt contigs can have hundreds
+of thousands of sequences. This writes a coordinate sorted sam file on such a
+reference (a few proper pairs, a deletion and, for every fifth contig, a
+translocation to a later contig) along with its config, then runs the given
+breakdancer-max on it and reports how long it took.
+
+    many_contigs_benchmark.py path/to/breakdancer-max [--contigs N] [args...]
+
+Any arguments after the options are passed to breakdancer-max. This is not
+run by ctest.
+"""
+
+import argparse
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+READ_LEN = 100
+INSERT_MEAN = 400
+INSERT_STD = 30
+SEQ = "A" * READ_LEN
+QUAL = "I" * READ_LEN
+
+
+def pair(reads, name, tid, pos, mate_tid, mate_pos):
+    # Forward read first, reverse mate
+    same = tid == mate_tid
+    tlen = mate_pos + READ_LEN - pos if same else 0
+    proper = same and abs(tlen) < INSERT_MEAN + 3 * INSERT_STD
+    flag = 1 | 32 | (2 if proper else 0)
+    reads.setdefault(tid, []).append((pos, name, flag | 64, tid, pos, mate_tid, mate_pos, tlen))
+    reads.setdefault(mate_tid, []).append(
+        (mate_pos, name, (flag & ~32) | 16 | 128, mate_tid, mate_pos, tid, pos, -tlen))
+
+
+def write_sam(path, contigs, contig_len, seed):
+    rng = random.Random(seed)
+    reads = {}
+    n = 0
+    for tid in range(contigs):
+        for _ in range(6):
+            pos = rng.randrange(1, contig_len - INSERT_MEAN - READ_LEN)
+            pair(reads, "r%d" % n, tid, pos, tid, pos + INSERT_MEAN - READ_LEN)
+            n += 1
+        start = rng.randrange(1, contig_len // 2)
+        for i in range(3):
+            pos = start + 20 * i
+            pair(reads, "r%d" % n, tid, pos, tid, pos + 3000)
+            n += 1
+        if tid % 5 == 0 and tid + 1 < contigs:
+            mate_tid = rng.randrange(tid + 1, contigs)
+            mate_start = rng.randrange(1, contig_len - 200)
+            for i in range(3):
+                pair(reads, "r%d" % n, tid, 1700 + 20 * i, mate_tid, mate_start + 20 * i)
+                n += 1
+
+    with open(path, "w") as out:
+        out.write("@HD\tVN:1.0\tSO:coordinate\n")
+        for tid in range(contigs):
+            out.write("@SQ\tSN:ctg%d\tLN:%d\n" % (tid, contig_len))
+        out.write("@RG\tID:rg1\tLB:lib1\tSM:s1\n")
+        for tid in range(contigs):
+            for pos, name, flag, _, _, mate_tid, mate_pos, tlen in sorted(reads.get(tid, [])):
+                mate = "=" if mate_tid == tid else "ctg%d" % mate_tid
+                out.write("%s\t%d\tctg%d\t%d\t60\t%dM\t%s\t%d\t%d\t%s\t%s\tRG:Z:rg1\n" % (
+                    name, flag, tid, pos, READ_LEN, mate, mate_pos, tlen, SEQ, QUAL))
+    return n
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument("breakdancer")
+    parser.add_argument("--contigs", type=int, default=100000)
+    parser.add_argument("--contig-length", type=int, default=5000)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--keep", help="directory to write the data to, and keep")
+    opts, extra = parser.parse_known_args()
+
+    workdir = opts.keep or tempfile.mkdtemp(prefix="bd-many-contigs-")
+    if not os.path.isdir(workdir):
+        os.makedirs(workdir)
+    sam = os.path.join(workdir, "many_contigs.sam")
+    cfg = os.path.join(workdir, "many_contigs.cfg")
+
+    pairs = write_sam(sam, opts.contigs, opts.contig_length, opts.seed)
+    with open(cfg, "w") as out:
+        out.write("readgroup:rg1\tplatform:illumina\tmap:%s\treadlen:%.2f\tlib:lib1"
+                  "\tnum:10001\tlower:%d\tupper:%d\tmean:%d\tstd:%d\n" % (
+                      sam, READ_LEN, INSERT_MEAN - 3 * INSERT_STD,
+                      INSERT_MEAN + 3 * INSERT_STD, INSERT_MEAN, INSERT_STD))
+
+    output = os.path.join(workdir, "many_contigs.out")
+    start = time.time()
+    with open(output, "w") as out:
+        rv = subprocess.call([opts.breakdancer] + extra + [cfg], stdout=out)
+    elapsed = time.time() - start
+
+    with open(output) as f:
+        calls = sum(1 for line in f if not line.startswith("#"))
+    print("contigs\tpairs\tcalls\tseconds")
+    print("%d\t%d\t%d\t%.2f" % (opts.contigs, pairs, calls, elapsed))
+
+    if not opts.keep:
+        for path in (sam, cfg, output):
+            os.remove(path)
+        os.rmdir(workdir)
+    return rv
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,168 @@
+// Times inflating bams with each deflate backend built in, with and without
+// crc32 checks, against samtools' own bgzf_read.
+//
+//     bgzf-bench [--reads N] [--repeat N] [bam...]
+//
+// A synthetic bam of N reads (default 500000) is always timed as well, so
+// that there is something to compare with no data at hand. Speeds are in
+// megabytes of uncompressed data per second, best of the repeats.
+
+#include "common/Timer.hpp"
+#include "io/BamWriter.hpp"
+#include "io/BgzfReader.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using boost::format;
+using namespace std;
+
+namespace {
+    typedef Timer<boost::chrono::steady_clock> BenchTimer;
+
+    // 100bp pairs along one sequence, with sequence and qualities drawn
+    // from a few symbols so that they compress about as well as real ones
+    void write_synthetic_bam(string const& path, size_t n_reads) {
+        bam_header_t* header = bam_header_init();
+        header->n_targets = 1;
+        header->target_len = (uint32_t*)malloc(sizeof(uint32_t));
+        header->target_len[0] = 250000000;
+        header->target_name = (char**)malloc(sizeof(char*));
+        header->target_name[0] = strdup("1");
+
+        BamWriter writer(path, header);
+        bam1_t* b = bam_init1();
+        int32_t const len = 100;
+        uint32_t state = 1;
+        for (size_t i = 0; i < n_reads; ++i) {
+            string name = "read" + boost::lexical_cast<string>(i / 2);
+            state = state * 1103515245 + 12345;
+            b->core.tid = 0;
+            b->core.pos = 40 * (i / 2) + (i % 2) * 300;
+            b->core.bin = bam_reg2bin(b->core.pos, b->core.pos + len);
+            b->core.qual = 60;
+            b->core.l_qname = name.size() + 1;
+            b->core.flag = BAM_FPAIRED | BAM_FPROPER_PAIR
+                | (i % 2 ? BAM_FREVERSE | BAM_FREAD2 : BAM_FMREVERSE | BAM_FREAD1);
+            b->core.n_cigar = 1;
+            b->core.l_qseq = len;
+            b->core.mtid = 0;
+            b->core.mpos = b->core.pos + (i % 2 ? -300 : 300);
+            b->core.isize = i % 2 ? -400 : 400;
+            b->data_len = b->core.l_qname + 4 + (len + 1) / 2 + len;
+            b->m_data = b->data_len;
+            b->data = (uint8_t*)realloc(b->data, b->m_data);
+            memcpy(b->data, name.c_str(), b->core.l_qname);
+            uint32_t cigar = len << BAM_CIGAR_SHIFT | BAM_CMATCH;
+            memcpy(bam1_cigar(b), &cigar, 4);
+            uint8_t* seq = bam1_seq(b);
+            for (int32_t j = 0; j < (len + 1) / 2; ++j) {
+                state = state * 1103515245 + 12345;
+                seq[j] = (1 << ((state >> 16) & 3)) << 4 | 1 << ((state >> 20) & 3);
+            }
+            uint8_t* qual = bam1_qual(b);
+            for (int32_t j = 0; j < len; ++j) {
+                state = state * 1103515245 + 12345;
+                qual[j] = 30 + ((state >> 16) & 7);
+            }
+            writer.write(b);
+        }
+        bam_destroy1(b);
+        writer.close();
+        bam_header_destroy(header);
+    }
+
+    size_t read_samtools(string const& path) {
+        BGZF* in = bgzf_open(path.c_str(), "r");
+        if (!in)
+            throw runtime_error(str(format("Failed to open %1%") % path));
+        vector<char> buf(BgzfInflater::MAX_BLOCK_SIZE);
+        size_t total = 0;
+        int n;
+        while ((n = bgzf_read(in, &buf[0], buf.size())) > 0)
+            total += n;
+        bgzf_close(in);
+        if (n < 0)
+            throw runtime_error(str(format("Failed to read %1%") % path));
+        return total;
+    }
+
+    size_t read_native(string const& path, BgzfInflater::Backend backend, bool verify_crc) {
+        BgzfReader in(path, verify_crc, backend);
+        vector<char> buf(BgzfInflater::MAX_BLOCK_SIZE);
+        size_t total = 0;
+        size_t n;
+        while ((n = in.read(&buf[0], buf.size())) > 0)
+            total += n;
+        return total;
+    }
+
+    template<typename F>
+    void time(string const& label, size_t repeat, F f) {
+        double best = 0;
+        size_t bytes = 0;
+        for (size_t i = 0; i < repeat; ++i) {
+            BenchTimer timer;
+            bytes = f();
+            double secs = timer.elapsed<boost::chrono::duration<double> >().count();
+            if (i == 0 || secs < best)
+                best = secs;
+        }
+        cout << format("    %-22s %8.1f MB/s\n") % label % (bytes / 1e6 / max(best, 1e-9));
+    }
+
+    void bench(string const& path, size_t repeat) {
+        cout << path << " (" << bfs::file_size(path) / 1000 << " kB)\n";
+        time("samtools", repeat, [&] { return read_samtools(path); });
+
+        vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+        for (size_t i = 0; i < backends.size(); ++i) {
+            for (int verify = 0; verify < 2; ++verify) {
+                string label = str(format("%1%%2%")
+                    % BgzfInflater::name(backends[i]) % (verify ? " + crc32" : ""));
+                time(label, repeat, [&] { return read_native(path, backends[i], verify); });
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        size_t n_reads = 500000;
+        size_t repeat = 5;
+        vector<string> paths;
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if ((arg == "--reads" || arg == "--repeat") && i + 1 < argc)
+                (arg == "--reads" ? n_reads : repeat) = boost::lexical_cast<size_t>(argv[++i]);
+            else
+                paths.push_back(arg);
+        }
+
+        bfs::path dir = bfs::temp_directory_path() / bfs::unique_path("bgzf-bench-%%%%-%%%%");
+        bfs::create_directory(dir);
+        string synthetic = (dir / "synthetic.bam").native();
+        write_synthetic_bam(synthetic, n_reads);
+        paths.push_back(synthetic);
+
+        for (size_t i = 0; i < paths.size(); ++i)
+            bench(paths[i], max(repeat, size_t(1)));
+
+        bfs::remove_all(dir);
+    }
+    catch (exception const& e) {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
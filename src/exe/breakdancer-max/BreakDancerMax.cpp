@@ -1,8 +1,13 @@
+#include "breakdancer/Bench.hpp"
 #include "breakdancer/BreakDancer.hpp"
+#include "breakdancer/Evidence.hpp"
 #include "breakdancer/ReadCountsByLib.hpp"
 #include "breakdancer/ReadRegionData.hpp"
+#include "breakdancer/Targets.hpp"
 #include "common/ConfigMap.hpp"
 #include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "common/Trace.hpp"
 #include "io/BamConfig.hpp"
 #include "io/BamSummary.hpp"
 #include "io/ConfigLoader.hpp"
@@ -10,9 +15,12 @@
 #include "io/LibraryInfo.hpp"
 #include "io/BamIo.hpp"
 #include "io/BamMerger.hpp"
+#include "io/IntervalMask.hpp"
+#include "io/MaskedBamReader.hpp"
 
 #include "version.h"
 
+#include <boost/format.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include <algorithm>
@@ -22,6 +30,7 @@
 #include <fstream>
 #include <functional>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <set>
 #include <stdexcept>
@@ -30,6 +39,7 @@
 # define SCORE_FLOAT_TYPE double
 #endif
 
+using boost::format;
 using boost::shared_ptr;
 
 using namespace std;
@@ -38,7 +48,14 @@ using namespace std;
 int main(int argc, char *argv[]) {
     try {
         Options const initial_options(argc, argv);
-        ConfigLoader const context(initial_options);
+        if (trace_enabled())
+            trace_thread_name("main");
+
+        // Every parallel stage shares these; the main thread makes up the
+        // rest of the --threads budget.
+        TaskExecutor executor(initial_options.threads - 1);
+
+        ConfigLoader const context(initial_options, executor);
 
         Options const& opts = context.options();
         BamConfig const& cfg = context.bam_config();
@@ -55,22 +72,42 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        // Evidence files for calling jointly with other samples later
+        if (!opts.evidence_prefix.empty())
+            write_evidence_files(opts, lib_info, context.read_classifier(), executor);
+
         typedef vector<boost::shared_ptr<BamReaderBase> > ReaderVecType;
-        ReaderVecType sp_readers(openBams(cfg.bam_files(), opts.chr));
+        ReaderVecType sp_readers(openBams(cfg.bam_files(), opts.chr, &executor, io_options(opts)));
         vector<BamReaderBase*> readers;
         for(size_t i = 0; i != sp_readers.size(); ++i)
             readers.push_back(sp_readers[i].get());
 
-        BamMerger merged_reader(readers);
-        ReadRegionData read_regions(opts);
+        // Reads in masked regions are dropped before they are decoded
+        IntervalMask mask;
+        if (!opts.mask_bed.empty()) {
+            ifstream bed(opts.mask_bed.c_str());
+            if (!bed)
+                throw runtime_error(str(format("Failed to open mask file %1%") % opts.mask_bed));
+            mask = IntervalMask(bed, readers[0]->header());
+        }
 
-        BreakDancer bdancer(
-            context.read_classifier(),
-            opts,
-            lib_info,
-            read_regions,
-            merged_reader,
-            max_read_window_size);
+        vector<boost::shared_ptr<MaskedBamReader> > masked_readers;
+        if (!mask.empty()) {
+            for (size_t i = 0; i != readers.size(); ++i) {
+                masked_readers.push_back(boost::shared_ptr<MaskedBamReader>(
+                    new MaskedBamReader(*readers[i], mask)));
+                readers[i] = masked_readers.back().get();
+            }
+        }
+
+        // Regions to call in, each on its own, instead of the whole genome
+        IntervalMask targets;
+        if (!opts.targets_bed.empty()) {
+            ifstream bed(opts.targets_bed.c_str());
+            if (!bed)
+                throw runtime_error(str(format("Failed to open targets file %1%") % opts.targets_bed));
+            targets = IntervalMask(bed, readers[0]->header(), opts.target_padding);
+        }
 
         cout << "#Software: " << __g_prog_version << " (commit "
             << __g_commit_hash << ")" << endl;
@@ -81,6 +118,7 @@ int main(int argc, char *argv[]) {
         cout << endl;
         cout << "#Library Statistics:" << endl;
         size_t num_libs = lib_info._cfg.num_libs();
+        map<string, float> read_density;
         for(size_t i = 0; i < num_libs; ++i) {
             LibraryConfig const& lib_config = lib_info._cfg.library_config(i);
 
@@ -104,7 +142,7 @@ int main(int argc, char *argv[]) {
 
             std::string const& lib = lib_config.name;
             std::string const& density_libkey = opts.CN_lib ? lib : lib_config.bam_file;
-            bdancer.set_read_density(density_libkey, dens);
+            read_density[density_libkey] = dens;
 
             int nread_lengthDiscrepant = \
                 lib_info._summary.library_flag_distribution(i).read_counts_by_flag[ReadFlag::ARP_LARGE_INSERT] +
@@ -113,7 +151,6 @@ int main(int argc, char *argv[]) {
 
             int tmp = (nread_lengthDiscrepant > 0)?(float)covered_ref_len/(float)nread_lengthDiscrepant:50;
             max_read_window_size = std::min(max_read_window_size, tmp);
-            bdancer.set_max_read_window_size(max_read_window_size);
 
             cout << "#" << lib_config.bam_file
                 << "\tmean:" << lib_config.mean_insertsize
@@ -136,6 +173,14 @@ int main(int argc, char *argv[]) {
             cout << "\n";
         }
 
+        // The library statistics say what was benchmarked; the rest of
+        // the output is its report instead of calls
+        if (!opts.bench.empty()) {
+            run_bench(opts.bench, readers, opts, lib_info, context.read_classifier(),
+                read_density, max_read_window_size, executor, cout);
+            return 0;
+        }
+
         cout << "#Chr1\tPos1\tOrientation1\tChr2\tPos2\tOrientation2\tType\tSize\tScore\tnum_Reads\tnum_Reads_lib";
         if(opts.print_AF == 1)
             cout << "\tAllele_frequency";
@@ -149,9 +194,34 @@ int main(int argc, char *argv[]) {
                     cout << "\t" << *it_map;
             }
         }
+        if (cfg.has_sample_roles())
+            cout << "\tTumor_reads\tNormal_reads\tSomatic_status";
 
         cout << "\n";
 
+        if (!opts.targets_bed.empty()) {
+            call_targets(readers[0]->header(), targets, mask, opts, lib_info,
+                context.read_classifier(), read_density, max_read_window_size,
+                executor, cout);
+            return 0;
+        }
+
+        BamMerger merged_reader(readers);
+        ReadRegionData read_regions(opts);
+
+        BreakDancer bdancer(
+            context.read_classifier(),
+            opts,
+            lib_info,
+            read_regions,
+            merged_reader,
+            executor,
+            max_read_window_size);
+
+        typedef map<string, float>::const_iterator DensityIter;
+        for (DensityIter i = read_density.begin(); i != read_density.end(); ++i)
+            bdancer.set_read_density(i->first, i->second);
+
         bdancer.run();
 
     } catch (exception const& e) {
@@ -31,6 +31,10 @@ public:
         , rev_read_count(0)
         , times_accessed(0)
         , times_collapsed(0)
+        , mate_horizon_tid(-1)
+        , mate_horizon_pos(-1)
+        , open_candidates(0)
+        , settled(false)
     {
     }
 
@@ -44,6 +48,17 @@ public:
     int times_accessed;
     int times_collapsed;
 
+    // Highest mate coordinate of any read held by this region. Once the
+    // input stream has moved past it, no new read can ever link to this
+    // region.
+    int mate_horizon_tid;
+    int mate_horizon_pos;
+
+    // Event driven mode only: candidates naming this region that have not
+    // been handed out yet, and whether the region is known to be final.
+    int open_candidates;
+    bool settled;
+
     void swap_reads(ReadVector& reads) {
         _reads.swap(reads);
     }
@@ -0,0 +1,240 @@
+#include "Bench.hpp"
+
+#include "BreakDancer.hpp"
+#include "ReadRegionData.hpp"
+#include "common/AllocationCounter.hpp"
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "io/AlignmentPipeline.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamMerger.hpp"
+#include "io/BgzfReader.hpp"
+#include "io/LibraryInfo.hpp"
+#include "io/RecordBatch.hpp"
+
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <streambuf>
+#include <vector>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    // Passes records through, counting them
+    class CountingReader : public BamReaderBase {
+    public:
+        explicit CountingReader(BamReaderBase& in)
+            : _in(in)
+            , records(0)
+            , bytes(0)
+        {
+        }
+
+        int next(bam1_t* entry) {
+            int rv = _in.next(entry);
+            if (rv > 0)
+                _count(entry);
+            return rv;
+        }
+
+        std::size_t next_batch(RecordBatch& batch) {
+            std::size_t n = _in.next_batch(batch);
+            for (std::size_t i = 0; i < n; ++i)
+                _count(batch[i]);
+            return n;
+        }
+
+        bool skip_to(int tid, int pos) {
+            return _in.skip_to(tid, pos);
+        }
+
+        bool set_region(int tid, int beg, int end) {
+            return _in.set_region(tid, beg, end);
+        }
+
+        bam_header_t* header() const {
+            return _in.header();
+        }
+
+        std::string const& path() const {
+            return _in.path();
+        }
+
+    private:
+        void _count(bam1_t const* entry) {
+            ++records;
+            // block_size, the fixed fields and the rest, as in the file
+            bytes += 4 + 32 + entry->data_len;
+        }
+
+    private:
+        BamReaderBase& _in;
+
+    public:
+        uint64_t records;
+        uint64_t bytes;
+    };
+
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) {
+            return traits_type::not_eof(c);
+        }
+    };
+
+    double cpu_seconds() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+    }
+
+    // Writing 5 to clear_refs resets VmHWM (Linux 4.0 and up)
+    void reset_peak_rss() {
+        ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5\n";
+    }
+
+    // In kilobytes
+    long peak_rss() {
+        ifstream status("/proc/self/status");
+        string line;
+        while (getline(status, line)) {
+            long kb;
+            if (sscanf(line.c_str(), "VmHWM: %ld kB", &kb) == 1)
+                return kb;
+        }
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // A number about records, or NA for a stage that does not see them
+    template<typename T>
+    string per_record(bool has_records, T value) {
+        if (!has_records)
+            return "NA";
+        ostringstream out;
+        out << fixed << setprecision(3) << value;
+        return out.str();
+    }
+
+    uint64_t inflate_bams(Options const& opts, LibraryInfo const& lib_info, TaskExecutor& executor) {
+        uint64_t bytes = 0;
+        vector<char> buf(BgzfReader::READ_SIZE);
+        vector<string> const& paths = lib_info._cfg.bam_files();
+        for (size_t i = 0; i < paths.size(); ++i) {
+            BgzfReader in(paths[i], BgzfInflater::verify_crc_default(),
+                BgzfInflater::default_backend(), io_options(opts), &executor);
+            while (size_t n = in.read(&buf[0], buf.size()))
+                bytes += n;
+        }
+        return bytes;
+    }
+}
+
+void run_bench(
+        std::string const& stage,
+        std::vector<BamReaderBase*> const& readers,
+        Options const& opts,
+        LibraryInfo const& lib_info,
+        IAlignmentClassifier const& read_classifier,
+        std::map<std::string, float> const& read_density,
+        int max_read_window_size,
+        TaskExecutor& executor,
+        std::ostream& out
+        )
+{
+    BamMerger merged_reader(readers);
+    CountingReader counted(merged_reader);
+    uint64_t bytes = 0;
+
+    reset_peak_rss();
+    uint64_t allocations = allocation_count();
+    count_allocations(true);
+    double cpu_start = cpu_seconds();
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+
+    if (stage == "read") {
+        bytes = inflate_bams(opts, lib_info, executor);
+    }
+    else if (stage == "decode") {
+        RecordBatch batch;
+        while (counted.next_batch(batch))
+            ;
+    }
+    else if (stage == "classify") {
+        boost::shared_ptr<IAlignmentBatchSource> src = make_alignment_source(
+            counted, read_classifier, lib_info._cfg, opts.need_sequence_data(), executor);
+        vector<Alignment::Ptr> alns;
+        while (src->next_batch(alns))
+            ;
+    }
+    else if (stage == "regions" || stage == "call") {
+        NullBuffer discard;
+        ostream calls(&discard);
+        ReadRegionData read_regions(opts);
+        BreakDancer bdancer(
+            read_classifier,
+            opts,
+            lib_info,
+            read_regions,
+            counted,
+            executor,
+            max_read_window_size);
+
+        typedef map<string, float>::const_iterator IterType;
+        for (IterType i = read_density.begin(); i != read_density.end(); ++i)
+            bdancer.set_read_density(i->first, i->second);
+
+        bdancer.set_output(calls);
+        bdancer.set_score_svs(stage == "call");
+        bdancer.run();
+    }
+    else {
+        throw runtime_error(str(format("Unknown --bench stage %1%") % stage));
+    }
+
+    double seconds = boost::chrono::duration<double>(
+        boost::chrono::steady_clock::now() - start).count();
+    double cpu = cpu_seconds() - cpu_start;
+    count_allocations(false);
+    allocations = allocation_count() - allocations;
+    long rss_kb = peak_rss();
+
+    // Inflating does not split the stream into records
+    bool has_records = stage != "read";
+    if (has_records)
+        bytes = counted.bytes;
+    uint64_t records = counted.records;
+    seconds = max(seconds, 1e-9);
+
+    out << "#Bench\tstage\trecords\tbytes\tseconds\tcpu_seconds\trecords_per_s\tmb_per_s"
+        "\tallocations\tallocations_per_record\tpeak_rss_mb\n";
+    out << fixed << setprecision(3)
+        << "bench\t" << stage
+        << "\t" << per_record(has_records, records)
+        << "\t" << bytes
+        << "\t" << seconds
+        << "\t" << cpu
+        << "\t" << per_record(has_records, records / seconds)
+        << "\t" << bytes / seconds / (1 << 20)
+        << "\t" << allocations
+        << "\t" << per_record(has_records, records ? double(allocations) / records : 0.0)
+        << "\t" << rss_kb / 1024.0
+        << "\n";
+}
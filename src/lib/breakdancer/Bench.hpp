@@ -0,0 +1,40 @@
+#pragma once
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+class BamReaderBase;
+class IAlignmentClassifier;
+class TaskExecutor;
+struct LibraryInfo;
+struct Options;
+
+// --bench: run the real pipeline on the real input, but only as far as
+// one stage, and write one line about its throughput to out:
+//
+//   read:     inflate each bam in the config (all of it, whatever -o says)
+//   decode:   read records from the readers, merged by BamMerger
+//   classify: make Alignments and classify them, as an IAlignmentBatchSource
+//   regions:  push_read and build_connection, dropping the candidate SVs
+//   call:     everything, with the calls thrown away
+//
+// Bytes are those of the decompressed bam stream (records as stored,
+// headers too for read). read sees no records, so the columns about them
+// are NA. Allocations count calls to operator new. Peak
+// RSS is for the stage alone where the kernel lets it be reset
+// (/proc/self/clear_refs), for the whole run otherwise. CPU seconds over
+// seconds tells a stage that waits on IO from one that is busy.
+// The other arguments are as for call_targets.
+void run_bench(
+    std::string const& stage,
+    std::vector<BamReaderBase*> const& readers,
+    Options const& opts,
+    LibraryInfo const& lib_info,
+    IAlignmentClassifier const& read_classifier,
+    std::map<std::string, float> const& read_density,
+    int max_read_window_size,
+    TaskExecutor& executor,
+    std::ostream& out
+    );
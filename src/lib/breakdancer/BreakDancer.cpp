@@ -2,8 +2,11 @@
 
 #include "SvBuilder.hpp"
 #include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "common/Probes.hpp"
 #include "common/Timer.hpp"
-#include "io/AlignmentSource.hpp"
+#include "common/Trace.hpp"
+#include "io/AlignmentPipeline.hpp"
 #include "io/BamConfig.hpp"
 #include "io/BamReaderBase.hpp"
 #include "io/IAlignmentClassifier.hpp"
@@ -17,8 +20,10 @@
 #include <boost/ref.hpp>
 
 #include <algorithm>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <fstream>
 #include <functional>
 #include <set>
@@ -90,6 +95,7 @@ BreakDancer::BreakDancer(
         LibraryInfo const& lib_info,
         ReadRegionData& read_regions,
         BamReaderBase& merged_reader,
+        TaskExecutor& executor,
         int max_read_window_size
         )
     : _read_classifier(read_classifier)
@@ -97,7 +103,9 @@ BreakDancer::BreakDancer(
     , _lib_info(lib_info)
     , _rdata(read_regions)
     , _merged_reader(merged_reader)
+    , _executor(executor)
     , _max_read_window_size(max_read_window_size)
+    , _triage(opts, lib_info)
 
     , _collecting_normal_reads(false)
     , _nnormal_reads(0)
@@ -109,6 +117,13 @@ BreakDancer::BreakDancer(
     , _region_start_pos(-1)
     , _region_end_tid(-1)
     , _region_end_pos(-1)
+    , _region_read_count(0)
+    , _region_too_dense(false)
+    , _dense_regions(0)
+    , _dense_reads_dropped(0)
+    , _out(&cout)
+    , _svs_written(0)
+    , _score_svs(true)
 {
     if (!_opts.prefix_fastq.empty()) {
         _fastq_writer.reset(new FastqWriter(opts.prefix_fastq));
@@ -121,91 +136,126 @@ BreakDancer::BreakDancer(
 
     }
 
+    if (!_opts.depth_prefix.empty()) {
+        vector<string> lib_names;
+        for (size_t i = 0; i < _lib_info._cfg.num_libs(); ++i)
+            lib_names.push_back(_lib_info._cfg.library_config(i).name);
+        _depth_writer.reset(new DepthWriter(_opts.depth_prefix, lib_names,
+            _merged_reader.header(), _opts.depth_bin_size, _opts.depth_binary));
+    }
+
+    if (_opts.collapse_duplicates)
+        _duplicate_collapser.reset(new DuplicateCollapser);
+
+    if (_opts.somatic_only && !_lib_info._cfg.has_sample_roles())
+        throw runtime_error("--somatic-only needs tumor and normal roles (role:) in the bam config");
+
     if (!_opts.dump_BED.empty()) {
         _bed_stream.reset(new ofstream(_opts.dump_BED.c_str()));
         _bed_writer.reset(new BedWriter(*_bed_stream, _lib_info, _merged_reader.header()));
     }
+
+    if (!_opts.hotspot_prefix.empty()) {
+        _hotspots.reset(new HotspotProfiler(_opts.hotspot_prefix, _merged_reader.header(),
+            _opts.hotspot_window));
+        _rdata.set_clear_callback(boost::bind(&HotspotProfiler::region_done, _hotspots.get(), _1));
+    }
+}
+
+BreakDancer::~BreakDancer() {
+    if (_hotspots)
+        _rdata.set_clear_callback(ReadRegionData::RegionCallback());
 }
 
 
 void BreakDancer::run() {
-    AlignmentSource src(
+    boost::shared_ptr<IAlignmentBatchSource> src = make_alignment_source(
         _merged_reader,
         _read_classifier,
         _lib_info._cfg,
-        _opts.need_sequence_data()
+        _opts.need_sequence_data(),
+        _executor
         );
 
-    while (Alignment::Ptr aln = src.next()) {
-        push_read(aln);
+    std::vector<Alignment::Ptr> alns;
+    double waited_since = _hotspots ? HotspotProfiler::now() : 0;
+    while (src->next_batch(alns)) {
+        if (_hotspots)
+            _hotspots->charge_decode(alns, HotspotProfiler::now() - waited_since);
+
+        typedef std::vector<Alignment::Ptr>::const_iterator IterType;
+        for (IterType aln = alns.begin(); aln != alns.end(); ++aln)
+            push_read(*aln);
+
+        if (_hotspots)
+            waited_since = HotspotProfiler::now();
     }
 
     process_final_region();
+
+    if (_depth_writer)
+        _depth_writer->close();
+
+    if (_hotspots) {
+        // Regions that were never cleared are done too
+        for (size_t i = 0; i < _rdata.num_regions(); ++i) {
+            if (_rdata.region_exists(i))
+                _hotspots->region_done(_rdata.region(i));
+        }
+        _hotspots->write();
+    }
+
+    if (getenv("BD_PIPELINE_STATS")) {
+        if (AlignmentPipeline* pipeline = dynamic_cast<AlignmentPipeline*>(src.get()))
+            pipeline->report_stats(cerr);
+        _executor.report_stats(cerr);
+        cerr << "#Dense regions\tregions\tdropped_reads\n"
+            << "dense\t" << _dense_regions << "\t" << _dense_reads_dropped << "\n";
+        if (_duplicate_collapser) {
+            cerr << "#Duplicates\tdropped_reads\n"
+                << "duplicates\t" << _duplicate_collapser->duplicates() << "\n";
+        }
+    }
 }
 
 
 void BreakDancer::push_read(Alignment::Ptr const& alnptr) {
     auto& aln = *alnptr;
 
-    LibraryConfig const& lib_config = _lib_info._cfg.library_config(aln.lib_index());
-
-    // XXX: this value can be missing in the config (indicated by a value of -1),
-    // in which case we'll wan't to use the default from the cmdline rather than
-    // admit everything.
-    int min_mapq = lib_config.min_mapping_quality < 0 ?
-            _opts.min_map_qual : lib_config.min_mapping_quality;
-
-    // Ignore fragments, poorly mapped reads, etc.
-    if (aln.bdflag() == ReadFlag::NA || aln.either_unmapped() || aln.bdqual() <= min_mapq
-        // ignore CTX when not in ctx mode
-        || (_opts.transchr_rearrange && !aln.interchrom_pair())
-        // ignore reads mapped too distantly on the same chromosome
-        || (aln.bdflag() != ReadFlag::ARP_CTX && aln.abs_isize() > _opts.max_sd)
-        )
-    {
+    if (aln.is_read_counts()) {
+        _push_read_counts(aln);
         return;
     }
 
+    ReadTriage::Fate fate = _triage(aln);
+    if (fate == ReadTriage::IGNORED)
+        return;
+
     // region between last and next begin
     // Store readdepth in nread_ROI by bam name (no per library calc) or by library
     // I believe this only counts normally mapped reads
     if (aln.proper_pair()) {
-        string const& key = _opts.CN_lib == 1 ? lib_config.name : lib_config.bam_file;
-        _rdata.incr_normal_read_count(key);
-    }
-
-    // for long insert
-    // Mate pair libraries have different expected orientations so adjust
-    // Also, aligner COULD have marked (if it was maq) that reads had abnormally large or small insert sizes
-    // Remark based on BD options
-    // FIXME: make mate-pair alignment classifier class
-    if(_opts.Illumina_long_insert) {
-        if(aln.abs_isize() > lib_config.uppercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
-            aln.set_bdflag(ReadFlag::ARP_RF);
-        }
-        if(aln.abs_isize() < lib_config.uppercutoff && aln.bdflag() == ReadFlag::ARP_RF) {
-            aln.set_bdflag(ReadFlag::NORMAL_RF);
-        }
-        if(aln.abs_isize() < lib_config.lowercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
-            aln.set_bdflag(ReadFlag::ARP_SMALL_INSERT);
-        }
-    }
-
-    // This makes FF and RR the same thing
-    if(aln.bdflag() == ReadFlag::ARP_RR) {
-        aln.set_bdflag(ReadFlag::ARP_FF);
+        _rdata.incr_normal_read_count(_read_count_key(aln));
+        if (_depth_writer)
+            _depth_writer->add(aln.lib_index(), aln.tid(), aln.pos());
     }
 
     //count reads mapped by SW, FR and RF reads, but only if normal_switch is true
     //normal_switch is set to 1 as soon as reads are accumulated for dumping to fastq??? Not sure on this. Happens later in this function
     //I suspect this is to include those reads in the fastq dump for assembly!
-    if(aln.bdflag() == ReadFlag::NORMAL_FR || aln.bdflag() == ReadFlag::NORMAL_RF) {
+    if (fate == ReadTriage::NORMAL) {
         if(_collecting_normal_reads && aln.leftmost()) {
             ++_nnormal_reads;
         }
         return;
     }
 
+    if (fate == ReadTriage::FILTERED)
+        return;
+
+    if (_duplicate_collapser && _duplicate_collapser->is_duplicate(aln))
+        return;
+
     if(_collecting_normal_reads) {
         _ntotal_nucleotides += aln.query_length();
         _max_readlen = std::max(_max_readlen, aln.query_length());
@@ -216,11 +266,19 @@ void BreakDancer::push_read(Alignment::Ptr const& alnptr) {
     bool do_break = aln.tid() != _region_end_tid || aln.pos() - _region_end_pos > _max_read_window_size;
 
     if(do_break) { // breakpoint in the assembly
-        process_breakpoint();
+        BD_PROBE4(region_break, _region_start_tid, _region_start_pos, _region_end_pos, _region_read_count);
+        process_breakpoint(aln.tid(), aln.pos());
+        // Every read before this one now belongs to a registered region, so
+        // reads still waiting on a mate located earlier than here are orphans.
+        _rdata.set_stream_position(aln.tid(), aln.pos());
+        if (_opts.event_driven)
+            _process_ready_svs();
         // clear out this node
         _region_start_tid = aln.tid();
         _region_start_pos = aln.pos();
         reads_in_current_region.clear();
+        _region_read_count = 0;
+        _region_too_dense = false;
         _collecting_normal_reads = false;
         _nnormal_reads = 0;
         _max_readlen = 0;
@@ -230,21 +288,109 @@ void BreakDancer::push_read(Alignment::Ptr const& alnptr) {
         _rdata.clear_flanking_region_accumulator();
     }
 
-    reads_in_current_region.push_back(alnptr); // store each read in the region_sequence buffer
+    ++_region_read_count;
+    if (_region_too_dense)
+        _push_dense_read(alnptr);
+    else
+        reads_in_current_region.push_back(alnptr); // store each read in the region_sequence buffer
 
     //If we just added the first read, flip the flag that lets us collect all reads
-    if(reads_in_current_region.size() == 1)
+    if(_region_read_count == 1)
         _collecting_normal_reads = true;
     _region_end_tid = aln.tid();
     _region_end_pos = aln.pos();
 
+    // With --dense-region-early, a big region counts as too dense as soon
+    // as its coverage so far passes -x, even if later reads would spread it
+    // out, so a pileup never has to be held in memory whole. Otherwise only
+    // the exact check when the region closes decides.
+    if (_opts.dense_region_early && !_region_too_dense
+            && _region_read_count >= MIN_DENSE_REGION_READS
+            && _region_coverage() >= _opts.seq_coverage_lim)
+    {
+        _start_dense_region();
+    }
+
     _rdata.clear_region_accumulator();
 }
 
-void BreakDancer::process_breakpoint() {
-    float seq_coverage = _ntotal_nucleotides/float(_region_end_pos - _region_start_pos + 1 + _max_readlen);
+void BreakDancer::_push_read_counts(Alignment const& aln) {
+    // Normal reads summarized by an evidence file, as counted in push_read
+    if (aln.proper_pair_count() > 0) {
+        _rdata.incr_normal_read_count(_read_count_key(aln), aln.proper_pair_count());
+        if (_depth_writer)
+            _depth_writer->add(aln.lib_index(), aln.tid(), aln.pos(), aln.proper_pair_count());
+    }
+    if (_collecting_normal_reads)
+        _nnormal_reads += aln.normal_read_count();
+}
+
+std::string const& BreakDancer::_read_count_key(Alignment const& aln) const {
+    LibraryConfig const& lib_config = _lib_info._cfg.library_config(aln.lib_index());
+    return _opts.CN_lib == 1 ? lib_config.name : lib_config.bam_file;
+}
+
+float BreakDancer::_region_coverage() const {
+    return _ntotal_nucleotides/float(_region_end_pos - _region_start_pos + 1 + _max_readlen);
+}
+
+void BreakDancer::_start_dense_region() {
+    _region_too_dense = true;
+    ++_dense_regions;
+
+    // The sample is a max heap on read name hash, so the same names are
+    // kept at both ends of a connection.
+    ReadVector& reads = reads_in_current_region;
+    std::make_heap(reads.begin(), reads.end(), NameHashLess());
+    while (reads.size() > size_t(_opts.dense_region_sample)) {
+        std::pop_heap(reads.begin(), reads.end(), NameHashLess());
+        _drop_dense_read(*reads.back());
+        reads.pop_back();
+    }
+}
+
+void BreakDancer::_push_dense_read(Alignment::Ptr const& aln) {
+    ReadVector& reads = reads_in_current_region;
+    if (reads.size() < size_t(_opts.dense_region_sample)) {
+        reads.push_back(aln);
+        std::push_heap(reads.begin(), reads.end(), NameHashLess());
+    }
+    else if (!reads.empty() && NameHashLess()(aln, reads.front())) {
+        std::pop_heap(reads.begin(), reads.end(), NameHashLess());
+        _drop_dense_read(*reads.back());
+        reads.back() = aln;
+        std::push_heap(reads.begin(), reads.end(), NameHashLess());
+    }
+    else
+        _drop_dense_read(*aln);
+}
+
+void BreakDancer::_drop_dense_read(Alignment const& aln) {
+    // What collapse_accumulated_data_into_last_region would have done with
+    // it when the region closed
+    _rdata.erase_read(aln.query_name());
+    ++_dense_reads_dropped;
+}
+
+void BreakDancer::process_breakpoint(int next_tid, int next_pos) {
+    if (_hotspots) {
+        _hotspots->charge_region(_region_start_tid, _region_start_pos,
+            _region_read_count, reads_in_current_region.size());
+    }
+
+    if (!_region_too_dense && _opts.dense_region_sample > 0
+            && _region_coverage() >= _opts.seq_coverage_lim)
+    {
+        _start_dense_region();
+    }
+
+    // Dense regions are dropped, or kept with their sample if asked to
+    bool coverage_ok = _region_too_dense
+        ? _opts.dense_region_sample > 0
+        : _region_coverage() < _opts.seq_coverage_lim;
+
     if(_region_end_pos - _region_start_pos > _opts.min_len
-            && seq_coverage < _opts.seq_coverage_lim) // skip short/unreliable flanking supporting regions
+            && coverage_ok) // skip short/unreliable flanking supporting regions
     {
         // register reliable region and supporting reads across gaps
         //int region_idx = _rdata.add_region(new BasicRegion(_region_start_tid, _region_start_pos, _region_end_pos, _nnormal_reads));
@@ -252,7 +398,10 @@ void BreakDancer::process_breakpoint() {
         _rdata.add_region(_region_start_tid, _region_start_pos, _region_end_pos, _nnormal_reads, reads_in_current_region);
 
         ++_buffer_size; //increment tracking of number of regions in buffer???
-        if(_buffer_size > _opts.buffer_size){
+        if(!_opts.event_driven && _buffer_size > _opts.buffer_size){
+            // The stream is at the read that ended this region, so regions
+            // whose mates all lie in it are final and can be freed.
+            _rdata.set_stream_position(next_tid, next_pos);
             build_connection();
             //flush buffer by building connection
             _buffer_size = 0;
@@ -270,6 +419,8 @@ void BreakDancer::build_connection() {
     typedef ReadRegionData::Graph Graph;
     //Graph graph(_rdata.region_graph());
     Graph& graph = _rdata.persistent_graph();
+    TraceSpan span("build_connection", "regions", graph.num_vertices());
+    BD_PROBE1(build_connection_begin, graph.num_vertices());
 
     vector<int> active_nodes(graph.num_vertices());
     Graph::size_type i = 0;
@@ -277,6 +428,10 @@ void BreakDancer::build_connection() {
         active_nodes[i] = gi->first;
     }
 
+    // The traversal only depends on which regions exist, not on anything
+    // process_sv changes, so the candidates are gathered first and then
+    // evaluated together.
+    vector<SvEvaluation> candidates;
     Graph::iterator ii_graph = graph.begin();
     while (ii_graph != graph.end()) {
         vector<int> tails;
@@ -297,6 +452,8 @@ void BreakDancer::build_connection() {
                 if (found == graph.end())
                     continue;
 
+                double traversal_start = _hotspots ? HotspotProfiler::now() : 0;
+
                 Graph::EdgeMap& graph_tail = found->second;
                 Graph::EdgeMap::iterator ii_graph_tail = graph_tail.begin();
                 while (ii_graph_tail != graph_tail.end()) {
@@ -321,8 +478,11 @@ void BreakDancer::build_connection() {
                         snodes.push_back(s1);
 
                     newtails.push_back(s1);
-                    process_sv(snodes);
+                    candidates.push_back(SvEvaluation());
+                    candidates.back().snodes.swap(snodes);
                 }
+                if (_hotspots)
+                    _hotspots->charge_traversal(_rdata.region(tail), HotspotProfiler::now() - traversal_start);
                 if (tail == ii_graph->first) {
                     // The fact that this is postincrement is critical
                     graph.erase(ii_graph++);
@@ -336,6 +496,9 @@ void BreakDancer::build_connection() {
         if (need_iter_increment)
             ++ii_graph;
     }
+    BD_PROBE2(build_connection_end, active_nodes.size(), candidates.size());
+
+    _process_svs(candidates);
 
     for (vector<int>::const_iterator i = active_nodes.begin(); i != active_nodes.end(); ++i) {
         if (_rdata.is_region_final(*i))
@@ -345,27 +508,112 @@ void BreakDancer::build_connection() {
     graph.clear();
 }
 
+void BreakDancer::_process_ready_svs() {
+    vector<vector<int> > ready;
+    _rdata.take_ready_candidates(ready);
+    TraceSpan span("process_ready_svs", "candidates", ready.size());
+
+    vector<SvEvaluation> candidates(ready.size());
+    for (size_t i = 0; i < ready.size(); ++i)
+        candidates[i].snodes.swap(ready[i]);
+
+    _process_svs(candidates);
+    _rdata.clear_settled_regions();
+}
+
 void BreakDancer::process_sv(std::vector<int> const& snodes) {
+    SvEvaluation ev;
+    ev.snodes = snodes;
+    _evaluate_sv(ev);
+    _commit_sv(ev, 0);
+}
+
+void BreakDancer::_process_svs(std::vector<SvEvaluation>& svs) {
+    if (!_score_svs)
+        return;
+
+    if (_executor.num_workers() == 0 || svs.size() < MIN_PARALLEL_SVS) {
+        for (size_t i = 0; i < svs.size(); ++i) {
+            _evaluate_sv(svs[i]);
+            _commit_sv(svs[i], 0);
+        }
+        BD_PROBE1(output_flush, _svs_written);
+        return;
+    }
+
+    // A candidate that shares a region with an earlier one sees the reads
+    // that the earlier one's commit leaves behind, so it has to wait for
+    // that commit. The rest are evaluated up front, in parallel.
+    vector<size_t> independent;
+    boost::unordered_set<int> seen;
+    for (size_t i = 0; i < svs.size(); ++i) {
+        vector<int> const& snodes = svs[i].snodes;
+        bool shared = false;
+        for (size_t j = 0; j < snodes.size(); ++j)
+            shared |= !seen.insert(snodes[j]).second;
+        if (!shared)
+            independent.push_back(i);
+    }
+
+    _executor.parallel_for(independent.size(),
+        [&](size_t k) { _evaluate_sv(svs[independent[k]]); });
+
+    // Commit in traversal order. Earlier commits only free reads from
+    // their own regions, but a read name seen more than twice can also
+    // live elsewhere, so results that saw a freed read are redone.
+    boost::unordered_set<string> freed;
+    for (size_t i = 0; i < svs.size(); ++i) {
+        SvEvaluation& ev = svs[i];
+        if (!ev.svb || _saw_freed_read(ev, freed))
+            _evaluate_sv(ev);
+        _commit_sv(ev, &freed);
+    }
+    BD_PROBE1(output_flush, _svs_written);
+}
+
+bool BreakDancer::_saw_freed_read(SvEvaluation const& ev,
+        boost::unordered_set<std::string> const& freed) const
+{
+    if (freed.empty())
+        return false;
+
+    for (size_t i = 0; i < ev.snodes.size(); ++i) {
+        ReadVector const& reads = _rdata.region(ev.snodes[i]).reads();
+        for (ReadVector::const_iterator r = reads.begin(); r != reads.end(); ++r) {
+            if (freed.count((*r)->query_name()))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Must not modify any shared state: this runs concurrently for different
+// candidates.
+void BreakDancer::_evaluate_sv(SvEvaluation& ev) const {
+    TraceSpan span("process_sv");
+    if (!_hotspots) {
+        _score_sv(ev);
+        return;
+    }
+
+    double start = HotspotProfiler::now();
+    _score_sv(ev);
+    ev.seconds += HotspotProfiler::now() - start;
+}
+
+void BreakDancer::_score_sv(SvEvaluation& ev) const {
     typedef ReadRegionData::read_iter_range ReadRange;
+    std::vector<int> const& snodes = ev.snodes;
     BasicRegion const* regions[2] = {0};
     ReadRange read_ranges[2];
     for (size_t i = 0; i < snodes.size(); ++i) {
         int const& region_idx = snodes[i];
-        _rdata.incr_region_access_counter(region_idx);
         regions[i] = &_rdata.region(region_idx);
         read_ranges[i] = _rdata.region_reads_range(region_idx);
     }
-    SvBuilder svb(_opts, snodes.size(), regions, read_ranges, _max_readlen);
-
-    // This predicate takes a read and evaluates:
-    //      read_pair.count(read.query_name()) == 0
-    using boost::bind;
-    boost::function<bool(Alignment::Ptr const&)> is_supportive = bind(
-        std::equal_to<size_t>(), 0, bind(&SvBuilder::ObservedReads::count,
-            &svb.observed_reads, bind(&Alignment::query_name, _1)));
-
-    for (vector<int>::const_iterator i = snodes.begin(); i != snodes.end(); ++i)
-        _rdata.remove_reads_in_region_if(*i, is_supportive);
+    ev.svb.reset(new SvBuilder(_opts, snodes.size(), regions, read_ranges, _max_readlen));
+    ev.passed = false;
+    SvBuilder& svb = *ev.svb;
 
     if(svb.num_pairs < _opts.min_read_pair)
         return;
@@ -374,8 +622,7 @@ void BreakDancer::process_sv(std::vector<int> const& snodes) {
     if(svb.flag_counts[svb.flag] < _opts.min_read_pair)
         return;
 
-    string sptype;
-
+    ev.passed = true;
     // print out result
     ReadCountsByLib read_count_accumulator;
     if (snodes.size() == 2) {
@@ -451,20 +698,73 @@ void BreakDancer::process_sv(std::vector<int> const& snodes) {
     } // do bam for support reads; copy number will be done later
 
     svb.diffspan = int(diff/float(svb.flag_counts[svb.flag]) + 0.5);
-    sptype = sptype_tmp;
+    ev.sptype = sptype_tmp;
+
+    if (_lib_info._cfg.has_sample_roles()) {
+        for(
+            map<size_t, int>::const_iterator ii_type_lib_rc = svb.type_library_readcount[svb.flag].begin();
+            ii_type_lib_rc != svb.type_library_readcount[svb.flag].end();
+            ii_type_lib_rc ++)
+        {
+            LibraryConfig const& lib_config = _lib_info._cfg.library_config(ii_type_lib_rc->first);
+            if (lib_config.role == ROLE_TUMOR)
+                ev.tumor_support += ii_type_lib_rc->second;
+            else
+                ev.normal_support += ii_type_lib_rc->second;
+        }
+    }
 
 
     int total_region_size = _rdata.sum_of_region_sizes(snodes);
     real_type LogPvalue = ComputeProbScore(total_region_size, svb.type_library_readcount[svb.flag], svb.flag, _opts.fisher, _lib_info);
     real_type PhredQ_tmp = -10*LogPvalue/log(10);
-    int PhredQ = PhredQ_tmp>99 ? 99:int(PhredQ_tmp+0.5);
+    ev.phred_q = PhredQ_tmp>99 ? 99:int(PhredQ_tmp+0.5);
 
     // Convert the coordinates to base 1
     ++svb.pos[0];
     ++svb.pos[1];
-    if(PhredQ > _opts.score_threshold){
+}
+
+void BreakDancer::_commit_sv(SvEvaluation& ev,
+        boost::unordered_set<std::string>* freed)
+{
+    std::vector<int> const& snodes = ev.snodes;
+    SvBuilder& svb = *ev.svb;
+    for (size_t i = 0; i < snodes.size(); ++i)
+        _rdata.incr_region_access_counter(snodes[i]);
+
+    if (_hotspots) {
+        // Only the evaluation is timed; committing is cheap next to it
+        for (size_t i = 0; i < snodes.size(); ++i) {
+            if (_rdata.region_exists(snodes[i]))
+                _hotspots->charge_sv(_rdata.region(snodes[i]), ev.seconds / snodes.size());
+        }
+    }
+
+    // This predicate takes a read and evaluates:
+    //      read_pair.count(read.query_name()) == 0
+    using boost::bind;
+    boost::function<bool(Alignment::Ptr const&)> is_supportive = bind(
+        std::equal_to<size_t>(), 0, bind(&SvBuilder::ObservedReads::count,
+            &svb.observed_reads, bind(&Alignment::query_name, _1)));
+
+    for (vector<int>::const_iterator i = snodes.begin(); i != snodes.end(); ++i)
+        _rdata.remove_reads_in_region_if(*i, is_supportive);
+
+    if (!ev.passed)
+        return;
+
+    BD_PROBE4(process_sv, snodes.front(), snodes.back(), int(svb.flag), ev.phred_q);
+
+    int const& PhredQ = ev.phred_q;
+    string const& sptype = ev.sptype;
+    bool somatic = ev.normal_support <= _opts.max_normal_support;
+    if(PhredQ > _opts.score_threshold && (somatic || !_opts.somatic_only)){
+        TraceSpan span("write sv");
+        ++_svs_written;
         bam_header_t const* bam_header = _merged_reader.header();
-        cout << bam_header->target_name[svb.chr[0]]
+        ostream& out = *_out;
+        out << bam_header->target_name[svb.chr[0]]
             << "\t" << svb.pos[0]
             << "\t" << svb.fwd_read_count[0] << "+" << svb.rev_read_count[0] << "-"
             << "\t" << bam_header->target_name[svb.chr[1]]
@@ -478,7 +778,7 @@ void BreakDancer::process_sv(std::vector<int> const& snodes) {
             ;
 
         if(_opts.print_AF == 1)
-            cout <<  "\t" << svb.allele_frequency;
+            out <<  "\t" << svb.allele_frequency;
 
         if(_opts.CN_lib == 0 && svb.flag != ReadFlag::ARP_CTX){
             vector<string> const& bams = _lib_info._cfg.bam_files();
@@ -486,15 +786,21 @@ void BreakDancer::process_sv(std::vector<int> const& snodes) {
                 map<string, float>::const_iterator cniter = svb.copy_number.find(*iter);
 
                 if(cniter  == svb.copy_number.end())
-                    cout << "\tNA";
+                    out << "\tNA";
                 else {
-                    cout << "\t";
-                    cout << fixed;
-                    cout << setprecision(2) << cniter->second;
+                    out << "\t";
+                    out << fixed;
+                    out << setprecision(2) << cniter->second;
                 }
             }
         }
-        cout << "\n";
+
+        if (_lib_info._cfg.has_sample_roles()) {
+            out << "\t" << ev.tumor_support
+                << "\t" << ev.normal_support
+                << "\t" << (somatic ? "SOMATIC" : "GERMLINE");
+        }
+        out << "\n";
 
         if (_bed_writer) {
             _bed_writer->write(svb);
@@ -509,6 +815,8 @@ void BreakDancer::process_sv(std::vector<int> const& snodes) {
 
     std::for_each(svb.reads_to_free.begin(), svb.reads_to_free.end(),
         boost::bind(&ReadRegionData::erase_read, &_rdata, _1));
+    if (freed)
+        freed->insert(svb.reads_to_free.begin(), svb.reads_to_free.end());
 }
 
 void BreakDancer::dump_fastq(
@@ -534,10 +842,16 @@ void BreakDancer::dump_fastq(
 }
 
 void BreakDancer::process_final_region() {
-    if (reads_in_current_region.size() != 0) {
-        process_breakpoint();
+    if (reads_in_current_region.size() != 0 || _region_too_dense) {
+        process_breakpoint(
+            std::numeric_limits<int>::max(),
+            std::numeric_limits<int>::max());
     }
-    build_connection();
+    _rdata.set_end_of_stream();
+    if (_opts.event_driven)
+        _process_ready_svs();
+    else
+        build_connection();
 }
 
 void BreakDancer::set_read_density(std::string const& libName, float density) {
@@ -2,13 +2,20 @@
 
 #include "BasicRegion.hpp"
 #include "BedWriter.hpp" // FIXME: try to move this to io lib
+#include "DuplicateCollapser.hpp"
+#include "HotspotProfiler.hpp"
 #include "ReadCountsByLib.hpp"
 #include "ReadRegionData.hpp"
+#include "ReadTriage.hpp"
 #include "common/Timer.hpp"
+#include "io/DepthWriter.hpp"
 #include "io/FastqWriter.hpp"
 
+#include <boost/functional/hash.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <algorithm>
 #include <cassert>
@@ -17,6 +24,7 @@
 #include <iterator>
 #include <map>
 #include <numeric>
+#include <ostream>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -24,6 +32,8 @@
 
 class BamReaderBase;
 class IAlignmentClassifier;
+class SvBuilder;
+class TaskExecutor;
 struct LibraryInfo;
 struct Options;
 
@@ -40,8 +50,10 @@ public:
         LibraryInfo const& lib_info,
         ReadRegionData& read_regions,
         BamReaderBase& merged_reader,
+        TaskExecutor& executor,
         int max_read_window_size
         );
+    ~BreakDancer();
 
     void push_read(Alignment::Ptr const& aln);
     void build_connection();
@@ -52,7 +64,8 @@ public:
         _max_read_window_size = val;
     }
 
-    void process_breakpoint();
+    // Closes the current region; next_tid/next_pos is the read after it
+    void process_breakpoint(int next_tid, int next_pos);
     void process_final_region();
 
     void dump_fastq(ReadFlag const& flag, std::vector<Alignment::Ptr> const& support_reads);
@@ -61,7 +74,66 @@ public:
 
     void set_read_density(std::string const& libName, float density);
 
+    // Where calls are written; std::cout unless set
+    void set_output(std::ostream& out) {
+        _out = &out;
+    }
+
+    // Without scoring, regions are built and linked as usual but the
+    // candidate SVs are dropped (for --bench regions)
+    void set_score_svs(bool score_svs) {
+        _score_svs = score_svs;
+    }
+
 private:
+    // Regions with fewer reads than this are held whole until they close,
+    // so the -x check on them is exact.
+    enum { MIN_DENSE_REGION_READS = 10000 };
+
+    // Batches of fewer candidates than this (e.g., those of one small
+    // contig in event driven mode) are not worth handing to the workers.
+    enum { MIN_PARALLEL_SVS = 16 };
+
+    // Orders reads by a hash of their name
+    struct NameHashLess {
+        bool operator()(Alignment::Ptr const& a, Alignment::Ptr const& b) const {
+            boost::hash<std::string> hash;
+            return hash(a->query_name()) < hash(b->query_name());
+        }
+    };
+
+    // What process_sv works out for a pair of regions before it touches
+    // any shared state.
+    struct SvEvaluation {
+        SvEvaluation() : passed(false), phred_q(0), tumor_support(0), normal_support(0), seconds(0) {}
+
+        std::vector<int> snodes;
+        boost::shared_ptr<SvBuilder> svb;
+        bool passed; // enough supporting pairs to be scored
+        std::string sptype;
+        int phred_q;
+        // Supporting pairs by sample role, if the config assigns roles
+        int tumor_support;
+        int normal_support;
+        // Time spent evaluating it, for --hotspots
+        double seconds;
+    };
+
+    void _push_read_counts(Alignment const& aln);
+    float _region_coverage() const;
+    void _start_dense_region();
+    void _push_dense_read(Alignment::Ptr const& aln);
+    void _drop_dense_read(Alignment const& aln);
+    std::string const& _read_count_key(Alignment const& aln) const;
+
+    void _process_ready_svs();
+    void _process_svs(std::vector<SvEvaluation>& svs);
+    void _evaluate_sv(SvEvaluation& ev) const;
+    void _score_sv(SvEvaluation& ev) const;
+    void _commit_sv(SvEvaluation& ev, boost::unordered_set<std::string>* freed);
+    bool _saw_freed_read(SvEvaluation const& ev,
+        boost::unordered_set<std::string> const& freed) const;
+
     uint32_t _region_lib_counts(size_t region_idx, std::string const& lib, RoiReadCounts const& x) const {
         if (region_idx >= x.size())
             return 0;
@@ -77,7 +149,9 @@ private: // data
     LibraryInfo const& _lib_info;
     ReadRegionData& _rdata;
     BamReaderBase& _merged_reader;
+    TaskExecutor& _executor;
     int _max_read_window_size;
+    ReadTriage _triage;
 
     bool _collecting_normal_reads;
     int _nnormal_reads;
@@ -90,10 +164,25 @@ private: // data
     int _region_end_tid; // global (chr, should be int in samtools)
     int _region_end_pos; // global
 
+    // Once the region counts as too dense (when it closes, or earlier with
+    // --dense-region-early), only a sample of its reads (of
+    // --dense-region-sample, possibly none) stays in
+    // reads_in_current_region, as a heap ordered by NameHashLess.
+    std::size_t _region_read_count;
+    bool _region_too_dense;
+    uint64_t _dense_regions;
+    uint64_t _dense_reads_dropped;
+
     ReadVector reads_in_current_region;
+    std::ostream* _out;
+    uint64_t _svs_written;
+    bool _score_svs;
     boost::scoped_ptr<FastqWriter> _fastq_writer;
+    boost::scoped_ptr<DepthWriter> _depth_writer;
+    boost::scoped_ptr<DuplicateCollapser> _duplicate_collapser;
     boost::scoped_ptr<std::ofstream> _bed_stream;
     boost::scoped_ptr<BedWriter> _bed_writer;
+    boost::scoped_ptr<HotspotProfiler> _hotspots;
 
     std::map<std::string, float> _read_density;
 };
@@ -0,0 +1,97 @@
+#include "DuplicateCollapser.hpp"
+
+#include "io/Alignment.hpp"
+
+#include <boost/functional/hash.hpp>
+
+using namespace std;
+
+bool DuplicateCollapser::PairKey::operator==(PairKey const& rhs) const {
+    return lib_index == rhs.lib_index
+        && mate_tid == rhs.mate_tid
+        && mate_pos == rhs.mate_pos
+        && reverse == rhs.reverse
+        && mate_reverse == rhs.mate_reverse;
+}
+
+std::size_t hash_value(DuplicateCollapser::PairKey const& key) {
+    size_t seed = 0;
+    boost::hash_combine(seed, key.lib_index);
+    boost::hash_combine(seed, key.mate_tid);
+    boost::hash_combine(seed, key.mate_pos);
+    boost::hash_combine(seed, key.reverse);
+    boost::hash_combine(seed, key.mate_reverse);
+    return seed;
+}
+
+bool DuplicateCollapser::PendingMate::operator<(PendingMate const& rhs) const {
+    if (tid != rhs.tid)
+        return tid < rhs.tid;
+    if (pos != rhs.pos)
+        return pos < rhs.pos;
+    return name < rhs.name;
+}
+
+DuplicateCollapser::DuplicateCollapser()
+    : _tid(-1)
+    , _pos(-1)
+    , _duplicates(0)
+{
+}
+
+bool DuplicateCollapser::is_duplicate(Alignment const& aln) {
+    if (aln.tid() != _tid || aln.pos() != _pos)
+        _move_to(aln.tid(), aln.pos());
+
+    // The second end of a pair that lost at its first end
+    PendingMate pending = {aln.tid(), aln.pos(), aln.query_name()};
+    set<PendingMate>::iterator found = _pending.find(pending);
+    if (found != _pending.end()) {
+        _pending.erase(found);
+        ++_duplicates;
+        return true;
+    }
+
+    // Pairs with both ends at the same position are decided at each end
+    bool first_end = aln.tid() < aln.mate_tid()
+        || (aln.tid() == aln.mate_tid() && aln.pos() <= aln.mate_pos());
+    if (!first_end)
+        return false;
+
+    PairKey key = {
+        aln.lib_index(),
+        aln.mate_tid(),
+        aln.mate_pos(),
+        bool(aln.sam_flag() & BAM_FREVERSE),
+        bool(aln.sam_flag() & BAM_FMREVERSE)
+    };
+    bool same_position = aln.tid() == aln.mate_tid() && aln.pos() == aln.mate_pos();
+    typedef boost::unordered_map<PairKey, string>::iterator IterType;
+    pair<IterType, bool> inserted = _here.insert(make_pair(key, string()));
+    if (inserted.second) {
+        if (same_position)
+            inserted.first->second = aln.query_name();
+        return false;
+    }
+
+    // Both ends on the same strand at the same position look alike; the
+    // second is the mate of the pair that was kept, not a duplicate
+    if (same_position && inserted.first->second == aln.query_name())
+        return false;
+
+    pending.tid = aln.mate_tid();
+    pending.pos = aln.mate_pos();
+    _pending.insert(pending);
+    ++_duplicates;
+    return true;
+}
+
+void DuplicateCollapser::_move_to(int32_t tid, int32_t pos) {
+    _tid = tid;
+    _pos = pos;
+    _here.clear();
+
+    // Mates the stream has gone past without seeing (filtered out, say)
+    PendingMate here = {tid, pos, string()};
+    _pending.erase(_pending.begin(), _pending.lower_bound(here));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <boost/unordered_map.hpp>
+
+#include <cstddef>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+class Alignment;
+
+// Drops PCR duplicate read pairs from a sorted stream of discordant reads,
+// for bams that have not been through duplicate marking. Two pairs are
+// duplicates if they come from the same library and both their ends are
+// at the same positions on the same strands.
+//
+// The first end of a pair decides: of the duplicates starting at one
+// position, the first one seen is kept. The other ends of the pairs that
+// lost are remembered until the stream gets to them, so the same pairs
+// are dropped at both ends. Only reads at the current position and those
+// pending mates are held.
+class DuplicateCollapser {
+public:
+    DuplicateCollapser();
+
+    // Reads must be passed in coordinate order.
+    bool is_duplicate(Alignment const& aln);
+
+    uint64_t duplicates() const;
+    std::size_t pending_mates() const;
+
+private:
+    struct PairKey {
+        std::size_t lib_index;
+        int32_t mate_tid;
+        int32_t mate_pos;
+        bool reverse;
+        bool mate_reverse;
+
+        bool operator==(PairKey const& rhs) const;
+    };
+    friend std::size_t hash_value(PairKey const& key);
+
+    // tid, pos, name of the other end of a dropped pair
+    struct PendingMate {
+        int32_t tid;
+        int32_t pos;
+        std::string name;
+
+        bool operator<(PendingMate const& rhs) const;
+    };
+
+    void _move_to(int32_t tid, int32_t pos);
+
+private:
+    int32_t _tid;
+    int32_t _pos;
+    // First ends kept at _tid:_pos, with the read name for pairs that
+    // have both ends here (so that the mate is not taken for a duplicate)
+    boost::unordered_map<PairKey, std::string> _here;
+    std::set<PendingMate> _pending;
+    uint64_t _duplicates;
+};
+
+inline
+uint64_t DuplicateCollapser::duplicates() const {
+    return _duplicates;
+}
+
+inline
+std::size_t DuplicateCollapser::pending_mates() const {
+    return _pending.size();
+}
@@ -0,0 +1,84 @@
+#include "Evidence.hpp"
+
+#include "ReadTriage.hpp"
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "io/AlignmentBuilder.hpp"
+#include "io/BamIo.hpp"
+#include "io/EvidenceFile.hpp"
+#include "io/LibraryInfo.hpp"
+#include "io/RecordBatch.hpp"
+
+#include <boost/format.hpp>
+
+#include <memory>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    void write_evidence_file(
+            Options const& opts,
+            LibraryInfo const& lib_info,
+            IAlignmentClassifier const& read_classifier,
+            size_t bam_index,
+            TaskExecutor& executor)
+    {
+        BamConfig const& cfg = lib_info._cfg;
+        string const& bam_path = cfg.bam_files()[bam_index];
+        auto_ptr<BamReaderBase> reader(openBam(bam_path, opts.chr, &executor, io_options(opts)));
+
+        EvidenceSummary summary;
+        if (summary.parse_header(reader->header())) {
+            throw runtime_error(str(format(
+                "%1% is already an evidence file") % bam_path));
+        }
+
+        summary.bin_size = opts.evidence_bin_size;
+        summary.covered_ref_len = lib_info._summary.covered_reference_length();
+        summary.read_count = lib_info._summary.read_count_in_bam(bam_path);
+        for (size_t i = 0; i < cfg.num_libs(); ++i) {
+            LibraryConfig const& lib = cfg.library_config(i);
+            if (lib.bam_file_index == bam_index)
+                summary.libraries[lib.name] = lib_info._summary.library_flag_distribution(i);
+        }
+
+        EvidenceWriter writer(evidence_path(opts.evidence_prefix, bam_path),
+            reader->header(), summary, cfg.num_libs());
+
+        ReadTriage triage(opts, lib_info);
+        AlignmentBuilder make_alignment(read_classifier, cfg, false);
+        RecordBatch batch;
+        while (reader->next_batch(batch)) {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                bam1_t const* record = batch[i];
+                Alignment::Ptr aln = make_alignment(record);
+                ReadTriage::Fate fate = triage(*aln);
+                if (fate == ReadTriage::DISCORDANT) {
+                    writer.add_read(record);
+                }
+                else if (fate != ReadTriage::IGNORED) {
+                    // Whether normal reads add to the region being built
+                    // is decided when the counts are replayed.
+                    writer.count_read(record, aln->lib_index(),
+                        aln->proper_pair(),
+                        fate == ReadTriage::NORMAL && aln->leftmost());
+                }
+            }
+        }
+        writer.close();
+    }
+}
+
+void write_evidence_files(
+        Options const& opts,
+        LibraryInfo const& lib_info,
+        IAlignmentClassifier const& read_classifier,
+        TaskExecutor& executor
+        )
+{
+    executor.parallel_for(lib_info._cfg.num_bams(), [&](size_t i) {
+        write_evidence_file(opts, lib_info, read_classifier, i, executor);
+    });
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+class IAlignmentClassifier;
+class TaskExecutor;
+struct LibraryInfo;
+struct Options;
+
+// Write an evidence file (see io/EvidenceFile.hpp) for each bam in the
+// config, named by evidence_path(opts.evidence_prefix, bam). The bams are
+// read again, in parallel if the executor has workers.
+void write_evidence_files(
+    Options const& opts,
+    LibraryInfo const& lib_info,
+    IAlignmentClassifier const& read_classifier,
+    TaskExecutor& executor
+    );
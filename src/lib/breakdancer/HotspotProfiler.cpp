@@ -0,0 +1,197 @@
+#include "HotspotProfiler.hpp"
+
+#include "BasicRegion.hpp"
+
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    template<typename T>
+    bool costlier(T const* a, T const* b) {
+        return a->second.total() > b->second.total()
+            || (a->second.total() == b->second.total() && a->first < b->first);
+    }
+
+    void open_output(ofstream& out, string const& path) {
+        out.open(path.c_str());
+        if (!out)
+            throw runtime_error(str(format("Failed to open hotspot file '%1%' for writing") % path));
+    }
+}
+
+HotspotProfiler::HotspotProfiler(std::string const& prefix, bam_header_t const* header, int window_size)
+    : _prefix(prefix)
+    , _header(header)
+    , _window_size(window_size)
+{
+    if (window_size <= 0)
+        throw runtime_error(str(format("Invalid hotspot window size %1%") % window_size));
+}
+
+double HotspotProfiler::now() {
+    return boost::chrono::duration<double>(
+        boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+HotspotProfiler::WindowCost& HotspotProfiler::_window(int32_t tid, int32_t pos) {
+    return _windows[WindowKey(tid, max(pos, 0) / _window_size)];
+}
+
+void HotspotProfiler::charge_decode(std::vector<Alignment::Ptr> const& reads, double seconds) {
+    size_t n = 0;
+    for (size_t i = 0; i < reads.size(); ++i)
+        n += reads[i]->tid() >= 0;
+    if (n == 0)
+        return;
+
+    // Reads come sorted, so most of them land in the window before
+    double share = seconds / n;
+    WindowCost* window = 0;
+    WindowKey key(-1, -1);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        Alignment const& aln = *reads[i];
+        if (aln.tid() < 0)
+            continue;
+
+        WindowKey here(aln.tid(), max(aln.pos(), 0) / _window_size);
+        if (!window || here != key) {
+            key = here;
+            window = &_windows[key];
+        }
+        window->decode += share;
+        ++window->reads;
+    }
+}
+
+void HotspotProfiler::charge_region(int32_t tid, int32_t pos, std::size_t reads_seen, std::size_t reads_held) {
+    if (tid < 0 || reads_seen == 0)
+        return;
+
+    WindowCost& window = _window(tid, pos);
+    ++window.regions;
+    window.max_held = max(window.max_held, uint64_t(reads_held));
+}
+
+void HotspotProfiler::charge_traversal(BasicRegion const& region, double seconds) {
+    _window(region.chr, region.start).traversal += seconds;
+    _open_regions[region.index].traversal += seconds;
+}
+
+void HotspotProfiler::charge_sv(BasicRegion const& region, double seconds) {
+    WindowCost& window = _window(region.chr, region.start);
+    window.sv += seconds;
+    ++window.candidates;
+    _open_regions[region.index].sv += seconds;
+}
+
+void HotspotProfiler::region_done(BasicRegion const& region) {
+    boost::unordered_map<int, RegionCost>::iterator found = _open_regions.find(region.index);
+    RegionCost cost;
+    if (found != _open_regions.end()) {
+        cost = found->second;
+        _open_regions.erase(found);
+    }
+    cost.index = region.index;
+    cost.tid = region.chr;
+    cost.start = region.start;
+    cost.end = region.end;
+    cost.reads = region.fwd_read_count + region.rev_read_count;
+    cost.times_accessed = region.times_accessed;
+    cost.times_collapsed = region.times_collapsed;
+
+    if (_regions.size() < size_t(MAX_REGIONS)) {
+        _regions.push_back(cost);
+        push_heap(_regions.begin(), _regions.end(), CostlierRegion());
+    }
+    else if (CostlierRegion()(cost, _regions.front())) {
+        pop_heap(_regions.begin(), _regions.end(), CostlierRegion());
+        _regions.back() = cost;
+        push_heap(_regions.begin(), _regions.end(), CostlierRegion());
+    }
+}
+
+void HotspotProfiler::write() const {
+    ofstream table;
+    open_output(table, _prefix + ".hotspots.txt");
+    write_table(table);
+
+    ofstream bedgraph;
+    open_output(bedgraph, _prefix + ".hotspots.bedGraph");
+    write_bedgraph(bedgraph);
+
+    if (!table || !bedgraph)
+        throw runtime_error(str(format("Failed to write hotspot files %1%.hotspots.*") % _prefix));
+}
+
+void HotspotProfiler::write_table(std::ostream& out) const {
+    vector<WindowMap::value_type const*> windows;
+    for (WindowMap::const_iterator i = _windows.begin(); i != _windows.end(); ++i)
+        windows.push_back(&*i);
+    sort(windows.begin(), windows.end(), costlier<WindowMap::value_type>);
+
+    out << fixed << setprecision(6);
+    out << "#Window rank\tchr\tstart\tend\ttotal_s\tdecode_s\ttraversal_s\tsv_s"
+        "\treads\tmax_reads_held\tregions\tcandidates\n";
+    for (size_t i = 0; i < windows.size(); ++i) {
+        WindowKey const& key = windows[i]->first;
+        WindowCost const& cost = windows[i]->second;
+        int64_t start = int64_t(key.second) * _window_size;
+        int64_t end = min(start + _window_size, int64_t(_header->target_len[key.first]));
+        out << i + 1
+            << "\t" << _header->target_name[key.first]
+            << "\t" << start
+            << "\t" << end
+            << "\t" << cost.total()
+            << "\t" << cost.decode
+            << "\t" << cost.traversal
+            << "\t" << cost.sv
+            << "\t" << cost.reads
+            << "\t" << cost.max_held
+            << "\t" << cost.regions
+            << "\t" << cost.candidates
+            << "\n";
+    }
+
+    vector<RegionCost> regions(_regions);
+    sort(regions.begin(), regions.end(), CostlierRegion());
+    out << "#Region rank\tindex\tchr\tstart\tend\ttotal_s\ttraversal_s\tsv_s"
+        "\treads\ttimes_accessed\ttimes_collapsed\n";
+    for (size_t i = 0; i < regions.size(); ++i) {
+        RegionCost const& r = regions[i];
+        out << i + 1
+            << "\t" << r.index
+            << "\t" << _header->target_name[r.tid]
+            << "\t" << r.start
+            << "\t" << r.end + 1
+            << "\t" << r.total()
+            << "\t" << r.traversal
+            << "\t" << r.sv
+            << "\t" << r.reads
+            << "\t" << r.times_accessed
+            << "\t" << r.times_collapsed
+            << "\n";
+    }
+}
+
+void HotspotProfiler::write_bedgraph(std::ostream& out) const {
+    out << fixed << setprecision(6);
+    out << "track type=bedGraph name=\"breakdancer seconds\"\n";
+    for (WindowMap::const_iterator i = _windows.begin(); i != _windows.end(); ++i) {
+        WindowKey const& key = i->first;
+        int64_t start = int64_t(key.second) * _window_size;
+        int64_t end = min(start + _window_size, int64_t(_header->target_len[key.first]));
+        out << _header->target_name[key.first]
+            << "\t" << start
+            << "\t" << end
+            << "\t" << i->second.total()
+            << "\n";
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "io/Alignment.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <bam.h>
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class BasicRegion;
+
+// Where a run spends its time and memory along the genome (--hotspots).
+// Costs are charged to fixed size windows and to the regions that
+// build_connection and process_sv work on:
+//
+//   decode:    waiting for the next batch of reads, spread over its reads
+//   traversal: build_connection following the links of a region
+//   sv:        process_sv scoring a candidate, split between its regions
+//   held:      the most reads held in reads_in_current_region while a
+//              region was open
+//
+// Times are wall clock seconds on the thread that runs BreakDancer.
+// write() ranks the windows, and the MAX_REGIONS costliest regions, by
+// time in PREFIX.hotspots.txt and writes the time per window to
+// PREFIX.hotspots.bedGraph. Coordinates in both are as in bed files.
+class HotspotProfiler : public boost::noncopyable {
+public:
+    enum { MAX_REGIONS = 1000 };
+
+    HotspotProfiler(std::string const& prefix, bam_header_t const* header, int window_size);
+
+    // Seconds on a steady clock, for measuring what to charge
+    static double now();
+
+    void charge_decode(std::vector<Alignment::Ptr> const& reads, double seconds);
+    // A region (kept or not) starting at tid:pos has closed
+    void charge_region(int32_t tid, int32_t pos, std::size_t reads_seen, std::size_t reads_held);
+    void charge_traversal(BasicRegion const& region, double seconds);
+    void charge_sv(BasicRegion const& region, double seconds);
+
+    // Call once for every region before it is freed; its counters are
+    // final then.
+    void region_done(BasicRegion const& region);
+
+    void write() const;
+    void write_table(std::ostream& out) const;
+    void write_bedgraph(std::ostream& out) const;
+
+private:
+    struct WindowCost {
+        WindowCost()
+            : decode(0), traversal(0), sv(0), reads(0), max_held(0), regions(0), candidates(0)
+        {
+        }
+
+        double total() const { return decode + traversal + sv; }
+
+        double decode;
+        double traversal;
+        double sv;
+        uint64_t reads;
+        uint64_t max_held;
+        uint64_t regions;
+        uint64_t candidates;
+    };
+
+    struct RegionCost {
+        RegionCost()
+            : index(-1), tid(-1), start(0), end(0), traversal(0), sv(0), reads(0)
+            , times_accessed(0), times_collapsed(0)
+        {
+        }
+
+        double total() const { return traversal + sv; }
+
+        int index;
+        int tid;
+        int start;
+        int end;
+        double traversal;
+        double sv;
+        int reads;
+        int times_accessed;
+        int times_collapsed;
+    };
+
+    // Orders the kept regions so that the cheapest is on top of the heap
+    struct CostlierRegion {
+        bool operator()(RegionCost const& a, RegionCost const& b) const {
+            return a.total() > b.total() || (a.total() == b.total() && a.index < b.index);
+        }
+    };
+
+    typedef std::pair<int32_t, int32_t> WindowKey;
+    typedef std::map<WindowKey, WindowCost> WindowMap;
+
+    WindowCost& _window(int32_t tid, int32_t pos);
+
+private:
+    std::string _prefix;
+    bam_header_t const* _header;
+    int _window_size;
+    WindowMap _windows;
+    // Regions charged something that are not done yet
+    boost::unordered_map<int, RegionCost> _open_regions;
+    // A heap of the costliest regions that are done
+    std::vector<RegionCost> _regions;
+};
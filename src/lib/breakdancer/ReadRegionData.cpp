@@ -1,8 +1,11 @@
 #include "ReadRegionData.hpp"
+#include "common/Probes.hpp"
 #include "common/Timer.hpp"
 
 #include <boost/format.hpp>
 #include <boost/bind.hpp>
+
+#include <algorithm>
 #include <iostream>
 
 using std::cerr;
@@ -68,12 +71,80 @@ void ReadRegionData::summary(std::ostream& out) const {
 }
 
 void ReadRegionData::accumulate_reads_between_regions(ReadCountsByLib& acc, size_t begin, size_t end) const {
-    for(size_t i = begin; i < std::min(end, _read_count_ROI_map.size()); i++){
-        acc += _read_count_ROI_map[i];
+    end = std::min(end, _read_count_ROI_map.size());
+    _accumulate_counts(acc, _read_count_ROI_map, _ROI_count_prefixes, begin, end);
+
+    // flanking region doesn't contain the first node
+    _accumulate_counts(acc, _read_count_FR_map, _FR_count_prefixes, begin + 1, end);
+}
+
+void ReadRegionData::_accumulate_counts(ReadCountsByLib& acc, RoiReadCounts const& counts,
+        std::vector<CountPrefix> const& prefixes, size_t begin, size_t end)
+{
+    end = std::min(end, counts.size());
+    if (begin >= end)
+        return;
 
-        // flanking region doesn't contain the first node
-        if(i > begin && i < _read_count_FR_map.size())
-            acc += _read_count_FR_map[i];
+    size_t const interval = COUNT_CHECKPOINT_INTERVAL;
+    size_t first = (begin + interval - 1) / interval;
+    size_t last = prefixes.empty() ? 0 : std::min(end / interval, prefixes.size() - 1);
+    if (first >= last) {
+        for (size_t i = begin; i < end; ++i)
+            acc += counts[i];
+        return;
+    }
+
+    for (size_t i = begin; i < first * interval; ++i)
+        acc += counts[i];
+
+    // A library gets an entry (maybe 0) iff one of the regions has one,
+    // as if the regions had been added up one by one.
+    CountPrefix const& before = prefixes[first];
+    CountPrefix const& after = prefixes[last];
+    for (CountPrefix::const_iterator i = after.begin(); i != after.end(); ++i) {
+        uint32_t sum = i->second.first;
+        uint32_t present = i->second.second;
+        CountPrefix::const_iterator found = before.find(i->first);
+        if (found != before.end()) {
+            sum -= found->second.first;
+            present -= found->second.second;
+        }
+        if (present)
+            acc[i->first] += sum;
+    }
+
+    for (size_t i = last * interval; i < end; ++i)
+        acc += counts[i];
+}
+
+void ReadRegionData::_add_count_checkpoint(size_t end_region_idx) {
+    // Only the last region's counts can still change, so everything
+    // before end_region_idx is settled.
+    if (_ROI_count_prefixes.empty()) {
+        _ROI_count_prefixes.push_back(CountPrefix());
+        _FR_count_prefixes.push_back(CountPrefix());
+    }
+
+    size_t begin = (_ROI_count_prefixes.size() - 1) * COUNT_CHECKPOINT_INTERVAL;
+    assert(begin + COUNT_CHECKPOINT_INTERVAL == end_region_idx);
+
+    _ROI_count_prefixes.push_back(_ROI_count_prefixes.back());
+    _FR_count_prefixes.push_back(_FR_count_prefixes.back());
+    for (size_t i = begin; i < end_region_idx; ++i) {
+        typedef ReadCountsByLib::const_iterator IterType;
+        ReadCountsByLib const& roi = _read_count_ROI_map[i];
+        for (IterType j = roi.begin(); j != roi.end(); ++j) {
+            std::pair<uint32_t, uint32_t>& entry = _ROI_count_prefixes.back()[j->first];
+            entry.first += j->second;
+            ++entry.second;
+        }
+
+        ReadCountsByLib const& fr = _read_count_FR_map[i];
+        for (IterType j = fr.begin(); j != fr.end(); ++j) {
+            std::pair<uint32_t, uint32_t>& entry = _FR_count_prefixes.back()[j->first];
+            entry.first += j->second;
+            ++entry.second;
+        }
     }
 }
 
@@ -89,11 +160,19 @@ uint32_t ReadRegionData::region_lib_read_count(size_t region_idx, std::string co
 size_t ReadRegionData::add_region(int start_tid, int start_pos, int end_pos, int normal_reads,
         ReadVector& reads)
 {
+    // The region that was last until now can be final from here on
+    if (_opts.event_driven)
+        _release_held_events();
+
     size_t region_idx = _regions.size();
     _regions.push_back(new BasicRegion(region_idx, start_tid, start_pos, end_pos, normal_reads));
+    BD_PROBE5(add_region, region_idx, start_tid, start_pos, end_pos, reads.size());
     _add_current_read_counts_to_region(region_idx);
+    if (region_idx > 0 && region_idx % COUNT_CHECKPOINT_INTERVAL == 0)
+        _add_count_checkpoint(region_idx);
 
     int non_ctx_reads(0);
+    std::vector<int> partners;
 
     // This adds the region id to an array of region ids
     for(ReadVector::const_iterator iter = reads.begin(); iter != reads.end(); ++iter) {
@@ -109,36 +188,232 @@ size_t ReadRegionData::add_region(int start_tid, int start_pos, int end_pos, int
         std::vector<int>& regions = _read_regions[aln.query_name()];
         regions.push_back(region_idx);
         if (regions.size() == 2) {
-            _persistent_graph.increment_edge_weight(regions[0], regions[1]);
+            if (!_opts.event_driven) {
+                _persistent_graph.increment_edge_weight(regions[0], regions[1]);
+            }
+            else if (region_exists(regions[0])) {
+                // Links to a region that was already cleared can never
+                // be scored, so they are not counted at all.
+                _persistent_graph.increment_edge_weight(regions[0], regions[1]);
+                if (_persistent_graph.get_edge_weight_default(regions[0], regions[1], 0) == _opts.min_read_pair)
+                    partners.push_back(regions[0]);
+            }
         }
     }
 
     // we're essentially destroying reads_in_current_region here by swapping it with whatever
     //reads this region had (probably none) this is ok because it is just about to be cleared anyway.
     int valid_reads = _opts.chr.empty() ? reads.size() : non_ctx_reads;
-    if (valid_reads >= _opts.min_read_pair) {
+    bool keep_reads = valid_reads >= _opts.min_read_pair;
+    if (keep_reads) {
         swap_reads_in_region(region_idx, reads);
     }
 
+    // Reads whose mates have not shown up yet either wait in the pending
+    // queue or, if the stream is already past their mate, are dropped
+    // right away. Only reads the region actually holds move its horizon.
+    BasicRegion& region = *_regions[region_idx];
+    ReadVector const& tracked = keep_reads ? region.reads() : reads;
+    bool dirty = false;
+    for(ReadVector::const_iterator iter = tracked.begin(); iter != tracked.end(); ++iter) {
+        auto const& aln = **iter;
+        if (!_opts.chr.empty() && aln.bdflag() == ReadFlag::ARP_CTX)
+            continue;
+
+        int mtid = aln.mate_tid();
+        int mpos = aln.mate_pos();
+        if (keep_reads && (mtid > region.mate_horizon_tid
+                || (mtid == region.mate_horizon_tid && mpos > region.mate_horizon_pos)))
+        {
+            region.mate_horizon_tid = mtid;
+            region.mate_horizon_pos = mpos;
+        }
+
+        ReadsToRegionsMap::const_iterator found = _read_regions.find(aln.query_name());
+        if (found == _read_regions.end() || found->second.size() != 1)
+            continue;
+
+        if (_stream_passed(mtid, mpos))
+            dirty |= _evict_orphan(region_idx, aln.query_name());
+        else
+            _pending_mates.push(PendingMate(mtid, mpos, region_idx, aln.query_name()));
+    }
+
+    if (dirty && keep_reads)
+        _compact_region(region_idx);
+
+    if (_opts.event_driven)
+        _track_candidates(region_idx, partners);
+
     return region_idx;
 }
 
+void ReadRegionData::_track_candidates(size_t region_idx, std::vector<int> const& partners) {
+    BasicRegion& region = *_regions[region_idx];
+    _unsettled_regions.push(HorizonEvent(region.mate_horizon_tid, region.mate_horizon_pos,
+        region_idx, region_idx));
+
+    // A link count only grows while the later of its two regions is being
+    // added, so these are final already. The regions are not, and scoring
+    // has to wait until both are.
+    for (std::vector<int>::const_iterator i = partners.begin(); i != partners.end(); ++i) {
+        BasicRegion& partner = *_regions[*i];
+        ++region.open_candidates;
+        if (size_t(*i) != region_idx)
+            ++partner.open_candidates;
+
+        int tid = region.mate_horizon_tid;
+        int pos = region.mate_horizon_pos;
+        if (partner.mate_horizon_tid > tid
+            || (partner.mate_horizon_tid == tid && partner.mate_horizon_pos > pos))
+        {
+            tid = partner.mate_horizon_tid;
+            pos = partner.mate_horizon_pos;
+        }
+        _pending_candidates.push(HorizonEvent(tid, pos,
+            std::min(*i, int(region_idx)), std::max(*i, int(region_idx))));
+    }
+}
+
+void ReadRegionData::_release_held_events() {
+    for (std::vector<HorizonEvent>::const_iterator i = _held_events.begin(); i != _held_events.end(); ++i) {
+        if (i->first == i->second)
+            _unsettled_regions.push(*i);
+        else
+            _pending_candidates.push(*i);
+    }
+    _held_events.clear();
+}
+
+void ReadRegionData::take_ready_candidates(std::vector<std::vector<int> >& candidates) {
+    // Settle regions first: a candidate never comes due before its regions
+    while (!_unsettled_regions.empty()) {
+        HorizonEvent const& event = _unsettled_regions.top();
+        if (!_stream_passed(event.tid, event.pos))
+            break;
+
+        if (_involves_last_region(event)) {
+            _held_events.push_back(event);
+        }
+        else if (region_exists(event.first)) {
+            BasicRegion& region = *_regions[event.first];
+            region.settled = true;
+            if (region.open_candidates == 0)
+                _clearable_regions.push_back(event.first);
+        }
+        _unsettled_regions.pop();
+    }
+
+    while (!_pending_candidates.empty()) {
+        HorizonEvent const& event = _pending_candidates.top();
+        if (!_stream_passed(event.tid, event.pos))
+            break;
+
+        if (_involves_last_region(event)) {
+            _held_events.push_back(event);
+        }
+        else {
+            std::vector<int> snodes(1, event.first);
+            if (event.second != event.first)
+                snodes.push_back(event.second);
+            candidates.push_back(snodes);
+
+            _persistent_graph.erase_edge(event.first, event.second);
+            _release_candidate(event.first);
+            if (event.second != event.first)
+                _release_candidate(event.second);
+        }
+        _pending_candidates.pop();
+    }
+}
+
+void ReadRegionData::_release_candidate(int region_idx) {
+    BasicRegion& region = *_regions[region_idx];
+    if (--region.open_candidates == 0 && region.settled)
+        _clearable_regions.push_back(region_idx);
+}
+
+void ReadRegionData::clear_settled_regions() {
+    for (std::vector<int>::const_iterator i = _clearable_regions.begin(); i != _clearable_regions.end(); ++i) {
+        if (!region_exists(*i) || _regions[*i]->open_candidates != 0)
+            continue;
+
+        _erase_from_graph(*i);
+        clear_region(*i);
+    }
+    _clearable_regions.clear();
+}
+
+void ReadRegionData::_erase_from_graph(int region_idx) {
+    Graph::iterator found = _persistent_graph.find(region_idx);
+    if (found == _persistent_graph.end())
+        return;
+
+    // Links that never reached min_read_pair; nothing will come of them now
+    Graph::EdgeMap const& edges = found->second;
+    for (Graph::EdgeMap::const_iterator i = edges.begin(); i != edges.end(); ++i) {
+        if (i->first != region_idx) {
+            Graph::iterator other = _persistent_graph.find(i->first);
+            if (other != _persistent_graph.end())
+                other->second.erase(region_idx);
+        }
+    }
+    _persistent_graph.erase(found);
+}
+
 bool ReadRegionData::is_region_final(size_t region_idx) const {
-    if (!region_exists(region_idx) || region_idx == last_region_idx())
+    if (!region_exists(region_idx) || (region_idx == last_region_idx() && !_end_of_stream))
         return false;
 
-    ReadVector const& v = _reads_in_region(region_idx);
-    for (ReadVector::const_iterator i = v.begin(); i != v.end(); ++i) {
-        auto const& aln = **i;
-        if (!_opts.chr.empty() && aln.bdflag() == ReadFlag::ARP_CTX)
-            continue;
+    // Every mate that could still link to this region lies behind the
+    // current stream position, so either it has arrived already or it
+    // never will.
+    BasicRegion const& r = *_regions[region_idx];
+    return _stream_passed(r.mate_horizon_tid, r.mate_horizon_pos);
+}
 
-        ReadsToRegionsMap::const_iterator found = _read_regions.find(aln.query_name());
-        if (found == _read_regions.end() || found->second.size() != 2)
+void ReadRegionData::set_stream_position(int tid, int pos) {
+    _stream_tid = tid;
+    _stream_pos = pos;
+    _evict_orphaned_reads();
+}
+
+bool ReadRegionData::_evict_orphan(size_t region_idx, std::string const& read_name) {
+    ReadsToRegionsMap::iterator found = _read_regions.find(read_name);
+    if (found != _read_regions.end()) {
+        if (found->second.size() != 1 || found->second[0] != int(region_idx))
             return false;
+        _read_regions.erase(found);
+    }
+
+    // Either we just dropped the read or something else (e.g., collapsing
+    // the mate's region) did. The region may still hold a stale copy.
+    return region_exists(region_idx);
+}
+
+void ReadRegionData::_compact_region(size_t region_idx) {
+    read_iter_range live = region_reads_range(region_idx);
+    ReadVector reads(live.begin(), live.end());
+    swap_reads_in_region(region_idx, reads);
+}
+
+void ReadRegionData::_evict_orphaned_reads() {
+    std::vector<size_t> dirty;
+    while (!_pending_mates.empty()) {
+        PendingMate const& pending = _pending_mates.top();
+        if (!_stream_passed(pending.tid, pending.pos))
+            break;
+
+        if (_evict_orphan(pending.region_idx, pending.name))
+            dirty.push_back(pending.region_idx);
+
+        _pending_mates.pop();
     }
 
-    return true;
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    for (std::vector<size_t>::const_iterator i = dirty.begin(); i != dirty.end(); ++i)
+        _compact_region(*i);
 }
 
 int ReadRegionData::sum_of_region_sizes(std::vector<int> const& region_ids) const {
@@ -152,6 +427,7 @@ int ReadRegionData::sum_of_region_sizes(std::vector<int> const& region_ids) cons
 void ReadRegionData::clear_region(size_t region_idx) {
     if (!region_exists(region_idx))
         return;
+    BD_PROBE1(region_cleared, region_idx);
 
     BasicRegion::ReadVector const& reads = _reads_in_region(region_idx);
     for(ReadVector::const_iterator i = reads.begin(); i != reads.end(); ++i) {
@@ -170,6 +446,8 @@ void ReadRegionData::clear_region(size_t region_idx) {
         }
     }
 
+    if (_clear_callback)
+        _clear_callback(*_regions[region_idx]);
     delete _regions[region_idx];
     _regions[region_idx] = 0;
 }
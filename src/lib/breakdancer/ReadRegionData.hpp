@@ -12,9 +12,12 @@
 #include <boost/unordered_set.hpp>
 
 #include <cassert>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <ostream>
+#include <queue>
 #include <string>
 #include <vector>
 
@@ -28,10 +31,20 @@ public:
     typedef std::vector<ReadCountsByLib> RoiReadCounts;
     typedef boost::unordered_map<std::string, std::vector<int> > ReadsToRegionsMap;
     typedef UndirectedWeightedGraph<int, int> Graph; // tmpl params=vertex type, weight type.
+    typedef boost::function<void(BasicRegion const&)> RegionCallback;
+
+    // Every COUNT_CHECKPOINT_INTERVAL regions, the per library read counts
+    // of all regions before it are summed up, so counting the reads between
+    // two distant regions (e.g., across many small contigs for a
+    // translocation) does not walk every region in between.
+    enum { COUNT_CHECKPOINT_INTERVAL = 256 };
 
 public:
     ReadRegionData(Options const& opts)
         : _opts(opts)
+        , _stream_tid(-1)
+        , _stream_pos(-1)
+        , _end_of_stream(false)
     {
     }
 
@@ -58,14 +71,35 @@ public:
             ReadVector& reads);
     bool is_region_final(size_t region_idx) const;
 
+    // Records how far the (coordinate sorted) input stream has progressed.
+    // Reads whose mates should have been seen before this point, but were
+    // not (e.g., because the mate was filtered out), are evicted.
+    void set_stream_position(int tid, int pos);
+    void set_end_of_stream();
+
+    // Event driven mode (Options::event_driven): add_region notes each
+    // pair of regions whose link count reaches min_read_pair, and this
+    // hands them out once both regions are final, in the order they became
+    // so. A pair is a single region if both reads of the pairs live there.
+    void take_ready_candidates(std::vector<std::vector<int> >& candidates);
+
+    // Event driven mode: frees the final regions that no longer have any
+    // candidates to hand out. Call after the candidates are processed.
+    void clear_settled_regions();
+
     int sum_of_region_sizes(std::vector<int> const& region_ids) const;
 
     void clear_region(size_t region_idx);
+    // Called with each region just before clear_region frees it
+    void set_clear_callback(RegionCallback const& fn) {
+        _clear_callback = fn;
+    }
+
     size_t num_regions() const;
     size_t last_region_idx() const;
     BasicRegion const& region(size_t region_idx) const;
 
-    void incr_normal_read_count(ReadCountsByLib::LibId const& key);
+    void incr_normal_read_count(ReadCountsByLib::LibId const& key, uint32_t count = 1);
     void clear_region_accumulator();
     void clear_flanking_region_accumulator();
     void collapse_accumulated_data_into_last_region(ReadVector const& reads);
@@ -86,9 +120,80 @@ public:
     }
 
 private:
+    // A read that is still waiting for its mate to show up.
+    struct PendingMate {
+        PendingMate(int tid, int pos, size_t region_idx, std::string const& name)
+            : tid(tid)
+            , pos(pos)
+            , region_idx(region_idx)
+            , name(name)
+        {
+        }
+
+        bool operator>(PendingMate const& rhs) const {
+            return tid > rhs.tid || (tid == rhs.tid && pos > rhs.pos);
+        }
+
+        int tid;
+        int pos;
+        size_t region_idx;
+        std::string name;
+    };
+
+    typedef std::priority_queue<
+            PendingMate,
+            std::vector<PendingMate>,
+            std::greater<PendingMate>
+            > PendingMateQueue;
+
+    // Something that happens once the stream passes (tid, pos): a region
+    // becoming final (first == second), or a candidate pair becoming ready.
+    struct HorizonEvent {
+        HorizonEvent(int tid, int pos, int first, int second)
+            : tid(tid)
+            , pos(pos)
+            , first(first)
+            , second(second)
+        {
+        }
+
+        bool operator>(HorizonEvent const& rhs) const {
+            if (tid != rhs.tid)
+                return tid > rhs.tid;
+            if (pos != rhs.pos)
+                return pos > rhs.pos;
+            if (first != rhs.first)
+                return first > rhs.first;
+            return second > rhs.second;
+        }
+
+        int tid;
+        int pos;
+        int first;
+        int second;
+    };
+
+    typedef std::priority_queue<
+            HorizonEvent,
+            std::vector<HorizonEvent>,
+            std::greater<HorizonEvent>
+            > HorizonEventQueue;
+
+    bool _stream_passed(int tid, int pos) const;
+    bool _evict_orphan(size_t region_idx, std::string const& read_name);
+    void _compact_region(size_t region_idx);
+    void _evict_orphaned_reads();
+
+    void _track_candidates(size_t region_idx, std::vector<int> const& partners);
+    void _release_held_events();
+    bool _involves_last_region(HorizonEvent const& event) const;
+    void _release_candidate(int region_idx);
+    void _erase_from_graph(int region_idx);
+
     void _add_current_read_counts_to_region(size_t region_idx);
     void _add_per_lib_read_counts_to_last_region(ReadCountsByLib const& counts);
     ReadVector const& _reads_in_region(size_t region_idx) const;
+    void _add_count_checkpoint(size_t end_region_idx);
 
     size_t DEBUG_unpaired_reads(size_t region_idx) const {
         if (!region_exists(region_idx))
@@ -104,10 +209,20 @@ private:
         return rv;
     }
 
+private:
+    // Sum and number of regions with a count, by library
+    typedef std::map<ReadCountsByLib::LibId, std::pair<uint32_t, uint32_t> > CountPrefix;
+
+    static void _accumulate_counts(ReadCountsByLib& acc, RoiReadCounts const& counts,
+            std::vector<CountPrefix> const& prefixes, size_t begin, size_t end);
+
 private:
     Options const& _opts;
     RoiReadCounts _read_count_ROI_map;
     RoiReadCounts _read_count_FR_map;
+    // Entry i sums the counts of regions [0, i * COUNT_CHECKPOINT_INTERVAL)
+    std::vector<CountPrefix> _ROI_count_prefixes;
+    std::vector<CountPrefix> _FR_count_prefixes;
     RegionData _regions;
 
     ReadCountsByLib nread_ROI;
@@ -116,6 +231,19 @@ private:
     ReadsToRegionsMap _read_regions;
 
     Graph _persistent_graph;
+
+    int _stream_tid;
+    int _stream_pos;
+    bool _end_of_stream;
+    PendingMateQueue _pending_mates;
+
+    HorizonEventQueue _unsettled_regions;
+    HorizonEventQueue _pending_candidates;
+    // Events that came due while one of their regions was the last one
+    // (which can still grow); they go back in the queues when it is not.
+    std::vector<HorizonEvent> _held_events;
+    std::vector<int> _clearable_regions;
+    RegionCallback _clear_callback;
 };
 
 inline
@@ -156,9 +284,9 @@ BasicRegion const& ReadRegionData::region(size_t region_idx) const {
 }
 
 inline
-void ReadRegionData::incr_normal_read_count(ReadCountsByLib::LibId const& key) {
-    ++nread_ROI[key];
-    ++nread_FR[key];
+void ReadRegionData::incr_normal_read_count(ReadCountsByLib::LibId const& key, uint32_t count) {
+    nread_ROI[key] += count;
+    nread_FR[key] += count;
 }
 
 inline
@@ -182,6 +310,26 @@ void ReadRegionData::erase_read(std::string const& read_name) {
     _read_regions.erase(read_name);
 }
 
+inline
+bool ReadRegionData::_stream_passed(int tid, int pos) const {
+    return tid < _stream_tid || (tid == _stream_tid && pos < _stream_pos);
+}
+
+inline
+void ReadRegionData::set_end_of_stream() {
+    _end_of_stream = true;
+    _release_held_events();
+    set_stream_position(
+        std::numeric_limits<int>::max(),
+        std::numeric_limits<int>::max());
+}
+
+inline
+bool ReadRegionData::_involves_last_region(HorizonEvent const& event) const {
+    size_t last = last_region_idx();
+    return !_end_of_stream && (size_t(event.first) == last || size_t(event.second) == last);
+}
+
 inline
 bool ReadRegionData::read_exists(ReadType const& read) const {
     return _read_regions.find(read->query_name()) != _read_regions.end();
@@ -0,0 +1,75 @@
+#include "ReadTriage.hpp"
+
+#include "common/BloomFilter.hpp"
+#include "common/Options.hpp"
+#include "io/Alignment.hpp"
+#include "io/LibraryInfo.hpp"
+
+ReadTriage::ReadTriage(Options const& opts, LibraryInfo const& lib_info)
+    : _opts(opts)
+    , _lib_info(lib_info)
+{
+}
+
+ReadTriage::Fate ReadTriage::operator()(Alignment& aln) const {
+    LibraryConfig const& lib_config = _lib_info._cfg.library_config(aln.lib_index());
+
+    // XXX: this value can be missing in the config (indicated by a value of -1),
+    // in which case we'll wan't to use the default from the cmdline rather than
+    // admit everything.
+    int min_mapq = lib_config.min_mapping_quality < 0 ?
+            _opts.min_map_qual : lib_config.min_mapping_quality;
+
+    // Ignore fragments, poorly mapped reads, etc.
+    if (aln.bdflag() == ReadFlag::NA || aln.either_unmapped() || aln.bdqual() <= min_mapq
+        // ignore CTX when not in ctx mode
+        || (_opts.transchr_rearrange && !aln.interchrom_pair())
+        // ignore reads mapped too distantly on the same chromosome
+        || (aln.bdflag() != ReadFlag::ARP_CTX && aln.abs_isize() > _opts.max_sd)
+        )
+    {
+        return IGNORED;
+    }
+
+    // for long insert
+    // Mate pair libraries have different expected orientations so adjust
+    // Also, aligner COULD have marked (if it was maq) that reads had abnormally large or small insert sizes
+    // Remark based on BD options
+    // FIXME: make mate-pair alignment classifier class
+    if(_opts.Illumina_long_insert) {
+        if(aln.abs_isize() > lib_config.uppercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
+            aln.set_bdflag(ReadFlag::ARP_RF);
+        }
+        if(aln.abs_isize() < lib_config.uppercutoff && aln.bdflag() == ReadFlag::ARP_RF) {
+            aln.set_bdflag(ReadFlag::NORMAL_RF);
+        }
+        if(aln.abs_isize() < lib_config.lowercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
+            aln.set_bdflag(ReadFlag::ARP_SMALL_INSERT);
+        }
+    }
+
+    // This makes FF and RR the same thing
+    if(aln.bdflag() == ReadFlag::ARP_RR) {
+        aln.set_bdflag(ReadFlag::ARP_FF);
+    }
+
+    if(aln.bdflag() == ReadFlag::NORMAL_FR || aln.bdflag() == ReadFlag::NORMAL_RF)
+        return NORMAL;
+
+    // Don't hold on to reads that can never be paired up.
+    if (_opts.mate_qual_prefilter && !_mate_may_pass(aln, min_mapq))
+        return FILTERED;
+
+    return DISCORDANT;
+}
+
+bool ReadTriage::_mate_may_pass(Alignment const& aln, int min_mapq) const {
+    if (aln.mate_bdqual() >= 0)
+        return aln.mate_bdqual() > min_mapq;
+
+    // The mate is discordant too, so it is in the filter iff it passed the
+    // quality check during the summary pass (modulo false positives, which
+    // just mean we keep the read as we would have anyway).
+    BloomFilter const* passing = _lib_info._summary.passing_reads_filter();
+    return !passing || passing->maybe_contains(BamSummary::passing_mate_key(aln));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+class Alignment;
+struct LibraryInfo;
+struct Options;
+
+// What breakdancer does with a read, decided from the read alone (before
+// looking at the regions being built). Used by BreakDancer::push_read and
+// when writing evidence files, which have to agree exactly.
+class ReadTriage {
+public:
+    enum Fate {
+        IGNORED,    // fragment, poorly mapped, out of range, ...
+        NORMAL,     // normally mapped pair; only counted
+        FILTERED,   // discordant, but its mate can never pass
+        DISCORDANT  // kept to build regions from
+    };
+
+    ReadTriage(Options const& opts, LibraryInfo const& lib_info);
+
+    // Reads that are not IGNORED add to the normal read counts if they
+    // are proper pairs. May change the read's bdflag (mate pair libraries
+    // and the FF/RR merge).
+    Fate operator()(Alignment& aln) const;
+
+private:
+    bool _mate_may_pass(Alignment const& aln, int min_mapq) const;
+
+private:
+    Options const& _opts;
+    LibraryInfo const& _lib_info;
+};
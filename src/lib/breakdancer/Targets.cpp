@@ -0,0 +1,128 @@
+#include "Targets.hpp"
+
+#include "BreakDancer.hpp"
+#include "ReadRegionData.hpp"
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamMerger.hpp"
+#include "io/IntervalMask.hpp"
+#include "io/LibraryInfo.hpp"
+#include "io/MaskedBamReader.hpp"
+
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    struct Target {
+        Target(int32_t tid, int32_t beg, int32_t end)
+            : tid(tid)
+            , beg(beg)
+            , end(end)
+        {
+        }
+
+        int32_t tid;
+        int32_t beg;
+        int32_t end;
+    };
+
+    // What one thread keeps from target to target
+    struct TargetWorker {
+        TargetWorker()
+            : serial(0)
+        {
+        }
+
+        vector<boost::shared_ptr<BamReaderBase> > bams;
+        // Targets are the unit of parallelism, so calling each one runs
+        // on the thread that took it
+        TaskExecutor serial;
+    };
+}
+
+void call_targets(
+        bam_header_t const* header,
+        IntervalMask const& targets,
+        IntervalMask const& mask,
+        Options const& opts,
+        LibraryInfo const& lib_info,
+        IAlignmentClassifier const& read_classifier,
+        std::map<std::string, float> const& read_density,
+        int max_read_window_size,
+        TaskExecutor& executor,
+        std::ostream& out
+        )
+{
+    BamConfig const& cfg = lib_info._cfg;
+    vector<Target> sorted;
+    for (int32_t tid = 0; tid < header->n_targets; ++tid) {
+        vector<IntervalMask::Interval> const& ivs = targets.intervals(tid);
+        for (size_t i = 0; i < ivs.size(); ++i)
+            sorted.push_back(Target(tid, ivs[i].first, ivs[i].second));
+    }
+
+    WorkerLocal<boost::shared_ptr<TargetWorker> > workers(executor);
+    vector<string> calls(sorted.size());
+    executor.parallel_for(sorted.size(), [&](size_t i) {
+        Target const& target = sorted[i];
+        boost::shared_ptr<TargetWorker>& worker = workers.local();
+        if (!worker) {
+            worker.reset(new TargetWorker);
+            worker->bams = openBams(cfg.bam_files(), header->target_name[target.tid]);
+        }
+
+        vector<BamReaderBase*> readers;
+        vector<boost::shared_ptr<MaskedBamReader> > masked_readers;
+        for (size_t j = 0; j < worker->bams.size(); ++j) {
+            BamReaderBase& bam = *worker->bams[j];
+            if (!bam.set_region(target.tid, target.beg, target.end)) {
+                throw runtime_error(str(format(
+                    "Failed to move %1% to a new target region") % bam.path()));
+            }
+
+            readers.push_back(&bam);
+            if (!mask.empty()) {
+                masked_readers.push_back(boost::shared_ptr<MaskedBamReader>(
+                    new MaskedBamReader(bam, mask)));
+                readers.back() = masked_readers.back().get();
+            }
+        }
+
+        // The same as -o with the target's region
+        Options target_opts(opts);
+        target_opts.chr = str(format("%1%:%2%-%3%")
+            % header->target_name[target.tid] % (target.beg + 1) % target.end);
+
+        BamMerger merged_reader(readers);
+        ReadRegionData read_regions(target_opts);
+        BreakDancer bdancer(
+            read_classifier,
+            target_opts,
+            lib_info,
+            read_regions,
+            merged_reader,
+            worker->serial,
+            max_read_window_size);
+
+        typedef map<string, float>::const_iterator IterType;
+        for (IterType j = read_density.begin(); j != read_density.end(); ++j)
+            bdancer.set_read_density(j->first, j->second);
+
+        stringstream target_calls;
+        bdancer.set_output(target_calls);
+        bdancer.run();
+        calls[i] = target_calls.str();
+    });
+
+    for (size_t i = 0; i < calls.size(); ++i)
+        out << calls[i];
+}
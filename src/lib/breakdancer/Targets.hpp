@@ -0,0 +1,36 @@
+#pragma once
+
+#include <bam.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+
+class IAlignmentClassifier;
+class IntervalMask;
+class TaskExecutor;
+struct LibraryInfo;
+struct Options;
+
+// Call SVs in each of the (merged) intervals of targets on its own, as -o
+// does for one region, and write the calls to out in target order. Unlike
+// separate -o runs, every target is scored with the statistics of the
+// whole bams (the one BamSummary in lib_info). Targets are spread over the
+// executor's threads. Each thread opens every bam (and loads its index)
+// once, then moves it from one target to the next, so the index queries on
+// a file come in sorted order. header is that of the bams, which the
+// targets refer to. read_density and max_read_window_size are as set on
+// BreakDancer for a whole genome run. Reads in mask are skipped as with
+// --mask.
+void call_targets(
+    bam_header_t const* header,
+    IntervalMask const& targets,
+    IntervalMask const& mask,
+    Options const& opts,
+    LibraryInfo const& lib_info,
+    IAlignmentClassifier const& read_classifier,
+    std::map<std::string, float> const& read_density,
+    int max_read_window_size,
+    TaskExecutor& executor,
+    std::ostream& out
+    );
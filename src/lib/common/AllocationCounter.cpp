@@ -0,0 +1,73 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<bool> g_counting(false);
+    std::atomic<uint64_t> g_allocations(0);
+
+    void* allocate(std::size_t n) {
+        if (g_counting.load(std::memory_order_relaxed))
+            g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+        for (;;) {
+            if (void* p = std::malloc(n ? n : 1))
+                return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    void* allocate_nothrow(std::size_t n) {
+        try {
+            return allocate(n);
+        }
+        catch (std::bad_alloc const&) {
+            return 0;
+        }
+    }
+}
+
+void count_allocations(bool on) {
+    g_counting = on;
+}
+
+uint64_t allocation_count() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t n) {
+    return allocate(n);
+}
+
+void* operator new[](std::size_t n) {
+    return allocate(n);
+}
+
+void* operator new(std::size_t n, std::nothrow_t const&) noexcept {
+    return allocate_nothrow(n);
+}
+
+void* operator new[](std::size_t n, std::nothrow_t const&) noexcept {
+    return allocate_nothrow(n);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::nothrow_t const&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::nothrow_t const&) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+// Counts calls to operator new, for --bench. A program that uses these
+// gets the global operator new and delete of AllocationCounter.cpp for
+// every run, not only while counting. They go straight to malloc and free
+// as the standard ones do; while counting is off the only extra cost is a
+// relaxed atomic load and an untaken branch per allocation (no difference
+// measurable at about 15 ns per new/delete pair).
+void count_allocations(bool on);
+uint64_t allocation_count();
@@ -0,0 +1,59 @@
+#include "BloomFilter.hpp"
+
+#include <stdexcept>
+
+BloomFilter::BloomFilter(std::size_t num_bits, unsigned num_hashes)
+    : _num_bits(num_bits < 64 ? 64 : num_bits)
+    , _num_hashes(num_hashes < 1 ? 1 : num_hashes)
+    , _words((_num_bits + 63) / 64)
+{
+    for (std::size_t i = 0; i < _words.size(); ++i)
+        _words[i].store(0, std::memory_order_relaxed);
+}
+
+void BloomFilter::_hash(std::string const& key, uint64_t& h1, uint64_t& h2) {
+    // 64 bit FNV-1a, followed by the murmur3 finalizer to derive a second,
+    // independent looking hash for double hashing.
+    uint64_t h = 14695981039346656037ull;
+    for (std::string::const_iterator i = key.begin(); i != key.end(); ++i) {
+        h ^= uint8_t(*i);
+        h *= 1099511628211ull;
+    }
+    h1 = h;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    h2 = h | 1;
+}
+
+void BloomFilter::insert(std::string const& key) {
+    uint64_t h1, h2;
+    _hash(key, h1, h2);
+    for (unsigned i = 0; i < _num_hashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % _num_bits;
+        _words[bit >> 6].fetch_or(uint64_t(1) << (bit & 63), std::memory_order_relaxed);
+    }
+}
+
+bool BloomFilter::maybe_contains(std::string const& key) const {
+    uint64_t h1, h2;
+    _hash(key, h1, h2);
+    for (unsigned i = 0; i < _num_hashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % _num_bits;
+        if (!(_words[bit >> 6].load(std::memory_order_relaxed) & (uint64_t(1) << (bit & 63))))
+            return false;
+    }
+    return true;
+}
+
+BloomFilter& BloomFilter::operator|=(BloomFilter const& rhs) {
+    if (_num_bits != rhs._num_bits || _num_hashes != rhs._num_hashes)
+        throw std::invalid_argument("Attempted to merge incompatible bloom filters");
+
+    for (std::size_t i = 0; i < _words.size(); ++i)
+        _words[i].fetch_or(rhs._words[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
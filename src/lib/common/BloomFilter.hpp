@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// A plain bit-vector Bloom filter over strings. maybe_contains() never
+// returns false for a string that was inserted; it may (rarely) return
+// true for one that was not. Any number of threads may insert at once, so
+// threads filling in one set can share a filter instead of each keeping a
+// copy.
+class BloomFilter {
+public:
+    BloomFilter(std::size_t num_bits, unsigned num_hashes);
+
+    void insert(std::string const& key);
+    bool maybe_contains(std::string const& key) const;
+
+    // Combine with a filter of the same geometry (set union).
+    BloomFilter& operator|=(BloomFilter const& rhs);
+
+    std::size_t num_bits() const;
+    unsigned num_hashes() const;
+
+private:
+    static void _hash(std::string const& key, uint64_t& h1, uint64_t& h2);
+
+private:
+    std::size_t _num_bits;
+    unsigned _num_hashes;
+    std::vector<std::atomic<uint64_t> > _words;
+};
+
+inline
+std::size_t BloomFilter::num_bits() const {
+    return _num_bits;
+}
+
+inline
+unsigned BloomFilter::num_hashes() const {
+    return _num_hashes;
+}
@@ -7,6 +7,61 @@
 
 using namespace std;
 
+namespace {
+    // Values for options that only have a long form. These start above the
+    // range of any short option character.
+    enum LongOption {
+        OPT_MATE_QUAL_PREFILTER = 256,
+        OPT_MATE_FILTER_MB,
+        OPT_THREADS,
+        OPT_EVENT_DRIVEN,
+        OPT_MAX_NORMAL_SUPPORT,
+        OPT_SOMATIC_ONLY,
+        OPT_WRITE_EVIDENCE,
+        OPT_EVIDENCE_BIN_SIZE,
+        OPT_DEPTH_PREFIX,
+        OPT_DEPTH_BIN_SIZE,
+        OPT_DEPTH_BINARY,
+        OPT_MASK,
+        OPT_DENSE_REGION_SAMPLE,
+        OPT_COLLAPSE_DUPLICATES,
+        OPT_TARGETS,
+        OPT_TARGET_PADDING,
+        OPT_IO_DEPTH,
+        OPT_IO_POLICY,
+        OPT_HOTSPOTS,
+        OPT_HOTSPOT_WINDOW,
+        OPT_BENCH,
+        OPT_DENSE_REGION_EARLY
+    };
+
+    struct option const LONG_OPTIONS[] = {
+        {"mate-qual-prefilter", no_argument, 0, OPT_MATE_QUAL_PREFILTER},
+        {"mate-filter-mb", required_argument, 0, OPT_MATE_FILTER_MB},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"event-driven", no_argument, 0, OPT_EVENT_DRIVEN},
+        {"max-normal-support", required_argument, 0, OPT_MAX_NORMAL_SUPPORT},
+        {"somatic-only", no_argument, 0, OPT_SOMATIC_ONLY},
+        {"write-evidence", required_argument, 0, OPT_WRITE_EVIDENCE},
+        {"evidence-bin-size", required_argument, 0, OPT_EVIDENCE_BIN_SIZE},
+        {"depth-prefix", required_argument, 0, OPT_DEPTH_PREFIX},
+        {"depth-bin-size", required_argument, 0, OPT_DEPTH_BIN_SIZE},
+        {"depth-binary", no_argument, 0, OPT_DEPTH_BINARY},
+        {"mask", required_argument, 0, OPT_MASK},
+        {"dense-region-sample", required_argument, 0, OPT_DENSE_REGION_SAMPLE},
+        {"collapse-duplicates", no_argument, 0, OPT_COLLAPSE_DUPLICATES},
+        {"targets", required_argument, 0, OPT_TARGETS},
+        {"target-padding", required_argument, 0, OPT_TARGET_PADDING},
+        {"io-depth", required_argument, 0, OPT_IO_DEPTH},
+        {"io-policy", required_argument, 0, OPT_IO_POLICY},
+        {"hotspots", required_argument, 0, OPT_HOTSPOTS},
+        {"hotspot-window", required_argument, 0, OPT_HOTSPOT_WINDOW},
+        {"bench", required_argument, 0, OPT_BENCH},
+        {"dense-region-early", no_argument, 0, OPT_DENSE_REGION_EARLY},
+        {0, 0, 0, 0}
+    };
+}
+
 Options::Options()
         : min_len(7)
         , cut_sd(3)
@@ -20,6 +75,22 @@ Options::Options()
         , Illumina_long_insert(false)
         , CN_lib(false)
         , print_AF(false)
+        , mate_qual_prefilter(false)
+        , mate_filter_mb(64)
+        , threads(1)
+        , event_driven(false)
+        , max_normal_support(0)
+        , somatic_only(false)
+        , evidence_bin_size(1)
+        , depth_bin_size(1000)
+        , depth_binary(false)
+        , dense_region_sample(0)
+        , dense_region_early(false)
+        , collapse_duplicates(false)
+        , target_padding(0)
+        , io_depth(0)
+        , io_policy("normal")
+        , hotspot_window(100000)
         , score_threshold(30)
 {
 }
@@ -37,11 +108,27 @@ Options::Options(int argc, char** argv)
         , Illumina_long_insert(false)
         , CN_lib(false)
         , print_AF(false)
+        , mate_qual_prefilter(false)
+        , mate_filter_mb(64)
+        , threads(1)
+        , event_driven(false)
+        , max_normal_support(0)
+        , somatic_only(false)
+        , evidence_bin_size(1)
+        , depth_bin_size(1000)
+        , depth_binary(false)
+        , dense_region_sample(0)
+        , dense_region_early(false)
+        , collapse_duplicates(false)
+        , target_padding(0)
+        , io_depth(0)
+        , io_policy("normal")
+        , hotspot_window(100000)
         , score_threshold(30)
         , orig_argv(argv, argv + argc)
 {
     int c;
-    while((c = getopt(argc, argv, "o:s:c:m:q:r:x:b:tfd:g:lahy:C:R:")) >= 0) {
+    while((c = getopt_long(argc, argv, "o:s:c:m:q:r:x:b:tfd:g:lahy:C:R:", LONG_OPTIONS, 0)) >= 0) {
         switch(c) {
             case 'C': cache_file = optarg; break;
             case 'R': {
@@ -68,6 +155,28 @@ Options::Options(int argc, char** argv)
             case 'a': CN_lib = true; break;
             case 'h': print_AF = true; break;
             case 'y': score_threshold = atoi(optarg); break;
+            case OPT_MATE_QUAL_PREFILTER: mate_qual_prefilter = true; break;
+            case OPT_MATE_FILTER_MB: mate_filter_mb = atoi(optarg); break;
+            case OPT_THREADS: threads = atoi(optarg); break;
+            case OPT_EVENT_DRIVEN: event_driven = true; break;
+            case OPT_MAX_NORMAL_SUPPORT: max_normal_support = atoi(optarg); break;
+            case OPT_SOMATIC_ONLY: somatic_only = true; break;
+            case OPT_WRITE_EVIDENCE: evidence_prefix = optarg; break;
+            case OPT_EVIDENCE_BIN_SIZE: evidence_bin_size = atoi(optarg); break;
+            case OPT_DEPTH_PREFIX: depth_prefix = optarg; break;
+            case OPT_DEPTH_BIN_SIZE: depth_bin_size = atoi(optarg); break;
+            case OPT_DEPTH_BINARY: depth_binary = true; break;
+            case OPT_MASK: mask_bed = optarg; break;
+            case OPT_DENSE_REGION_SAMPLE: dense_region_sample = atoi(optarg); break;
+            case OPT_COLLAPSE_DUPLICATES: collapse_duplicates = true; break;
+            case OPT_TARGETS: targets_bed = optarg; break;
+            case OPT_TARGET_PADDING: target_padding = atoi(optarg); break;
+            case OPT_IO_DEPTH: io_depth = atoi(optarg); break;
+            case OPT_IO_POLICY: io_policy = optarg; break;
+            case OPT_HOTSPOTS: hotspot_prefix = optarg; break;
+            case OPT_HOTSPOT_WINDOW: hotspot_window = atoi(optarg); break;
+            case OPT_BENCH: bench = optarg; break;
+            case OPT_DENSE_REGION_EARLY: dense_region_early = true; break;
             default: fprintf(stderr, "Unrecognized option '-%c'.\n", c);
                 exit(1);
         }
@@ -96,11 +205,80 @@ Options::Options(int argc, char** argv)
         fprintf(stderr, "       -a              print out copy number and support reads per library rather than per bam, by default off\n");
         fprintf(stderr, "       -h              print out Allele Frequency column, by default off\n");
         fprintf(stderr, "       -y INT          output score filter [%d]\n", score_threshold);
+        fprintf(stderr, "       --mate-qual-prefilter\n");
+        fprintf(stderr, "                       drop discordant reads whose mate fails the mapping quality filter, by default off\n");
+        fprintf(stderr, "       --mate-filter-mb INT\n");
+        fprintf(stderr, "                       memory for the mate quality prefilter, in megabytes [%d]\n", mate_filter_mb);
+        fprintf(stderr, "       --threads INT   number of threads shared by bam scanning, decoding, classification and SV scoring [%d]\n", threads);
+        fprintf(stderr, "       --event-driven  score each pair of regions as soon as it is complete instead of every -b regions, by default off\n");
+        fprintf(stderr, "       --max-normal-support INT\n");
+        fprintf(stderr, "                       with tumor/normal roles in the config, most normal read pairs a SOMATIC call may have [%d]\n", max_normal_support);
+        fprintf(stderr, "       --somatic-only  with tumor/normal roles in the config, only report SOMATIC calls, by default off\n");
+        fprintf(stderr, "       --write-evidence STRING\n");
+        fprintf(stderr, "                       also write a PREFIX.<bam name>.bde evidence file per bam for later joint calling\n");
+        fprintf(stderr, "       --evidence-bin-size INT\n");
+        fprintf(stderr, "                       most bases of normal reads one evidence count record may span [%d]\n", evidence_bin_size);
+        fprintf(stderr, "       --depth-prefix STRING\n");
+        fprintf(stderr, "                       write binned proper pair depth per library to PREFIX.<lib>.bedGraph\n");
+        fprintf(stderr, "       --depth-bin-size INT\n");
+        fprintf(stderr, "                       bin size for --depth-prefix, in bases [%d]\n", depth_bin_size);
+        fprintf(stderr, "       --depth-binary  write depth as compact binary PREFIX.<lib>.depth files instead, by default off\n");
+        fprintf(stderr, "       --mask STRING   BED file of regions (centromeres, satellites, ...) whose reads are skipped\n");
+        fprintf(stderr, "       --dense-region-sample INT\n");
+        fprintf(stderr, "                       keep regions over the -x coverage limit, with a sample of this many of their reads [%d]\n", dense_region_sample);
+        fprintf(stderr, "       --dense-region-early\n");
+        fprintf(stderr, "                       treat a region as over -x once its coverage so far is, without waiting for it to end, by default off\n");
+        fprintf(stderr, "       --collapse-duplicates\n");
+        fprintf(stderr, "                       drop discordant read pairs duplicating another pair's positions, for bams without duplicates marked, by default off\n");
+        fprintf(stderr, "       --targets STRING\n");
+        fprintf(stderr, "                       BED file of regions to call SVs in, each on its own (overlapping ones are merged)\n");
+        fprintf(stderr, "       --target-padding INT\n");
+        fprintf(stderr, "                       bases to widen each --targets region by on both sides [%d]\n", target_padding);
+        fprintf(stderr, "       --io-depth INT  256 kB reads of each bam to keep in flight ahead of decompression, 0 to read as needed [%d]\n", io_depth);
+        fprintf(stderr, "       --io-policy STRING\n");
+        fprintf(stderr, "                       page cache use when reading bams: normal, stream (drop what has been read) or direct (bypass it) [%s]\n", io_policy.c_str());
+        fprintf(stderr, "       --hotspots STRING\n");
+        fprintf(stderr, "                       write the time and memory spent on each part of the genome to PREFIX.hotspots.txt and PREFIX.hotspots.bedGraph\n");
+        fprintf(stderr, "       --hotspot-window INT\n");
+        fprintf(stderr, "                       window size for --hotspots, in bases [%d]\n", hotspot_window);
+        fprintf(stderr, "       --bench STRING  instead of calling SVs, run up to one stage (read, decode, classify, regions or call) and report its throughput\n");
         //fprintf(stderr, "Version: %s\n", version);
         fprintf(stderr, "\n");
         exit(1);
     }
 
+    // Each target is called as with -o, and files written while calling
+    // would be clobbered by the next target
+    if (!targets_bed.empty() && (!chr.empty() || !prefix_fastq.empty()
+            || !dump_BED.empty() || !depth_prefix.empty() || !hotspot_prefix.empty()))
+    {
+        throw runtime_error("--targets cannot be combined with -o, -d, -g, --depth-prefix or --hotspots");
+    }
+
+    if (threads <= 0)
+        throw runtime_error("--threads must be positive");
+    if (mate_filter_mb <= 0)
+        throw runtime_error("--mate-filter-mb must be positive");
+    if (evidence_bin_size <= 0)
+        throw runtime_error("--evidence-bin-size must be positive");
+    if (dense_region_sample < 0)
+        throw runtime_error("--dense-region-sample cannot be negative");
+    if (target_padding < 0)
+        throw runtime_error("--target-padding cannot be negative");
+    if (io_depth < 0)
+        throw runtime_error("--io-depth cannot be negative");
+    if (io_policy != "normal" && io_policy != "stream" && io_policy != "direct")
+        throw runtime_error("--io-policy must be normal, stream or direct");
+    if (hotspot_window <= 0)
+        throw runtime_error("--hotspot-window must be positive");
+    if (!bench.empty() && bench != "read" && bench != "decode" && bench != "classify"
+            && bench != "regions" && bench != "call")
+    {
+        throw runtime_error("--bench must be read, decode, classify, regions or call");
+    }
+    if (!bench.empty() && !targets_bed.empty())
+        throw runtime_error("--bench cannot be combined with --targets");
+
     // define the map SVtype
     if (Illumina_long_insert) {
         SVtype[ReadFlag::ARP_FF] = "INV";
@@ -135,6 +313,28 @@ bool Options::operator==(Options const& rhs) const {
         && Illumina_long_insert == rhs.Illumina_long_insert
         && CN_lib == rhs.CN_lib
         && print_AF == rhs.print_AF
+        && mate_qual_prefilter == rhs.mate_qual_prefilter
+        && mate_filter_mb == rhs.mate_filter_mb
+        && threads == rhs.threads
+        && event_driven == rhs.event_driven
+        && max_normal_support == rhs.max_normal_support
+        && somatic_only == rhs.somatic_only
+        && evidence_prefix == rhs.evidence_prefix
+        && evidence_bin_size == rhs.evidence_bin_size
+        && depth_prefix == rhs.depth_prefix
+        && depth_bin_size == rhs.depth_bin_size
+        && depth_binary == rhs.depth_binary
+        && mask_bed == rhs.mask_bed
+        && dense_region_sample == rhs.dense_region_sample
+        && dense_region_early == rhs.dense_region_early
+        && collapse_duplicates == rhs.collapse_duplicates
+        && targets_bed == rhs.targets_bed
+        && target_padding == rhs.target_padding
+        && io_depth == rhs.io_depth
+        && io_policy == rhs.io_policy
+        && hotspot_prefix == rhs.hotspot_prefix
+        && hotspot_window == rhs.hotspot_window
+        && bench == rhs.bench
         && score_threshold == rhs.score_threshold
         && bam_file == rhs.bam_file
         && prefix_fastq == rhs.prefix_fastq
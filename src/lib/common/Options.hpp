@@ -3,6 +3,7 @@
 #include "ReadFlags.hpp"
 
 #include <boost/serialization/array.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/nvp.hpp>
@@ -35,6 +36,28 @@ struct Options {
     bool Illumina_long_insert;
     bool CN_lib;
     bool print_AF;
+    bool mate_qual_prefilter;
+    int mate_filter_mb;
+    int threads;
+    bool event_driven;
+    int max_normal_support;
+    bool somatic_only;
+    std::string evidence_prefix;
+    int evidence_bin_size;
+    std::string depth_prefix;
+    int depth_bin_size;
+    bool depth_binary;
+    std::string mask_bed;
+    int dense_region_sample;
+    bool dense_region_early;
+    bool collapse_duplicates;
+    std::string targets_bed;
+    int target_padding;
+    int io_depth;
+    std::string io_policy;
+    std::string hotspot_prefix;
+    int hotspot_window;
+    std::string bench;
     int score_threshold;
     std::string bam_file;
     std::string prefix_fastq;
@@ -67,9 +90,86 @@ struct Options {
             & BOOST_SERIALIZATION_NVP(SVtype)
             & BOOST_SERIALIZATION_NVP(orig_argv)
             ;
+
+        if (version > 0) {
+            arch
+                & BOOST_SERIALIZATION_NVP(mate_qual_prefilter)
+                & BOOST_SERIALIZATION_NVP(mate_filter_mb)
+                ;
+        }
+
+        if (version > 1) {
+            arch & BOOST_SERIALIZATION_NVP(threads);
+        }
+
+        if (version > 2) {
+            arch & BOOST_SERIALIZATION_NVP(event_driven);
+        }
+
+        if (version > 3) {
+            arch
+                & BOOST_SERIALIZATION_NVP(max_normal_support)
+                & BOOST_SERIALIZATION_NVP(somatic_only)
+                ;
+        }
+
+        if (version > 4) {
+            arch
+                & BOOST_SERIALIZATION_NVP(evidence_prefix)
+                & BOOST_SERIALIZATION_NVP(evidence_bin_size)
+                ;
+        }
+
+        if (version > 5) {
+            arch
+                & BOOST_SERIALIZATION_NVP(depth_prefix)
+                & BOOST_SERIALIZATION_NVP(depth_bin_size)
+                & BOOST_SERIALIZATION_NVP(depth_binary)
+                ;
+        }
+
+        if (version > 6) {
+            arch & BOOST_SERIALIZATION_NVP(mask_bed);
+        }
+
+        if (version > 7) {
+            arch & BOOST_SERIALIZATION_NVP(dense_region_sample);
+        }
+
+        if (version > 8) {
+            arch & BOOST_SERIALIZATION_NVP(collapse_duplicates);
+        }
+
+        if (version > 9) {
+            arch & BOOST_SERIALIZATION_NVP(targets_bed)
+                & BOOST_SERIALIZATION_NVP(target_padding)
+                ;
+        }
+
+        if (version > 10) {
+            arch & BOOST_SERIALIZATION_NVP(io_depth)
+                & BOOST_SERIALIZATION_NVP(io_policy)
+                ;
+        }
+
+        if (version > 11) {
+            arch & BOOST_SERIALIZATION_NVP(hotspot_prefix)
+                & BOOST_SERIALIZATION_NVP(hotspot_window)
+                ;
+        }
+
+        if (version > 12) {
+            arch & BOOST_SERIALIZATION_NVP(bench);
+        }
+
+        if (version > 13) {
+            arch & BOOST_SERIALIZATION_NVP(dense_region_early);
+        }
     }
 };
 
+BOOST_CLASS_VERSION(Options, 14)
+
 inline
 bool Options::need_sequence_data() const {
     // we'll need to keep sequence/quality data if we are dumping
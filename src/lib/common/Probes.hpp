@@ -0,0 +1,52 @@
+#pragma once
+
+// Static tracepoints (USDT) for attaching perf or bpftrace to a running
+// breakdancer-max, e.g.
+//
+//   bpftrace -e 'usdt:/path/to/breakdancer-max:breakdancer:process_sv { @[arg3] = count(); }'
+//
+// A probe compiles to a single nop and the instructions that put its
+// arguments where the tracer can read them, so arguments should be values
+// already at hand. They are built when sys/sdt.h (systemtap-sdt-dev) is
+// found and ENABLE_PROBES is on; otherwise the macros expand to nothing and
+// their arguments are not evaluated. `readelf -n` lists the probes in a
+// binary built with them. See tools/bpftrace for example scripts.
+//
+// Probes (all arguments are integers):
+//
+//   record_decoded(tid, pos, flag)
+//       a bam record has been turned into an Alignment
+//   region_break(tid, start, end, reads)
+//       push_read has closed the region of reads so far
+//   add_region(index, tid, start, end, reads)
+//       a region has been kept
+//   build_connection_begin(regions)
+//   build_connection_end(regions, candidates)
+//   process_sv(index1, index2, flag, phred_q)
+//       a candidate SV has been scored and passed; index2 is index1 for
+//       an SV within one region
+//   region_cleared(index)
+//       a region and its reads have been freed
+//   output_flush(svs)
+//       a batch of candidates has been written out; svs counts the SVs
+//       written so far
+
+#ifdef BD_HAVE_SDT
+
+#include <sys/sdt.h>
+
+#define BD_PROBE1(name, a) DTRACE_PROBE1(breakdancer, name, a)
+#define BD_PROBE2(name, a, b) DTRACE_PROBE2(breakdancer, name, a, b)
+#define BD_PROBE3(name, a, b, c) DTRACE_PROBE3(breakdancer, name, a, b, c)
+#define BD_PROBE4(name, a, b, c, d) DTRACE_PROBE4(breakdancer, name, a, b, c, d)
+#define BD_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(breakdancer, name, a, b, c, d, e)
+
+#else
+
+#define BD_PROBE1(name, a) do {} while (0)
+#define BD_PROBE2(name, a, b) do {} while (0)
+#define BD_PROBE3(name, a, b, c) do {} while (0)
+#define BD_PROBE4(name, a, b, c, d) do {} while (0)
+#define BD_PROBE5(name, a, b, c, d, e) do {} while (0)
+
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// Bounded, lock-free queue for exactly one producer thread and one consumer
+// thread. Capacity is rounded up to a power of two.
+//
+// The head (consumer) and tail (producer) indices are free-running counters;
+// each side only ever writes its own index, and reads the other side's with
+// acquire semantics, so no locks or CAS loops are needed.
+template<typename T>
+class SpscQueue : public boost::noncopyable {
+public:
+    explicit SpscQueue(std::size_t capacity);
+
+    // Non-blocking; return false if the queue is full (push) or empty (pop).
+    bool try_push(T const& value);
+    bool try_pop(T& value);
+
+    // Approximate when called from a thread other than producer or consumer.
+    std::size_t size() const;
+    std::size_t capacity() const;
+
+private:
+    static std::size_t round_up_pow2(std::size_t n);
+
+private:
+    std::vector<T> _slots;
+    std::size_t _mask;
+
+    // Keep the two indices on separate cache lines so the producer and
+    // consumer do not contend for the same line. (Padding rather than
+    // alignas, since C++11 new does not honour extended alignment.)
+    char _pad0[64];
+    std::atomic<std::size_t> _head;
+    char _pad1[64];
+    std::atomic<std::size_t> _tail;
+    char _pad2[64];
+};
+
+template<typename T>
+inline
+SpscQueue<T>::SpscQueue(std::size_t capacity)
+    : _slots(round_up_pow2(capacity))
+    , _mask(_slots.size() - 1)
+    , _head(0)
+    , _tail(0)
+{
+}
+
+template<typename T>
+inline
+std::size_t SpscQueue<T>::round_up_pow2(std::size_t n) {
+    std::size_t rv = 1;
+    while (rv < n)
+        rv <<= 1;
+    return rv;
+}
+
+template<typename T>
+inline
+bool SpscQueue<T>::try_push(T const& value) {
+    std::size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == _slots.size())
+        return false;
+
+    _slots[tail & _mask] = value;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+inline
+bool SpscQueue<T>::try_pop(T& value) {
+    std::size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire))
+        return false;
+
+    value = _slots[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+inline
+std::size_t SpscQueue<T>::size() const {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+}
+
+template<typename T>
+inline
+std::size_t SpscQueue<T>::capacity() const {
+    return _slots.size();
+}
@@ -0,0 +1,299 @@
+#include "TaskExecutor.hpp"
+#include "Trace.hpp"
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    // Which executor (if any) the current thread works for, and as what
+    thread_local TaskExecutor const* t_executor = 0;
+    thread_local size_t t_slot = 0;
+
+    int64_t now_ns() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+TaskExecutor::TaskExecutor(size_t num_workers, size_t queue_capacity)
+    : _num_workers(num_workers)
+    , _queue_capacity(queue_capacity)
+    , _queued(0)
+    , _shutdown(false)
+{
+    for (size_t i = 0; i <= num_workers; ++i) {
+        boost::shared_ptr<WorkerQueue> q(new WorkerQueue);
+        q->tasks_run = 0;
+        q->tasks_stolen = 0;
+        q->busy_ns = 0;
+        _queues.push_back(q);
+    }
+
+    try {
+        for (size_t i = 0; i < num_workers; ++i)
+            _threads.push_back(thread(&TaskExecutor::_worker_loop, this, i));
+    }
+    catch (...) {
+        _stop();
+        throw;
+    }
+}
+
+TaskExecutor::~TaskExecutor() {
+    _stop();
+}
+
+void TaskExecutor::_stop() {
+    {
+        lock_guard<mutex> lock(_sleep_mutex);
+        _shutdown = true;
+    }
+    _work_ready.notify_all();
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        if (_threads[i].joinable())
+            _threads[i].join();
+    }
+}
+
+size_t TaskExecutor::current_worker() const {
+    return t_executor == this ? t_slot : _num_workers;
+}
+
+void TaskExecutor::_submit(QueuedTask const& task) {
+    WorkerQueue& q = *_queues[current_worker()];
+    {
+        lock_guard<mutex> lock(q.mutex);
+        q.tasks.push_back(task);
+    }
+    ++_queued;
+
+    // Taking the lock orders us against a worker that has just seen an
+    // empty queue and is about to sleep, so the wakeup cannot be lost.
+    { lock_guard<mutex> lock(_sleep_mutex); }
+    _work_ready.notify_one();
+}
+
+bool TaskExecutor::_take(size_t slot, QueuedTask& task) {
+    if (_queued == 0)
+        return false;
+
+    // Our own work first, newest first
+    if (slot < _num_workers) {
+        WorkerQueue& q = *_queues[slot];
+        lock_guard<mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+            --_queued;
+            return true;
+        }
+    }
+
+    // Then the shared queue, then everyone else's oldest work
+    size_t n = _queues.size();
+    for (size_t i = 0; i < n; ++i) {
+        size_t victim = (_num_workers + i) % n;
+        if (victim == slot)
+            continue;
+
+        WorkerQueue& q = *_queues[victim];
+        lock_guard<mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            --_queued;
+            if (victim != _num_workers)
+                ++_queues[slot]->tasks_stolen;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskExecutor::_take_from_group(TaskGroup const* group, QueuedTask& task) {
+    for (size_t i = 0; i < _queues.size(); ++i) {
+        WorkerQueue& q = *_queues[i];
+        lock_guard<mutex> lock(q.mutex);
+        for (deque<QueuedTask>::iterator t = q.tasks.begin(); t != q.tasks.end(); ++t) {
+            if (t->group == group) {
+                task = *t;
+                q.tasks.erase(t);
+                --_queued;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskExecutor::_execute(QueuedTask& task, size_t slot) {
+    TaskGroup& group = *task.group;
+    if (group.cancelled()) {
+        group._finish(false, 0, exception_ptr());
+        return;
+    }
+
+    exception_ptr error;
+    int64_t start = now_ns();
+    try {
+        TraceSpan span("task");
+        task.fn();
+    }
+    catch (...) {
+        error = current_exception();
+    }
+    uint64_t ns = now_ns() - start;
+
+    WorkerQueue& q = *_queues[slot];
+    ++q.tasks_run;
+    q.busy_ns += ns;
+
+    // Drop the closure before the group can see this task as finished;
+    // it may hold references into the caller's stack.
+    task.fn.clear();
+    group._finish(true, ns, error);
+}
+
+void TaskExecutor::_worker_loop(size_t slot) {
+    t_executor = this;
+    t_slot = slot;
+    if (trace_enabled())
+        trace_thread_name(str(format("worker %1%") % slot));
+
+    for (;;) {
+        QueuedTask task;
+        if (_take(slot, task)) {
+            _execute(task, slot);
+            continue;
+        }
+
+        unique_lock<mutex> lock(_sleep_mutex);
+        if (_shutdown)
+            return;
+        if (_queued == 0)
+            _work_ready.wait(lock);
+    }
+}
+
+void TaskExecutor::parallel_for(size_t n, IndexedTask const& fn) {
+    if (n == 0)
+        return;
+
+    TaskGroup group(*this);
+    atomic<size_t> next(0);
+    auto runner = [&]() {
+        size_t i;
+        while (!group.cancelled() && (i = next++) < n)
+            fn(i);
+    };
+
+    // One runner per thread that can take part; wait() has the calling
+    // thread run whichever of them no worker got to.
+    size_t runners = min(n, _num_workers + 1);
+    for (size_t i = 0; i < runners; ++i)
+        group.run(runner);
+    group.wait();
+}
+
+void TaskExecutor::report_stats(ostream& out) const {
+    out << "#Executor worker\ttasks\tstolen\tbusy_s\n";
+    for (size_t i = 0; i < _queues.size(); ++i) {
+        WorkerQueue const& q = *_queues[i];
+        if (i < _num_workers)
+            out << i;
+        else
+            out << "caller";
+        out << format("\t%1%\t%2%\t%3$.3f\n")
+            % q.tasks_run % q.tasks_stolen % (q.busy_ns / 1e9);
+    }
+}
+
+TaskGroup::Stats::Stats()
+    : tasks_run(0)
+    , tasks_skipped(0)
+    , busy_ns(0)
+    , max_task_ns(0)
+{
+}
+
+TaskGroup::TaskGroup(TaskExecutor& executor)
+    : _executor(executor)
+    , _pending(0)
+    , _cancelled(false)
+{
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    }
+    catch (...) {
+    }
+}
+
+void TaskGroup::run(TaskExecutor::Task const& fn) {
+    ++_pending;
+    TaskExecutor::QueuedTask task(fn, this);
+
+    // Nobody to hand it to, or too much queued already: run it here
+    if (_executor._num_workers == 0 || _executor._queued >= _executor._queue_capacity)
+        _executor._execute(task, _executor.current_worker());
+    else
+        _executor._submit(task);
+}
+
+void TaskGroup::wait() {
+    size_t slot = _executor.current_worker();
+    while (_pending > 0) {
+        TaskExecutor::QueuedTask task;
+        if (_executor._take_from_group(this, task)) {
+            _executor._execute(task, slot);
+            continue;
+        }
+
+        // The rest are running elsewhere; each one wakes us as it finishes
+        // in case it queued more work for the group.
+        unique_lock<mutex> lock(_mutex);
+        if (_pending > 0)
+            _done.wait(lock);
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    if (_error) {
+        exception_ptr error = _error;
+        _error = exception_ptr();
+        _cancelled = false;
+        rethrow_exception(error);
+    }
+}
+
+TaskGroup::Stats TaskGroup::stats() const {
+    lock_guard<mutex> lock(_mutex);
+    return _stats;
+}
+
+void TaskGroup::_finish(bool ran, uint64_t ns, exception_ptr const& error) {
+    // Notify under the lock: once _pending drops to zero the waiter may
+    // destroy the group as soon as it can take the lock.
+    lock_guard<mutex> lock(_mutex);
+    if (ran) {
+        ++_stats.tasks_run;
+        _stats.busy_ns += ns;
+        _stats.max_task_ns = max(_stats.max_task_ns, ns);
+    }
+    else {
+        ++_stats.tasks_skipped;
+    }
+
+    if (error && !_error) {
+        _error = error;
+        _cancelled = true;
+    }
+    --_pending;
+    _done.notify_all();
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// The one pool of threads that every parallel stage draws on, so that
+// together they use the core budget given by --threads rather than each
+// starting threads of its own.
+//
+// Each worker has its own deque of tasks: it pushes and pops at the back
+// (newest first, which keeps nested work cache friendly) and, when it runs
+// dry, steals from the front of the others'. Tasks submitted from outside
+// the pool go on a shared queue. Tasks are always submitted through a
+// TaskGroup, which is how callers wait for them and see their errors.
+//
+// Tasks that run for the whole life of a stage (like the stages of an
+// AlignmentPipeline) tie up a worker; the caller has to leave enough
+// workers free for anything that such a task waits on.
+class TaskExecutor : public boost::noncopyable {
+public:
+    typedef boost::function<void()> Task;
+    typedef boost::function<void(std::size_t)> IndexedTask;
+
+    // With no workers, tasks run on the submitting thread right away. Once
+    // queue_capacity tasks are waiting, submitters run new ones themselves
+    // instead of queueing them.
+    explicit TaskExecutor(std::size_t num_workers, std::size_t queue_capacity = 4096);
+
+    // Groups must all be finished before this runs.
+    ~TaskExecutor();
+
+    std::size_t num_workers() const;
+
+    // [0, num_workers()) on a worker of this executor, num_workers() on any
+    // other thread. See WorkerLocal.
+    std::size_t current_worker() const;
+
+    // Calls fn(i) for every i in [0, n), spread over the workers and the
+    // calling thread, and returns once all calls have finished. If any call
+    // throws, the remaining ones are skipped and the first exception is
+    // rethrown here.
+    void parallel_for(std::size_t n, IndexedTask const& fn);
+
+    // Tasks run, tasks stolen from another worker and time spent running
+    // tasks, per worker ("caller" is every thread outside the pool).
+    void report_stats(std::ostream& out) const;
+
+private:
+    friend class TaskGroup;
+
+    struct QueuedTask {
+        QueuedTask() : group(0) {}
+        QueuedTask(Task const& fn, TaskGroup* group) : fn(fn), group(group) {}
+
+        Task fn;
+        TaskGroup* group;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+        // Only ever written by the thread(s) owning this slot
+        std::atomic<uint64_t> tasks_run;
+        std::atomic<uint64_t> tasks_stolen;
+        std::atomic<uint64_t> busy_ns;
+        char pad[64];
+    };
+
+    void _submit(QueuedTask const& task);
+    bool _take(std::size_t slot, QueuedTask& task);
+    bool _take_from_group(TaskGroup const* group, QueuedTask& task);
+    void _execute(QueuedTask& task, std::size_t slot);
+    void _worker_loop(std::size_t slot);
+    void _stop();
+
+private:
+    std::size_t _num_workers;
+    std::size_t _queue_capacity;
+
+    // One per worker, plus the shared queue for outside submitters
+    std::vector<boost::shared_ptr<WorkerQueue> > _queues;
+    std::vector<std::thread> _threads;
+
+    std::atomic<std::size_t> _queued;
+    std::mutex _sleep_mutex;
+    std::condition_variable _work_ready;
+    bool _shutdown;
+};
+
+// A set of tasks that are waited on together. The first task to throw
+// cancels the group: its tasks that have not started yet are skipped, and
+// wait() rethrows the exception. Long running tasks can poll cancelled().
+class TaskGroup : public boost::noncopyable {
+public:
+    struct Stats {
+        Stats();
+
+        uint64_t tasks_run;
+        uint64_t tasks_skipped;
+        uint64_t busy_ns;
+        uint64_t max_task_ns;
+    };
+
+    explicit TaskGroup(TaskExecutor& executor);
+
+    // Waits for the tasks, but drops any error; call wait() to see it.
+    ~TaskGroup();
+
+    void run(TaskExecutor::Task const& fn);
+
+    // Returns once every task has finished, running queued tasks of this
+    // group on the calling thread meanwhile.
+    void wait();
+
+    void cancel();
+    bool cancelled() const;
+
+    // Per task timing; complete once wait() returns.
+    Stats stats() const;
+
+private:
+    friend class TaskExecutor;
+
+    void _finish(bool ran, uint64_t ns, std::exception_ptr const& error);
+
+private:
+    TaskExecutor& _executor;
+    std::atomic<std::size_t> _pending;
+    std::atomic<bool> _cancelled;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _done;
+    std::exception_ptr _error;
+    Stats _stats;
+};
+
+// One T per worker of an executor, plus one for threads outside it, so
+// tasks can accumulate results or reuse scratch space without locking.
+// Outside threads share their slot, so only one of them may use it at once.
+template<typename T>
+class WorkerLocal : public boost::noncopyable {
+public:
+    typedef typename std::vector<T>::iterator iterator;
+
+    explicit WorkerLocal(TaskExecutor const& executor, T const& init = T())
+        : _executor(executor)
+        , _slots(executor.num_workers() + 1, init)
+    {
+    }
+
+    T& local() {
+        return _slots[_executor.current_worker()];
+    }
+
+    iterator begin() { return _slots.begin(); }
+    iterator end() { return _slots.end(); }
+
+private:
+    TaskExecutor const& _executor;
+    std::vector<T> _slots;
+};
+
+inline
+std::size_t TaskExecutor::num_workers() const {
+    return _num_workers;
+}
+
+inline
+bool TaskGroup::cancelled() const {
+    return _cancelled;
+}
+
+inline
+void TaskGroup::cancel() {
+    _cancelled = true;
+}
@@ -0,0 +1,302 @@
+#include "Trace.hpp"
+
+#include <boost/format.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    enum {
+        MAX_THREADS = 1024,
+        THREAD_NAME_SIZE = 64
+    };
+
+    struct TraceEvent {
+        char const* name;
+        char const* arg_name;
+        int64_t arg;
+        int64_t start_ns;
+        int64_t end_ns;
+    };
+
+    // Written only by its thread; read by whoever writes the trace
+    struct ThreadBuffer {
+        ThreadBuffer() : head(0) {
+            name[0] = 0;
+        }
+
+        char name[THREAD_NAME_SIZE];
+        // Events recorded so far; the latest BUFFER_EVENTS of them are kept
+        atomic<uint64_t> head;
+        TraceEvent events[TraceSpan::BUFFER_EVENTS];
+    };
+
+    // Buffers are never freed, so that the spans of threads that have
+    // finished still make it into the trace.
+    atomic<ThreadBuffer*> g_buffers[MAX_THREADS];
+    atomic<int> g_num_buffers(0);
+    thread_local ThreadBuffer* t_buffer = 0;
+    thread_local bool t_no_buffer = false;
+
+    char g_path[4096];
+    int64_t g_epoch_ns = 0;
+    atomic_flag g_writing = ATOMIC_FLAG_INIT;
+
+    ThreadBuffer* thread_buffer() {
+        if (!t_buffer && !t_no_buffer) {
+            int i = g_num_buffers++;
+            if (i >= MAX_THREADS) {
+                t_no_buffer = true;
+                return 0;
+            }
+            t_buffer = new ThreadBuffer;
+            g_buffers[i].store(t_buffer, memory_order_release);
+        }
+        return t_buffer;
+    }
+
+    // Formats into a fixed buffer and writes it out with write(2), without
+    // allocating, so that it can run in a signal handler.
+    class TraceWriter {
+    public:
+        explicit TraceWriter(int fd) : _fd(fd), _n(0) {}
+
+        ~TraceWriter() {
+            flush();
+        }
+
+        void put(char c) {
+            if (_n == sizeof(_buf))
+                flush();
+            _buf[_n++] = c;
+        }
+
+        void put(char const* s) {
+            while (*s)
+                put(*s++);
+        }
+
+        void put_int(int64_t v) {
+            if (v < 0) {
+                put('-');
+                v = -v;
+            }
+            char digits[20];
+            int n = 0;
+            do {
+                digits[n++] = '0' + v % 10;
+                v /= 10;
+            } while (v);
+            while (n)
+                put(digits[--n]);
+        }
+
+        // Nanoseconds as the microseconds the format wants
+        void put_us(int64_t ns) {
+            put_int(ns / 1000);
+            put('.');
+            int64_t frac = ns % 1000;
+            put('0' + frac / 100);
+            put('0' + frac / 10 % 10);
+            put('0' + frac % 10);
+        }
+
+        void put_string(char const* s) {
+            put('"');
+            for (; *s; ++s) {
+                if (*s == '"' || *s == '\\')
+                    put('\\');
+                put((unsigned char)*s < 0x20 ? ' ' : *s);
+            }
+            put('"');
+        }
+
+        void flush() {
+            size_t done = 0;
+            while (done < _n) {
+                ssize_t rv = ::write(_fd, _buf + done, _n - done);
+                if (rv <= 0)
+                    break;
+                done += rv;
+            }
+            _n = 0;
+        }
+
+    private:
+        int _fd;
+        size_t _n;
+        char _buf[16384];
+    };
+
+    void write_trace() {
+        // A signal arriving while the trace is being written gives up
+        // rather than wait for itself
+        if (g_writing.test_and_set())
+            return;
+
+        int fd = open(g_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            g_writing.clear();
+            return;
+        }
+
+        {
+            TraceWriter out(fd);
+            int pid = getpid();
+            uint64_t dropped = 0;
+            bool first = true;
+            out.put("{\"traceEvents\":[\n");
+
+            int n_buffers = min(int(g_num_buffers), int(MAX_THREADS));
+            for (int i = 0; i < n_buffers; ++i) {
+                ThreadBuffer const* buffer = g_buffers[i].load(memory_order_acquire);
+                if (!buffer)
+                    continue;
+
+                if (!first)
+                    out.put(",\n");
+                first = false;
+                out.put("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":");
+                out.put_int(pid);
+                out.put(",\"tid\":");
+                out.put_int(i + 1);
+                out.put(",\"args\":{\"name\":");
+                if (buffer->name[0]) {
+                    out.put_string(buffer->name);
+                }
+                else {
+                    out.put("\"thread ");
+                    out.put_int(i + 1);
+                    out.put("\"");
+                }
+                out.put("}}");
+
+                uint64_t head = buffer->head.load(memory_order_acquire);
+                uint64_t begin = 0;
+                if (head > uint64_t(TraceSpan::BUFFER_EVENTS)) {
+                    begin = head - TraceSpan::BUFFER_EVENTS;
+                    dropped += begin;
+                }
+                for (uint64_t j = begin; j < head; ++j) {
+                    TraceEvent const& e = buffer->events[j % TraceSpan::BUFFER_EVENTS];
+                    out.put(",\n{\"name\":");
+                    out.put_string(e.name);
+                    out.put(",\"ph\":\"X\",\"pid\":");
+                    out.put_int(pid);
+                    out.put(",\"tid\":");
+                    out.put_int(i + 1);
+                    out.put(",\"ts\":");
+                    out.put_us(e.start_ns - g_epoch_ns);
+                    out.put(",\"dur\":");
+                    out.put_us(e.end_ns - e.start_ns);
+                    if (e.arg_name) {
+                        out.put(",\"args\":{");
+                        out.put_string(e.arg_name);
+                        out.put(":");
+                        out.put_int(e.arg);
+                        out.put("}");
+                    }
+                    out.put("}");
+                }
+            }
+            out.put("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":");
+            out.put_int(dropped);
+            out.put("}}\n");
+        }
+        close(fd);
+        g_writing.clear();
+    }
+
+    void on_signal(int sig) {
+        write_trace();
+        if (sig == SIGUSR1)
+            return;
+
+        // Die of the signal as we would have without tracing
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+
+    void handle_signal(int sig) {
+        struct sigaction old;
+        if (sigaction(sig, 0, &old) != 0 || old.sa_handler == SIG_IGN)
+            return;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(sig, &action, 0);
+    }
+
+    bool init_trace() {
+        char const* path = getenv("BD_TRACE");
+        if (!path || !*path)
+            return false;
+        if (strlen(path) >= sizeof(g_path))
+            throw runtime_error(str(format("Trace file name in BD_TRACE is too long: %1%") % path));
+
+        strcpy(g_path, path);
+        g_epoch_ns = trace_now_ns();
+        atexit(write_trace);
+        handle_signal(SIGINT);
+        handle_signal(SIGTERM);
+        handle_signal(SIGUSR1);
+        return true;
+    }
+}
+
+bool trace_enabled() {
+    static bool const enabled = init_trace();
+    return enabled;
+}
+
+int64_t trace_now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_record(char const* name, char const* arg_name, int64_t arg,
+        int64_t start_ns, int64_t end_ns)
+{
+    ThreadBuffer* buffer = thread_buffer();
+    if (!buffer)
+        return;
+
+    uint64_t head = buffer->head.load(memory_order_relaxed);
+    TraceEvent& e = buffer->events[head % TraceSpan::BUFFER_EVENTS];
+    e.name = name;
+    e.arg_name = arg_name;
+    e.arg = arg;
+    e.start_ns = start_ns;
+    e.end_ns = end_ns;
+    buffer->head.store(head + 1, memory_order_release);
+}
+
+void trace_thread_name(std::string const& name) {
+    if (!trace_enabled())
+        return;
+
+    ThreadBuffer* buffer = thread_buffer();
+    if (!buffer)
+        return;
+    size_t n = min(name.size(), size_t(THREAD_NAME_SIZE) - 1);
+    memcpy(buffer->name, name.data(), n);
+    buffer->name[n] = 0;
+}
+
+void trace_flush() {
+    if (trace_enabled())
+        write_trace();
+}
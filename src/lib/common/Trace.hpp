@@ -0,0 +1,78 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <stdint.h>
+#include <string>
+
+// A timeline of what every thread was doing, for finding stalls and
+// imbalance between parallel stages. Setting BD_TRACE in the environment to
+// a file name turns it on; the file is written in the Chrome trace-event
+// JSON format (for chrome://tracing or ui.perfetto.dev) when the program
+// exits, when it is stopped by SIGINT or SIGTERM, and whenever it gets
+// SIGUSR1.
+//
+// Each thread records its spans into a ring buffer of its own, so tracing
+// takes no locks; a thread that records more than BUFFER_EVENTS spans
+// keeps only the latest. Without BD_TRACE, a span only checks whether
+// tracing is on.
+class TraceSpan : public boost::noncopyable {
+public:
+    enum { BUFFER_EVENTS = 1 << 15 };
+
+    // name (and arg_name) must outlive the trace, e.g. be string literals
+    explicit TraceSpan(char const* name);
+    TraceSpan(char const* name, char const* arg_name, int64_t arg);
+    ~TraceSpan();
+
+    // A number shown with the span, e.g. how many records it handled
+    void set_arg(char const* arg_name, int64_t arg);
+
+private:
+    char const* _name;
+    char const* _arg_name;
+    int64_t _arg;
+    // -1 if not tracing
+    int64_t _start_ns;
+};
+
+bool trace_enabled();
+int64_t trace_now_ns();
+void trace_record(char const* name, char const* arg_name, int64_t arg,
+    int64_t start_ns, int64_t end_ns);
+
+// Names the calling thread in the timeline
+void trace_thread_name(std::string const& name);
+
+// Writes the trace so far to the BD_TRACE file
+void trace_flush();
+
+inline
+TraceSpan::TraceSpan(char const* name)
+    : _name(name)
+    , _arg_name(0)
+    , _arg(0)
+    , _start_ns(trace_enabled() ? trace_now_ns() : -1)
+{
+}
+
+inline
+TraceSpan::TraceSpan(char const* name, char const* arg_name, int64_t arg)
+    : _name(name)
+    , _arg_name(arg_name)
+    , _arg(arg)
+    , _start_ns(trace_enabled() ? trace_now_ns() : -1)
+{
+}
+
+inline
+TraceSpan::~TraceSpan() {
+    if (_start_ns >= 0)
+        trace_record(_name, _arg_name, _arg, _start_ns, trace_now_ns());
+}
+
+inline
+void TraceSpan::set_arg(char const* arg_name, int64_t arg) {
+    _arg_name = arg_name;
+    _arg = arg;
+}
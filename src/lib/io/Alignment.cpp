@@ -9,22 +9,44 @@
 using namespace std;
 
 
-uint8_t determine_bdqual(bam1_t const* record) {
+uint8_t determine_bdqual(BamRecordView const& view) {
     // Breakdancer always takes the alternative mapping quality, if available
     // it originally contained support for AQ, but the newer tag appears to be
     // AM. Dropping support for AQ.
-    if(uint8_t* alt_qual = bam_aux_get(record, "AM")) {
-         return bam_aux2i(alt_qual);
+    if (view.has_alt_qual()) {
+         return view.alt_qual();
     }
     else {
         // if no alternative mapping quality, use core quality
-        return record->core.qual;
+        return view.core().qual;
     }
 }
 
+int determine_mate_bdqual(BamRecordView const& view) {
+    // MQ holds the mate's core mapping quality. That is only what we would
+    // use for the mate if the aligner doesn't also emit AM, in which case
+    // the mate's AM value is unknown to us.
+    if (view.has_alt_qual())
+        return -1;
+
+    if (view.has_mate_qual())
+        return view.mate_qual();
+
+    return -1;
+}
+
+uint8_t determine_bdqual(bam1_t const* record) {
+    return determine_bdqual(BamRecordView(record));
+}
+
+int determine_mate_bdqual(bam1_t const* record) {
+    return determine_mate_bdqual(BamRecordView(record));
+}
+
 std::string determine_read_group(bam1_t const* record) {
-    if(uint8_t* tmp = bam_aux_get(record, "RG"))
-        return bam_aux2Z(tmp);
+    BamRecordView view(record);
+    if (view.read_group())
+        return std::string(view.read_group(), view.read_group_length());
     return "";
 }
 
@@ -37,32 +59,62 @@ Alignment::Alignment()
     , _abs_isize(-1)
     , _sam_flag(0)
     , _bdqual(0)
+    , _mate_bdqual(-1)
+    , _is_read_counts(false)
+    , _proper_pair_count(0)
+    , _normal_read_count(0)
     , _lib_index(-1)
     , _bdflag(ReadFlag::NA)
 {
 }
 
 Alignment::Alignment(bam1_t const* record, bool seq_data)
-    : _tid(record->core.tid)
-    , _pos(record->core.pos)
-    , _query_length(record->core.l_qseq)
-    , _mtid(record->core.mtid)
-    , _mpos(record->core.mpos)
-    , _abs_isize(abs(record->core.isize))
-    , _sam_flag(record->core.flag)
-    , _bdqual(determine_bdqual(record))
-    , _query_name(bam1_qname(record))
+    : _is_read_counts(false)
+    , _proper_pair_count(0)
+    , _normal_read_count(0)
     , _lib_index(~0)
     , _bdflag(ReadFlag::NA)
 {
+    _init(BamRecordView(record), seq_data);
+}
+
+Alignment::Alignment(BamRecordView const& view, bool seq_data)
+    : _is_read_counts(false)
+    , _proper_pair_count(0)
+    , _normal_read_count(0)
+    , _lib_index(~0)
+    , _bdflag(ReadFlag::NA)
+{
+    _init(view, seq_data);
+}
+
+void Alignment::_init(BamRecordView const& view, bool seq_data) {
+    bam1_core_t const& core = view.core();
+    _tid = core.tid;
+    _pos = core.pos;
+    _query_length = core.l_qseq;
+    _mtid = core.mtid;
+    _mpos = core.mpos;
+    _abs_isize = abs(core.isize);
+    _sam_flag = core.flag;
+    _bdqual = determine_bdqual(view);
+    _mate_bdqual = determine_mate_bdqual(view);
+    _query_name = view.query_name();
+
     if (seq_data) {
-        uint8_t* end = bam1_qual(record);
+        uint8_t const* end = view.qual();
         if (*end != 0xff)
-            end += record->core.l_qseq;
-        _bam_data.assign(bam1_seq(record), end);
+            end += core.l_qseq;
+        _bam_data.assign(view.seq(), end);
     }
 }
 
+void Alignment::set_read_counts(BamRecordView const& view) {
+    _is_read_counts = view.has_read_counts();
+    _proper_pair_count = _is_read_counts ? view.proper_pair_count() : 0;
+    _normal_read_count = _is_read_counts ? view.normal_read_count() : 0;
+}
+
 void Alignment::to_fastq(std::ostream& stream) const {
     assert(!_bam_data.empty());
     stream << "@" << query_name() << "\n";
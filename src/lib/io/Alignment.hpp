@@ -1,5 +1,6 @@
 #pragma once
 
+#include "BamRecordView.hpp"
 #include "common/ReadFlags.hpp"
 
 #include <boost/noncopyable.hpp>
@@ -18,7 +19,10 @@ extern "C" {
 
 struct LibraryInfo;
 
+uint8_t determine_bdqual(BamRecordView const& view);
+int determine_mate_bdqual(BamRecordView const& view);
 uint8_t determine_bdqual(bam1_t const* record);
+int determine_mate_bdqual(bam1_t const* record);
 std::string determine_read_group(bam1_t const* record);
 
 class Alignment : public boost::noncopyable {
@@ -27,6 +31,7 @@ public:
 
     Alignment();
     Alignment(bam1_t const* record, bool seq_data = true);
+    Alignment(BamRecordView const& view, bool seq_data = true);
 
     void set_bdflag(ReadFlag const& new_flag);
     bool proper_pair() const;
@@ -41,9 +46,12 @@ public:
     uint16_t sam_flag() const;
     int32_t tid() const;
     int32_t pos() const;
+    int32_t mate_tid() const;
+    int32_t mate_pos() const;
     int32_t query_length() const;
     int32_t abs_isize() const;
     uint8_t bdqual() const;
+    int mate_bdqual() const;
     strand_e ori() const;
 
     void set_lib_index(std::size_t const& index);
@@ -52,6 +60,17 @@ public:
     void to_fastq(std::ostream& stream) const;
     bool leftmost() const;
 
+    // Evidence file count records (see BamRecordView::has_read_counts).
+    // Records only count as such once set_read_counts takes their counts,
+    // which is only done for records from evidence files.
+    void set_read_counts(BamRecordView const& view);
+    bool is_read_counts() const;
+    int32_t proper_pair_count() const;
+    int32_t normal_read_count() const;
+
+private:
+    void _init(BamRecordView const& view, bool seq_data);
+
 private: // Data
     int32_t _tid;
     int32_t _pos;
@@ -61,6 +80,10 @@ private: // Data
     int32_t _abs_isize;
     uint16_t _sam_flag;
     uint8_t _bdqual;
+    int16_t _mate_bdqual;
+    bool _is_read_counts;
+    int32_t _proper_pair_count;
+    int32_t _normal_read_count;
 
     std::string _query_name;
 
@@ -74,6 +97,21 @@ bool Alignment::leftmost() const {
     return _pos < _mpos;
 }
 
+inline
+bool Alignment::is_read_counts() const {
+    return _is_read_counts;
+}
+
+inline
+int32_t Alignment::proper_pair_count() const {
+    return _proper_pair_count;
+}
+
+inline
+int32_t Alignment::normal_read_count() const {
+    return _normal_read_count;
+}
+
 inline
 void Alignment::set_bdflag(ReadFlag const& new_flag) {
     _bdflag = new_flag;
@@ -89,6 +127,12 @@ uint8_t Alignment::bdqual() const {
     return _bdqual;
 }
 
+// The mate's bdqual, or -1 when the record does not tell us what it is.
+inline
+int Alignment::mate_bdqual() const {
+    return _mate_bdqual;
+}
+
 inline
 int32_t Alignment::tid() const {
     return _tid;
@@ -99,6 +143,16 @@ int32_t Alignment::pos() const {
     return _pos;
 }
 
+inline
+int32_t Alignment::mate_tid() const {
+    return _mtid;
+}
+
+inline
+int32_t Alignment::mate_pos() const {
+    return _mpos;
+}
+
 inline
 int32_t Alignment::query_length() const {
     return _query_length;
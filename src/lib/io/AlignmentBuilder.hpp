@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Alignment.hpp"
+#include "BamConfig.hpp"
+#include "BamRecordView.hpp"
+#include "IAlignmentClassifier.hpp"
+
+#include "common/Probes.hpp"
+
+#include <cstddef>
+#include <string>
+
+// Turns raw bam records into classified Alignments: decodes the fields we
+// use, looks up the library from the read group and sets the read flag.
+// Records of libraries in evidence files may be count records.
+// Not thread safe (it caches the last read group lookup); use one per
+// thread.
+class AlignmentBuilder {
+public:
+    AlignmentBuilder(
+            IAlignmentClassifier const& alignment_classifier,
+            BamConfig const& bam_config,
+            bool seq_data
+            )
+        : alignment_classifier_(alignment_classifier)
+        , bam_config_(bam_config)
+        , seq_data_(seq_data)
+        , last_lib_index_(UNKNOWN_LIB)
+    {
+    }
+
+    Alignment::Ptr operator()(bam1_t const* record) {
+        BD_PROBE3(record_decoded, record->core.tid, record->core.pos, record->core.flag);
+        BamRecordView view(record);
+
+        // FIXME: construct alignment more directly rather than using partial
+        // construction then setters
+        Alignment::Ptr aln(new Alignment(view, seq_data_));
+
+        int lib_index = library_index(view);
+        if (lib_index >= 0) {
+            aln->set_lib_index(lib_index);
+            if (bam_config_.is_evidence_file(bam_config_.library_config(lib_index).bam_file_index))
+                aln->set_read_counts(view);
+            alignment_classifier_.set_flag(*aln);
+        }
+
+        return aln;
+    }
+
+private:
+    // Reads arrive in long runs from the same read group, so remember the
+    // last lookup rather than going through the config maps for every read.
+    int library_index(BamRecordView const& view) {
+        char const* rg = view.read_group();
+        std::size_t rg_len = view.read_group_length();
+        if (!rg)
+            rg = "";
+
+        if (last_lib_index_ == UNKNOWN_LIB
+            || last_read_group_.size() != rg_len
+            || last_read_group_.compare(0, rg_len, rg, rg_len) != 0)
+        {
+            last_read_group_.assign(rg, rg_len);
+            std::string const& lib = bam_config_.readgroup_library(last_read_group_);
+            last_lib_index_ = lib.empty() ? NO_LIB : bam_config_.library_config(lib).index;
+        }
+        return last_lib_index_;
+    }
+
+private:
+    IAlignmentClassifier const& alignment_classifier_;
+    BamConfig const& bam_config_;
+    bool seq_data_;
+
+    enum { UNKNOWN_LIB = -2, NO_LIB = -1 };
+    std::string last_read_group_;
+    int last_lib_index_;
+};
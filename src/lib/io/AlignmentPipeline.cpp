@@ -0,0 +1,327 @@
+#include "AlignmentPipeline.hpp"
+#include "AlignmentSource.hpp"
+#include "common/Trace.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    int64_t now_ns() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Spin briefly, then yield, then back off to short sleeps so an idle
+    // stage does not burn a core while another stage is the bottleneck.
+    void backoff(unsigned& spins) {
+        if (++spins < 64)
+            return;
+        else if (spins < 256)
+            this_thread::yield();
+        else
+            this_thread::sleep_for(chrono::microseconds(50));
+    }
+
+    double seconds(uint64_t ns) {
+        return ns / 1e9;
+    }
+}
+
+AlignmentPipeline::StageStats::StageStats()
+    : batches(0)
+    , records(0)
+    , busy_ns(0)
+    , starved_ns(0)
+    , blocked_ns(0)
+    , occupancy_sum(0)
+{
+}
+
+AlignmentPipeline::AlignmentPipeline(
+        TaskExecutor& executor,
+        BamReaderBase& bam_reader,
+        IAlignmentClassifier const& alignment_classifier,
+        BamConfig const& bam_config,
+        bool seq_data,
+        size_t queue_depth
+        )
+    : _bam_reader(bam_reader)
+    , _make_alignment(alignment_classifier, bam_config, seq_data)
+    , _decoded(queue_depth)
+    , _free_records(queue_depth + 2)
+    , _classified(queue_depth)
+    , _free_alignments(queue_depth + 2)
+    , _cancelled(false)
+    , _failed(false)
+    , _finished(false)
+    , _last_return_ns(0)
+    , _two_stages(executor.num_workers() >= MIN_WORKERS_FOR_TWO_STAGES)
+    , _stages(executor)
+{
+    if (executor.num_workers() == 0)
+        throw std::logic_error("AlignmentPipeline needs an executor with worker threads");
+
+    // Each stage can hold one batch while the queues are full, so this many
+    // batches are enough that no stage ever waits on the free queues.
+    size_t n_batches = _decoded.capacity() + 2;
+    for (size_t i = 0; i < n_batches; ++i) {
+        _record_pool.push_back(boost::shared_ptr<RecordBatch>(new RecordBatch));
+        _free_records.try_push(_record_pool.back().get());
+        _alignment_pool.push_back(boost::shared_ptr<AlignmentBatch>(new AlignmentBatch));
+        _free_alignments.try_push(_alignment_pool.back().get());
+    }
+
+    try {
+        if (_two_stages) {
+            _stages.run(boost::bind(&AlignmentPipeline::_decode_loop, this));
+            _stages.run(boost::bind(&AlignmentPipeline::_classify_loop, this));
+        }
+        else {
+            _stages.run(boost::bind(&AlignmentPipeline::_decode_and_classify_loop, this));
+        }
+    }
+    catch (...) {
+        _stop();
+        throw;
+    }
+}
+
+AlignmentPipeline::~AlignmentPipeline() {
+    _stop();
+}
+
+void AlignmentPipeline::_stop() {
+    _cancelled = true;
+    // The stage loops catch their own errors
+    _stages.wait();
+}
+
+template<typename T>
+bool AlignmentPipeline::_push(SpscQueue<T>& q, T const& value, StageStats& stats) {
+    if (!q.try_push(value)) {
+        TraceSpan span("queue full");
+        int64_t start = now_ns();
+        unsigned spins = 0;
+        while (!q.try_push(value)) {
+            if (_cancelled || _failed)
+                return false;
+            backoff(spins);
+        }
+        stats.blocked_ns += now_ns() - start;
+    }
+    stats.occupancy_sum += q.size();
+    return true;
+}
+
+template<typename T>
+bool AlignmentPipeline::_pop(SpscQueue<T>& q, T& value, StageStats* stats) {
+    if (!q.try_pop(value)) {
+        TraceSpan span("queue empty");
+        int64_t start = now_ns();
+        unsigned spins = 0;
+        while (!q.try_pop(value)) {
+            if (_cancelled || _failed)
+                return false;
+            backoff(spins);
+        }
+        if (stats)
+            stats->starved_ns += now_ns() - start;
+    }
+    return true;
+}
+
+void AlignmentPipeline::_decode_loop() {
+    try {
+        RecordBatch* batch = 0;
+        while (_pop(_free_records, batch, 0)) {
+            int64_t start = now_ns();
+            size_t n;
+            {
+                TraceSpan span("decode");
+                n = _bam_reader.next_batch(*batch);
+                span.set_arg("records", n);
+            }
+            _decode_stats.busy_ns += now_ns() - start;
+
+            if (n == 0)
+                break;
+
+            ++_decode_stats.batches;
+            _decode_stats.records += n;
+            if (!_push(_decoded, batch, _decode_stats))
+                return;
+        }
+    }
+    catch (...) {
+        _decode_error = current_exception();
+    }
+    _push(_decoded, static_cast<RecordBatch*>(0), _decode_stats);
+}
+
+void AlignmentPipeline::_classify(RecordBatch const& records, AlignmentBatch& alns) {
+    TraceSpan span("classify", "records", records.size());
+    int64_t start = now_ns();
+    alns.clear();
+    alns.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+        alns.push_back(_make_alignment(records[i]));
+    _classify_stats.busy_ns += now_ns() - start;
+
+    ++_classify_stats.batches;
+    _classify_stats.records += alns.size();
+}
+
+void AlignmentPipeline::_classify_loop() {
+    try {
+        RecordBatch* records = 0;
+        while (_pop(_decoded, records, &_classify_stats) && records) {
+            AlignmentBatch* alns = 0;
+            if (!_pop(_free_alignments, alns, 0))
+                return;
+
+            _classify(*records, *alns);
+
+            // The free queue has room for every batch, so this never waits
+            _free_records.try_push(records);
+            if (!_push(_classified, alns, _classify_stats))
+                return;
+        }
+    }
+    catch (...) {
+        _classify_error = current_exception();
+        // Let the decoder give up rather than wait forever for us
+        _failed = true;
+    }
+    _finish_classified();
+}
+
+void AlignmentPipeline::_decode_and_classify_loop() {
+    try {
+        // There is only ever one record batch in flight here
+        RecordBatch* records = 0;
+        _free_records.try_pop(records);
+
+        AlignmentBatch* alns = 0;
+        while (_pop(_free_alignments, alns, 0)) {
+            int64_t start = now_ns();
+            size_t n;
+            {
+                TraceSpan span("decode");
+                n = _bam_reader.next_batch(*records);
+                span.set_arg("records", n);
+            }
+            _decode_stats.busy_ns += now_ns() - start;
+
+            // The unused batch stays in the pool: next_batch is the only
+            // producer on _free_alignments
+            if (n == 0)
+                break;
+
+            ++_decode_stats.batches;
+            _decode_stats.records += n;
+
+            _classify(*records, *alns);
+            if (!_push(_classified, alns, _classify_stats))
+                return;
+        }
+    }
+    catch (...) {
+        _decode_error = current_exception();
+    }
+    _finish_classified();
+}
+
+void AlignmentPipeline::_finish_classified() {
+    // Bypass _push: it gives up after a failure, and the consumer must see
+    // the end of the stream even then.
+    unsigned spins = 0;
+    while (!_classified.try_push(0) && !_cancelled)
+        backoff(spins);
+}
+
+size_t AlignmentPipeline::next_batch(AlignmentBatch& alns) {
+    alns.clear();
+    if (_finished)
+        return 0;
+
+    int64_t start = now_ns();
+    if (_last_return_ns)
+        _consume_stats.busy_ns += start - _last_return_ns;
+
+    AlignmentBatch* batch = 0;
+    if (!_classified.try_pop(batch)) {
+        TraceSpan span("queue empty");
+        unsigned spins = 0;
+        while (!_classified.try_pop(batch))
+            backoff(spins);
+    }
+
+    if (!batch) {
+        _finished = true;
+        _stop();
+        if (_decode_error)
+            rethrow_exception(_decode_error);
+        if (_classify_error)
+            rethrow_exception(_classify_error);
+        return 0;
+    }
+
+    // Hand the alignments over by swapping vectors; the caller's old
+    // vector is recycled.
+    alns.swap(*batch);
+    _free_alignments.try_push(batch);
+
+    ++_consume_stats.batches;
+    _consume_stats.records += alns.size();
+    _last_return_ns = now_ns();
+    _consume_stats.starved_ns += _last_return_ns - start;
+    return alns.size();
+}
+
+void AlignmentPipeline::report_stats(ostream& out) const {
+    struct {
+        char const* name;
+        StageStats const* stats;
+        size_t queue_capacity;
+    } stages[] = {
+        {"decode", &_decode_stats, _two_stages ? _decoded.capacity() : 0},
+        {"classify", &_classify_stats, _classified.capacity()},
+        {"consume", &_consume_stats, 0}
+    };
+
+    out << "#Pipeline stage\tbatches\trecords\tbusy_s\tstarved_s\tblocked_s\tavg_queue\n";
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+        StageStats const& s = *stages[i].stats;
+        out << format("%1%\t%2%\t%3%\t%4$.3f\t%5$.3f\t%6$.3f\t")
+            % stages[i].name % s.batches % s.records
+            % seconds(s.busy_ns) % seconds(s.starved_ns) % seconds(s.blocked_ns);
+        if (stages[i].queue_capacity && s.batches)
+            out << format("%1$.2f/%2%") % (double(s.occupancy_sum) / s.batches) % stages[i].queue_capacity;
+        else
+            out << "-";
+        out << "\n";
+    }
+}
+
+boost::shared_ptr<IAlignmentBatchSource> make_alignment_source(
+        BamReaderBase& bam_reader,
+        IAlignmentClassifier const& alignment_classifier,
+        BamConfig const& bam_config,
+        bool seq_data,
+        TaskExecutor& executor
+        )
+{
+    boost::shared_ptr<IAlignmentBatchSource> rv;
+    if (executor.num_workers() > 0)
+        rv.reset(new AlignmentPipeline(executor, bam_reader, alignment_classifier, bam_config, seq_data));
+    else
+        rv.reset(new AlignmentSource(bam_reader, alignment_classifier, bam_config, seq_data));
+    return rv;
+}
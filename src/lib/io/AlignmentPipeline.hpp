@@ -0,0 +1,123 @@
+#pragma once
+
+#include "AlignmentBuilder.hpp"
+#include "BamReaderBase.hpp"
+#include "IAlignmentBatchSource.hpp"
+#include "RecordBatch.hpp"
+#include "common/SpscQueue.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+class BamConfig;
+class IAlignmentClassifier;
+
+// Reads alignments with decoding and classification running ahead of the
+// consumer as long running tasks on a TaskExecutor:
+//
+//   decode task:   reader.next_batch() -> RecordBatch
+//   classify task: RecordBatch -> vector<Alignment::Ptr>
+//   consumer:      next_batch()
+//
+// Each task holds on to a worker for the life of the pipeline. With fewer
+// than MIN_WORKERS_FOR_TWO_STAGES workers, a single task does both decoding
+// and classification so that a worker is left for other work.
+//
+// Stages are connected by bounded SPSC queues. Batches are preallocated
+// and recycled through return queues, so the steady state does no batch
+// allocation. An exception thrown in a stage is rethrown from next_batch.
+class AlignmentPipeline : public IAlignmentBatchSource, public boost::noncopyable {
+public:
+    typedef std::vector<Alignment::Ptr> AlignmentBatch;
+
+    enum { MIN_WORKERS_FOR_TWO_STAGES = 3 };
+
+    // The executor needs at least one worker.
+    AlignmentPipeline(
+            TaskExecutor& executor,
+            BamReaderBase& bam_reader,
+            IAlignmentClassifier const& alignment_classifier,
+            BamConfig const& bam_config,
+            bool seq_data,
+            std::size_t queue_depth = 8
+            );
+
+    // Stops the stages and waits for them, even if input remains.
+    ~AlignmentPipeline();
+
+    std::size_t next_batch(AlignmentBatch& alns);
+
+    // Per stage counts, busy time and time spent stalled on the queues,
+    // plus the average output queue occupancy.
+    void report_stats(std::ostream& out) const;
+
+private:
+    struct StageStats {
+        StageStats();
+
+        uint64_t batches;
+        uint64_t records;
+        uint64_t busy_ns;
+        uint64_t starved_ns; // waiting for input
+        uint64_t blocked_ns; // waiting for space on the output queue
+        uint64_t occupancy_sum; // output queue size, summed at each push
+    };
+
+    template<typename T>
+    bool _push(SpscQueue<T>& q, T const& value, StageStats& stats);
+
+    template<typename T>
+    bool _pop(SpscQueue<T>& q, T& value, StageStats* stats);
+
+    void _classify(RecordBatch const& records, AlignmentBatch& alns);
+    void _decode_loop();
+    void _classify_loop();
+    void _decode_and_classify_loop();
+    void _finish_classified();
+    void _stop();
+
+private:
+    BamReaderBase& _bam_reader;
+    AlignmentBuilder _make_alignment;
+
+    std::vector<boost::shared_ptr<RecordBatch> > _record_pool;
+    std::vector<boost::shared_ptr<AlignmentBatch> > _alignment_pool;
+
+    // Null pointers mark the end of the stream.
+    SpscQueue<RecordBatch*> _decoded;
+    SpscQueue<RecordBatch*> _free_records;
+    SpscQueue<AlignmentBatch*> _classified;
+    SpscQueue<AlignmentBatch*> _free_alignments;
+
+    std::atomic<bool> _cancelled; // the consumer is done with us
+    std::atomic<bool> _failed; // the (last) classify stage threw
+    bool _finished;
+    std::exception_ptr _decode_error;
+    std::exception_ptr _classify_error;
+
+    StageStats _decode_stats;
+    StageStats _classify_stats;
+    StageStats _consume_stats;
+    int64_t _last_return_ns;
+
+    bool _two_stages;
+    TaskGroup _stages;
+};
+
+// An AlignmentPipeline if the executor has workers, otherwise a plain
+// AlignmentSource.
+boost::shared_ptr<IAlignmentBatchSource> make_alignment_source(
+        BamReaderBase& bam_reader,
+        IAlignmentClassifier const& alignment_classifier,
+        BamConfig const& bam_config,
+        bool seq_data,
+        TaskExecutor& executor
+        );
@@ -1,15 +1,18 @@
 #pragma once
 
 #include "Alignment.hpp"
+#include "AlignmentBuilder.hpp"
 #include "BamReaderBase.hpp"
+#include "IAlignmentBatchSource.hpp"
 #include "IAlignmentClassifier.hpp"
 #include "BamConfig.hpp"
-#include "RawBamEntry.hpp"
+#include "RecordBatch.hpp"
+#include "common/Trace.hpp"
 
 #include <cstddef>
-#include <string>
+#include <vector>
 
-class AlignmentSource {
+class AlignmentSource : public IAlignmentBatchSource {
 public:
     AlignmentSource(
             BamReaderBase& bam_reader,
@@ -18,9 +21,8 @@ public:
             bool seq_data
             )
         : bam_reader_(bam_reader)
-        , alignment_classifier_(alignment_classifier)
-        , bam_config_(bam_config)
-        , seq_data_(seq_data)
+        , make_alignment_(alignment_classifier, bam_config, seq_data)
+        , cursor_(0)
     {
     }
 
@@ -46,29 +48,35 @@ public:
 */
 
     Alignment::Ptr next() {
-        if (bam_reader_.next(record_) <= 0)
-            return Alignment::Ptr();
+        if (cursor_ == batch_.size()) {
+            cursor_ = 0;
+            if (bam_reader_.next_batch(batch_) == 0)
+                return Alignment::Ptr();
+        }
 
-        // FIXME: construct alignment more directly rather than using partial
-        // construction then setters
-        Alignment::Ptr aln(new Alignment(record_, seq_data_));
+        return make_alignment_(batch_[cursor_++]);
+    }
 
-        std::string read_group = determine_read_group(record_);
-        std::string const& lib = bam_config_.readgroup_library(read_group);
-        if(!lib.empty()) {
-            std::size_t lib_index = bam_config_.library_config(lib).index;
-            aln->set_lib_index(lib_index);
-            alignment_classifier_.set_flag(*aln);
+    std::size_t next_batch(std::vector<Alignment::Ptr>& alns) {
+        alns.clear();
+        if (cursor_ == batch_.size()) {
+            TraceSpan span("decode");
+            cursor_ = 0;
+            span.set_arg("records", bam_reader_.next_batch(batch_));
         }
 
-        return aln;
+        TraceSpan span("classify", "records", batch_.size() - cursor_);
+        alns.reserve(batch_.size() - cursor_);
+        for (; cursor_ < batch_.size(); ++cursor_)
+            alns.push_back(make_alignment_(batch_[cursor_]));
+
+        return alns.size();
     }
 
 private:
     BamReaderBase& bam_reader_;
-    IAlignmentClassifier const& alignment_classifier_;
-    BamConfig const& bam_config_;
-    bool seq_data_;
+    AlignmentBuilder make_alignment_;
 
-    RawBamEntry record_;
+    RecordBatch batch_;
+    std::size_t cursor_;
 };
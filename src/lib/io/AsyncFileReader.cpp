@@ -0,0 +1,544 @@
+#include "AsyncFileReader.hpp"
+
+#include "common/TaskExecutor.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef BD_HAVE_IO_URING
+# include <linux/io_uring.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    // Reads until n bytes or the end of the file; -errno on failure
+    ssize_t pread_fully(int fd, void* buf, size_t n, uint64_t offset) {
+        unsigned char* out = static_cast<unsigned char*>(buf);
+        size_t done = 0;
+        while (done < n) {
+            ssize_t rv = pread(fd, out + done, n - done, offset + done);
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -errno;
+            }
+            if (rv == 0)
+                break;
+            done += rv;
+        }
+        return done;
+    }
+}
+
+struct AsyncFileReader::Chunk : public boost::noncopyable {
+    // Aligned for O_DIRECT
+    explicit Chunk(size_t capacity)
+        : data(0)
+        , capacity(capacity)
+        , offset(0)
+        , size(0)
+        , error(0)
+        , in_flight(false)
+    {
+        if (posix_memalign(reinterpret_cast<void**>(&data), DIRECT_ALIGNMENT, capacity))
+            throw bad_alloc();
+    }
+
+    ~Chunk() {
+        free(data);
+    }
+
+    unsigned char* data;
+    size_t capacity;
+    uint64_t offset;
+    // Bytes read, once the read is done; fewer than capacity only at the
+    // end of the file
+    size_t size;
+    // errno of a failed read
+    int error;
+    bool in_flight;
+
+    // THREADS: the task reading the chunk
+    boost::scoped_ptr<TaskGroup> group;
+#ifdef BD_HAVE_IO_URING
+    struct iovec iov;
+#endif
+};
+
+#ifdef BD_HAVE_IO_URING
+// A bare io_uring: the kernel header and two system calls are all it takes
+// to read files, so there is no dependency on liburing.
+struct AsyncFileReader::Ring {
+    Ring()
+        : fd(-1)
+        , sq_ptr(MAP_FAILED)
+        , sq_len(0)
+        , cq_ptr(MAP_FAILED)
+        , cq_len(0)
+        , sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+        , sqes_len(0)
+    {
+    }
+
+    ~Ring() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED)
+            munmap(sq_ptr, sq_len);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // False if the kernel has no io_uring or it is not allowed here (as
+    // under some seccomp profiles)
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0)
+            return false;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+        single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+#endif
+        if (single_mmap)
+            sq_len = cq_len = max(sq_len, cq_len);
+
+        sq_ptr = mmap(0, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED)
+            return false;
+        cq_ptr = single_mmap ? sq_ptr : mmap(0, cq_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+            return false;
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(0, sqes_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            return false;
+
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // Queues a read of chunk, to be submitted by enter(). There is always
+    // room: the ring has an entry for every chunk.
+    void prepare(Chunk& chunk, int file_fd, uint64_t user_data) {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        chunk.iov.iov_base = chunk.data;
+        chunk.iov.iov_len = chunk.capacity;
+        // READV rather than READ, which only came with Linux 5.6
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = file_fd;
+        sqe->off = chunk.offset;
+        sqe->addr = reinterpret_cast<uint64_t>(&chunk.iov);
+        sqe->len = 1;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Submits to_submit queued reads and waits for min_complete reads
+    void enter(unsigned to_submit, unsigned min_complete) {
+        while (to_submit > 0 || min_complete > 0) {
+            long rv = syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                min_complete ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw runtime_error(str(format("io_uring_enter failed: %1%") % strerror(errno)));
+            }
+            to_submit -= min(unsigned(rv), to_submit);
+            min_complete = 0;
+        }
+    }
+
+    int fd;
+    void* sq_ptr;
+    size_t sq_len;
+    void* cq_ptr;
+    size_t cq_len;
+    io_uring_sqe* sqes;
+    size_t sqes_len;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+};
+#else
+struct AsyncFileReader::Ring {
+};
+#endif
+
+IoPolicy parse_io_policy(std::string const& name) {
+    for (int i = IO_NORMAL; i <= IO_DIRECT; ++i) {
+        if (name == io_policy_name(IoPolicy(i)))
+            return IoPolicy(i);
+    }
+    throw runtime_error(str(format(
+        "Unknown io policy '%1%' (expected normal, stream or direct)") % name));
+}
+
+char const* io_policy_name(IoPolicy policy) {
+    switch (policy) {
+        case IO_NORMAL: return "normal";
+        case IO_STREAM: return "stream";
+        case IO_DIRECT: return "direct";
+    }
+    return "unknown";
+}
+
+IoOptions::IoOptions()
+    : depth(0)
+    , policy(IO_NORMAL)
+{
+}
+
+AsyncFileReader::AsyncFileReader(
+        int fd,
+        std::string const& path,
+        IoOptions const& io,
+        TaskExecutor* executor,
+        Backend backend,
+        size_t chunk_size
+        )
+    : _fd(fd)
+    , _read_fd(fd)
+    , _path(path)
+    , _policy(io.policy)
+    , _chunk_size(chunk_size)
+    , _head(0)
+    , _count(0)
+    , _next_offset(0)
+    , _dropped_to(0)
+    , _bytes_read(0)
+    , _bytes_dropped(0)
+{
+    size_t depth = io.depth;
+    if (_policy == IO_DIRECT) {
+        _read_fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+        if (_read_fd < 0) {
+            // tmpfs, for one, has no O_DIRECT
+            _read_fd = fd;
+            _policy = IO_STREAM;
+        }
+        else {
+            // Direct reads go through the (aligned) chunks even when
+            // nothing is read ahead
+            _chunk_size = (_chunk_size + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+            depth = max(depth, size_t(1));
+        }
+    }
+    if (_policy == IO_STREAM)
+        posix_fadvise(_read_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (io.depth == 0)
+        backend = SYNC;
+
+    if (backend == IO_URING) {
+#ifdef BD_HAVE_IO_URING
+        _ring.reset(new Ring);
+        if (!_ring->setup(depth)) {
+            _ring.reset();
+            backend = THREADS;
+        }
+#else
+        backend = THREADS;
+#endif
+    }
+
+    if (backend == THREADS && (!executor || executor->num_workers() == 0))
+        backend = SYNC;
+    _backend = backend;
+
+    if (_backend == SYNC && _policy != IO_DIRECT)
+        return;
+
+    for (size_t i = 0; i < depth; ++i) {
+        _chunks.push_back(boost::shared_ptr<Chunk>(new Chunk(_chunk_size)));
+        if (_backend == THREADS)
+            _chunks.back()->group.reset(new TaskGroup(*executor));
+    }
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    // The chunks must not go while the kernel or a task still writes them
+    try {
+        while (_count > 0)
+            _pop();
+    }
+    catch (...) {
+    }
+
+    if (getenv("BD_PIPELINE_STATS")) {
+        cerr << "#Io file\tpolicy\tdepth\tread_mb\tdropped_mb\tcached_mb\n"
+            << format("%1%\t%2%\t%3%\t%4$.1f\t%5$.1f\t%6$.1f\n")
+                % _path % io_policy_name(_policy) % depth()
+                % (_bytes_read / 1e6) % (_bytes_dropped / 1e6) % (bytes_cached() / 1e6);
+    }
+
+    if (_read_fd != _fd)
+        close(_read_fd);
+}
+
+size_t AsyncFileReader::read(void* buf, size_t n, uint64_t offset) {
+    // After a seek back, what is read again is dropped again
+    if (offset < _dropped_to)
+        _dropped_to = offset / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+
+    size_t rv = _chunks.empty()
+        ? _read_sync(buf, n, offset)
+        : _read_chunked(static_cast<unsigned char*>(buf), n, offset);
+
+    if (_policy == IO_STREAM)
+        _drop_behind(offset + rv);
+    return rv;
+}
+
+uint64_t AsyncFileReader::bytes_cached() const {
+    struct stat st;
+    if (fstat(_fd, &st) || st.st_size == 0)
+        return 0;
+
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED)
+        return 0;
+    size_t page = sysconf(_SC_PAGESIZE);
+    vector<unsigned char> pages((st.st_size + page - 1) / page);
+    uint64_t rv = 0;
+    if (mincore(map, st.st_size, &pages[0]) == 0) {
+        for (size_t i = 0; i < pages.size(); ++i)
+            rv += (pages[i] & 1) ? page : 0;
+    }
+    munmap(map, st.st_size);
+    return min(rv, uint64_t(st.st_size));
+}
+
+size_t AsyncFileReader::_read_sync(void* buf, size_t n, uint64_t offset) {
+    ssize_t rv = pread_fully(_read_fd, buf, n, offset);
+    if (rv < 0) {
+        throw runtime_error(str(format("Failed to read %1% at offset %2%: %3%")
+            % _path % offset % strerror(-rv)));
+    }
+    _bytes_read += rv;
+    return rv;
+}
+
+size_t AsyncFileReader::_read_chunked(unsigned char* out, size_t n, uint64_t offset) {
+    size_t done = 0;
+    while (done < n) {
+        uint64_t pos = offset + done;
+        // Chunks that do not hold pos are no use any more
+        while (_count > 0 && (pos < _chunks[_head]->offset
+                || pos >= _chunks[_head]->offset + _chunk_size))
+        {
+            _pop();
+        }
+        if (_count == 0)
+            _next_offset = _policy == IO_DIRECT ? pos / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT : pos;
+        _issue();
+
+        // Chunks are only short at the end of the file
+        Chunk& chunk = _wait_head();
+        if (pos >= chunk.offset + chunk.size)
+            break;
+
+        size_t k = min(n - done, size_t(chunk.offset + chunk.size - pos));
+        memcpy(out + done, chunk.data + (pos - chunk.offset), k);
+        done += k;
+        if (pos + k == chunk.offset + _chunk_size) {
+            _pop();
+            _issue();
+        }
+    }
+    return done;
+}
+
+void AsyncFileReader::_issue() {
+    unsigned prepared = 0;
+    while (_count < _chunks.size()) {
+        size_t index = (_head + _count) % _chunks.size();
+        Chunk& chunk = *_chunks[index];
+        chunk.offset = _next_offset;
+        chunk.size = 0;
+        chunk.error = 0;
+        chunk.in_flight = true;
+        _next_offset += _chunk_size;
+        ++_count;
+
+        switch (_backend) {
+            case SYNC:
+                _read_chunk(&chunk);
+                chunk.in_flight = false;
+                _bytes_read += chunk.size;
+                break;
+
+            case THREADS:
+                chunk.group->run(boost::bind(&AsyncFileReader::_read_chunk, this, &chunk));
+                break;
+
+            case IO_URING:
+#ifdef BD_HAVE_IO_URING
+                _ring->prepare(chunk, _read_fd, index);
+                ++prepared;
+#endif
+                break;
+        }
+    }
+
+#ifdef BD_HAVE_IO_URING
+    if (prepared > 0)
+        _ring->enter(prepared, 0);
+#endif
+}
+
+void AsyncFileReader::_read_chunk(Chunk* chunk) const {
+    ssize_t rv = pread_fully(_read_fd, chunk->data, chunk->capacity, chunk->offset);
+    if (rv < 0)
+        chunk->error = -rv;
+    else
+        chunk->size = rv;
+}
+
+void AsyncFileReader::_wait(Chunk& chunk) {
+    if (!chunk.in_flight)
+        return;
+
+    if (_backend == THREADS) {
+        chunk.group->wait();
+        chunk.in_flight = false;
+        _bytes_read += chunk.size;
+    }
+    while (chunk.in_flight)
+        _reap();
+}
+
+AsyncFileReader::Chunk& AsyncFileReader::_wait_head() {
+    Chunk& chunk = *_chunks[_head];
+    _wait(chunk);
+    if (chunk.error) {
+        throw runtime_error(str(format("Failed to read %1% at offset %2%: %3%")
+            % _path % chunk.offset % strerror(chunk.error)));
+    }
+    return chunk;
+}
+
+void AsyncFileReader::_pop() {
+    _wait(*_chunks[_head]);
+    _head = (_head + 1) % _chunks.size();
+    --_count;
+}
+
+void AsyncFileReader::_reap() {
+#ifdef BD_HAVE_IO_URING
+    _ring->enter(0, 1);
+
+    unsigned head = *_ring->cq_head;
+    unsigned tail = __atomic_load_n(_ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        io_uring_cqe const& cqe = _ring->cqes[head & *_ring->cq_mask];
+        Chunk& chunk = *_chunks[cqe.user_data];
+        if (cqe.res < 0) {
+            chunk.error = -cqe.res;
+        }
+        else {
+            chunk.size = cqe.res;
+            // io_uring may stop short of the end of the file; the rest is
+            // read here, so that only the last chunk is ever short
+            if (chunk.size > 0 && chunk.size < chunk.capacity) {
+                ssize_t rv = pread_fully(_read_fd, chunk.data + chunk.size,
+                    chunk.capacity - chunk.size, chunk.offset + chunk.size);
+                if (rv > 0)
+                    chunk.size += rv;
+            }
+        }
+        chunk.in_flight = false;
+        _bytes_read += chunk.size;
+    }
+    __atomic_store_n(_ring->cq_head, head, __ATOMIC_RELEASE);
+#endif
+}
+
+void AsyncFileReader::_drop_behind(uint64_t end) {
+    if (end < _dropped_to + DROP_BEHIND + DROP_BEHIND / 4)
+        return;
+
+    // Whole pages, and not the ones still being read
+    uint64_t to = (end - DROP_BEHIND) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+    if (posix_fadvise(_read_fd, _dropped_to, to - _dropped_to, POSIX_FADV_DONTNEED) == 0)
+        _bytes_dropped += to - _dropped_to;
+    _dropped_to = to;
+}
+
+vector<AsyncFileReader::Backend> AsyncFileReader::available_backends() {
+    vector<Backend> rv;
+    rv.push_back(SYNC);
+    rv.push_back(THREADS);
+#ifdef BD_HAVE_IO_URING
+    rv.push_back(IO_URING);
+#endif
+    return rv;
+}
+
+AsyncFileReader::Backend AsyncFileReader::default_backend() {
+    static Backend const backend = [] {
+        vector<Backend> backends = available_backends();
+        if (char const* chosen = getenv("BD_ASYNC_IO")) {
+            for (size_t i = 0; i < backends.size(); ++i) {
+                if (strcmp(chosen, name(backends[i])) == 0)
+                    return backends[i];
+            }
+            throw runtime_error(str(format(
+                "Unknown or unavailable async io backend '%1%' in BD_ASYNC_IO") % chosen));
+        }
+        return backends.back();
+    }();
+    return backend;
+}
+
+char const* AsyncFileReader::name(Backend backend) {
+    switch (backend) {
+        case SYNC: return "sync";
+        case THREADS: return "threads";
+        case IO_URING: return "io_uring";
+    }
+    return "unknown";
+}
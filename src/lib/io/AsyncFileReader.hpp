@@ -0,0 +1,169 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class TaskExecutor;
+
+// What reading a bam may leave in the page cache:
+//   IO_NORMAL: whatever the kernel keeps
+//   IO_STREAM: sequential readahead, and what has been read is dropped
+//              from the cache a few megabytes behind the reader
+//   IO_DIRECT: nothing; reads bypass the cache with O_DIRECT (or, where
+//              the file system does not allow that, as IO_STREAM)
+enum IoPolicy {
+    IO_NORMAL,
+    IO_STREAM,
+    IO_DIRECT
+};
+
+// Throws on names other than normal, stream and direct
+IoPolicy parse_io_policy(std::string const& name);
+char const* io_policy_name(IoPolicy policy);
+
+// How bams read from start to end are read
+struct IoOptions {
+    IoOptions();
+
+    // Chunks read ahead; 0 reads only as data is needed
+    std::size_t depth;
+    IoPolicy policy;
+};
+
+// Reads a file that is mostly read front to back (the compressed data of a
+// bam) with the next few chunks already being read, so that the reader
+// does not wait on the disk or the network for every buffer it fills.
+//
+// Reads are issued through io_uring where the kernel supports it (see
+// BD_HAVE_IO_URING in the top level CMakeLists.txt), and otherwise as
+// tasks of the executor. Without either, or with a depth of 0, every read
+// is a plain pread on the calling thread. Setting BD_ASYNC_IO in the
+// environment to a backend name picks another backend than the default.
+//
+// A read that does not follow on from the last one (a seek) throws away
+// the chunks in flight and starts over from there.
+//
+// With BD_PIPELINE_STATS set, each reader reports what it read, what it
+// dropped from the page cache and how much of the file is still cached
+// when it is done.
+class AsyncFileReader : public boost::noncopyable {
+public:
+    enum Backend {
+        SYNC,
+        THREADS,
+        IO_URING
+    };
+
+    enum {
+        DEFAULT_CHUNK_SIZE = 256 << 10,
+        // Alignment of O_DIRECT reads
+        DIRECT_ALIGNMENT = 4096,
+        // How far behind the reader IO_STREAM drops the cache, and so
+        // about what it keeps of the data already read
+        DROP_BEHIND = 8 << 20
+    };
+
+    // Reads fd, which is left open, keeping io.depth chunks of chunk_size
+    // bytes in flight. THREADS needs an executor with workers; backends
+    // that are unavailable fall back to the next one down.
+    AsyncFileReader(
+            int fd,
+            std::string const& path,
+            IoOptions const& io,
+            TaskExecutor* executor = 0,
+            Backend backend = default_backend(),
+            std::size_t chunk_size = DEFAULT_CHUNK_SIZE
+            );
+    ~AsyncFileReader();
+
+    // As pread(2): copies up to n bytes from offset on to buf and returns
+    // how many, fewer only at the end of the file. Throws on read errors.
+    std::size_t read(void* buf, std::size_t n, uint64_t offset);
+
+    // The backend and policy in use, after any fallback
+    Backend backend() const;
+    IoPolicy policy() const;
+    std::size_t depth() const;
+
+    // Bytes read from the file, and dropped from the page cache
+    uint64_t bytes_read() const;
+    uint64_t bytes_dropped() const;
+    // Bytes of the file that are in the page cache now
+    uint64_t bytes_cached() const;
+
+    static std::vector<Backend> available_backends();
+    static Backend default_backend();
+    static char const* name(Backend backend);
+
+private:
+    struct Chunk;
+    struct Ring;
+
+    std::size_t _read_sync(void* buf, std::size_t n, uint64_t offset);
+    std::size_t _read_chunked(unsigned char* out, std::size_t n, uint64_t offset);
+    // Issues reads for free chunks from _next_offset on
+    void _issue();
+    void _read_chunk(Chunk* chunk) const;
+    void _wait(Chunk& chunk);
+    // Waits for the oldest chunk, throwing if its read failed
+    Chunk& _wait_head();
+    // Waits for the oldest chunk and frees it
+    void _pop();
+    // Waits for at least one io_uring read to finish
+    void _reap();
+    // IO_STREAM: drops what is far enough behind end from the cache
+    void _drop_behind(uint64_t end);
+
+private:
+    int _fd;
+    // _fd, or a descriptor of our own opened with O_DIRECT
+    int _read_fd;
+    std::string _path;
+    Backend _backend;
+    IoPolicy _policy;
+    std::size_t _chunk_size;
+
+    // In file order starting at _head; _count of them are in use
+    std::vector<boost::shared_ptr<Chunk> > _chunks;
+    std::size_t _head;
+    std::size_t _count;
+    uint64_t _next_offset;
+
+    boost::scoped_ptr<Ring> _ring;
+
+    // Everything before this has been dropped from the cache
+    uint64_t _dropped_to;
+    uint64_t _bytes_read;
+    uint64_t _bytes_dropped;
+};
+
+inline
+AsyncFileReader::Backend AsyncFileReader::backend() const {
+    return _backend;
+}
+
+inline
+IoPolicy AsyncFileReader::policy() const {
+    return _policy;
+}
+
+inline
+std::size_t AsyncFileReader::depth() const {
+    return _backend == SYNC ? 0 : _chunks.size();
+}
+
+inline
+uint64_t AsyncFileReader::bytes_read() const {
+    return _bytes_read;
+}
+
+inline
+uint64_t AsyncFileReader::bytes_dropped() const {
+    return _bytes_dropped;
+}
@@ -41,6 +41,7 @@ BamConfig::BamConfig(std::istream& in, int cutoff_sd)
         float upper = 0.0f;
         float lower = 0.0f;
         int mqual = -1;
+        string role;
 
         if (!entry.set_value(Entry::LIBRARY_NAME, lib))
             entry.set_value(Entry::SAMPLE_NAME, lib);
@@ -54,6 +55,7 @@ BamConfig::BamConfig(std::istream& in, int cutoff_sd)
 
         entry.set_value(Entry::READ_LENGTH, readlen);
         entry.set_value(Entry::MIN_MAP_QUAL, mqual);
+        entry.set_value(Entry::SAMPLE_ROLE, role);
 
         // Insert size statistics
         bool have_mean = entry.set_value(Entry::INSERT_SIZE_MEAN, mean);
@@ -72,6 +74,8 @@ BamConfig::BamConfig(std::istream& in, int cutoff_sd)
         lib_config.name = lib;
         lib_config.bam_file = fmap;
         lib_config.min_mapping_quality = mqual;
+        if (!role.empty())
+            lib_config.role = parse_sample_role(role);
 
 
         // FIXME: why are we reading this as float from the config and storing as int?
@@ -118,9 +122,26 @@ BamConfig::BamConfig(std::istream& in, int cutoff_sd)
         lib.bam_file_index = std::distance(bam_files().begin(), bam_iter);
     }
 
+    _check_sample_roles();
+
     _max_read_window_size = std::max(_max_read_window_size, 50);
 }
 
+void BamConfig::_check_sample_roles() const {
+    size_t counts[3] = {0};
+    for (size_t i = 0; i < _library_config.size(); ++i)
+        ++counts[_library_config[i].role];
+
+    if (counts[ROLE_NONE] == _library_config.size())
+        return;
+
+    if (counts[ROLE_NONE] != 0)
+        throw runtime_error("Either all libraries or none must have a sample role");
+
+    if (counts[ROLE_TUMOR] == 0 || counts[ROLE_NORMAL] == 0)
+        throw runtime_error("Sample roles need at least one tumor and one normal library");
+}
+
 int BamConfig::max_read_window_size() const {
     return _max_read_window_size;
 }
@@ -33,7 +33,19 @@ public:
     LibraryConfig const& library_config(std::string const& lib) const;
     std::string const& readgroup_library(std::string const& rg) const;
 
+    // True if the libraries are marked as tumor or normal (role:...), in
+    // which case every library is, and both roles are present.
+    bool has_sample_roles() const;
+
+    // Which of bam_files() are evidence files (see EvidenceFile.hpp), going
+    // by their headers. Only records from those can be count records.
+    // ConfigLoader sets this; it is not part of the config file.
+    bool is_evidence_file(size_t bam_index) const;
+    void set_evidence_files(std::vector<bool> const& evidence_files);
+
 private:
+    void _check_sample_roles() const;
+
     template<typename Archive>
     void serialize(Archive& arch, const unsigned int version);
 
@@ -45,6 +57,7 @@ private:
     ConfigMap<std::string, std::string>::type _readgroup_library;
 
     int _max_read_window_size;
+    std::vector<bool> _evidence_files;
 };
 
 inline
@@ -59,6 +72,21 @@ LibraryConfig const& BamConfig::library_config(std::string const& lib) const {
     return _library_config[_lib_names_to_indices.at(lib)];
 }
 
+inline
+bool BamConfig::has_sample_roles() const {
+    return !_library_config.empty() && _library_config[0].role != ROLE_NONE;
+}
+
+inline
+bool BamConfig::is_evidence_file(size_t bam_index) const {
+    return bam_index < _evidence_files.size() && _evidence_files[bam_index];
+}
+
+inline
+void BamConfig::set_evidence_files(std::vector<bool> const& evidence_files) {
+    _evidence_files = evidence_files;
+}
+
 inline
 std::string const& BamConfig::readgroup_library(std::string const& rg) const {
     ConfigMap<std::string, std::string>::type::const_iterator lib = _readgroup_library.find(rg);
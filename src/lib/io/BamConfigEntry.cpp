@@ -23,6 +23,7 @@ std::string const& BamConfigEntry::token_string(Field tok) {
         (INSERT_SIZE_LOWER_CUTOFF, "low")
         (MIN_MAP_QUAL, "map")
         (SAMPLE_NAME, "sample")
+        (SAMPLE_ROLE, "role")
         ;
 
     return tok_map[tok];
@@ -51,6 +52,7 @@ BamConfigEntry::Field BamConfigEntry::translate_token(std::string const& tok) {
         (regex("low\\w*$", regex::icase), INSERT_SIZE_LOWER_CUTOFF)
         (regex("map\\w*qual\\w*$", regex::icase), MIN_MAP_QUAL)
         (regex("samp\\w*$", regex::icase), SAMPLE_NAME)
+        (regex("role$", regex::icase), SAMPLE_ROLE)
         ;
 
     typedef flat_map<regex, Field>::const_iterator TIter;
@@ -19,6 +19,7 @@ public:
         INSERT_SIZE_LOWER_CUTOFF,
         MIN_MAP_QUAL,
         SAMPLE_NAME,
+        SAMPLE_ROLE,
         UNKNOWN
     };
 
@@ -0,0 +1,716 @@
+#include "BamIndex.hpp"
+
+#include "BgzfInflater.hpp"
+#include "SamReader.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+
+namespace bfs = boost::filesystem;
+using boost::format;
+using namespace std;
+
+namespace {
+    // samtools' pseudo bin holding per sequence offsets and read counts
+    uint32_t const META_BIN = 37450;
+    int const LINEAR_SHIFT = 14;
+
+    // A guessed record start has to be followed by this many records that
+    // parse (or by the end of the file)
+    int const SYNC_RECORDS = 8;
+
+    // Larger than any real record; keeps a wrong guess from reading far
+    uint32_t const MAX_RECORD_SIZE = 1 << 28;
+
+    uint64_t const NO_START = ~uint64_t(0);
+
+    uint32_t le32(unsigned char const* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    // Samtools' order: by sequence, unplaced reads (tid -1) last, and by
+    // position within a sequence.
+    bool out_of_order(int32_t prev_tid, int32_t prev_pos, int32_t tid, int32_t pos) {
+        return uint32_t(tid) < uint32_t(prev_tid)
+            || (tid == prev_tid && tid >= 0 && pos < prev_pos);
+    }
+
+    class BgzfFile : public boost::noncopyable {
+    public:
+        explicit BgzfFile(string const& path)
+            : _path(path)
+            , _fd(open(path.c_str(), O_RDONLY))
+            , _size(0)
+        {
+            struct stat st;
+            if (_fd < 0 || fstat(_fd, &st) != 0)
+                throw runtime_error(str(format("Failed to open %1%") % path));
+            _size = st.st_size;
+        }
+
+        ~BgzfFile() {
+            close(_fd);
+        }
+
+        string const& path() const {
+            return _path;
+        }
+
+        uint64_t size() const {
+            return _size;
+        }
+
+        // Up to n bytes at offset; safe to call from several threads
+        size_t read(uint64_t offset, unsigned char* buf, size_t n) const {
+            size_t done = 0;
+            while (done < n) {
+                ssize_t rv = pread(_fd, buf + done, n - done, offset + done);
+                if (rv < 0)
+                    throw runtime_error(str(format("Failed to read %1%") % _path));
+                if (rv == 0)
+                    break;
+                done += rv;
+            }
+            return done;
+        }
+
+        // The first block starting at or after offset, or the file size if
+        // there is none. A header counts if the next one follows it.
+        uint64_t find_block(uint64_t offset) const {
+            vector<unsigned char> buf(BgzfInflater::MAX_BLOCK_SIZE + BgzfInflater::BLOCK_HEADER_SIZE);
+            buf.resize(read(offset, &buf[0], buf.size()));
+            unsigned char next[BgzfInflater::BLOCK_HEADER_SIZE];
+            for (size_t i = 0; i + BgzfInflater::BLOCK_HEADER_SIZE <= buf.size(); ++i) {
+                size_t size = BgzfInflater::block_size(&buf[i]);
+                if (!size)
+                    continue;
+                uint64_t after = offset + i + size;
+                if (after == _size
+                    || (read(after, next, BgzfInflater::BLOCK_HEADER_SIZE) == BgzfInflater::BLOCK_HEADER_SIZE
+                        && BgzfInflater::block_size(next)))
+                {
+                    return offset + i;
+                }
+            }
+            return _size;
+        }
+
+    private:
+        string _path;
+        int _fd;
+        uint64_t _size;
+    };
+
+    // Consecutive records on one sequence that share a bin
+    struct Run {
+        int32_t tid;
+        uint32_t bin;
+        uint64_t beg;
+        uint64_t end;
+        uint64_t mapped;
+        uint64_t unmapped;
+    };
+
+    // The index of the records starting in the blocks of one piece of a bam
+    struct Piece {
+        Piece()
+            : ok(false)
+            , first_block(0)
+            , next_block(0)
+            , start(NO_START)
+            , stop(NO_START)
+            , n_records(0)
+            , n_no_coor(0)
+            , first_tid(-1)
+            , first_pos(-1)
+            , last_tid(-1)
+            , last_pos(-1)
+        {
+        }
+
+        // False if the guess at where its first record starts went wrong
+        bool ok;
+        // Its first block and the one after its last
+        uint64_t first_block;
+        uint64_t next_block;
+        // Virtual offsets of its first record and just past its last one
+        uint64_t start;
+        uint64_t stop;
+
+        vector<Run> runs;
+        // Per sequence, the first record overlapping each 16kbp window
+        // (0 for none)
+        map<int32_t, vector<uint64_t> > linear;
+
+        uint64_t n_records;
+        uint64_t n_no_coor;
+        int32_t first_tid;
+        int32_t first_pos;
+        int32_t last_tid;
+        int32_t last_pos;
+    };
+
+    class PieceIndexer : public boost::noncopyable {
+    public:
+        PieceIndexer(BgzfFile const& file, int32_t n_targets, uint64_t header_end)
+            : _file(file)
+            , _n_targets(n_targets)
+            , _header_end(header_end)
+            , _inflater(BgzfInflater::default_backend(), BgzfInflater::verify_crc_default())
+            , _next_coffset(0)
+        {
+        }
+
+        // Indexes the records starting in the blocks from first_block up to
+        // the first block at or after end. Given start == NO_START, it
+        // guesses where the first of them is; a wrong guess returns a piece
+        // that is not ok rather than throwing.
+        Piece run(uint64_t first_block, uint64_t end, uint64_t start) {
+            Piece piece;
+            piece.first_block = first_block;
+            _data.clear();
+            _blocks.clear();
+            _next_coffset = first_block;
+            try {
+                while (_next_coffset < end && _read_block())
+                    ;
+                piece.next_block = _next_coffset;
+                _index(piece, start);
+            }
+            catch (runtime_error const&) {
+                if (start != NO_START)
+                    throw;
+                piece.ok = false;
+            }
+            return piece;
+        }
+
+    private:
+        struct Block {
+            uint64_t coffset;
+            size_t ustart;
+        };
+
+        void _index(Piece& piece, uint64_t start) {
+            piece.ok = true;
+            if (_data.empty()) {
+                // No data (no blocks, or the empty one at the end of the
+                // file): whatever starts the next piece starts here
+                piece.start = piece.stop = start;
+                return;
+            }
+
+            uint64_t limit = piece.next_block << 16;
+            // Nothing before the header ends is a record
+            if (start == NO_START && _header_end >= piece.first_block << 16)
+                start = _header_end;
+
+            size_t u = 0;
+            if (start == NO_START) {
+                while (_voffset(u) < limit && !_valid_chain(u))
+                    ++u;
+                start = _voffset(u);
+                if (start >= limit)
+                    throw runtime_error("No record found");
+            }
+            else if (start < limit) {
+                u = _position(start);
+            }
+            piece.start = start;
+            if (start >= limit) {
+                piece.stop = start;
+                return;
+            }
+
+            while (_voffset(u) < limit) {
+                if (!_ensure(u + 4)) {
+                    if (u == _data.size())
+                        break;
+                    throw runtime_error(str(format("%1% is truncated") % _file.path()));
+                }
+                size_t next;
+                if (!_valid_record(u, next)) {
+                    throw runtime_error(str(format(
+                        "Invalid bam record in %1% at offset %2%")
+                        % _file.path() % _voffset(u)));
+                }
+                _add_record(piece, u, next);
+                u = next;
+            }
+            piece.stop = _voffset(u);
+        }
+
+        // Appends the next block; false at the end of the file
+        bool _read_block() {
+            if (_next_coffset >= _file.size())
+                return false;
+
+            unsigned char header[BgzfInflater::BLOCK_HEADER_SIZE];
+            size_t size = 0;
+            if (_file.read(_next_coffset, header, BgzfInflater::BLOCK_HEADER_SIZE) == BgzfInflater::BLOCK_HEADER_SIZE)
+                size = BgzfInflater::block_size(header);
+            if (!size) {
+                throw runtime_error(str(format(
+                    "Invalid bgzf block in %1% at offset %2%")
+                    % _file.path() % _next_coffset));
+            }
+
+            _compressed.resize(size);
+            if (_file.read(_next_coffset, &_compressed[0], size) != size)
+                throw runtime_error(str(format("%1% is truncated") % _file.path()));
+
+            size_t usize = le32(&_compressed[size - 4]);
+            Block block = { _next_coffset, _data.size() };
+            _data.resize(block.ustart + min(usize, size_t(BgzfInflater::MAX_BLOCK_SIZE)));
+            try {
+                _inflater.inflate(&_compressed[0], size, _data.data() + block.ustart,
+                    _data.size() - block.ustart);
+            }
+            catch (runtime_error const& e) {
+                throw runtime_error(str(format("%1% in %2% at offset %3%")
+                    % e.what() % _file.path() % block.coffset));
+            }
+            _blocks.push_back(block);
+            _next_coffset += size;
+            return true;
+        }
+
+        bool _ensure(size_t n) {
+            while (_data.size() < n) {
+                if (!_read_block())
+                    return false;
+            }
+            return true;
+        }
+
+        // Virtual offset of position u of the data. At the end of a block
+        // this is the start of the next one, as bgzf_tell has it.
+        uint64_t _voffset(size_t u) const {
+            vector<Block>::const_iterator i = lower_bound(_blocks.begin(), _blocks.end(), u,
+                [](Block const& b, size_t u) { return b.ustart < u; });
+            if (i != _blocks.end() && i->ustart == u)
+                return i->coffset << 16;
+            if (u >= _data.size())
+                return _next_coffset << 16;
+            --i;
+            return (i->coffset << 16) | (u - i->ustart);
+        }
+
+        size_t _position(uint64_t voffset) const {
+            for (size_t i = 0; i < _blocks.size(); ++i) {
+                if (_blocks[i].coffset == voffset >> 16)
+                    return _blocks[i].ustart + (voffset & 0xffff);
+            }
+            throw runtime_error(str(format(
+                "No bgzf block in %1% at offset %2%") % _file.path() % (voffset >> 16)));
+        }
+
+        // Whether a record that makes sense starts at u, and where the next
+        // one would
+        bool _valid_record(size_t u, size_t& next) {
+            if (!_ensure(u + 36))
+                return false;
+
+            unsigned char const* p = &_data[u];
+            uint32_t size = le32(p);
+            int32_t tid = le32(p + 4);
+            int32_t pos = le32(p + 8);
+            uint32_t l_name = p[12];
+            uint32_t n_cigar = le32(p + 16) & 0xffff;
+            int32_t l_seq = le32(p + 20);
+            int32_t mtid = le32(p + 24);
+            int32_t mpos = le32(p + 28);
+            if (tid < -1 || tid >= _n_targets || mtid < -1 || mtid >= _n_targets
+                || pos < -1 || mpos < -1 || l_name == 0 || l_seq < 0 || size > MAX_RECORD_SIZE
+                || size < 32 + l_name + 4 * n_cigar + (uint32_t(l_seq) + 1) / 2 + l_seq)
+            {
+                return false;
+            }
+
+            if (!_ensure(u + 36 + l_name))
+                return false;
+            p = &_data[u + 36];
+            for (uint32_t i = 0; i + 1 < l_name; ++i) {
+                if (p[i] < '!' || p[i] > '~')
+                    return false;
+            }
+            if (p[l_name - 1] != 0)
+                return false;
+
+            if (!_ensure(u + 4 + size))
+                return false;
+            p = &_data[u + 36 + l_name];
+            for (uint32_t i = 0; i < n_cigar; ++i) {
+                if ((le32(p + 4 * i) & 0xf) > BAM_CDIFF)
+                    return false;
+            }
+
+            next = u + 4 + size;
+            return true;
+        }
+
+        bool _valid_chain(size_t u) {
+            for (int i = 0; i < SYNC_RECORDS; ++i) {
+                if (i > 0 && u == _data.size() && !_ensure(u + 1))
+                    return true;
+                size_t next;
+                if (!_valid_record(u, next))
+                    return false;
+                u = next;
+            }
+            return true;
+        }
+
+        void _add_record(Piece& piece, size_t u, size_t next) {
+            unsigned char const* p = &_data[u];
+            int32_t tid = le32(p + 4);
+            int32_t pos = le32(p + 8);
+            uint32_t bin = le32(p + 12) >> 16;
+            uint32_t l_name = p[12];
+            uint32_t flag = le32(p + 16) >> 16;
+            uint32_t n_cigar = le32(p + 16) & 0xffff;
+
+            if (piece.n_records == 0) {
+                piece.first_tid = tid;
+                piece.first_pos = pos;
+            }
+            else if (out_of_order(piece.last_tid, piece.last_pos, tid, pos)) {
+                throw runtime_error(str(format(
+                    "%1% is not sorted by coordinate") % _file.path()));
+            }
+            ++piece.n_records;
+            piece.last_tid = tid;
+            piece.last_pos = pos;
+
+            if (tid < 0) {
+                ++piece.n_no_coor;
+                return;
+            }
+
+            uint64_t beg = _voffset(u);
+            uint64_t end = _voffset(next);
+            if (!(flag & BAM_FUNMAP) && pos >= 0) {
+                int32_t ref_end = pos;
+                unsigned char const* cigar = p + 36 + l_name;
+                for (uint32_t i = 0; i < n_cigar; ++i) {
+                    uint32_t op = le32(cigar + 4 * i);
+                    switch (op & 0xf) {
+                        case BAM_CMATCH: case BAM_CDEL: case BAM_CREF_SKIP:
+                        case BAM_CEQUAL: case BAM_CDIFF:
+                            ref_end += op >> 4;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                ref_end = max(ref_end, pos + 1);
+
+                vector<uint64_t>& linear = piece.linear[tid];
+                size_t last = size_t(ref_end - 1) >> LINEAR_SHIFT;
+                if (linear.size() <= last)
+                    linear.resize(last + 1);
+                for (size_t w = size_t(pos) >> LINEAR_SHIFT; w <= last; ++w) {
+                    if (linear[w] == 0)
+                        linear[w] = beg;
+                }
+            }
+
+            if (piece.runs.empty() || piece.runs.back().tid != tid || piece.runs.back().bin != bin) {
+                Run run = { tid, bin, beg, end, 0, 0 };
+                piece.runs.push_back(run);
+            }
+            Run& run = piece.runs.back();
+            run.end = end;
+            ++(flag & BAM_FUNMAP ? run.unmapped : run.mapped);
+        }
+
+    private:
+        BgzfFile const& _file;
+        int32_t _n_targets;
+        uint64_t _header_end;
+
+        BgzfInflater _inflater;
+        vector<unsigned char> _compressed;
+        vector<unsigned char> _data;
+        vector<Block> _blocks;
+        uint64_t _next_coffset;
+    };
+
+    typedef pair<uint64_t, uint64_t> Chunk;
+
+    struct RefIndex {
+        RefIndex() : has_records(false), off_beg(0), off_end(0), mapped(0), unmapped(0) {}
+
+        map<uint32_t, vector<Chunk> > bins;
+        vector<uint64_t> linear;
+
+        bool has_records;
+        uint64_t off_beg;
+        uint64_t off_end;
+        uint64_t mapped;
+        uint64_t unmapped;
+    };
+
+    void put32(ostream& out, uint32_t x) {
+        char buf[4] = { char(x), char(x >> 8), char(x >> 16), char(x >> 24) };
+        out.write(buf, 4);
+    }
+
+    void put64(ostream& out, uint64_t x) {
+        put32(out, uint32_t(x));
+        put32(out, uint32_t(x >> 32));
+    }
+
+    void write_index(string const& path, vector<RefIndex>& refs, uint64_t n_no_coor) {
+        ofstream out(path.c_str(), ios::binary);
+        if (!out)
+            throw runtime_error(str(format("Failed to open %1% for writing") % path));
+
+        out.write("BAI\1", 4);
+        put32(out, refs.size());
+        for (size_t i = 0; i < refs.size(); ++i) {
+            RefIndex& ref = refs[i];
+            put32(out, ref.bins.size() + ref.has_records);
+            typedef map<uint32_t, vector<Chunk> >::iterator BinIter;
+            for (BinIter bin = ref.bins.begin(); bin != ref.bins.end(); ++bin) {
+                // Chunks that meet in the same block are one seek apart
+                vector<Chunk>& chunks = bin->second;
+                size_t m = 0;
+                for (size_t j = 1; j < chunks.size(); ++j) {
+                    if (chunks[m].second >> 16 == chunks[j].first >> 16)
+                        chunks[m].second = chunks[j].second;
+                    else
+                        chunks[++m] = chunks[j];
+                }
+                chunks.resize(m + 1);
+
+                put32(out, bin->first);
+                put32(out, chunks.size());
+                for (size_t j = 0; j < chunks.size(); ++j) {
+                    put64(out, chunks[j].first);
+                    put64(out, chunks[j].second);
+                }
+            }
+            if (ref.has_records) {
+                put32(out, META_BIN);
+                put32(out, 2);
+                put64(out, ref.off_beg);
+                put64(out, ref.off_end);
+                put64(out, ref.mapped);
+                put64(out, ref.unmapped);
+            }
+
+            // Windows no read starts in point where the one before does
+            put32(out, ref.linear.size());
+            for (size_t j = 0; j < ref.linear.size(); ++j) {
+                if (j > 0 && ref.linear[j] == 0)
+                    ref.linear[j] = ref.linear[j - 1];
+                put64(out, ref.linear[j]);
+            }
+        }
+        put64(out, n_no_coor);
+
+        out.close();
+        if (!out)
+            throw runtime_error(str(format("Failed to write %1%") % path));
+    }
+
+    // bam_index_load complains on stderr when there is no index; we only
+    // want to know.
+    bool bamIndexExists(std::string const& path) {
+        if (std::ifstream((path + ".bai").c_str()))
+            return true;
+        size_t len = path.size();
+        return len >= 4 && path.compare(len - 4, 4, ".bam") == 0
+            && std::ifstream((path.substr(0, len - 4) + ".bai").c_str());
+    }
+}
+
+void build_bam_index(
+        std::string const& bam_path,
+        std::string const& index_path,
+        TaskExecutor& executor,
+        std::size_t chunk_size
+        )
+{
+    int32_t n_targets = 0;
+    uint64_t header_end = 0;
+    {
+        bamFile in = bam_open(bam_path.c_str(), "r");
+        if (!in)
+            throw runtime_error(str(format("Failed to open %1%") % bam_path));
+        bam_header_t* header = bam_header_read(in);
+        if (header) {
+            n_targets = header->n_targets;
+            header_end = bam_tell(in);
+            bam_header_destroy(header);
+        }
+        bam_close(in);
+        if (!header)
+            throw runtime_error(str(format("%1% is not a valid bam file") % bam_path));
+    }
+
+    BgzfFile file(bam_path);
+    chunk_size = max(chunk_size, size_t(1));
+    size_t n_pieces = max(uint64_t(1), (file.size() + chunk_size - 1) / chunk_size);
+
+    // One indexer per worker, so their buffers are reused from piece to piece
+    vector<Piece> pieces(n_pieces);
+    WorkerLocal<boost::shared_ptr<PieceIndexer> > indexers(executor);
+    executor.parallel_for(n_pieces, [&](size_t i) {
+        boost::shared_ptr<PieceIndexer>& indexer = indexers.local();
+        if (!indexer)
+            indexer.reset(new PieceIndexer(file, n_targets, header_end));
+        uint64_t begin = uint64_t(i) * chunk_size;
+        uint64_t end = min(file.size(), begin + chunk_size);
+        pieces[i] = indexer->run(i == 0 ? 0 : file.find_block(begin), end, NO_START);
+    });
+
+    // Join the pieces in order, redoing any that started in the wrong place
+    PieceIndexer indexer(file, n_targets, header_end);
+    vector<RefIndex> refs(n_targets);
+    uint64_t n_no_coor = 0;
+    uint64_t expected_block = 0;
+    uint64_t expected_start = header_end;
+    bool have_last = false;
+    int32_t last_tid = -1;
+    int32_t last_pos = -1;
+    int32_t run_tid = -1;
+    uint32_t run_bin = 0;
+    for (size_t i = 0; i < n_pieces; ++i) {
+        Piece& piece = pieces[i];
+        // A piece without data has no start of its own (NO_START)
+        if (!piece.ok || piece.first_block != expected_block
+            || (piece.start != NO_START && piece.start != expected_start))
+        {
+            uint64_t end = min(file.size(), uint64_t(i + 1) * chunk_size);
+            piece = indexer.run(expected_block, end, expected_start);
+        }
+        expected_block = piece.next_block;
+        if (piece.start != NO_START)
+            expected_start = piece.stop;
+
+        if (piece.n_records == 0)
+            continue;
+        if (have_last && out_of_order(last_tid, last_pos, piece.first_tid, piece.first_pos))
+            throw runtime_error(str(format("%1% is not sorted by coordinate") % bam_path));
+        have_last = true;
+        last_tid = piece.last_tid;
+        last_pos = piece.last_pos;
+        n_no_coor += piece.n_no_coor;
+
+        for (size_t j = 0; j < piece.runs.size(); ++j) {
+            Run const& run = piece.runs[j];
+            RefIndex& ref = refs[run.tid];
+            vector<Chunk>& chunks = ref.bins[run.bin];
+            // A run carrying on from the last piece
+            if (run.tid == run_tid && run.bin == run_bin && !chunks.empty())
+                chunks.back().second = run.end;
+            else
+                chunks.push_back(Chunk(run.beg, run.end));
+            run_tid = run.tid;
+            run_bin = run.bin;
+
+            if (!ref.has_records) {
+                ref.has_records = true;
+                ref.off_beg = run.beg;
+            }
+            ref.off_end = run.end;
+            ref.mapped += run.mapped;
+            ref.unmapped += run.unmapped;
+        }
+
+        typedef map<int32_t, vector<uint64_t> >::const_iterator LinearIter;
+        for (LinearIter l = piece.linear.begin(); l != piece.linear.end(); ++l) {
+            vector<uint64_t>& linear = refs[l->first].linear;
+            if (linear.size() < l->second.size())
+                linear.resize(l->second.size());
+            for (size_t w = 0; w < l->second.size(); ++w) {
+                if (linear[w] == 0)
+                    linear[w] = l->second[w];
+            }
+        }
+
+        // Done with it
+        piece = Piece();
+    }
+
+    // Like samtools, the last sequence ends at the end of the file
+    if (have_last && last_tid >= 0) {
+        refs[run_tid].bins[run_bin].back().second = file.size() << 16;
+        refs[run_tid].off_end = file.size() << 16;
+    }
+
+    // Written aside and moved into place, so nobody loads half an index
+    string tmp_path = str(format("%1%.tmp%2%") % index_path % getpid());
+    try {
+        write_index(tmp_path, refs, n_no_coor);
+        if (rename(tmp_path.c_str(), index_path.c_str()) != 0)
+            throw runtime_error(str(format("Failed to create %1%") % index_path));
+    }
+    catch (...) {
+        remove(tmp_path.c_str());
+        throw;
+    }
+}
+
+std::string bam_index_cache_prefix(std::string const& bam_path) {
+    bfs::path path = bfs::absolute(bam_path);
+    size_t key = 0;
+    boost::hash_combine(key, path.native());
+    boost::hash_combine(key, bfs::file_size(path));
+    boost::hash_combine(key, bfs::last_write_time(path));
+    bfs::path prefix = bfs::temp_directory_path()
+        / str(format("breakdancer-index-%1$016x-%2%") % key % path.filename().native());
+    return prefix.native();
+}
+
+std::string find_bam_index(std::string const& bam_path) {
+    if (bamIndexExists(bam_path))
+        return bam_path;
+
+    boost::system::error_code ec;
+    if (!bfs::exists(bam_path, ec))
+        return "";
+    std::string prefix = bam_index_cache_prefix(bam_path);
+    return bfs::exists(prefix + ".bai", ec) ? prefix : "";
+}
+
+bam_index_t* load_bam_index(std::string const& bam_path) {
+    std::string prefix = find_bam_index(bam_path);
+    return prefix.empty() ? 0 : bam_index_load(prefix.c_str());
+}
+
+void ensure_bam_indexes(std::vector<std::string> const& paths, TaskExecutor& executor) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string const& path = paths[i];
+        if (is_sam_path(path))
+            continue;
+        if (!find_bam_index(path).empty())
+            continue;
+
+        bfs::path dir = bfs::absolute(path).parent_path();
+        std::string index_path = access(dir.c_str(), W_OK) == 0
+            ? path + ".bai"
+            : bam_index_cache_prefix(path) + ".bai";
+        cerr << "No index for " << path << ", writing one to " << index_path << "\n";
+        build_bam_index(path, index_path, executor);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <bam.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class TaskExecutor;
+
+// Region queries (-o, --targets, --mask) need a bai index. Bams fresh out
+// of an aligner or a sort often have none yet, so breakdancer can build
+// one itself.
+//
+// The bam is cut into pieces of chunk_size compressed bytes, which are
+// decompressed and indexed in parallel. A piece starts at the first bgzf
+// block in it; where its first record starts is not known until the piece
+// before it has been read, so each piece guesses by looking for a run of
+// records that parse, and the guesses are checked (and any wrong one
+// redone) when the pieces are joined in order. The result is what
+// samtools index would write, up to the order of the bins.
+enum { BAM_INDEX_CHUNK_SIZE = 256 << 10 };
+
+// Writes the index of the coordinate sorted bam at bam_path to index_path.
+// Throws if the bam is not sorted or cannot be read.
+void build_bam_index(
+        std::string const& bam_path,
+        std::string const& index_path,
+        TaskExecutor& executor,
+        std::size_t chunk_size = BAM_INDEX_CHUNK_SIZE
+        );
+
+// Where an index is built when there is no writing one next to the bam:
+// the temporary directory, under a name that changes with the path, size
+// and modification time of the bam. bam_index_load takes this, not the
+// path of the index itself.
+std::string bam_index_cache_prefix(std::string const& bam_path);
+
+// What to give bam_index_load for bam_path: the bam itself if its index
+// sits next to it, the cache prefix if one was built there, or "" if there
+// is none.
+std::string find_bam_index(std::string const& bam_path);
+
+// The index of bam_path, or null if there is none. Unlike bam_index_load,
+// this does not complain on stderr when there is no index.
+bam_index_t* load_bam_index(std::string const& bam_path);
+
+// Builds an index for each bam in paths that has none, next to the bam if
+// its directory is writable and in the cache otherwise. Sam files are left
+// alone.
+void ensure_bam_indexes(std::vector<std::string> const& paths, TaskExecutor& executor);
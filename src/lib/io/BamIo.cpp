@@ -2,31 +2,57 @@
 
 #include "BamReader.hpp"
 #include "RegionLimitedBamReader.hpp"
+#include "SamReader.hpp"
+#include "common/Options.hpp"
+
+#include <boost/format.hpp>
+
+#include <stdexcept>
 
 BamReaderBase* openBam(
         std::string const& path,
-        std::string const& region /* = "" */
+        std::string const& region, /* = "" */
+        TaskExecutor* executor, /* = 0 */
+        IoOptions const& io /* = IoOptions() */
         )
 {
     typedef AlignmentFilter::Chain<
         std::logical_and<bool>, AlignmentFilter::IsPrimary, AlignmentFilter::IsAligned
         > IsPrimaryAligned;
 
+    if (is_sam_path(path)) {
+        if (!region.empty()) {
+            throw std::runtime_error(str(boost::format(
+                "Cannot limit %1% to region %2%: only indexed bam files can be")
+                % path % region));
+        }
+        return new SamReader<IsPrimaryAligned>(path, executor);
+    }
+
     if (region.empty())
-        return new BamReader<IsPrimaryAligned>(path);
+        return new BamReader<IsPrimaryAligned>(path, IsPrimaryAligned(), io, executor);
     else
         return new RegionLimitedBamReader<IsPrimaryAligned>(path, region.c_str());
 }
 
 std::vector<boost::shared_ptr<BamReaderBase> > openBams(
         std::vector<std::string> const& paths,
-        std::string const& region /* = "" */
+        std::string const& region, /* = "" */
+        TaskExecutor* executor, /* = 0 */
+        IoOptions const& io /* = IoOptions() */
         )
 {
     std::vector<boost::shared_ptr<BamReaderBase> > rv;
     for (size_t i = 0; i < paths.size(); ++i) {
-        rv.push_back(boost::shared_ptr<BamReaderBase>(openBam(paths[i], region)));
+        rv.push_back(boost::shared_ptr<BamReaderBase>(openBam(paths[i], region, executor, io)));
     }
     return rv;
 }
 
+
+IoOptions io_options(Options const& opts) {
+    IoOptions rv;
+    rv.depth = opts.io_depth;
+    rv.policy = parse_io_policy(opts.io_policy);
+    return rv;
+}
@@ -7,10 +7,23 @@
 #include <string>
 
 class BamReaderBase;
+class TaskExecutor;
 struct Options;
 
-BamReaderBase* openBam(std::string const& path, std::string const& region = "");
+// Sam files (.sam, .sam.gz) are parsed by tasks of executor, if given.
+// They cannot be limited to a region. Bams read from start to end are
+// read as io says (see AsyncFileReader).
+BamReaderBase* openBam(
+        std::string const& path,
+        std::string const& region = "",
+        TaskExecutor* executor = 0,
+        IoOptions const& io = IoOptions());
 
 std::vector<boost::shared_ptr<BamReaderBase> > openBams(
         std::vector<std::string> const& paths,
-        std::string const& region = "");
+        std::string const& region = "",
+        TaskExecutor* executor = 0,
+        IoOptions const& io = IoOptions());
+
+// --io-depth and --io-policy
+IoOptions io_options(Options const& opts);
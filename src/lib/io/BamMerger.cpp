@@ -1,8 +1,8 @@
 #include "BamMerger.hpp"
-#include "RawBamEntry.hpp"
 
 #include <boost/noncopyable.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <stdexcept>
@@ -16,31 +16,35 @@ struct BamMerger::Stream : public boost::noncopyable {
 
     bool valid() const;
     bool advance();
+    bam1_t* entry();
+    bam1_t const* entry() const;
 
     bool operator>(Stream const& rhs) const;
 
     // Data
     BamReaderBase* bam;
-    RawBamEntry entry;
-    int status;
+    // Records are pulled from the underlying reader a batch at a time
+    RecordBatch batch;
+    std::size_t cursor;
 };
 
 BamMerger::Stream::Stream()
     : bam(0)
-    , status(-1)
+    , cursor(0)
 {
 }
 
 BamMerger::Stream::Stream(BamReaderBase* bam)
     : bam(bam)
+    , cursor(0)
 {
-    advance();
+    bam->next_batch(batch);
 }
 
 bool BamMerger::Stream::operator>(Stream const& rhs) const {
     assert(valid() && rhs.valid());
-    bam1_t const* x = entry;
-    bam1_t const* y = rhs.entry;
+    bam1_t const* x = entry();
+    bam1_t const* y = rhs.entry();
 
     // TODO: determine if it is better to do this samtools style
     // (by cramming tid, pos, and strand into a uint64_t like:
@@ -61,13 +65,24 @@ bool BamMerger::Stream::operator>(Stream const& rhs) const {
 }
 
 bool BamMerger::Stream::valid() const {
-    return status > 0;
+    return cursor < batch.size();
 }
 
 bool BamMerger::Stream::advance() {
-    assert(bam && entry);
-    status = bam->next(entry);
-    return status > 0;
+    assert(bam && valid());
+    if (++cursor == batch.size()) {
+        cursor = 0;
+        bam->next_batch(batch);
+    }
+    return valid();
+}
+
+bam1_t* BamMerger::Stream::entry() {
+    return batch[cursor];
+}
+
+bam1_t const* BamMerger::Stream::entry() const {
+    return batch[cursor];
 }
 
 BamMerger::BamMerger(std::vector<BamReaderBase*> const& streams) {
@@ -111,10 +126,12 @@ int BamMerger::next(bam1_t* entry) {
     Stream* s = _streams.top();
     _streams.pop();
 
-    assert(s && s->entry && s->status > 0);
+    assert(s && s->valid());
 
-    int rv = s->status;
-    bam_copy1(entry, s->entry);
+    // Hand over the record by exchanging buffers rather than copying it;
+    // the caller's old buffer is recycled by the stream's batch. Both
+    // records own heap data allocated by samtools, so this is safe.
+    std::swap(*entry, *s->entry());
 
     if (s->advance()) {
         _streams.push(s);
@@ -122,7 +139,15 @@ int BamMerger::next(bam1_t* entry) {
         delete s;
     }
 
-    return rv;
+    return 1;
+}
+
+std::size_t BamMerger::next_batch(RecordBatch& batch) {
+    std::size_t n = 0;
+    while (n < batch.capacity() && BamMerger::next(batch.slot(n)) > 0)
+        ++n;
+    batch.resize(n);
+    return n;
 }
 
 std::string const& BamMerger::path() const {
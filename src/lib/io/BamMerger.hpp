@@ -14,6 +14,7 @@ public:
 
     bam_header_t* header() const;
     int next(bam1_t* entry);
+    std::size_t next_batch(RecordBatch& batch);
 
     std::string const& path() const;
 
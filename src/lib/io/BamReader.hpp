@@ -1,8 +1,12 @@
 #pragma once
 
+#include "BamIndex.hpp"
 #include "BamReaderBase.hpp"
+#include "BgzfReader.hpp"
 
 #include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <fstream>
 #include <functional>
 #include <stdexcept>
 #include <string>
@@ -21,26 +25,61 @@ namespace {
 template<typename AcceptFilter>
 class BamReader : public BamReaderBase {
 public:
-    explicit BamReader(std::string const& path, AcceptFilter aflt = AcceptFilter());
+    // The file is read as io says (see AsyncFileReader), by tasks of
+    // executor if it reads ahead and the kernel has no io_uring.
+    explicit BamReader(
+            std::string const& path,
+            AcceptFilter aflt = AcceptFilter(),
+            IoOptions const& io = IoOptions(),
+            TaskExecutor* executor = 0
+            );
     ~BamReader();
 
     int next(bam1_t* entry);
+    std::size_t next_batch(RecordBatch& batch);
+
+    // Seeks using the bam index, if there is one. Once it has skipped,
+    // the reader walks the index a sequence at a time, so unaligned
+    // records at the end of the file are not returned.
+    bool skip_to(int tid, int pos);
 
     bam_header_t* header() const;
     std::string const& path() const;
 
+protected:
+    int _next_indexed(bam1_t* entry);
+
 protected:
     std::string _path;
     samfile_t* _in;
     AcceptFilter _accept_filter;
+
+    // Reads the records of a bam in order; samtools' handle is kept for
+    // the header and index queries
+    boost::scoped_ptr<BgzfReader> _bgzf;
+
+    // Loaded by the first skip_to
+    bool _skip_index_tried;
+    bam_index_t* _skip_index;
+    bam_iter_t _skip_iter;
+    int _skip_tid;
 };
 
 template<typename AcceptFilter>
 inline
-BamReader<AcceptFilter>::BamReader(std::string const& path, AcceptFilter aflt)
+BamReader<AcceptFilter>::BamReader(
+        std::string const& path,
+        AcceptFilter aflt,
+        IoOptions const& io,
+        TaskExecutor* executor
+        )
     : _path(path)
     , _in(samopen(path.c_str(), bamOpenMode(path), 0))
     , _accept_filter(aflt)
+    , _skip_index_tried(false)
+    , _skip_index(0)
+    , _skip_iter(0)
+    , _skip_tid(-1)
 {
     using boost::format;
     if (!_in || !_in->header) {
@@ -50,11 +89,21 @@ BamReader<AcceptFilter>::BamReader(std::string const& path, AcceptFilter aflt)
     if (!_in->x.bam) {
         throw std::runtime_error(str(format("%1% is not a valid bam file") % path));
     }
+
+    if (bamOpenMode(path)[1] == 'b' && !bam_is_be) {
+        _bgzf.reset(new BgzfReader(path, BgzfInflater::verify_crc_default(),
+            BgzfInflater::default_backend(), io, executor));
+        _bgzf->seek(bam_tell(_in->x.bam));
+    }
 }
 
 template<typename AcceptFilter>
 inline
 BamReader<AcceptFilter>::~BamReader() {
+    if (_skip_iter)
+        bam_iter_destroy(_skip_iter);
+    if (_skip_index)
+        bam_index_destroy(_skip_index);
     samclose(_in);
     _in = 0;
 }
@@ -62,6 +111,17 @@ BamReader<AcceptFilter>::~BamReader() {
 template<typename AcceptFilter>
 inline
 int BamReader<AcceptFilter>::next(bam1_t* entry) {
+    if (_skip_iter)
+        return _next_indexed(entry);
+
+    if (_bgzf) {
+        while (read_bam_record(*_bgzf, entry) > 0) {
+            if (_accept_filter(entry))
+                return 1;
+        }
+        return 0;
+    }
+
     while (int rv = samread(_in, entry) > 0) {
         if (_accept_filter(entry))
             return rv;
@@ -69,6 +129,62 @@ int BamReader<AcceptFilter>::next(bam1_t* entry) {
     return 0;
 }
 
+template<typename AcceptFilter>
+inline
+std::size_t BamReader<AcceptFilter>::next_batch(RecordBatch& batch) {
+    // Qualified call: no virtual dispatch inside the loop
+    std::size_t n = 0;
+    while (n < batch.capacity() && BamReader<AcceptFilter>::next(batch.slot(n)) > 0)
+        ++n;
+    batch.resize(n);
+    return n;
+}
+
+template<typename AcceptFilter>
+inline
+int BamReader<AcceptFilter>::_next_indexed(bam1_t* entry) {
+    while (_skip_iter) {
+        while (int rv = bam_iter_read(_in->x.bam, _skip_iter, entry) > 0) {
+            if (_accept_filter(entry))
+                return rv;
+        }
+
+        // Done with this sequence, on to the next one
+        bam_iter_destroy(_skip_iter);
+        _skip_iter = 0;
+        if (++_skip_tid < _in->header->n_targets) {
+            _skip_iter = bam_iter_query(_skip_index, _skip_tid, 0,
+                _in->header->target_len[_skip_tid]);
+        }
+    }
+    // Past the last sequence: reads in order go on from where the index
+    // left samtools' handle
+    if (_bgzf)
+        _bgzf->seek(bam_tell(_in->x.bam));
+    return 0;
+}
+
+template<typename AcceptFilter>
+inline
+bool BamReader<AcceptFilter>::skip_to(int tid, int pos) {
+    if (!_skip_index_tried) {
+        _skip_index_tried = true;
+        if (bamOpenMode(_path)[1] == 'b')
+            _skip_index = load_bam_index(_path);
+    }
+
+    if (!_skip_index || tid < 0 || tid >= _in->header->n_targets)
+        return false;
+
+    if (_skip_iter)
+        bam_iter_destroy(_skip_iter);
+    _skip_tid = tid;
+    // Records starting before pos that overlap it come back too; it is up
+    // to the caller to drop them.
+    _skip_iter = bam_iter_query(_skip_index, tid, pos, _in->header->target_len[tid]);
+    return true;
+}
+
 template<typename AcceptFilter>
 inline
 bam_header_t* BamReader<AcceptFilter>::header() const {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "RecordBatch.hpp"
+
 #include <sam.h>
 #include <bam.h>
 
@@ -11,6 +13,33 @@ public:
     virtual ~BamReaderBase() {}
 
     virtual int next(bam1_t* entry) = 0;
+
+    // Fill the batch with up to batch.capacity() records and return the
+    // number read; 0 means the stream is exhausted. Implementations should
+    // override this to avoid a virtual call per record.
+    virtual std::size_t next_batch(RecordBatch& batch) {
+        std::size_t n = 0;
+        while (n < batch.capacity() && next(batch.slot(n)) > 0)
+            ++n;
+        batch.resize(n);
+        return n;
+    }
+
+    // Move the stream forward so the next record read is the first one at
+    // or after pos on sequence tid (records with a lower tid are skipped
+    // too). Readers that cannot seek return false and carry on from where
+    // they were; the caller then has to read through.
+    virtual bool skip_to(int tid, int pos) {
+        return false;
+    }
+
+    // Start over on [beg, end) of sequence tid (0 based, half open), for
+    // calling several regions with the one open file. Readers that cannot
+    // seek return false.
+    virtual bool set_region(int tid, int beg, int end) {
+        return false;
+    }
+
     virtual bam_header_t* header() const = 0;
     virtual std::string const& path() const = 0;
     virtual std::string const& description() const {
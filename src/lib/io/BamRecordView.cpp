@@ -0,0 +1,95 @@
+#include "BamRecordView.hpp"
+
+#include <boost/format.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    // Size of a fixed width aux value of the given type, or 0 if the type
+    // is variable length (or unknown).
+    std::size_t aux_type_size(uint8_t type) {
+        switch (type) {
+            case 'A': case 'c': case 'C': return 1;
+            case 's': case 'S': return 2;
+            case 'i': case 'I': case 'f': return 4;
+            case 'd': return 8;
+            default: return 0;
+        }
+    }
+}
+
+BamRecordView::BamRecordView(bam1_t const* record)
+    : _record(record)
+    , _am(0)
+    , _mq(0)
+    , _zp(0)
+    , _zn(0)
+    , _rg(0)
+    , _rg_len(0)
+{
+    _walk_aux();
+}
+
+void BamRecordView::_walk_aux() {
+    uint8_t const* p = bam1_aux(_record);
+    uint8_t const* end = _record->data + _record->data_len;
+
+    // Each entry is a 2 byte tag, a 1 byte type and then the value. We keep
+    // pointers to the type byte since that is what bam_aux2i expects.
+    while (p + 3 <= end) {
+        uint8_t const* tag = p;
+        uint8_t const* type = p + 2;
+        uint8_t const* value = p + 3;
+
+        if (std::size_t size = aux_type_size(*type)) {
+            p = value + size;
+        }
+        else if (*type == 'Z' || *type == 'H') {
+            uint8_t const* nul = static_cast<uint8_t const*>(
+                    memchr(value, 0, end - value));
+            if (!nul)
+                break;
+
+            if (tag[0] == 'R' && tag[1] == 'G' && *type == 'Z' && !_rg) {
+                _rg = reinterpret_cast<char const*>(value);
+                _rg_len = nul - value;
+            }
+            p = nul + 1;
+            continue;
+        }
+        else if (*type == 'B' && value + 5 <= end) {
+            // Unlike a truncated string, a bad array would have us step
+            // anywhere, so the record is not to be trusted
+            // Arrays hold integers or floats, never characters or doubles
+            bool numeric = value[0] != 'A' && value[0] != 'd';
+            std::size_t size = numeric ? aux_type_size(value[0]) : 0;
+            int32_t count;
+            memcpy(&count, value + 1, sizeof(count));
+            std::size_t left = end - (value + 5);
+            if (size == 0 || count < 0 || std::size_t(count) > left / size) {
+                throw std::runtime_error(str(boost::format(
+                    "Corrupt B array in the aux data of bam record %1%")
+                    % bam1_qname(_record)));
+            }
+            p = value + 5 + size * count;
+            continue;
+        }
+        else {
+            // Corrupt or unsupported aux data; stop here like bam_aux_get.
+            break;
+        }
+
+        if (p > end)
+            break;
+
+        if (tag[0] == 'A' && tag[1] == 'M' && !_am)
+            _am = type;
+        else if (tag[0] == 'M' && tag[1] == 'Q' && !_mq)
+            _mq = type;
+        else if (tag[0] == 'Z' && tag[1] == 'P' && !_zp)
+            _zp = type;
+        else if (tag[0] == 'Z' && tag[1] == 'N' && !_zn)
+            _zn = type;
+    }
+}
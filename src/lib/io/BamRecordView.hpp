@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+extern "C" {
+    #include <bam.h>
+}
+
+// A read-only view of the parts of a bam record that breakdancer looks at.
+//
+// The aux data is walked once on construction to locate the AM, MQ, RG, ZP
+// and ZN tags (samtools' bam_aux_get restarts from the beginning for every tag).
+// Nothing is copied: the view points into the record's data block and is
+// only valid for as long as the record is neither modified nor reused.
+class BamRecordView {
+public:
+    explicit BamRecordView(bam1_t const* record);
+
+    bam1_t const* record() const;
+    bam1_core_t const& core() const;
+    char const* query_name() const;
+
+    // Sequence and quality are only touched if these are called.
+    uint8_t const* seq() const;
+    uint8_t const* qual() const;
+
+    bool has_alt_qual() const;
+    int alt_qual() const;
+
+    bool has_mate_qual() const;
+    int mate_qual() const;
+
+    // Read group (not null terminated view), or 0 if there is no RG tag.
+    char const* read_group() const;
+    std::size_t read_group_length() const;
+
+    // Count records in evidence files stand in for normal reads: ZP is
+    // the number of proper pairs and ZN the number of leftmost normally
+    // mapped reads.
+    bool has_read_counts() const;
+    int proper_pair_count() const;
+    int normal_read_count() const;
+
+private:
+    void _walk_aux();
+
+private:
+    bam1_t const* _record;
+    uint8_t const* _am;
+    uint8_t const* _mq;
+    uint8_t const* _zp;
+    uint8_t const* _zn;
+    char const* _rg;
+    std::size_t _rg_len;
+};
+
+inline
+bam1_t const* BamRecordView::record() const {
+    return _record;
+}
+
+inline
+bam1_core_t const& BamRecordView::core() const {
+    return _record->core;
+}
+
+inline
+char const* BamRecordView::query_name() const {
+    return bam1_qname(_record);
+}
+
+inline
+uint8_t const* BamRecordView::seq() const {
+    return bam1_seq(_record);
+}
+
+inline
+uint8_t const* BamRecordView::qual() const {
+    return bam1_qual(_record);
+}
+
+inline
+bool BamRecordView::has_alt_qual() const {
+    return _am != 0;
+}
+
+inline
+int BamRecordView::alt_qual() const {
+    return bam_aux2i(_am);
+}
+
+inline
+bool BamRecordView::has_mate_qual() const {
+    return _mq != 0;
+}
+
+inline
+int BamRecordView::mate_qual() const {
+    return bam_aux2i(_mq);
+}
+
+inline
+char const* BamRecordView::read_group() const {
+    return _rg;
+}
+
+inline
+std::size_t BamRecordView::read_group_length() const {
+    return _rg_len;
+}
+
+inline
+bool BamRecordView::has_read_counts() const {
+    return _zp != 0 && _zn != 0;
+}
+
+inline
+int BamRecordView::proper_pair_count() const {
+    return bam_aux2i(_zp);
+}
+
+inline
+int BamRecordView::normal_read_count() const {
+    return bam_aux2i(_zn);
+}
@@ -1,13 +1,22 @@
 #include "BamSummary.hpp"
 
+#include "AlignmentPipeline.hpp"
 #include "AlignmentSource.hpp"
 #include "IAlignmentClassifier.hpp"
 
+#include "common/BloomFilter.hpp"
+#include "common/TaskExecutor.hpp"
+#include "common/Trace.hpp"
 #include "io/BamIo.hpp"
 #include "io/Alignment.hpp"
+#include "io/EvidenceFile.hpp"
+
+#include <boost/format.hpp>
 
 #include <iostream>
+#include <stdexcept>
 
+using boost::format;
 using namespace std;
 
 BamSummary::BamSummary()
@@ -19,13 +28,13 @@ BamSummary::BamSummary()
 BamSummary::BamSummary(
         Options const& opts,
         BamConfig const& bam_config,
-        IAlignmentClassifier const& alignment_classifier
+        IAlignmentClassifier const& alignment_classifier,
+        TaskExecutor& executor
         )
     : _covered_ref_len(0)
-    , _library_flag_distributions(bam_config.num_libs())
-    , _library_sequence_coverages(_library_flag_distributions.size())
+    , _library_sequence_coverages(bam_config.num_libs())
 {
-    _analyze_bams(opts, bam_config, alignment_classifier);
+    _analyze_bams(opts, bam_config, alignment_classifier, executor);
 }
 
 uint32_t BamSummary::covered_reference_length() const {
@@ -44,11 +53,46 @@ float BamSummary::library_sequence_coverage(size_t libIdx) const {
     return _library_sequence_coverages[libIdx];
 }
 
+BloomFilter const* BamSummary::passing_reads_filter() const {
+    return _passing_reads_filter.get();
+}
+
+std::string BamSummary::passing_read_key(Alignment const& aln) {
+    // Reads flagged as neither end get the bare name, which their mate
+    // shares; the filter then keeps every such read, as without it.
+    uint16_t flag = aln.sam_flag();
+    if (flag & BAM_FREAD1)
+        return aln.query_name() + "/1";
+    if (flag & BAM_FREAD2)
+        return aln.query_name() + "/2";
+    return aln.query_name();
+}
+
+std::string BamSummary::passing_mate_key(Alignment const& aln) {
+    uint16_t flag = aln.sam_flag();
+    if (flag & BAM_FREAD1)
+        return aln.query_name() + "/2";
+    if (flag & BAM_FREAD2)
+        return aln.query_name() + "/1";
+    return aln.query_name();
+}
+
+void BamSummary::_init_tally(
+        BamConfig const& bam_config,
+        boost::shared_ptr<BloomFilter> const& passing_reads_filter,
+        Tally& tally)
+{
+    tally.initialized = true;
+    tally.library_flag_distributions.resize(bam_config.num_libs());
+    tally.passing_reads_filter = passing_reads_filter;
+}
+
 void BamSummary::_analyze_bam(
         Options const& opts,
         BamConfig const& bam_config,
-        BamReaderBase& reader,
-        IAlignmentClassifier const& alignment_classifier)
+        IAlignmentBatchSource& src,
+        Tally& tally,
+        BamTotals& totals)
 {
     int last_pos = 0;
     int last_tid = -1;
@@ -56,87 +100,192 @@ void BamSummary::_analyze_bam(
     size_t ref_len = 0;
     uint32_t read_count = 0;
 
-    AlignmentSource src(
-        reader,
-        alignment_classifier,
-        bam_config,
-        false // do not need sequence data
-        );
-
-
     // FIXME: test with no read groups
-    while (Alignment::Ptr alnptr = src.next()) {
-        auto& aln = *alnptr;
-        if (last_tid >= 0 && last_tid == aln.tid())
-            ref_len += aln.pos() - last_pos;
-
-        last_pos = aln.pos();
-        last_tid = aln.tid();
+    std::vector<Alignment::Ptr> alns;
+    while (src.next_batch(alns)) {
+        typedef std::vector<Alignment::Ptr>::const_iterator IterType;
+        for (IterType alnptr = alns.begin(); alnptr != alns.end(); ++alnptr) {
+            auto& aln = **alnptr;
+            if (last_tid >= 0 && last_tid == aln.tid())
+                ref_len += aln.pos() - last_pos;
 
-        LibraryConfig const& lib_config = bam_config.library_config(aln.lib_index());
-        int min_mapq = lib_config.min_mapping_quality < 0 ?
-                opts.min_map_qual : lib_config.min_mapping_quality;
+            last_pos = aln.pos();
+            last_tid = aln.tid();
 
-        if (aln.bdqual() <= min_mapq)
-            continue;
+            LibraryConfig const& lib_config = bam_config.library_config(aln.lib_index());
+            int min_mapq = lib_config.min_mapping_quality < 0 ?
+                    opts.min_map_qual : lib_config.min_mapping_quality;
 
-        LibraryFlagDistribution& lib_flag_dist = _library_flag_distributions[lib_config.index];
-        if (aln.proper_pair()) {
-            ++lib_flag_dist.read_count; // per lib read count
-            ++read_count; // per bam read count
-        }
+            if (aln.bdqual() <= min_mapq)
+                continue;
 
-        if (aln.bdflag() == ReadFlag::NA || aln.either_unmapped()
-            || (opts.transchr_rearrange && !aln.interchrom_pair())
-            )
-        {
-            continue;
-        }
+            LibraryFlagDistribution& lib_flag_dist = tally.library_flag_distributions[lib_config.index];
+            if (aln.proper_pair()) {
+                ++lib_flag_dist.read_count; // per lib read count
+                ++read_count; // per bam read count
+            }
 
-        // FIXME: make mate-pair alignment classifier class
-        if (opts.Illumina_long_insert) {
-            if(aln.abs_isize() > lib_config.uppercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
-                aln.set_bdflag(ReadFlag::ARP_RF);
+            if (aln.bdflag() == ReadFlag::NA || aln.either_unmapped()
+                || (opts.transchr_rearrange && !aln.interchrom_pair())
+                )
+            {
+                continue;
             }
-            if(aln.abs_isize() < lib_config.uppercutoff && aln.bdflag() == ReadFlag::ARP_RF) {
-                aln.set_bdflag(ReadFlag::NORMAL_RF);
+
+            // FIXME: make mate-pair alignment classifier class
+            if (opts.Illumina_long_insert) {
+                if(aln.abs_isize() > lib_config.uppercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
+                    aln.set_bdflag(ReadFlag::ARP_RF);
+                }
+                if(aln.abs_isize() < lib_config.uppercutoff && aln.bdflag() == ReadFlag::ARP_RF) {
+                    aln.set_bdflag(ReadFlag::NORMAL_RF);
+                }
+                if(aln.abs_isize() < lib_config.lowercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
+                    aln.set_bdflag(ReadFlag::ARP_SMALL_INSERT);
+                }
             }
-            if(aln.abs_isize() < lib_config.lowercutoff && aln.bdflag() == ReadFlag::NORMAL_RF) {
-                aln.set_bdflag(ReadFlag::ARP_SMALL_INSERT);
+
+            if (aln.bdflag() == ReadFlag::NORMAL_FR || aln.bdflag() == ReadFlag::NORMAL_RF) {
+                continue;
             }
-        }
 
-        if (aln.bdflag() == ReadFlag::NORMAL_FR || aln.bdflag() == ReadFlag::NORMAL_RF) {
-            continue;
-        }
+            ++lib_flag_dist.read_counts_by_flag[aln.bdflag()];
 
-        ++lib_flag_dist.read_counts_by_flag[aln.bdflag()];
+            if (tally.passing_reads_filter)
+                tally.passing_reads_filter->insert(passing_read_key(aln));
+        }
     }
 
-    if (ref_len == 0) {
-        cerr << "Input file " << reader.description() <<
-            " does not contain legitimate paired end alignment. "
-            "Please check that you have the correct paths and the "
-            "map/bam files are properly formated and indexed.\n";
+    totals.ref_len = ref_len;
+    totals.read_count = read_count;
+}
+
+void BamSummary::_load_evidence(
+        BamConfig const& bam_config,
+        std::string const& path,
+        EvidenceSummary const& evidence,
+        IAlignmentBatchSource& src,
+        Tally& tally,
+        BamTotals& totals)
+{
+    typedef map<string, LibraryFlagDistribution>::const_iterator LibIter;
+    for (LibIter i = evidence.libraries.begin(); i != evidence.libraries.end(); ++i) {
+        size_t lib_index;
+        try {
+            lib_index = bam_config.library_config(i->first).index;
+        }
+        catch (out_of_range const&) {
+            throw runtime_error(str(format(
+                "Library %1% from evidence file %2% is not in the bam config"
+                ) % i->first % path));
+        }
+        tally.library_flag_distributions[lib_index].merge(i->second);
     }
 
-    _read_count_per_bam[reader.path()] = read_count;
+    totals.ref_len = evidence.covered_ref_len;
+    totals.read_count = evidence.read_count;
+
+    if (!tally.passing_reads_filter)
+        return;
 
-    if (_covered_ref_len < ref_len)
-        _covered_ref_len = ref_len;
+    // Every read in the file passed the quality filter when it was written
+    std::vector<Alignment::Ptr> alns;
+    while (src.next_batch(alns)) {
+        typedef std::vector<Alignment::Ptr>::const_iterator IterType;
+        for (IterType aln = alns.begin(); aln != alns.end(); ++aln) {
+            if (!(*aln)->is_read_counts())
+                tally.passing_reads_filter->insert(passing_read_key(**aln));
+        }
+    }
 }
 
 void BamSummary::_analyze_bams(
         Options const& opts,
         BamConfig const& bam_config,
-        IAlignmentClassifier const& alignment_classifier)
+        IAlignmentClassifier const& alignment_classifier,
+        TaskExecutor& executor)
 {
     std::vector<std::string> bam_files = bam_config.bam_files();
-    for(std::vector<std::string>::const_iterator iter = bam_files.begin(); iter != bam_files.end(); ++iter) {
-        auto_ptr<BamReaderBase> reader(openBam(*iter, opts.chr));
-        _analyze_bam(opts, bam_config, *reader, alignment_classifier);
+    std::vector<BamTotals> totals(bam_files.size());
+
+    boost::shared_ptr<BloomFilter> passing_reads_filter;
+    if (opts.mate_qual_prefilter) {
+        // 5 hashes are about optimal at the ~10-20 bits per read we expect
+        // to get for typical fractions of discordant reads.
+        size_t num_bits = size_t(opts.mate_filter_mb) * 8 * 1024 * 1024;
+        passing_reads_filter.reset(new BloomFilter(num_bits, 5));
+    }
+
+    Tally tally;
+    if (executor.num_workers() == 0 || bam_files.size() < 2) {
+        // One bam at a time, with the executor (if any) decoding ahead
+        _init_tally(bam_config, passing_reads_filter, tally);
+        for (size_t i = 0; i < bam_files.size(); ++i) {
+            TraceSpan span("summary", "bam", i);
+            auto_ptr<BamReaderBase> reader(openBam(bam_files[i], opts.chr, &executor, io_options(opts)));
+            boost::shared_ptr<IAlignmentBatchSource> src = make_alignment_source(
+                *reader, alignment_classifier, bam_config,
+                false, // do not need sequence data
+                executor);
+            EvidenceSummary evidence;
+            if (evidence.parse_header(reader->header()))
+                _load_evidence(bam_config, bam_files[i], evidence, *src, tally, totals[i]);
+            else
+                _analyze_bam(opts, bam_config, *src, tally, totals[i]);
+            totals[i].description = reader->description();
+        }
+    }
+    else {
+        // A bam per task. The counts are sums, so merging the per thread
+        // tallies gives the serial result; the filter is shared.
+        WorkerLocal<Tally> tallies(executor);
+        executor.parallel_for(bam_files.size(), [&](size_t i) {
+            Tally& local = tallies.local();
+            if (!local.initialized)
+                _init_tally(bam_config, passing_reads_filter, local);
+
+            TraceSpan span("summary", "bam", i);
+            auto_ptr<BamReaderBase> reader(openBam(bam_files[i], opts.chr, &executor, io_options(opts)));
+            AlignmentSource src(*reader, alignment_classifier, bam_config, false);
+            EvidenceSummary evidence;
+            if (evidence.parse_header(reader->header()))
+                _load_evidence(bam_config, bam_files[i], evidence, src, local, totals[i]);
+            else
+                _analyze_bam(opts, bam_config, src, local, totals[i]);
+            totals[i].description = reader->description();
+        });
+
+        for (WorkerLocal<Tally>::iterator t = tallies.begin(); t != tallies.end(); ++t) {
+            if (!t->initialized)
+                continue;
+
+            if (!tally.initialized) {
+                tally = *t;
+                continue;
+            }
+
+            for (size_t i = 0; i < tally.library_flag_distributions.size(); ++i)
+                tally.library_flag_distributions[i].merge(t->library_flag_distributions[i]);
+        }
     }
 
+    for (size_t i = 0; i < bam_files.size(); ++i) {
+        if (totals[i].ref_len == 0) {
+            cerr << "Input file " << totals[i].description <<
+                " does not contain legitimate paired end alignment. "
+                "Please check that you have the correct paths and the "
+                "map/bam files are properly formated and indexed.\n";
+        }
+
+        _read_count_per_bam[bam_files[i]] = totals[i].read_count;
+
+        if (_covered_ref_len < totals[i].ref_len)
+            _covered_ref_len = totals[i].ref_len;
+    }
+
+    _library_flag_distributions.swap(tally.library_flag_distributions);
+    _passing_reads_filter = passing_reads_filter;
+
     for (size_t i = 0; i < _library_flag_distributions.size(); ++i) {
         LibraryConfig const& lib_config = bam_config.library_config(i);
         uint32_t lib_read_count = library_flag_distribution(i).read_count;
@@ -8,10 +8,16 @@
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <vector>
 
+class Alignment;
+class BloomFilter;
+struct EvidenceSummary;
+class IAlignmentBatchSource;
 class IAlignmentClassifier;
+class TaskExecutor;
 
 class BamSummary {
 public:
@@ -19,10 +25,14 @@ public:
 
     BamSummary();
     // Construct flag distribution from bam files listed in in BamConfig.
+    // With more than one bam and an executor with workers, the bams are
+    // scanned in parallel. Evidence files are not scanned; their headers
+    // hold the counts.
     BamSummary(
         Options const& opts,
         BamConfig const& bam_config,
-        IAlignmentClassifier const& alignment_classifier
+        IAlignmentClassifier const& alignment_classifier,
+        TaskExecutor& executor
         );
 
     uint32_t covered_reference_length() const;
@@ -31,19 +41,67 @@ public:
     LibraryFlagDistribution const& library_flag_distribution(size_t libIdx) const;
     float library_sequence_coverage(size_t libIdx) const;
 
+    // Discordant reads that pass the mapping quality filter, by
+    // passing_read_key. Only built when the mate quality prefilter is
+    // requested (and not restored from a cache file), so this may be null.
+    // Threads scanning bams in parallel all add to this one filter.
+    BloomFilter const* passing_reads_filter() const;
+
+    // A read's key in passing_reads_filter: its name and which end of the
+    // pair it is, since both ends share the name. passing_mate_key is the
+    // key its mate would have.
+    static std::string passing_read_key(Alignment const& aln);
+    static std::string passing_mate_key(Alignment const& aln);
+
     bool operator==(BamSummary const& rhs) const;
     bool operator!=(BamSummary const& rhs) const;
 
 private:
-    void _analyze_bam(
+    // Counts that any number of bams can add to; bams scanned in parallel
+    // each add to the tally of the thread scanning them. The filter is
+    // shared by all of the tallies.
+    struct Tally {
+        Tally() : initialized(false) {}
+
+        bool initialized;
+        std::vector<LibraryFlagDistribution> library_flag_distributions;
+        boost::shared_ptr<BloomFilter> passing_reads_filter;
+    };
+
+    // Counts that are kept per bam
+    struct BamTotals {
+        BamTotals() : ref_len(0), read_count(0) {}
+
+        size_t ref_len;
+        uint32_t read_count;
+        std::string description;
+    };
+
+    static void _init_tally(
+        BamConfig const& bam_config,
+        boost::shared_ptr<BloomFilter> const& passing_reads_filter,
+        Tally& tally);
+
+    static void _analyze_bam(
         Options const& opts,
         BamConfig const& bam_confg,
-        BamReaderBase& reads,
-        IAlignmentClassifier const& alignment_classifier);
+        IAlignmentBatchSource& reads,
+        Tally& tally,
+        BamTotals& totals);
+
+    // Evidence files carry the counts of the bam they were written from
+    static void _load_evidence(
+        BamConfig const& bam_config,
+        std::string const& path,
+        EvidenceSummary const& evidence,
+        IAlignmentBatchSource& reads,
+        Tally& tally,
+        BamTotals& totals);
 
     void _analyze_bams(Options const& opts,
         BamConfig const& bam_config,
-        IAlignmentClassifier const& alignment_classifier);
+        IAlignmentClassifier const& alignment_classifier,
+        TaskExecutor& executor);
 
 private:
     template<typename Archive>
@@ -54,6 +112,7 @@ private:
     ConfigMap<std::string, uint32_t>::type _read_count_per_bam;
     std::vector<LibraryFlagDistribution> _library_flag_distributions;
     std::vector<float> _library_sequence_coverages;
+    boost::shared_ptr<BloomFilter> _passing_reads_filter;
 };
 
 template<typename Archive>
@@ -0,0 +1,190 @@
+#include "BgzfInflater.hpp"
+
+#include <boost/format.hpp>
+
+#include <zlib.h>
+#ifdef BD_HAVE_LIBDEFLATE
+# include <libdeflate.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    uint32_t le16(unsigned char const* p) {
+        return p[0] | (p[1] << 8);
+    }
+
+    uint32_t le32(unsigned char const* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+    }
+}
+
+size_t BgzfInflater::block_size(unsigned char const* p) {
+    if (p[0] != 31 || p[1] != 139 || p[2] != 8 || !(p[3] & 4)
+        || le16(p + 10) != 6 || p[12] != 'B' || p[13] != 'C' || le16(p + 14) != 2)
+    {
+        return 0;
+    }
+    size_t size = le16(p + 16) + 1;
+    return size >= BLOCK_HEADER_SIZE + BLOCK_FOOTER_SIZE ? size : 0;
+}
+
+struct BgzfInflater::Impl {
+    Impl()
+        : zs_ready(false)
+#ifdef BD_HAVE_LIBDEFLATE
+        , decompressor(0)
+#endif
+    {
+    }
+
+    ~Impl() {
+        if (zs_ready)
+            inflateEnd(&zs);
+#ifdef BD_HAVE_LIBDEFLATE
+        if (decompressor)
+            libdeflate_free_decompressor(decompressor);
+#endif
+    }
+
+    // One stream reset for each block, rather than samtools' set up and
+    // tear down of a new one
+    z_stream zs;
+    bool zs_ready;
+#ifdef BD_HAVE_LIBDEFLATE
+    libdeflate_decompressor* decompressor;
+#endif
+};
+
+BgzfInflater::BgzfInflater(Backend backend, bool verify_crc)
+    : _backend(backend)
+    , _verify_crc(verify_crc)
+    , _impl(new Impl)
+{
+    switch (backend) {
+        case ZLIB:
+            memset(&_impl->zs, 0, sizeof(_impl->zs));
+            if (inflateInit2(&_impl->zs, -15) != Z_OK)
+                throw runtime_error("Failed to initialize zlib");
+            _impl->zs_ready = true;
+            break;
+
+        case LIBDEFLATE:
+#ifdef BD_HAVE_LIBDEFLATE
+            _impl->decompressor = libdeflate_alloc_decompressor();
+            if (!_impl->decompressor)
+                throw runtime_error("Failed to initialize libdeflate");
+            break;
+#else
+            throw runtime_error("This build of breakdancer has no libdeflate support");
+#endif
+    }
+}
+
+BgzfInflater::~BgzfInflater() {
+}
+
+size_t BgzfInflater::inflate(
+        unsigned char const* block,
+        size_t size,
+        unsigned char* out,
+        size_t capacity
+        )
+{
+    unsigned char const* footer = block + size - BLOCK_FOOTER_SIZE;
+    size_t usize = le32(footer + 4);
+    if (usize > capacity) {
+        throw runtime_error(str(format(
+            "Invalid bgzf block (%1% bytes uncompressed)") % usize));
+    }
+
+    unsigned char const* in = block + BLOCK_HEADER_SIZE;
+    size_t in_size = size - BLOCK_HEADER_SIZE - BLOCK_FOOTER_SIZE;
+    bool ok = false;
+    switch (_backend) {
+        case ZLIB: {
+            z_stream& zs = _impl->zs;
+            // zlib refuses a null buffer even with nothing to write to it,
+            // as for the empty block at the end of a bam
+            unsigned char none;
+            inflateReset(&zs);
+            zs.next_in = const_cast<unsigned char*>(in);
+            zs.avail_in = in_size;
+            zs.next_out = out ? out : &none;
+            zs.avail_out = usize;
+            // Fails on more data than the footer says as well as on less
+            ok = ::inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.avail_out == 0;
+            break;
+        }
+
+        case LIBDEFLATE: {
+#ifdef BD_HAVE_LIBDEFLATE
+            size_t actual = 0;
+            ok = libdeflate_deflate_decompress(
+                _impl->decompressor, in, in_size, out, usize, &actual) == LIBDEFLATE_SUCCESS
+                && actual == usize;
+#endif
+            break;
+        }
+    }
+
+    if (!ok)
+        throw runtime_error("Failed to decompress bgzf block");
+
+    if (_verify_crc) {
+#ifdef BD_HAVE_LIBDEFLATE
+        uint32_t crc = libdeflate_crc32(0, out, usize);
+#else
+        uint32_t crc = crc32(crc32(0, Z_NULL, 0), out, usize);
+#endif
+        if (crc != le32(footer)) {
+            throw runtime_error(str(format(
+                "CRC mismatch (expected %1$08x, got %2$08x) in bgzf block")
+                % le32(footer) % crc));
+        }
+    }
+    return usize;
+}
+
+vector<BgzfInflater::Backend> BgzfInflater::available_backends() {
+    vector<Backend> rv;
+    rv.push_back(ZLIB);
+#ifdef BD_HAVE_LIBDEFLATE
+    rv.push_back(LIBDEFLATE);
+#endif
+    return rv;
+}
+
+BgzfInflater::Backend BgzfInflater::default_backend() {
+    static Backend const backend = [] {
+        vector<Backend> backends = available_backends();
+        if (char const* chosen = getenv("BD_INFLATE")) {
+            for (size_t i = 0; i < backends.size(); ++i) {
+                if (strcmp(chosen, name(backends[i])) == 0)
+                    return backends[i];
+            }
+            throw runtime_error(str(format(
+                "Unknown or unavailable inflate backend '%1%' in BD_INFLATE") % chosen));
+        }
+        return backends.back();
+    }();
+    return backend;
+}
+
+char const* BgzfInflater::name(Backend backend) {
+    switch (backend) {
+        case ZLIB: return "zlib";
+        case LIBDEFLATE: return "libdeflate";
+    }
+    return "unknown";
+}
+
+bool BgzfInflater::verify_crc_default() {
+    static bool const verify = getenv("BD_VERIFY_CRC") != 0;
+    return verify;
+}
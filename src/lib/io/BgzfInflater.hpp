@@ -0,0 +1,82 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// Decompresses whole bgzf blocks.
+//
+// Which deflate implementations are there is decided when building (see
+// BD_INFLATE_BACKEND in cmake/BuildDeps.cmake): zlib always, libdeflate
+// if it was found. libdeflate inflates about twice as fast as zlib and
+// computes crc32 with the carry-less multiply instructions where the cpu
+// has them. The default is the fastest one built in; setting BD_INFLATE
+// in the environment to a backend name picks another.
+//
+// The size in each block's footer is always checked. The crc32 is only
+// checked in verifying mode (BD_VERIFY_CRC in the environment turns it on
+// for the readers), since samtools never checks it either and it costs a
+// pass over the data.
+class BgzfInflater : public boost::noncopyable {
+public:
+    enum Backend {
+        ZLIB,
+        LIBDEFLATE
+    };
+
+    // A bgzf block is an 18 byte gzip header with the block size in its
+    // extra field, raw deflate data, then the crc32 and size of the
+    // uncompressed data.
+    enum {
+        BLOCK_HEADER_SIZE = 18,
+        BLOCK_FOOTER_SIZE = 8,
+        MAX_BLOCK_SIZE = 65536
+    };
+
+    // Size of the block whose header is at p, or 0 if there is none there
+    static std::size_t block_size(unsigned char const* p);
+
+    explicit BgzfInflater(Backend backend = default_backend(), bool verify_crc = false);
+    ~BgzfInflater();
+
+    // Inflates the block [block, block + size) into out, which has room
+    // for capacity bytes, and returns the uncompressed size. Throws if the
+    // block is corrupt (or, when verifying, its crc32 does not match); the
+    // message does not say where the block is, which is up to the caller.
+    std::size_t inflate(
+            unsigned char const* block,
+            std::size_t size,
+            unsigned char* out,
+            std::size_t capacity
+            );
+
+    Backend backend() const;
+    bool verify_crc() const;
+
+    static std::vector<Backend> available_backends();
+    static Backend default_backend();
+    static char const* name(Backend backend);
+
+    // Whether BD_VERIFY_CRC is set
+    static bool verify_crc_default();
+
+private:
+    struct Impl;
+
+    Backend _backend;
+    bool _verify_crc;
+    boost::scoped_ptr<Impl> _impl;
+};
+
+inline
+BgzfInflater::Backend BgzfInflater::backend() const {
+    return _backend;
+}
+
+inline
+bool BgzfInflater::verify_crc() const {
+    return _verify_crc;
+}
@@ -0,0 +1,163 @@
+#include "BgzfReader.hpp"
+
+#include <boost/format.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+BgzfReader::BgzfReader(
+        std::string const& path,
+        bool verify_crc,
+        BgzfInflater::Backend backend,
+        IoOptions const& io,
+        TaskExecutor* executor
+        )
+    : _path(path)
+    , _fd(open(path.c_str(), O_RDONLY))
+    , _inflater(backend, verify_crc)
+    , _buf(READ_SIZE)
+    , _buf_pos(0)
+    , _buf_end(0)
+    , _coffset(0)
+    , _block(BgzfInflater::MAX_BLOCK_SIZE)
+    , _block_size(0)
+    , _block_pos(0)
+    , _block_offset(0)
+{
+    if (_fd < 0)
+        throw runtime_error(str(format("Failed to open %1%") % path));
+    _file.reset(new AsyncFileReader(_fd, path, io, executor));
+}
+
+BgzfReader::~BgzfReader() {
+    _file.reset();
+    close(_fd);
+}
+
+size_t BgzfReader::read(void* out, size_t n) {
+    unsigned char* p = static_cast<unsigned char*>(out);
+    size_t done = 0;
+    while (done < n) {
+        if (_block_pos == _block_size && !_next_block())
+            break;
+        size_t k = min(n - done, _block_size - _block_pos);
+        memcpy(p + done, &_block[_block_pos], k);
+        _block_pos += k;
+        done += k;
+    }
+    return done;
+}
+
+uint64_t BgzfReader::tell() const {
+    if (_block_pos == _block_size)
+        return _coffset << 16;
+    return (_block_offset << 16) | _block_pos;
+}
+
+void BgzfReader::seek(uint64_t voffset) {
+    uint64_t coffset = voffset >> 16;
+    size_t uoffset = voffset & 0xffff;
+    if (coffset != _block_offset || _block_size == 0) {
+        _buf_pos = _buf_end = 0;
+        _coffset = coffset;
+        _block_size = _block_pos = 0;
+        if (!_next_block() && uoffset > 0) {
+            throw runtime_error(str(format(
+                "Failed to seek in %1%: no bgzf block at offset %2%") % _path % coffset));
+        }
+    }
+    if (uoffset > _block_size) {
+        throw runtime_error(str(format(
+            "Failed to seek in %1%: offset %2% is past the end of the block at %3%")
+            % _path % uoffset % coffset));
+    }
+    _block_pos = uoffset;
+}
+
+bool BgzfReader::_next_block() {
+    size_t have = _fill(BgzfInflater::BLOCK_HEADER_SIZE);
+    if (have == 0)
+        return false;
+
+    size_t size = have >= BgzfInflater::BLOCK_HEADER_SIZE ? BgzfInflater::block_size(&_buf[_buf_pos]) : 0;
+    if (!size) {
+        throw runtime_error(str(format(
+            "Invalid bgzf block in %1% at offset %2%") % _path % _coffset));
+    }
+    if (_fill(size) < size)
+        throw runtime_error(str(format("%1% is truncated") % _path));
+
+    _block_offset = _coffset;
+    try {
+        _block_size = _inflater.inflate(&_buf[_buf_pos], size, &_block[0], _block.size());
+    }
+    catch (runtime_error const& e) {
+        throw runtime_error(str(format("%1% in %2% at offset %3%")
+            % e.what() % _path % _block_offset));
+    }
+    _block_pos = 0;
+    _buf_pos += size;
+    _coffset += size;
+    return true;
+}
+
+size_t BgzfReader::_fill(size_t n) {
+    size_t avail = _buf_end - _buf_pos;
+    if (avail >= n)
+        return avail;
+
+    memmove(&_buf[0], &_buf[_buf_pos], avail);
+    _buf_pos = 0;
+    _buf_end = avail;
+    _buf_end += _file->read(&_buf[_buf_end], _buf.size() - _buf_end, _coffset + _buf_end);
+    return _buf_end;
+}
+
+int read_bam_record(BgzfReader& in, bam1_t* b) {
+    int32_t block_len;
+    size_t got = in.read(&block_len, sizeof(block_len));
+    if (got == 0)
+        return 0;
+
+    uint32_t x[8];
+    if (got != sizeof(block_len) || in.read(x, sizeof(x)) != sizeof(x))
+        throw runtime_error(str(format("%1% is truncated") % in.path()));
+
+    bam1_core_t* c = &b->core;
+    c->tid = x[0];
+    c->pos = x[1];
+    c->bin = x[2] >> 16;
+    c->qual = x[2] >> 8 & 0xff;
+    c->l_qname = x[2] & 0xff;
+    c->flag = x[3] >> 16;
+    c->n_cigar = x[3] & 0xffff;
+    c->l_qseq = x[4];
+    c->mtid = x[5];
+    c->mpos = x[6];
+    c->isize = x[7];
+
+    b->data_len = block_len - int32_t(sizeof(x));
+    b->l_aux = b->data_len - c->n_cigar * 4 - c->l_qname - c->l_qseq - (c->l_qseq + 1) / 2;
+    if (block_len < int32_t(sizeof(x)) || c->l_qseq < 0 || c->l_qname == 0 || b->l_aux < 0) {
+        throw runtime_error(str(format(
+            "Invalid bam record in %1% before offset %2%") % in.path() % in.tell()));
+    }
+
+    if (b->m_data < b->data_len) {
+        b->m_data = b->data_len;
+        kroundup32(b->m_data);
+        b->data = (uint8_t*)realloc(b->data, b->m_data);
+    }
+    if (in.read(b->data, b->data_len) != size_t(b->data_len))
+        throw runtime_error(str(format("%1% is truncated") % in.path()));
+
+    return sizeof(block_len) + block_len;
+}
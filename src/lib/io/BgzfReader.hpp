@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AsyncFileReader.hpp"
+#include "BgzfInflater.hpp"
+
+#include <bam.h>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Reads the decompressed stream of a bgzf file (a bam), in place of
+// samtools' bgzf_read, so that blocks are inflated by a BgzfInflater.
+// Compressed data is read a megabyte at a time, through an AsyncFileReader
+// that reads ahead and treats the page cache as io says.
+class BgzfReader : public boost::noncopyable {
+public:
+    enum { READ_SIZE = 1 << 20 };
+
+    explicit BgzfReader(
+            std::string const& path,
+            bool verify_crc = BgzfInflater::verify_crc_default(),
+            BgzfInflater::Backend backend = BgzfInflater::default_backend(),
+            IoOptions const& io = IoOptions(),
+            TaskExecutor* executor = 0
+            );
+    ~BgzfReader();
+
+    // Copies the next n bytes of the stream to out. Returns the number
+    // copied, which is less than n only at the end of the file.
+    std::size_t read(void* out, std::size_t n);
+
+    // Virtual offsets, as bgzf_tell and bgzf_seek have them
+    uint64_t tell() const;
+    void seek(uint64_t voffset);
+
+    std::string const& path() const;
+    BgzfInflater const& inflater() const;
+    AsyncFileReader const& file() const;
+
+private:
+    // Inflates the next block; false at the end of the file
+    bool _next_block();
+    // At least n bytes of compressed data from _coffset on in the buffer,
+    // unless the file ends first; returns the number there are.
+    std::size_t _fill(std::size_t n);
+
+private:
+    std::string _path;
+    int _fd;
+    BgzfInflater _inflater;
+    boost::scoped_ptr<AsyncFileReader> _file;
+
+    // Compressed data: _buf[_buf_pos, _buf_end) is the file from _coffset
+    std::vector<unsigned char> _buf;
+    std::size_t _buf_pos;
+    std::size_t _buf_end;
+    // File offset of the next block to inflate
+    uint64_t _coffset;
+
+    // The current block, which starts at _block_offset in the file
+    std::vector<unsigned char> _block;
+    std::size_t _block_size;
+    std::size_t _block_pos;
+    uint64_t _block_offset;
+};
+
+// Reads the next bam record from in into b, as bam_read1 does on a
+// little endian machine. Returns the size of the record, or 0 at the end
+// of the file; throws if the file ends inside a record.
+int read_bam_record(BgzfReader& in, bam1_t* b);
+
+inline
+std::string const& BgzfReader::path() const {
+    return _path;
+}
+
+inline
+BgzfInflater const& BgzfReader::inflater() const {
+    return _inflater;
+}
+
+inline
+AsyncFileReader const& BgzfReader::file() const {
+    return *_file;
+}
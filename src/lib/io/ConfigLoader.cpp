@@ -1,7 +1,10 @@
 #include "ConfigLoader.hpp"
 
 #include "BamConfig.hpp"
+#include "BamIndex.hpp"
+#include "BamIo.hpp"
 #include "BamSummary.hpp"
+#include "EvidenceFile.hpp"
 #include "IlluminaPEReadClassifier.hpp"
 #include "common/Options.hpp"
 
@@ -15,21 +18,25 @@ namespace barch = boost::archive;
 namespace bser = boost::serialization;
 using namespace std;
 
-ConfigLoader::ConfigLoader(Options const& initial_options) {
+ConfigLoader::ConfigLoader(Options const& initial_options, TaskExecutor& executor) {
     if (!initial_options.restore_file.empty()) {
         ifstream restore_xml(initial_options.restore_file.c_str());
         if (!restore_xml)
             throw runtime_error("Failed to load restore file");
         load_config(restore_xml);
+        index_bams(executor);
+        find_evidence_files();
     }
     else {
         _options.reset(new Options(initial_options));
         // load bam config file
         ifstream config_stream(initial_options.bam_config_path.c_str());
         _bam_config.reset(new BamConfig(config_stream, initial_options.cut_sd));
+        index_bams(executor);
+        find_evidence_files();
 
         // create bam summary (parses all bams to create flag distribution etc)
-        _bam_summary.reset(new BamSummary(initial_options, *_bam_config, read_classifier()));
+        _bam_summary.reset(new BamSummary(initial_options, *_bam_config, read_classifier(), executor));
 
         // the above can be expensive, we have the option to write that data
         // to disk in case we need to rerun later (useful for debugging and
@@ -43,6 +50,26 @@ ConfigLoader::ConfigLoader(Options const& initial_options) {
     }
 }
 
+void ConfigLoader::index_bams(TaskExecutor& executor) {
+    // Region queries need an index; build any that are missing rather
+    // than fail on a bam that has not been indexed yet
+    if (!_options->chr.empty() || !_options->targets_bed.empty() || !_options->mask_bed.empty())
+        ensure_bam_indexes(_bam_config->bam_files(), executor);
+}
+
+void ConfigLoader::find_evidence_files() {
+    // Count records are only taken from files whose header says they are
+    // evidence files: other bams may use the same tags for anything.
+    vector<string> const& bams = _bam_config->bam_files();
+    vector<bool> evidence_files(bams.size());
+    for (size_t i = 0; i < bams.size(); ++i) {
+        auto_ptr<BamReaderBase> reader(openBam(bams[i]));
+        EvidenceSummary summary;
+        evidence_files[i] = summary.parse_header(reader->header());
+    }
+    _bam_config->set_evidence_files(evidence_files);
+}
+
 void ConfigLoader::save_config(std::ostream& stream) {
     barch::xml_oarchive arch(stream);
     arch
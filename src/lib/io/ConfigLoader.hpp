@@ -6,11 +6,12 @@
 class BamConfig;
 class BamSummary;
 class IAlignmentClassifier;
+class TaskExecutor;
 struct Options;
 
 class ConfigLoader {
 public:
-    ConfigLoader(Options const& initial_options);
+    ConfigLoader(Options const& initial_options, TaskExecutor& executor);
 
     Options const& options() const;
     BamConfig const& bam_config() const;
@@ -22,6 +23,8 @@ public:
 
 private:
     void create_read_classifier() const;
+    void index_bams(TaskExecutor& executor);
+    void find_evidence_files();
 
 private:
     mutable std::auto_ptr<IAlignmentClassifier> _read_classifier;
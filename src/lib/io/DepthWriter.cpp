@@ -0,0 +1,110 @@
+#include "DepthWriter.hpp"
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using boost::format;
+using namespace std;
+
+namespace {
+    int32_t const DEPTH_FORMAT_VERSION = 1;
+
+    // Binary output is little endian regardless of the host
+    void write_u32(ostream& out, uint32_t value) {
+        char bytes[4];
+        for (int i = 0; i < 4; ++i)
+            bytes[i] = char((value >> (8 * i)) & 0xff);
+        out.write(bytes, 4);
+    }
+}
+
+DepthWriter::DepthWriter(
+        std::string const& output_prefix,
+        std::vector<std::string> const& lib_names,
+        bam_header_t const* header,
+        int bin_size,
+        bool binary
+        )
+    : _header(header)
+    , _bin_size(bin_size)
+    , _binary(binary)
+    , _tracks(lib_names.size())
+{
+    if (bin_size <= 0)
+        throw runtime_error(str(format("Invalid depth bin size %1%") % bin_size));
+
+    for (size_t i = 0; i < lib_names.size(); ++i) {
+        string path = str(format("%1%.%2%.%3%")
+            % output_prefix % lib_names[i] % (binary ? "depth" : "bedGraph"));
+
+        ios::openmode mode = binary ? ios::out | ios::binary : ios::out;
+        _tracks[i].stream.reset(new ofstream(path.c_str(), mode));
+        ofstream& out = *_tracks[i].stream;
+        if (!out) {
+            throw runtime_error(str(format("Failed to open depth file '%1%' for writing")
+                % path));
+        }
+
+        if (binary) {
+            out.write("BDDP", 4);
+            write_u32(out, DEPTH_FORMAT_VERSION);
+            write_u32(out, bin_size);
+            write_u32(out, header->n_targets);
+            for (int32_t tid = 0; tid < header->n_targets; ++tid) {
+                uint32_t len = strlen(header->target_name[tid]);
+                write_u32(out, len);
+                out.write(header->target_name[tid], len);
+            }
+        }
+    }
+}
+
+DepthWriter::~DepthWriter() {
+    try {
+        close();
+    }
+    catch (...) {
+    }
+}
+
+void DepthWriter::add(std::size_t lib_index, int32_t tid, int32_t pos, uint32_t count) {
+    Track& track = _tracks[lib_index];
+    uint32_t bin = pos / _bin_size;
+    if (track.count > 0 && (tid != track.tid || bin != track.bin))
+        _write_bin(track);
+
+    track.tid = tid;
+    track.bin = bin;
+    track.count += count;
+}
+
+void DepthWriter::close() {
+    for (size_t i = 0; i < _tracks.size(); ++i) {
+        Track& track = _tracks[i];
+        if (!track.stream)
+            continue;
+        if (track.count > 0)
+            _write_bin(track);
+        track.stream->close();
+        track.stream.reset();
+    }
+}
+
+void DepthWriter::_write_bin(Track& track) {
+    ofstream& out = *track.stream;
+    if (_binary) {
+        write_u32(out, track.tid);
+        write_u32(out, track.bin);
+        write_u32(out, track.count);
+    }
+    else {
+        uint32_t start = track.bin * uint32_t(_bin_size);
+        uint32_t end = min(start + _bin_size, _header->target_len[track.tid]);
+        out << _header->target_name[track.tid] << "\t" << start << "\t" << end
+            << "\t" << track.count << "\n";
+    }
+    track.count = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <bam.h>
+
+#include <cstddef>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Binned read depth per library, written as reads stream past in sorted
+// order. Each library gets its own file, PREFIX.<lib>.bedGraph or, in
+// binary mode, PREFIX.<lib>.depth. Only bins with reads are written.
+//
+// The binary format is little endian: the magic "BDDP", then int32
+// version, bin size and number of sequences; each sequence name as an
+// int32 length followed by that many bytes; then an (int32 tid, uint32
+// bin, uint32 count) triple per bin, in sorted order. Bin i of a sequence
+// covers [i * bin size, (i + 1) * bin size).
+class DepthWriter : public boost::noncopyable {
+public:
+    DepthWriter(
+        std::string const& output_prefix,
+        std::vector<std::string> const& lib_names,
+        bam_header_t const* header,
+        int bin_size,
+        bool binary
+        );
+    ~DepthWriter();
+
+    // Add count reads starting at tid:pos to a library's depth. Positions
+    // for a library must not decrease.
+    void add(std::size_t lib_index, int32_t tid, int32_t pos, uint32_t count = 1);
+
+    // Write out the bins still held and close the files.
+    void close();
+
+private:
+    struct Track {
+        Track() : tid(-1), bin(0), count(0) {}
+
+        boost::shared_ptr<std::ofstream> stream;
+        int32_t tid;
+        uint32_t bin;
+        uint32_t count;
+    };
+
+    void _write_bin(Track& track);
+
+private:
+    bam_header_t const* _header;
+    int _bin_size;
+    bool _binary;
+    std::vector<Track> _tracks;
+};
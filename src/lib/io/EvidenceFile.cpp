@@ -0,0 +1,277 @@
+#include "EvidenceFile.hpp"
+
+#include "BamRecordView.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using boost::format;
+using boost::lexical_cast;
+using namespace std;
+
+namespace {
+    char const* SUMMARY_TAG = "breakdancer-evidence";
+    char const* LIBRARY_TAG = "breakdancer-evidence-lib";
+    int const FORMAT_VERSION = 1;
+
+    // Copy of header with extra_text appended to its text. Caller owns it.
+    bam_header_t* header_with_text(bam_header_t const* header, string const& extra_text) {
+        string text(header->text ? header->text : "", header->l_text);
+        text.erase(text.find_last_not_of('\0') + 1);
+        if (!text.empty() && text[text.size() - 1] != '\n')
+            text += '\n';
+        text += extra_text;
+
+        bam_header_t* rv = bam_header_init();
+        rv->n_targets = header->n_targets;
+        rv->target_len = (uint32_t*)malloc(sizeof(uint32_t) * header->n_targets);
+        rv->target_name = (char**)malloc(sizeof(char*) * header->n_targets);
+        for (int32_t i = 0; i < header->n_targets; ++i) {
+            rv->target_len[i] = header->target_len[i];
+            rv->target_name[i] = strdup(header->target_name[i]);
+        }
+        rv->l_text = text.size();
+        rv->text = (char*)malloc(text.size() + 1);
+        memcpy(rv->text, text.c_str(), text.size() + 1);
+        return rv;
+    }
+
+    // key:value fields of an @CO line after the tag
+    map<string, string> parse_fields(vector<string> const& fields) {
+        map<string, string> rv;
+        for (size_t i = 2; i < fields.size(); ++i) {
+            string::size_type colon = fields[i].find(':');
+            if (colon == string::npos)
+                continue;
+            rv[fields[i].substr(0, colon)] = fields[i].substr(colon + 1);
+        }
+        return rv;
+    }
+
+    string const& required_field(map<string, string> const& fields, string const& key) {
+        map<string, string>::const_iterator found = fields.find(key);
+        if (found == fields.end()) {
+            throw runtime_error(str(format(
+                "Evidence file header is missing '%1%'") % key));
+        }
+        return found->second;
+    }
+}
+
+EvidenceSummary::EvidenceSummary()
+    : bin_size(0)
+    , covered_ref_len(0)
+    , read_count(0)
+{
+}
+
+void EvidenceSummary::append_header_lines(std::string& text) const {
+    stringstream ss;
+    ss << "@CO\t" << SUMMARY_TAG
+        << "\tversion:" << FORMAT_VERSION
+        << "\tbin:" << bin_size
+        << "\treflen:" << covered_ref_len
+        << "\treads:" << read_count
+        << "\n";
+
+    typedef map<string, LibraryFlagDistribution>::const_iterator IterType;
+    for (IterType i = libraries.begin(); i != libraries.end(); ++i) {
+        ss << "@CO\t" << LIBRARY_TAG
+            << "\tlib:" << i->first
+            << "\treads:" << i->second.read_count
+            << "\tflags:";
+        vector<uint32_t> const& flags = i->second.read_counts_by_flag;
+        for (size_t j = 0; j < flags.size(); ++j)
+            ss << (j ? "," : "") << flags[j];
+        ss << "\n";
+    }
+    text += ss.str();
+}
+
+bool EvidenceSummary::parse_header(bam_header_t const* header) {
+    *this = EvidenceSummary();
+    if (!header->text)
+        return false;
+
+    string text(header->text, header->l_text);
+    vector<string> lines;
+    boost::split(lines, text, boost::is_any_of("\n"));
+
+    bool found = false;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i].compare(0, 4, "@CO\t") != 0)
+            continue;
+
+        vector<string> fields;
+        boost::split(fields, lines[i], boost::is_any_of("\t"));
+        map<string, string> values = parse_fields(fields);
+        try {
+            if (fields[1] == SUMMARY_TAG) {
+                int version = lexical_cast<int>(required_field(values, "version"));
+                if (version > FORMAT_VERSION) {
+                    throw runtime_error(str(format(
+                        "Evidence file format version %1% is newer than this "
+                        "program supports (%2%)") % version % FORMAT_VERSION));
+                }
+                bin_size = lexical_cast<int>(required_field(values, "bin"));
+                covered_ref_len = lexical_cast<uint32_t>(required_field(values, "reflen"));
+                read_count = lexical_cast<uint32_t>(required_field(values, "reads"));
+                found = true;
+            }
+            else if (fields[1] == LIBRARY_TAG) {
+                LibraryFlagDistribution& lib = libraries[required_field(values, "lib")];
+                lib.read_count = lexical_cast<size_t>(required_field(values, "reads"));
+
+                vector<string> flags;
+                boost::split(flags, required_field(values, "flags"), boost::is_any_of(","));
+                if (flags.size() != lib.read_counts_by_flag.size()) {
+                    throw runtime_error(str(format(
+                        "Expected %1% flag counts in evidence file header, got %2%")
+                        % lib.read_counts_by_flag.size() % flags.size()));
+                }
+                for (size_t j = 0; j < flags.size(); ++j)
+                    lib.read_counts_by_flag[j] = lexical_cast<uint32_t>(flags[j]);
+            }
+        }
+        catch (boost::bad_lexical_cast const&) {
+            throw runtime_error(str(format(
+                "Invalid evidence file header line: %1%") % lines[i]));
+        }
+    }
+
+    if (!found && !libraries.empty())
+        throw runtime_error("Evidence file header has libraries but no summary");
+
+    return found;
+}
+
+EvidenceWriter::EvidenceWriter(
+        std::string const& path,
+        bam_header_t const* header,
+        EvidenceSummary const& summary,
+        std::size_t num_libs
+        )
+    : _bin_size(summary.bin_size)
+    , _bin_open(false)
+    , _bin_tid(-1)
+    , _bin_pos(-1)
+    , _counts(num_libs * 2)
+    , _record(bam_init1())
+{
+    string extra_text;
+    summary.append_header_lines(extra_text);
+    bam_header_t* out_header = header_with_text(header, extra_text);
+    try {
+        _out.reset(new BamWriter(path, out_header));
+    }
+    catch (...) {
+        bam_header_destroy(out_header);
+        bam_destroy1(_record);
+        throw;
+    }
+    bam_header_destroy(out_header);
+}
+
+EvidenceWriter::~EvidenceWriter() {
+    bam_destroy1(_record);
+}
+
+void EvidenceWriter::add_read(bam1_t const* record) {
+    _flush_counts();
+    _out->write(record);
+}
+
+void EvidenceWriter::count_read(bam1_t const* record, std::size_t lib_index,
+        bool proper_pair, bool normal)
+{
+    if (!proper_pair && !normal)
+        return;
+
+    bam1_core_t const& core = record->core;
+    if (_bin_open && (core.tid != _bin_tid || core.pos - _bin_pos >= _bin_size))
+        _flush_counts();
+
+    if (!_bin_open) {
+        _bin_open = true;
+        _bin_tid = core.tid;
+        _bin_pos = core.pos;
+    }
+
+    LibCounts& counts = _counts[lib_index * 2 + bam1_strand(record)];
+    if (!counts.has_read_group) {
+        BamRecordView view(record);
+        if (view.read_group()) {
+            counts.has_read_group = true;
+            counts.read_group.assign(view.read_group(), view.read_group_length());
+        }
+    }
+    counts.proper_pairs += proper_pair;
+    counts.normal_reads += normal;
+}
+
+void EvidenceWriter::close() {
+    _flush_counts();
+    _out->close();
+}
+
+void EvidenceWriter::_flush_counts() {
+    if (!_bin_open)
+        return;
+    _bin_open = false;
+
+    // Forward strand counts first: merging puts them first at a position
+    for (size_t i = 0; i < _counts.size(); ++i) {
+        bool reverse = i >= _counts.size() / 2;
+        LibCounts& counts = _counts[(i % (_counts.size() / 2)) * 2 + reverse];
+        if (counts.proper_pairs == 0 && counts.normal_reads == 0)
+            continue;
+
+        // An unpaired record with no sequence named "*", on the strand of
+        // the reads it counts so it merges with other files like they did
+        bam1_core_t& core = _record->core;
+        memset(&core, 0, sizeof(core));
+        core.tid = _bin_tid;
+        core.pos = _bin_pos;
+        core.flag = reverse ? BAM_FREVERSE : 0;
+        core.bin = bam_reg2bin(_bin_pos, _bin_pos + 1);
+        core.qual = 255;
+        core.l_qname = 2;
+        core.mtid = -1;
+        core.mpos = -1;
+
+        if (_record->m_data < 2) {
+            _record->m_data = 64;
+            _record->data = (uint8_t*)realloc(_record->data, _record->m_data);
+        }
+        memcpy(_record->data, "*", 2);
+        _record->data_len = 2;
+        _record->l_aux = 0;
+
+        if (counts.has_read_group) {
+            bam_aux_append(_record, "RG", 'Z', counts.read_group.size() + 1,
+                (uint8_t*)counts.read_group.c_str());
+        }
+        bam_aux_append(_record, "ZP", 'i', 4, (uint8_t*)&counts.proper_pairs);
+        bam_aux_append(_record, "ZN", 'i', 4, (uint8_t*)&counts.normal_reads);
+
+        _out->write(_record);
+        counts.proper_pairs = 0;
+        counts.normal_reads = 0;
+    }
+}
+
+std::string evidence_path(std::string const& prefix, std::string const& bam_path) {
+    string name = bam_path;
+    string::size_type slash = name.rfind('/');
+    if (slash != string::npos)
+        name = name.substr(slash + 1);
+    if (boost::ends_with(name, ".bam") || boost::ends_with(name, ".sam"))
+        name.resize(name.size() - 4);
+    return prefix + "." + name + ".bde";
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "BamWriter.hpp"
+#include "LibraryFlagDistribution.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <sam.h>
+#include <bam.h>
+
+#include <cstddef>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Evidence files (.bde) keep what breakdancer needs from one bam to call
+// SVs jointly with others: the discordant reads it holds on to, count
+// records standing in for the normal reads between them, and the bam's
+// summary statistics (as @CO header lines). They are sorted bam files, so
+// a config can list any number of them in place of the bams they came
+// from.
+
+// The part of BamSummary that comes from one bam.
+struct EvidenceSummary {
+    EvidenceSummary();
+
+    // Append @CO lines describing this summary to sam header text.
+    void append_header_lines(std::string& text) const;
+
+    // Read the summary back from a header. Returns false if the header is
+    // not that of an evidence file.
+    bool parse_header(bam_header_t const* header);
+
+    int bin_size;
+    uint32_t covered_ref_len;
+    uint32_t read_count;
+    std::map<std::string, LibraryFlagDistribution> libraries;
+};
+
+class EvidenceWriter : public boost::noncopyable {
+public:
+    EvidenceWriter(
+        std::string const& path,
+        bam_header_t const* header,
+        EvidenceSummary const& summary,
+        std::size_t num_libs
+        );
+    ~EvidenceWriter();
+
+    // A read to keep as it is. Normal reads counted before it are written
+    // out first, so replaying the file sees them in the same order.
+    void add_read(bam1_t const* record);
+
+    // A read that is only counted: proper_pair and normal say which of the
+    // counts (see BamRecordView::has_read_counts) it adds to. Counts for a
+    // library are written as one record per bin of up to bin_size bases,
+    // placed at the first read in the bin.
+    void count_read(bam1_t const* record, std::size_t lib_index,
+        bool proper_pair, bool normal);
+
+    void close();
+
+private:
+    struct LibCounts {
+        LibCounts() : has_read_group(false), proper_pairs(0), normal_reads(0) {}
+
+        bool has_read_group;
+        std::string read_group;
+        int32_t proper_pairs;
+        int32_t normal_reads;
+    };
+
+    void _flush_counts();
+
+private:
+    boost::scoped_ptr<BamWriter> _out;
+    int _bin_size;
+    bool _bin_open;
+    int32_t _bin_tid;
+    int32_t _bin_pos;
+    std::vector<LibCounts> _counts;
+    bam1_t* _record;
+};
+
+// Name of the evidence file written for bam_path under prefix.
+std::string evidence_path(std::string const& prefix, std::string const& bam_path);
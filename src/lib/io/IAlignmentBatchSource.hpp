@@ -0,0 +1,15 @@
+#pragma once
+
+#include "io/Alignment.hpp"
+
+#include <cstddef>
+#include <vector>
+
+class IAlignmentBatchSource {
+public:
+    virtual ~IAlignmentBatchSource() {}
+
+    // Replace the contents of alns with the next block of alignments.
+    // Returns the number produced; 0 means the input is exhausted.
+    virtual std::size_t next_batch(std::vector<Alignment::Ptr>& alns) = 0;
+};
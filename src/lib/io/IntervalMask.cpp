@@ -0,0 +1,136 @@
+#include "IntervalMask.hpp"
+
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using boost::format;
+using boost::lexical_cast;
+using namespace std;
+
+IntervalMask::IntervalMask() {
+}
+
+IntervalMask::IntervalMask(std::istream& bed, bam_header_t const* header, int32_t padding) {
+    // Not bam_get_tid: that needs the header's hash, which only headers
+    // read from a file have
+    map<string, int32_t> tids;
+    for (int32_t i = 0; i < header->n_targets; ++i)
+        tids[header->target_name[i]] = i;
+
+    string line;
+    size_t line_num = 0;
+    while (getline(bed, line)) {
+        ++line_num;
+        if (line.empty() || line[0] == '#'
+            || line.compare(0, 5, "track") == 0
+            || line.compare(0, 7, "browser") == 0)
+        {
+            continue;
+        }
+
+        stringstream ss(line);
+        string chrom, start, end;
+        if (!(ss >> chrom >> start >> end)) {
+            throw runtime_error(str(format(
+                "BED line %1% has fewer than 3 fields") % line_num));
+        }
+
+        map<string, int32_t>::const_iterator found = tids.find(chrom);
+        if (found == tids.end())
+            continue;
+        int32_t tid = found->second;
+
+        Interval iv;
+        try {
+            iv.first = lexical_cast<int32_t>(start);
+            iv.second = lexical_cast<int32_t>(end);
+        }
+        catch (boost::bad_lexical_cast const&) {
+            throw runtime_error(str(format(
+                "Invalid coordinates on BED line %1%") % line_num));
+        }
+
+        if (padding > 0) {
+            iv.first = max(iv.first - padding, 0);
+            iv.second = int32_t(min(int64_t(iv.second) + padding,
+                int64_t(header->target_len[tid])));
+        }
+
+        if (iv.first < iv.second) {
+            if (size_t(tid) >= _intervals.size())
+                _intervals.resize(tid + 1);
+            _intervals[tid].push_back(iv);
+        }
+    }
+
+    for (size_t i = 0; i < _intervals.size(); ++i)
+        _merge(_intervals[i]);
+}
+
+void IntervalMask::add(int32_t tid, int32_t begin, int32_t end) {
+    if (begin >= end)
+        return;
+
+    if (size_t(tid) >= _intervals.size())
+        _intervals.resize(tid + 1);
+
+    vector<Interval>& ivs = _intervals[tid];
+    if (ivs.empty() || begin > ivs.back().second)
+        ivs.push_back(Interval(begin, end));
+    else if (begin >= ivs.back().first)
+        ivs.back().second = max(ivs.back().second, end);
+    else {
+        ivs.push_back(Interval(begin, end));
+        _merge(ivs);
+    }
+}
+
+bool IntervalMask::empty() const {
+    return size() == 0;
+}
+
+std::size_t IntervalMask::size() const {
+    size_t n = 0;
+    for (size_t i = 0; i < _intervals.size(); ++i)
+        n += _intervals[i].size();
+    return n;
+}
+
+std::vector<IntervalMask::Interval> const& IntervalMask::intervals(int32_t tid) const {
+    static vector<Interval> const none;
+    if (tid < 0 || size_t(tid) >= _intervals.size())
+        return none;
+    return _intervals[tid];
+}
+
+IntervalMask::Interval const* IntervalMask::_find(int32_t tid, int32_t pos) const {
+    if (tid < 0 || size_t(tid) >= _intervals.size())
+        return 0;
+
+    // The last interval starting at or before pos
+    vector<Interval> const& ivs = _intervals[tid];
+    vector<Interval>::const_iterator found = upper_bound(
+        ivs.begin(), ivs.end(), Interval(pos, INT32_MAX));
+    if (found == ivs.begin())
+        return 0;
+    --found;
+    return pos < found->second ? &*found : 0;
+}
+
+void IntervalMask::_merge(std::vector<Interval>& intervals) {
+    sort(intervals.begin(), intervals.end());
+    vector<Interval> merged;
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        if (!merged.empty() && intervals[i].first <= merged.back().second)
+            merged.back().second = max(merged.back().second, intervals[i].second);
+        else
+            merged.push_back(intervals[i]);
+    }
+    intervals.swap(merged);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <bam.h>
+
+#include <cstddef>
+#include <istream>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Intervals of the reference loaded from a BED file: those to leave out of
+// the analysis (--mask: centromeres, satellites, ...) or to call SVs in
+// (--targets). The intervals are kept sorted and merged per sequence, so
+// lookups are a binary search.
+class IntervalMask {
+public:
+    // Half open [begin, end), 0 based as in BED
+    typedef std::pair<int32_t, int32_t> Interval;
+
+    IntervalMask();
+
+    // Read BED lines (chrom, start, end, ...) naming sequences in header.
+    // Sequences the header does not have are skipped; header, track and
+    // browser lines and lines starting with # are ignored. Intervals are
+    // widened by padding bases on both sides (within the sequence) before
+    // they are merged.
+    IntervalMask(std::istream& bed, bam_header_t const* header, int32_t padding = 0);
+
+    // Cheapest when intervals come in order
+    void add(int32_t tid, int32_t begin, int32_t end);
+
+    bool empty() const;
+
+    // Number of (merged) intervals
+    std::size_t size() const;
+
+    // The (merged) intervals on sequence tid, in order
+    std::vector<Interval> const& intervals(int32_t tid) const;
+
+    bool contains(int32_t tid, int32_t pos) const;
+
+    // End of the masked interval containing tid:pos, or pos if it is not
+    // masked.
+    int32_t masked_until(int32_t tid, int32_t pos) const;
+
+private:
+    // The interval containing pos, or 0
+    Interval const* _find(int32_t tid, int32_t pos) const;
+    void _merge(std::vector<Interval>& intervals);
+
+private:
+    std::vector<std::vector<Interval> > _intervals;
+};
+
+inline
+bool IntervalMask::contains(int32_t tid, int32_t pos) const {
+    return _find(tid, pos) != 0;
+}
+
+inline
+int32_t IntervalMask::masked_until(int32_t tid, int32_t pos) const {
+    Interval const* found = _find(tid, pos);
+    return found ? found->second : pos;
+}
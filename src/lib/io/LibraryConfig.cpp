@@ -0,0 +1,19 @@
+#include "LibraryConfig.hpp"
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/format.hpp>
+
+#include <stdexcept>
+
+using boost::format;
+
+SampleRole parse_sample_role(std::string const& value) {
+    std::string role = boost::to_lower_copy(value);
+    if (role == "tumor" || role == "tumour")
+        return ROLE_TUMOR;
+    if (role == "normal")
+        return ROLE_NORMAL;
+
+    throw std::runtime_error(str(format(
+        "Invalid sample role '%1%' (expected tumor or normal)") % value));
+}
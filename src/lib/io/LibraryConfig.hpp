@@ -2,12 +2,24 @@
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/string.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <map>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
+// Which sample of a tumor/normal pair a library comes from
+enum SampleRole {
+    ROLE_NONE,
+    ROLE_TUMOR,
+    ROLE_NORMAL
+};
+
+// Parses "tumor" (or "tumour") and "normal", in any case. Throws
+// std::runtime_error for anything else.
+SampleRole parse_sample_role(std::string const& value);
+
 struct LibraryConfig {
     LibraryConfig();
 
@@ -21,6 +33,7 @@ struct LibraryConfig {
     float lowercutoff;
     float readlens;
     int min_mapping_quality;
+    SampleRole role;
 
     bool operator==(LibraryConfig const& rhs) const;
     bool operator!=(LibraryConfig const& rhs) const;
@@ -39,9 +52,15 @@ struct LibraryConfig {
             & BOOST_SERIALIZATION_NVP(readlens)
             & BOOST_SERIALIZATION_NVP(min_mapping_quality)
             ;
+
+        if (version > 0) {
+            arch & BOOST_SERIALIZATION_NVP(role);
+        }
     }
 };
 
+BOOST_CLASS_VERSION(LibraryConfig, 1)
+
 inline
 LibraryConfig::LibraryConfig()
     : index(0)
@@ -52,6 +71,7 @@ LibraryConfig::LibraryConfig()
     , lowercutoff(0)
     , readlens(0)
     , min_mapping_quality(-1)
+    , role(ROLE_NONE)
 {
 }
 
@@ -67,6 +87,7 @@ bool LibraryConfig::operator==(LibraryConfig const& rhs) const {
         && lowercutoff == rhs.lowercutoff
         && readlens == rhs.readlens
         && min_mapping_quality == rhs.min_mapping_quality
+        && role == rhs.role
         ;
 }
 
@@ -0,0 +1,67 @@
+#include "MaskedBamReader.hpp"
+
+#include <algorithm>
+
+MaskedBamReader::MaskedBamReader(BamReaderBase& reader, IntervalMask const& mask)
+    : _reader(reader)
+    , _mask(mask)
+    , _resume_tid(-1)
+    , _resume_pos(-1)
+    , _masked_count(0)
+    , _skip_count(0)
+{
+}
+
+int MaskedBamReader::next(bam1_t* entry) {
+    int rv;
+    while ((rv = _reader.next(entry)) > 0 && _drop(entry, true)) {
+    }
+    return rv > 0 ? rv : 0;
+}
+
+std::size_t MaskedBamReader::next_batch(RecordBatch& batch) {
+    std::size_t n = 0;
+    while (n == 0) {
+        std::size_t raw = _reader.next_batch(batch);
+        if (raw == 0)
+            return 0;
+
+        // Compact the records we keep to the front of the batch
+        for (std::size_t i = 0; i < raw; ++i) {
+            if (_drop(batch.slot(i), i + 1 == raw))
+                continue;
+            if (i != n)
+                std::swap(*batch.slot(i), *batch.slot(n));
+            ++n;
+        }
+    }
+    batch.resize(n);
+    return n;
+}
+
+bool MaskedBamReader::skip_to(int tid, int pos) {
+    if (!_reader.skip_to(tid, pos))
+        return false;
+    _resume_tid = tid;
+    _resume_pos = pos;
+    return true;
+}
+
+bool MaskedBamReader::_drop(bam1_t const* record, bool last) {
+    int32_t tid = record->core.tid;
+    int32_t pos = record->core.pos;
+    if (_resume_tid >= 0) {
+        if (tid < _resume_tid || (tid == _resume_tid && pos < _resume_pos))
+            return true;
+        _resume_tid = -1;
+    }
+
+    int32_t masked_until = _mask.masked_until(tid, pos);
+    if (masked_until == pos)
+        return false;
+
+    ++_masked_count;
+    if (last && masked_until - pos >= MIN_SKIP_LENGTH && skip_to(tid, masked_until))
+        ++_skip_count;
+    return true;
+}
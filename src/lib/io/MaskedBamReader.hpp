@@ -0,0 +1,72 @@
+#pragma once
+
+#include "BamReaderBase.hpp"
+#include "IntervalMask.hpp"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+// Drops records that start in a masked interval before anything is built
+// from them. When a long masked span comes up, the wrapped reader is asked
+// to seek past it (see BamReaderBase::skip_to), so indexed bams are not
+// even decompressed there.
+class MaskedBamReader : public BamReaderBase {
+public:
+    // Masked spans shorter than this are read through; seeking costs
+    // about as much as decompressing a block.
+    enum { MIN_SKIP_LENGTH = 65536 };
+
+    // Neither reader nor mask is owned; both have to outlive this.
+    MaskedBamReader(BamReaderBase& reader, IntervalMask const& mask);
+
+    int next(bam1_t* entry);
+    std::size_t next_batch(RecordBatch& batch);
+    bool skip_to(int tid, int pos);
+
+    bam_header_t* header() const;
+    std::string const& path() const;
+    std::string const& description() const;
+
+    uint64_t masked_count() const;
+    uint64_t skip_count() const;
+
+private:
+    // True if record should be dropped. Seeks past the rest of its masked
+    // span if last is set and the span is long enough.
+    bool _drop(bam1_t const* record, bool last);
+
+private:
+    BamReaderBase& _reader;
+    IntervalMask const& _mask;
+    // After a seek, records before here were seen already
+    int32_t _resume_tid;
+    int32_t _resume_pos;
+    uint64_t _masked_count;
+    uint64_t _skip_count;
+};
+
+inline
+bam_header_t* MaskedBamReader::header() const {
+    return _reader.header();
+}
+
+inline
+std::string const& MaskedBamReader::path() const {
+    return _reader.path();
+}
+
+inline
+std::string const& MaskedBamReader::description() const {
+    return _reader.description();
+}
+
+inline
+uint64_t MaskedBamReader::masked_count() const {
+    return _masked_count;
+}
+
+inline
+uint64_t MaskedBamReader::skip_count() const {
+    return _skip_count;
+}
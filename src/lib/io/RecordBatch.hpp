@@ -0,0 +1,104 @@
+#pragma once
+
+#include <bam.h>
+#include <boost/noncopyable.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// A reusable block of bam records for BamReaderBase::next_batch.
+//
+// The records are allocated once, up front, and their data buffers grow
+// as needed and are then recycled from batch to batch. Readers fill slots
+// [0, capacity()) and then call resize() with the number they filled.
+class RecordBatch : public boost::noncopyable {
+public:
+    enum { DEFAULT_CAPACITY = 256 };
+
+    explicit RecordBatch(std::size_t capacity = DEFAULT_CAPACITY);
+    ~RecordBatch();
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    bool empty() const;
+    bool full() const;
+
+    void clear();
+    void resize(std::size_t n);
+
+    // Access to any slot, filled or not, for readers populating the batch.
+    bam1_t* slot(std::size_t i);
+
+    bam1_t* operator[](std::size_t i);
+    bam1_t const* operator[](std::size_t i) const;
+
+private:
+    std::vector<bam1_t*> _records;
+    std::size_t _size;
+};
+
+inline
+RecordBatch::RecordBatch(std::size_t capacity)
+    : _records(capacity)
+    , _size(0)
+{
+    assert(capacity > 0);
+    for (std::size_t i = 0; i < capacity; ++i)
+        _records[i] = bam_init1();
+}
+
+inline
+RecordBatch::~RecordBatch() {
+    for (std::size_t i = 0; i < _records.size(); ++i)
+        bam_destroy1(_records[i]);
+}
+
+inline
+std::size_t RecordBatch::size() const {
+    return _size;
+}
+
+inline
+std::size_t RecordBatch::capacity() const {
+    return _records.size();
+}
+
+inline
+bool RecordBatch::empty() const {
+    return _size == 0;
+}
+
+inline
+bool RecordBatch::full() const {
+    return _size == _records.size();
+}
+
+inline
+void RecordBatch::clear() {
+    _size = 0;
+}
+
+inline
+void RecordBatch::resize(std::size_t n) {
+    assert(n <= _records.size());
+    _size = n;
+}
+
+inline
+bam1_t* RecordBatch::slot(std::size_t i) {
+    assert(i < _records.size());
+    return _records[i];
+}
+
+inline
+bam1_t* RecordBatch::operator[](std::size_t i) {
+    assert(i < _size);
+    return _records[i];
+}
+
+inline
+bam1_t const* RecordBatch::operator[](std::size_t i) const {
+    assert(i < _size);
+    return _records[i];
+}
@@ -1,7 +1,9 @@
+#include "BamIndex.hpp"
 #include "BamReaderBase.hpp"
 #include "BamReader.hpp"
 
 #include <boost/format.hpp>
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
@@ -12,6 +14,9 @@ public:
     ~RegionLimitedBamReader();
 
     int next(bam1_t* entry);
+    std::size_t next_batch(RecordBatch& batch);
+    bool skip_to(int tid, int pos);
+    bool set_region(int tid, int beg, int end);
 
     int tid() const { return _tid; }
     int beg() const { return _beg; }
@@ -37,7 +42,7 @@ RegionLimitedBamReader<Filter>::RegionLimitedBamReader(std::string const& path,
     : BamReader<Filter>(path)
     , _region(region)
     , _description(path + " (region: " + _region + ")")
-    , _index(bam_index_load(path.c_str()))
+    , _index(load_bam_index(path))
 {
     using boost::format;
     if (!_index)
@@ -69,3 +74,40 @@ int RegionLimitedBamReader<Filter>::next(bam1_t* entry) {
     }
     return 0;
 }
+
+template<typename Filter>
+inline
+std::size_t RegionLimitedBamReader<Filter>::next_batch(RecordBatch& batch) {
+    std::size_t n = 0;
+    while (n < batch.capacity() && RegionLimitedBamReader<Filter>::next(batch.slot(n)) > 0)
+        ++n;
+    batch.resize(n);
+    return n;
+}
+
+template<typename Filter>
+inline
+bool RegionLimitedBamReader<Filter>::skip_to(int tid, int pos) {
+    if (tid < _tid)
+        return false;
+
+    // Past the region, only records overlapping its end are left
+    bam_iter_destroy(_iter);
+    pos = tid == _tid ? std::min(std::max(pos, _beg), _end) : _end;
+    _iter = bam_iter_query(_index, _tid, pos, _end);
+    return true;
+}
+
+template<typename Filter>
+inline
+bool RegionLimitedBamReader<Filter>::set_region(int tid, int beg, int end) {
+    using boost::format;
+    bam_iter_destroy(_iter);
+    _tid = tid;
+    _beg = beg;
+    _end = end;
+    _region = str(format("%1%:%2%-%3%") % this->sequence_name(tid) % (beg + 1) % end);
+    _description = this->path() + " (region: " + _region + ")";
+    _iter = bam_iter_query(_index, _tid, _beg, _end);
+    return true;
+}
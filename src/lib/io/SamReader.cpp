@@ -0,0 +1,481 @@
+#include "SamReader.hpp"
+
+#include "common/TaskExecutor.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// Defined in bam_aux.c but not declared in bam.h
+extern "C" void bam_init_header_hash(bam_header_t* header);
+
+using boost::format;
+using namespace std;
+
+namespace {
+    enum { READ_SIZE = 64 << 10 };
+
+    bool ends_with(string const& s, char const* suffix) {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    // Looks up reference names, remembering the last one: sorted sam files
+    // name the same sequence line after line.
+    class TidLookup {
+    public:
+        explicit TidLookup(bam_header_t* header)
+            : _header(header)
+            , _tid(-1)
+        {
+        }
+
+        int32_t operator()(char const* name) {
+            if (name[0] == '*' && name[1] == 0)
+                return -1;
+
+            if (_tid >= 0 && _name == name)
+                return _tid;
+
+            if (_header->n_targets == 0)
+                throw runtime_error("reference sequence given, but no @SQ lines in the header");
+
+            int32_t tid = bam_get_tid(_header, name);
+            if (tid < 0)
+                throw runtime_error(str(format("unknown reference sequence '%1%'") % name));
+            _name = name;
+            _tid = tid;
+            return tid;
+        }
+
+    private:
+        bam_header_t* _header;
+        string _name;
+        int32_t _tid;
+    };
+
+    bool kept_tag(char const* tag) {
+        switch (tag[0]) {
+            case 'R': return tag[1] == 'G';
+            case 'A': return tag[1] == 'M';
+            case 'M': return tag[1] == 'Q';
+            case 'Z': return tag[1] == 'P' || tag[1] == 'N';
+            default: return false;
+        }
+    }
+
+    // Writes the tag at s (NUL terminated, as "TG:T:value") to out, with
+    // integers stored in the smallest type that holds them the way samtools
+    // does it. Returns the number of bytes written; types we have no use
+    // for are skipped.
+    size_t pack_tag(char const* s, uint8_t* out) {
+        char type = s[3];
+        char const* value = s + 5;
+        out[0] = s[0];
+        out[1] = s[1];
+        switch (type) {
+            case 'A': case 'a': case 'c': case 'C':
+                out[2] = 'A';
+                out[3] = value[0];
+                return 4;
+
+            case 'i': case 'I': {
+                long long x = atoll(value);
+                if (x < 0) {
+                    if (x >= -127) {
+                        out[2] = 'c';
+                        int8_t v = x;
+                        memcpy(out + 3, &v, 1);
+                        return 4;
+                    }
+                    if (x >= -32767) {
+                        out[2] = 's';
+                        int16_t v = x;
+                        memcpy(out + 3, &v, 2);
+                        return 5;
+                    }
+                    out[2] = 'i';
+                    int32_t v = x;
+                    memcpy(out + 3, &v, 4);
+                    return 7;
+                }
+                if (x <= 255) {
+                    out[2] = 'C';
+                    out[3] = x;
+                    return 4;
+                }
+                if (x <= 65535) {
+                    out[2] = 'S';
+                    uint16_t v = x;
+                    memcpy(out + 3, &v, 2);
+                    return 5;
+                }
+                out[2] = 'I';
+                uint32_t v = x;
+                memcpy(out + 3, &v, 4);
+                return 7;
+            }
+
+            case 'f': {
+                out[2] = 'f';
+                float v = atof(value);
+                memcpy(out + 3, &v, 4);
+                return 7;
+            }
+
+            case 'Z': {
+                size_t len = strlen(value) + 1;
+                out[2] = 'Z';
+                memcpy(out + 3, value, len);
+                return 3 + len;
+            }
+
+            default:
+                return 0;
+        }
+    }
+
+    uint8_t* reserve(bam1_t* b, int size) {
+        if (b->m_data < size) {
+            b->m_data = size;
+            kroundup32(b->m_data);
+            b->data = (uint8_t*)realloc(b->data, b->m_data);
+        }
+        return b->data;
+    }
+
+    // Parses the sam line [p, end) into b. The line is modified: fields
+    // are NUL terminated in place. Follows samtools' sam_read1, except that
+    // what it would only warn about (like an unknown reference name) is an
+    // error here.
+    void parse_record(char* p, char* end, TidLookup& lookup, bam1_t* b) {
+        enum { QNAME, FLAG, RNAME, POS, MAPQ, CIGAR, RNEXT, PNEXT, TLEN, SEQ, QUAL, N_FIELDS };
+        char* fields[N_FIELDS];
+        char* aux = 0;
+        *end = 0;
+        for (int i = 0; i < N_FIELDS; ++i) {
+            fields[i] = p;
+            char* tab = (char*)memchr(p, '\t', end - p);
+            if (!tab) {
+                if (i + 1 < N_FIELDS)
+                    throw runtime_error(str(format("expected %1% fields, found %2%") % N_FIELDS % (i + 1)));
+                break;
+            }
+            *tab = 0;
+            p = tab + 1;
+            if (i + 1 == N_FIELDS)
+                aux = p;
+        }
+
+        bam1_core_t* c = &b->core;
+        char* s;
+        long flag = strtol(fields[FLAG], &s, 0);
+        if (*s || s == fields[FLAG])
+            throw runtime_error(str(format("invalid flag '%1%'") % fields[FLAG]));
+        c->flag = flag;
+        c->tid = lookup(fields[RNAME]);
+        c->pos = isdigit(fields[POS][0]) ? atoi(fields[POS]) - 1 : -1;
+        c->qual = isdigit(fields[MAPQ][0]) ? atoi(fields[MAPQ]) : 0;
+
+        size_t l_qname = fields[FLAG] - fields[QNAME];
+        if (l_qname > 255)
+            throw runtime_error("query name too long");
+        c->l_qname = l_qname;
+
+        c->n_cigar = 0;
+        if (fields[CIGAR][0] != '*') {
+            for (s = fields[CIGAR]; *s; ++s) {
+                if (isalpha(*s) || *s == '=')
+                    ++c->n_cigar;
+                else if (!isdigit(*s))
+                    throw runtime_error("invalid CIGAR character");
+            }
+        }
+
+        c->mtid = strcmp(fields[RNEXT], "=") == 0 ? c->tid : lookup(fields[RNEXT]);
+        c->mpos = isdigit(fields[PNEXT][0]) ? atoi(fields[PNEXT]) - 1 : -1;
+        c->isize = fields[TLEN][0] == '-' || isdigit(fields[TLEN][0]) ? atoi(fields[TLEN]) : 0;
+
+        char const* seq = fields[SEQ];
+        char const* qual = fields[QUAL];
+        c->l_qseq = strcmp(seq, "*") == 0 ? 0 : fields[QUAL] - fields[SEQ] - 1;
+        if (strcmp(qual, "*") != 0 && strlen(qual) != size_t(c->l_qseq))
+            throw runtime_error("sequence and quality are inconsistent");
+
+        // Packed tags take at most a byte more than their text
+        int fixed = l_qname + c->n_cigar * 4 + (c->l_qseq + 1) / 2 + c->l_qseq;
+        int bound = fixed + (aux ? end - aux + 1 : 0);
+        uint8_t* data = reserve(b, bound);
+        memcpy(data, fields[QNAME], l_qname);
+
+        uint32_t* cigar = bam1_cigar(b);
+        if (c->n_cigar) {
+            s = fields[CIGAR];
+            for (uint32_t i = 0; i < c->n_cigar; ++i) {
+                char* t;
+                long len = strtol(s, &t, 10);
+                int op;
+                switch (toupper(*t)) {
+                    case 'M': op = BAM_CMATCH; break;
+                    case 'I': op = BAM_CINS; break;
+                    case 'D': op = BAM_CDEL; break;
+                    case 'N': op = BAM_CREF_SKIP; break;
+                    case 'S': op = BAM_CSOFT_CLIP; break;
+                    case 'H': op = BAM_CHARD_CLIP; break;
+                    case 'P': op = BAM_CPAD; break;
+                    case '=': op = BAM_CEQUAL; break;
+                    case 'X': op = BAM_CDIFF; break;
+                    default: throw runtime_error("invalid CIGAR operation");
+                }
+                cigar[i] = bam_cigar_gen(uint32_t(len), op);
+                s = t + 1;
+            }
+            c->bin = bam_reg2bin(c->pos, bam_calend(c, cigar));
+            if (c->l_qseq && c->l_qseq != bam_cigar2qlen(c, cigar))
+                throw runtime_error("CIGAR and sequence length are inconsistent");
+        }
+        else {
+            c->flag |= BAM_FUNMAP;
+            c->bin = bam_reg2bin(c->pos, c->pos + 1);
+        }
+
+        uint8_t* packed = data + l_qname + c->n_cigar * 4;
+        memset(packed, 0, (c->l_qseq + 1) / 2);
+        for (int32_t i = 0; i < c->l_qseq; ++i)
+            packed[i / 2] |= bam_nt16_table[(unsigned char)seq[i]] << 4 * (1 - i % 2);
+        packed += (c->l_qseq + 1) / 2;
+        if (qual[0] == '*' && qual[1] == 0)
+            memset(packed, 0xff, c->l_qseq);
+        else {
+            for (int32_t i = 0; i < c->l_qseq; ++i)
+                packed[i] = qual[i] - 33;
+        }
+
+        int doff = fixed;
+        for (p = aux; p && p < end; ) {
+            char* tab = (char*)memchr(p, '\t', end - p);
+            char* tag_end = tab ? tab : end;
+            *tag_end = 0;
+            if (tag_end - p < 5 || p[2] != ':' || p[4] != ':')
+                throw runtime_error("missing colon in auxiliary data");
+            // Strings may be empty, but numbers and characters may not
+            if (tag_end - p == 5 && p[3] != 'Z' && p[3] != 'H')
+                throw runtime_error("missing value in auxiliary data");
+            if (kept_tag(p))
+                doff += pack_tag(p, data + doff);
+            p = tag_end + 1;
+        }
+        b->data_len = doff;
+        b->l_aux = doff - fixed;
+    }
+}
+
+bool is_sam_path(std::string const& path) {
+    return ends_with(path, ".sam") || ends_with(path, ".sam.gz");
+}
+
+struct SamParser::Chunk : public boost::noncopyable {
+    explicit Chunk(TaskExecutor* executor)
+        : first_line(0)
+        , size(0)
+        , filled(false)
+        , ready(false)
+        , group(executor ? new TaskGroup(*executor) : 0)
+    {
+    }
+
+    ~Chunk() {
+        // Let any parse still running finish before freeing its records
+        group.reset();
+        for (size_t i = 0; i < records.size(); ++i)
+            bam_destroy1(records[i]);
+    }
+
+    string text;
+    uint64_t first_line;
+    vector<bam1_t*> records;
+    size_t size;
+    // Holds lines, and is parsed or being parsed
+    bool filled;
+    // Parsed, and being handed out
+    bool ready;
+    boost::scoped_ptr<TaskGroup> group;
+};
+
+SamParser::SamParser(
+        std::string const& path,
+        TaskExecutor* executor,
+        std::size_t chunk_size
+        )
+    : _path(path)
+    , _chunk_size(std::max(chunk_size, std::size_t(1)))
+    , _in(gzopen(path.c_str(), "rb"))
+    , _eof(false)
+    , _header(0)
+    , _lines(0)
+    , _current(0)
+    , _pos(0)
+{
+    if (!_in)
+        throw runtime_error(str(format("Failed to open samfile %1%") % path));
+    gzbuffer(_in, READ_SIZE);
+
+    try {
+        _read_header();
+
+        // One chunk for each worker to parse, and one to hand out
+        size_t depth = executor ? executor->num_workers() + 1 : 1;
+        for (size_t i = 0; i < depth; ++i) {
+            _chunks.push_back(boost::shared_ptr<Chunk>(new Chunk(executor)));
+            _fill(*_chunks.back());
+        }
+    }
+    catch (...) {
+        _chunks.clear();
+        bam_header_destroy(_header);
+        gzclose(_in);
+        throw;
+    }
+}
+
+SamParser::~SamParser() {
+    _chunks.clear();
+    bam_header_destroy(_header);
+    gzclose(_in);
+}
+
+bool SamParser::next(bam1_t* entry) {
+    while (true) {
+        Chunk& chunk = *_chunks[_current];
+        if (!chunk.ready) {
+            if (!chunk.filled)
+                return false;
+            if (chunk.group)
+                chunk.group->wait();
+            else
+                _parse(chunk);
+            chunk.ready = true;
+            _pos = 0;
+        }
+
+        if (_pos < chunk.size) {
+            std::swap(*entry, *chunk.records[_pos++]);
+            return true;
+        }
+
+        // Used up: it goes to the back of the line with the next lines
+        chunk.ready = false;
+        _fill(chunk);
+        _current = (_current + 1) % _chunks.size();
+    }
+}
+
+void SamParser::_read_header() {
+    string text;
+    size_t pos = 0;
+    while (true) {
+        size_t nl = _carry.find('\n', pos);
+        if (nl == string::npos) {
+            if (_read_more(_carry))
+                continue;
+            if (pos == _carry.size())
+                break;
+            _carry += '\n';
+            nl = _carry.size() - 1;
+        }
+        if (_carry[pos] != '@')
+            break;
+
+        text.append(_carry, pos, nl + 1 - pos);
+        pos = nl + 1;
+        ++_lines;
+    }
+    _carry.erase(0, pos);
+
+    _header = bam_header_init();
+    _header->l_text = text.size();
+    _header->text = (char*)malloc(text.size() + 1);
+    memcpy(_header->text, text.c_str(), text.size() + 1);
+    sam_header_parse(_header);
+    // The parse tasks share the header, so it has to be complete up front
+    bam_init_header_hash(_header);
+}
+
+bool SamParser::_fill(Chunk& chunk) {
+    chunk.text.swap(_carry);
+    _carry.clear();
+    while (!_eof) {
+        if (chunk.text.size() >= _chunk_size && chunk.text.rfind('\n') != string::npos)
+            break;
+        _read_more(chunk.text);
+    }
+    if (_eof && !chunk.text.empty() && chunk.text[chunk.text.size() - 1] != '\n')
+        chunk.text += '\n';
+
+    size_t end = chunk.text.rfind('\n') + 1;
+    _carry.assign(chunk.text, end, string::npos);
+    chunk.text.resize(end);
+
+    chunk.filled = !chunk.text.empty();
+    chunk.size = 0;
+    if (!chunk.filled)
+        return false;
+
+    chunk.first_line = _lines;
+    _lines += std::count(chunk.text.begin(), chunk.text.end(), '\n');
+    if (chunk.group)
+        chunk.group->run(boost::bind(&SamParser::_parse, this, boost::ref(chunk)));
+    return true;
+}
+
+bool SamParser::_read_more(std::string& text) {
+    if (_eof)
+        return false;
+
+    size_t old = text.size();
+    text.resize(old + std::min(_chunk_size, std::size_t(READ_SIZE)));
+    int n = gzread(_in, &text[old], text.size() - old);
+    if (n < 0) {
+        int errnum;
+        throw runtime_error(str(format("Failed to read %1%: %2%") % _path % gzerror(_in, &errnum)));
+    }
+    text.resize(old + n);
+    _eof = n == 0;
+    return n > 0;
+}
+
+void SamParser::_parse(Chunk& chunk) {
+    TidLookup lookup(_header);
+    char* p = &chunk.text[0];
+    char* end = p + chunk.text.size();
+    uint64_t line = chunk.first_line;
+    size_t n = 0;
+    while (p < end) {
+        char* eol = (char*)memchr(p, '\n', end - p);
+        ++line;
+        char* stop = eol;
+        if (stop > p && stop[-1] == '\r')
+            --stop;
+
+        if (stop > p) {
+            if (n == chunk.records.size())
+                chunk.records.push_back(bam_init1());
+            try {
+                parse_record(p, stop, lookup, chunk.records[n]);
+            }
+            catch (runtime_error const& e) {
+                throw runtime_error(str(format("Failed to parse %1%, line %2%: %3%")
+                    % _path % line % e.what()));
+            }
+            ++n;
+        }
+        p = eol + 1;
+    }
+    chunk.size = n;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "BamReaderBase.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class TaskExecutor;
+
+// True for the paths openBam reads as sam text: .sam and .sam.gz.
+bool is_sam_path(std::string const& path);
+
+// Reads sam text, plain or gzip compressed, without samtools' single
+// threaded parser.
+//
+// The file is read in chunks of whole lines, and each chunk is parsed by a
+// task of the executor while the next ones are read, so the reader is
+// mostly left with the decompression. Only what breakdancer looks at is
+// kept: the fixed fields (cigar, seq and qual too, since -d and the
+// evidence files write records back out) and the RG, AM, MQ, ZP and ZN
+// tags; other tags are dropped.
+class SamParser : public boost::noncopyable {
+public:
+    enum { DEFAULT_CHUNK_SIZE = 1 << 20 };
+
+    // Without an executor, chunks are parsed on the calling thread as they
+    // are needed. Throws if the file cannot be opened; errors in the
+    // records come from next().
+    explicit SamParser(
+            std::string const& path,
+            TaskExecutor* executor = 0,
+            std::size_t chunk_size = DEFAULT_CHUNK_SIZE
+            );
+    ~SamParser();
+
+    // Swaps the next record into entry; false at the end of the file.
+    // Throws on lines that do not parse, giving the line number.
+    bool next(bam1_t* entry);
+
+    bam_header_t* header() const;
+
+private:
+    struct Chunk;
+
+    void _read_header();
+    // Fills chunk with whole lines and, given an executor, starts parsing
+    // it; false at EOF.
+    bool _fill(Chunk& chunk);
+    bool _read_more(std::string& text);
+    void _parse(Chunk& chunk);
+
+private:
+    std::string _path;
+    std::size_t _chunk_size;
+    gzFile _in;
+    bool _eof;
+    bam_header_t* _header;
+
+    // Text read past the last complete line
+    std::string _carry;
+    uint64_t _lines;
+
+    // Parsed or being parsed, in file order starting at _current
+    std::vector<boost::shared_ptr<Chunk> > _chunks;
+    std::size_t _current;
+    std::size_t _pos;
+};
+
+template<typename AcceptFilter>
+class SamReader : public BamReaderBase {
+public:
+    explicit SamReader(
+            std::string const& path,
+            TaskExecutor* executor = 0,
+            AcceptFilter aflt = AcceptFilter()
+            );
+
+    int next(bam1_t* entry);
+    std::size_t next_batch(RecordBatch& batch);
+
+    bam_header_t* header() const;
+    std::string const& path() const;
+
+private:
+    std::string _path;
+    SamParser _parser;
+    AcceptFilter _accept_filter;
+};
+
+inline
+bam_header_t* SamParser::header() const {
+    return _header;
+}
+
+template<typename AcceptFilter>
+inline
+SamReader<AcceptFilter>::SamReader(
+        std::string const& path,
+        TaskExecutor* executor,
+        AcceptFilter aflt
+        )
+    : _path(path)
+    , _parser(path, executor)
+    , _accept_filter(aflt)
+{
+}
+
+template<typename AcceptFilter>
+inline
+int SamReader<AcceptFilter>::next(bam1_t* entry) {
+    while (_parser.next(entry)) {
+        if (_accept_filter(entry))
+            return 1;
+    }
+    return 0;
+}
+
+template<typename AcceptFilter>
+inline
+std::size_t SamReader<AcceptFilter>::next_batch(RecordBatch& batch) {
+    std::size_t n = 0;
+    while (n < batch.capacity() && SamReader<AcceptFilter>::next(batch.slot(n)) > 0)
+        ++n;
+    batch.resize(n);
+    return n;
+}
+
+template<typename AcceptFilter>
+inline
+bam_header_t* SamReader<AcceptFilter>::header() const {
+    return _parser.header();
+}
+
+template<typename AcceptFilter>
+inline
+std::string const& SamReader<AcceptFilter>::path() const {
+    return _path;
+}
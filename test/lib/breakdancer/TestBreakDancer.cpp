@@ -1,15 +1,54 @@
 #include "breakdancer/BreakDancer.hpp"
 
 #include "breakdancer/ReadCountsByLib.hpp"
+#include "breakdancer/ReadRegionData.hpp"
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
 #include "io/BamConfig.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamMerger.hpp"
+#include "io/BamSummary.hpp"
+#include "io/IlluminaPEReadClassifier.hpp"
+#include "io/LibraryInfo.hpp"
 
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
 #include <map>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+namespace bfs = boost::filesystem;
+using boost::format;
 using namespace std;
 
+namespace {
+    // Five discordant pairs from first_pos to mate_pos, 10 bases apart
+    string pairs(char const* prefix, int first_pos, int mate_pos) {
+        string rv;
+        for (int i = 0; i < 5; ++i) {
+            rv += str(format("%1%%2%\t97\t21\t%3%\t60\t10M\t=\t%4%\t%5%\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n")
+                % prefix % i % (first_pos + 10 * i) % (mate_pos + 10 * i) % (mate_pos - first_pos + 10));
+        }
+        return rv;
+    }
+
+    string mates(char const* prefix, int first_pos, int mate_pos) {
+        string rv;
+        for (int i = 0; i < 5; ++i) {
+            rv += str(format("%1%%2%\t145\t21\t%3%\t60\t10M\t=\t%4%\t%5%\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n")
+                % prefix % i % (mate_pos + 10 * i) % (first_pos + 10 * i) % (first_pos - mate_pos - 10));
+        }
+        return rv;
+    }
+}
+
 TEST(BreakDancer, accumulate_reads_in_region) {
 // The code this tests is under active development.
 // Commenting this out until it stabilizes.
@@ -40,3 +79,48 @@ TEST(BreakDancer, accumulate_reads_in_region) {
     ASSERT_EQ(counts1 + counts2, c);
 */
 }
+
+TEST(BreakDancer, regions_freed_when_their_mates_end_a_flush) {
+    // Region 0 (r at 1000) links to region 1 (its mates at 5000). The
+    // buffer is flushed when region 1 closes, at the first s read, and by
+    // then every mate of region 0 has been seen.
+    string sam_path = (bfs::temp_directory_path()
+        / bfs::unique_path("breakdancer-unit-test%%%%-%%%%-%%%%-%%%%.sam")).native();
+    {
+        ofstream out(sam_path.c_str());
+        out << "@HD\tVN:1.0\tSO:coordinate\n@SQ\tSN:21\tLN:46944323\n@RG\tID:rg1\n"
+            << pairs("r", 1000, 5000) << mates("r", 1000, 5000)
+            << pairs("s", 9000, 20000) << mates("s", 9000, 20000);
+    }
+
+    stringstream cfg_text;
+    cfg_text << "readgroup:rg1\tplatform:illumina\tmap:" << sam_path
+        << "\treadlen:10.00\tlib:lib1\tnum:10001\tlower:50.00\tupper:500.00"
+        << "\tmean:300.00\tstd:30.00\n";
+    BamConfig cfg(cfg_text, 3);
+    IlluminaPEReadClassifier classifier(cfg);
+
+    Options opts;
+    opts.buffer_size = 1;
+    opts.min_read_pair = 5;
+    TaskExecutor executor(0);
+    BamSummary summary(opts, cfg, classifier, executor);
+    LibraryInfo lib_info(cfg, summary);
+
+    boost::shared_ptr<BamReaderBase> reader(openBam(sam_path));
+    vector<BamReaderBase*> readers(1, reader.get());
+    BamMerger merged_reader(readers);
+    ReadRegionData read_regions(opts);
+    {
+        BreakDancer bdancer(classifier, opts, lib_info, read_regions,
+            merged_reader, executor, 100);
+        bdancer.set_read_density(sam_path, 0.001);
+        stringstream out;
+        bdancer.set_output(out);
+        bdancer.run();
+    }
+    bfs::remove(sam_path);
+
+    ASSERT_LE(4u, read_regions.num_regions());
+    EXPECT_FALSE(read_regions.region_exists(0));
+}
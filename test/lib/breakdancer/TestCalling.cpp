@@ -0,0 +1,272 @@
+#include "breakdancer/BreakDancer.hpp"
+#include "breakdancer/Evidence.hpp"
+#include "breakdancer/ReadRegionData.hpp"
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "io/BamConfig.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamMerger.hpp"
+#include "io/BamSummary.hpp"
+#include "io/ConfigLoader.hpp"
+#include "io/EvidenceFile.hpp"
+#include "io/LibraryConfig.hpp"
+#include "io/LibraryInfo.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/assign/list_of.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using boost::assign::map_list_of;
+using namespace std;
+
+namespace {
+    vector<string> fields(string const& line) {
+        vector<string> rv;
+        boost::split(rv, line, boost::is_any_of("\t"));
+        return rv;
+    }
+
+    // The Tumor_reads, Normal_reads and Somatic_status columns
+    string somatic_columns(string const& line) {
+        vector<string> f = fields(line);
+        return f[f.size() - 3] + " " + f[f.size() - 2] + " " + f[f.size() - 1];
+    }
+}
+
+// Calls on the test bams from start to end, the way breakdancer-max does
+class TestCalling : public ::testing::Test {
+protected:
+    void SetUp() {
+        _config_path = (bfs::temp_directory_path()
+            / bfs::unique_path("breakdancer-unit-test%%%%-%%%%-%%%%-%%%%.cfg")).native();
+    }
+
+    void TearDown() {
+        bfs::remove(_config_path);
+        for (size_t i = 0; i < _evidence_files.size(); ++i)
+            bfs::remove(_evidence_files[i]);
+    }
+
+    // Copies the test config with absolute bam paths, giving the libraries
+    // of each bam in roles that role. With an evidence prefix, the config
+    // lists the evidence files written under it instead of the bams.
+    void write_config(map<string, string> const& roles = map<string, string>(),
+            string const& evidence_prefix = "")
+    {
+        ifstream in((TEST_DATA_DIRECTORY + "/inv_del_bam_config").c_str());
+        ofstream out(_config_path.c_str());
+        string line;
+        while (getline(in, line)) {
+            string::size_type map_at = line.find("map:") + 4;
+            string::size_type map_end = line.find('\t', map_at);
+            string bam = line.substr(map_at, map_end - map_at);
+            string path = TEST_DATA_DIRECTORY + "/" + bam;
+            if (!evidence_prefix.empty())
+                path = evidence_path(evidence_prefix, path);
+            line.replace(map_at, map_end - map_at, path);
+            map<string, string>::const_iterator role = roles.find(bam);
+            if (role != roles.end())
+                line += "\trole:" + role->second;
+            out << line << "\n";
+        }
+    }
+
+    // Returns the call lines for the given options, separated by spaces
+    vector<string> call(string const& options = "") {
+        if (!bfs::exists(_config_path))
+            write_config();
+
+        vector<string> args(1, "breakdancer-max");
+        istringstream in(options);
+        copy(istream_iterator<string>(in), istream_iterator<string>(), back_inserter(args));
+        args.push_back(_config_path);
+        vector<char*> argv;
+        for (size_t i = 0; i < args.size(); ++i)
+            argv.push_back(&args[i][0]);
+
+        optind = 0;
+        Options const initial_options(argv.size(), &argv[0]);
+        TaskExecutor executor(0);
+        ConfigLoader const context(initial_options, executor);
+        Options const& opts = context.options();
+        BamConfig const& cfg = context.bam_config();
+        LibraryInfo const lib_info(cfg, context.bam_summary());
+
+        if (!opts.evidence_prefix.empty()) {
+            write_evidence_files(opts, lib_info, context.read_classifier(), executor);
+            for (size_t i = 0; i < cfg.num_bams(); ++i)
+                _evidence_files.push_back(evidence_path(opts.evidence_prefix, cfg.bam_files()[i]));
+        }
+
+        // Read densities and the read window as the library statistics
+        // set them
+        map<string, float> read_density;
+        int max_read_window_size = cfg.max_read_window_size();
+        BamSummary const& summary = lib_info._summary;
+        for (size_t i = 0; i < cfg.num_libs(); ++i) {
+            LibraryConfig const& lib_config = cfg.library_config(i);
+            LibraryFlagDistribution const& flags = summary.library_flag_distribution(i);
+            uint32_t covered_ref_len = summary.covered_reference_length();
+            if (opts.CN_lib)
+                read_density[lib_config.name] = float(flags.read_count) / covered_ref_len;
+            else
+                read_density[lib_config.bam_file] =
+                    float(summary.read_count_in_bam(lib_config.bam_file)) / covered_ref_len;
+
+            int discrepant = flags.read_counts_by_flag[ReadFlag::ARP_LARGE_INSERT]
+                + flags.read_counts_by_flag[ReadFlag::ARP_SMALL_INSERT];
+            int tmp = discrepant > 0 ? float(covered_ref_len) / discrepant : 50;
+            max_read_window_size = std::min(max_read_window_size, tmp);
+        }
+
+        vector<boost::shared_ptr<BamReaderBase> > sp_readers(
+            openBams(cfg.bam_files(), opts.chr, &executor, io_options(opts)));
+        vector<BamReaderBase*> readers;
+        for (size_t i = 0; i < sp_readers.size(); ++i)
+            readers.push_back(sp_readers[i].get());
+
+        BamMerger merged_reader(readers);
+        ReadRegionData read_regions(opts);
+        BreakDancer bdancer(context.read_classifier(), opts, lib_info,
+            read_regions, merged_reader, executor, max_read_window_size);
+        for (map<string, float>::const_iterator i = read_density.begin(); i != read_density.end(); ++i)
+            bdancer.set_read_density(i->first, i->second);
+
+        stringstream out;
+        bdancer.set_output(out);
+        bdancer.run();
+
+        vector<string> calls;
+        string line;
+        while (getline(out, line)) {
+            if (!line.empty() && line[0] != '#')
+                calls.push_back(line);
+        }
+        return calls;
+    }
+
+    string _config_path;
+    vector<string> _evidence_files;
+};
+
+TEST_F(TestCalling, denseRegionsDropped) {
+    vector<string> all = call();
+    ASSERT_EQ(4u, all.size());
+
+    // With coverage capped at 1x, most regions are too dense to call in
+    vector<string> capped = call("-x 1");
+    EXPECT_LT(capped.size(), all.size());
+    for (size_t i = 0; i < capped.size(); ++i)
+        EXPECT_NE(all.end(), find(all.begin(), all.end(), capped[i]));
+
+    // The early check only looks at regions with many reads, and none of
+    // these has that many, so it drops the same regions at their end
+    EXPECT_EQ(capped, call("-x 1 --dense-region-early"));
+}
+
+TEST_F(TestCalling, denseRegionsSampled) {
+    vector<string> all = call();
+
+    // A sample larger than any region keeps all of its reads
+    EXPECT_EQ(all, call("-x 1 --dense-region-sample 1000000"));
+
+    // A small sample still calls in dense regions, but with fewer reads
+    vector<string> sampled = call("-x 1 --dense-region-sample 3");
+    vector<string> capped = call("-x 1");
+    EXPECT_GT(sampled.size(), capped.size());
+    EXPECT_LE(sampled.size(), all.size());
+}
+
+TEST_F(TestCalling, somaticColumns) {
+    vector<string> plain = call();
+    ASSERT_EQ(4u, plain.size());
+
+    write_config(map_list_of
+        ("NA19240_chr21_del_inv.bam", "tumor")
+        ("NA19238_chr21_del_inv.bam", "normal"));
+    vector<string> calls = call();
+    ASSERT_EQ(4u, calls.size());
+
+    // The same calls, with the supporting reads split by role after them
+    for (size_t i = 0; i < calls.size(); ++i) {
+        vector<string> f = fields(calls[i]);
+        ASSERT_EQ(fields(plain[i]).size() + 3, f.size());
+        EXPECT_EQ(0u, calls[i].find(plain[i]));
+        EXPECT_EQ(atoi(f[9].c_str()), atoi(f[f.size() - 3].c_str()) + atoi(f[f.size() - 2].c_str()));
+    }
+    EXPECT_EQ("1 1 GERMLINE", somatic_columns(calls[0]));
+    EXPECT_EQ("0 21 GERMLINE", somatic_columns(calls[1]));
+    EXPECT_EQ("2 1 GERMLINE", somatic_columns(calls[2]));
+    EXPECT_EQ("2 0 SOMATIC", somatic_columns(calls[3]));
+}
+
+TEST_F(TestCalling, somaticFilters) {
+    write_config(map_list_of
+        ("NA19240_chr21_del_inv.bam", "tumor")
+        ("NA19238_chr21_del_inv.bam", "normal"));
+    vector<string> calls = call();
+
+    vector<string> somatic = call("--somatic-only");
+    ASSERT_EQ(1u, somatic.size());
+    EXPECT_EQ(calls[3], somatic[0]);
+
+    // With one normal read allowed, calls with a single normal read are
+    // SOMATIC too
+    vector<string> relaxed = call("--max-normal-support 1");
+    ASSERT_EQ(4u, relaxed.size());
+    EXPECT_EQ("1 1 SOMATIC", somatic_columns(relaxed[0]));
+    EXPECT_EQ("0 21 GERMLINE", somatic_columns(relaxed[1]));
+    EXPECT_EQ("2 1 SOMATIC", somatic_columns(relaxed[2]));
+    EXPECT_EQ("2 0 SOMATIC", somatic_columns(relaxed[3]));
+
+    vector<string> relaxed_somatic = call("--somatic-only --max-normal-support 1");
+    ASSERT_EQ(3u, relaxed_somatic.size());
+    EXPECT_EQ(relaxed[0], relaxed_somatic[0]);
+    EXPECT_EQ(relaxed[2], relaxed_somatic[1]);
+    EXPECT_EQ(relaxed[3], relaxed_somatic[2]);
+}
+
+TEST_F(TestCalling, somaticOnlyNeedsRoles) {
+    EXPECT_THROW(call("--somatic-only"), runtime_error);
+}
+
+TEST_F(TestCalling, evidenceFilesCallLikeBams) {
+    string prefix = (bfs::temp_directory_path()
+        / bfs::unique_path("breakdancer-unit-test%%%%-%%%%-%%%%-%%%%")).native();
+    char const* options[] = {"", "-h", "-a -h"};
+    vector<vector<string> > from_bams;
+    for (size_t i = 0; i < 3; ++i)
+        from_bams.push_back(call(options[i] + string(" --write-evidence ") + prefix));
+
+    // The same calls, but for the num_Reads_lib column, which names the
+    // files they came from
+    write_config(map<string, string>(), prefix);
+    for (size_t i = 0; i < 3; ++i) {
+        vector<string> from_evidence = call(options[i]);
+        ASSERT_EQ(from_bams[i].size(), from_evidence.size()) << options[i];
+        ASSERT_LT(0u, from_evidence.size());
+        for (size_t j = 0; j < from_evidence.size(); ++j) {
+            vector<string> expected = fields(from_bams[i][j]);
+            vector<string> actual = fields(from_evidence[j]);
+            expected[10] = actual[10] = "";
+            EXPECT_EQ(expected, actual) << options[i];
+        }
+    }
+}
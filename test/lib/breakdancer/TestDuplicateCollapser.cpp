@@ -0,0 +1,97 @@
+#include "breakdancer/DuplicateCollapser.hpp"
+
+#include "io/Alignment.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    Alignment::Ptr make_read(string const& name, int tid, int pos,
+            int mtid, int mpos, uint16_t flag = BAM_FPAIRED | BAM_FMREVERSE,
+            size_t lib_index = 0)
+    {
+        vector<uint8_t> data(name.begin(), name.end());
+        data.push_back(0);
+
+        bam1_t record;
+        memset(&record, 0, sizeof(record));
+        record.core.tid = tid;
+        record.core.pos = pos;
+        record.core.qual = 60;
+        record.core.l_qname = data.size();
+        record.core.flag = flag;
+        record.core.mtid = mtid;
+        record.core.mpos = mpos;
+        record.data_len = data.size();
+        record.m_data = data.size();
+        record.data = &data[0];
+
+        Alignment::Ptr aln(new Alignment(&record, false));
+        aln->set_lib_index(lib_index);
+        return aln;
+    }
+}
+
+TEST(DuplicateCollapser, samePairPositions) {
+    DuplicateCollapser dc;
+    uint16_t mate = BAM_FPAIRED | BAM_FREVERSE;
+
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 100, 0, 5000)));
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 100, 0, 5000)));
+    // Different mate position, strand or library: not duplicates
+    EXPECT_FALSE(dc.is_duplicate(*make_read("c", 0, 100, 0, 5001)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("d", 0, 100, 0, 5000, BAM_FPAIRED)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("e", 0, 100, 0, 5000, BAM_FPAIRED | BAM_FMREVERSE, 1)));
+    EXPECT_EQ(1u, dc.pending_mates());
+
+    // Second ends: b goes because it lost at the first end, whatever the
+    // order they come in
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 5000, 0, 100, mate)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 5000, 0, 100, mate)));
+    EXPECT_EQ(0u, dc.pending_mates());
+    EXPECT_EQ(2u, dc.duplicates());
+}
+
+TEST(DuplicateCollapser, bothEndsAtOnePosition) {
+    DuplicateCollapser dc;
+    uint16_t ff = BAM_FPAIRED;
+
+    // Both ends of a and of b are at 0:100 on the forward strand
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 100, 0, 100, ff)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 100, 0, 100, ff)));
+    EXPECT_EQ(0u, dc.pending_mates());
+
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 100, 0, 100, ff)));
+    EXPECT_EQ(1u, dc.pending_mates());
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 100, 0, 100, ff)));
+    EXPECT_EQ(0u, dc.pending_mates());
+    EXPECT_EQ(2u, dc.duplicates());
+}
+
+TEST(DuplicateCollapser, interchromosomal) {
+    DuplicateCollapser dc;
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 100, 1, 50)));
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 100, 1, 50)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 1, 50, 0, 100)));
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 1, 50, 0, 100)));
+}
+
+TEST(DuplicateCollapser, positionWindow) {
+    DuplicateCollapser dc;
+    EXPECT_FALSE(dc.is_duplicate(*make_read("a", 0, 100, 0, 5000)));
+    EXPECT_TRUE(dc.is_duplicate(*make_read("b", 0, 100, 0, 5000)));
+    EXPECT_FALSE(dc.is_duplicate(*make_read("c", 0, 101, 0, 5000)));
+    // Only one position is held
+    EXPECT_FALSE(dc.is_duplicate(*make_read("d", 0, 101, 0, 5000, BAM_FPAIRED)));
+    EXPECT_TRUE(dc.is_duplicate(*make_read("e", 0, 101, 0, 5000, BAM_FPAIRED)));
+
+    // The mate of b never shows up; it is forgotten once the stream passes
+    EXPECT_EQ(2u, dc.pending_mates());
+    EXPECT_FALSE(dc.is_duplicate(*make_read("x", 0, 5001, 0, 6000)));
+    EXPECT_EQ(0u, dc.pending_mates());
+}
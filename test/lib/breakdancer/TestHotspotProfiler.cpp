@@ -0,0 +1,127 @@
+#include "breakdancer/HotspotProfiler.hpp"
+
+#include "breakdancer/BasicRegion.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    Alignment::Ptr make_read(int tid, int pos) {
+        char name[] = "read";
+        bam1_t record;
+        memset(&record, 0, sizeof(record));
+        record.core.tid = tid;
+        record.core.pos = pos;
+        record.core.l_qname = sizeof(name);
+        record.core.mtid = tid;
+        record.core.mpos = pos;
+        record.data_len = sizeof(name);
+        record.m_data = sizeof(name);
+        record.data = reinterpret_cast<uint8_t*>(name);
+        return Alignment::Ptr(new Alignment(&record, false));
+    }
+
+    vector<string> lines(string const& text) {
+        vector<string> rv;
+        istringstream in(text);
+        string line;
+        while (getline(in, line))
+            rv.push_back(line);
+        return rv;
+    }
+}
+
+class TestHotspotProfiler : public ::testing::Test {
+protected:
+    void SetUp() {
+        header = bam_header_init();
+        header->n_targets = 2;
+        header->target_len = (uint32_t*)malloc(2 * sizeof(uint32_t));
+        header->target_len[0] = 2500;
+        header->target_len[1] = 1000;
+        header->target_name = (char**)malloc(2 * sizeof(char*));
+        header->target_name[0] = strdup("1");
+        header->target_name[1] = strdup("2");
+    }
+
+    void TearDown() {
+        bam_header_destroy(header);
+    }
+
+    bam_header_t* header;
+};
+
+TEST_F(TestHotspotProfiler, ranksWindowsAndRegions) {
+    HotspotProfiler profiler("unused", header, 1000);
+
+    // One second spread over four reads, one of them unplaced
+    vector<Alignment::Ptr> batch;
+    batch.push_back(make_read(0, 10));
+    batch.push_back(make_read(0, 20));
+    batch.push_back(make_read(0, 2100));
+    batch.push_back(make_read(-1, -1));
+    profiler.charge_decode(batch, 0.75);
+    profiler.charge_region(0, 2050, 3, 2);
+
+    BasicRegion near(0, 0, 10, 40, 0);
+    BasicRegion far(1, 0, 2050, 2150, 0);
+    far.fwd_read_count = 3;
+    far.times_accessed = 2;
+    far.times_collapsed = 1;
+    profiler.charge_traversal(far, 1.0);
+    profiler.charge_sv(far, 0.5);
+    profiler.charge_sv(near, 0.25);
+    profiler.region_done(near);
+    profiler.region_done(far);
+
+    ostringstream table;
+    profiler.write_table(table);
+    vector<string> rows = lines(table.str());
+    ASSERT_EQ(6u, rows.size());
+    EXPECT_EQ(0u, rows[0].find("#Window"));
+    EXPECT_EQ("1\t1\t2000\t2500\t1.750000\t0.250000\t1.000000\t0.500000\t1\t2\t1\t1", rows[1]);
+    EXPECT_EQ("2\t1\t0\t1000\t0.750000\t0.500000\t0.000000\t0.250000\t2\t0\t0\t1", rows[2]);
+    EXPECT_EQ(0u, rows[3].find("#Region"));
+    EXPECT_EQ("1\t1\t1\t2050\t2151\t1.500000\t1.000000\t0.500000\t3\t2\t1", rows[4]);
+    EXPECT_EQ("2\t0\t1\t10\t41\t0.250000\t0.000000\t0.250000\t0\t0\t0", rows[5]);
+
+    ostringstream bedgraph;
+    profiler.write_bedgraph(bedgraph);
+    rows = lines(bedgraph.str());
+    ASSERT_EQ(3u, rows.size());
+    EXPECT_EQ(0u, rows[0].find("track type=bedGraph"));
+    EXPECT_EQ("1\t0\t1000\t0.750000", rows[1]);
+    EXPECT_EQ("1\t2000\t2500\t1.750000", rows[2]);
+}
+
+TEST_F(TestHotspotProfiler, keepsCostliestRegions) {
+    HotspotProfiler profiler("unused", header, 1000);
+    int n = HotspotProfiler::MAX_REGIONS + 10;
+    for (int i = 0; i < n; ++i) {
+        BasicRegion region(i, 1, i % 1000, i % 1000, 0);
+        profiler.charge_sv(region, i);
+        profiler.region_done(region);
+    }
+
+    ostringstream table;
+    profiler.write_table(table);
+    vector<string> rows = lines(table.str());
+    size_t first = 0;
+    while (rows[first].find("#Region") != 0)
+        ++first;
+    EXPECT_EQ(size_t(HotspotProfiler::MAX_REGIONS), rows.size() - first - 1);
+    // The costliest first, and the cheapest ten gone
+    EXPECT_EQ(0u, rows[first + 1].find("1\t" + to_string(n - 1) + "\t"));
+    EXPECT_EQ(0u, rows.back().find(to_string(HotspotProfiler::MAX_REGIONS) + "\t10\t"));
+}
+
+TEST_F(TestHotspotProfiler, badWindow) {
+    EXPECT_THROW(HotspotProfiler("unused", header, 0), runtime_error);
+}
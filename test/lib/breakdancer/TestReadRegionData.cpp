@@ -0,0 +1,235 @@
+#include "breakdancer/ReadRegionData.hpp"
+
+#include "common/Options.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    Alignment::Ptr make_read(string const& name, int pos, int mpos) {
+        vector<uint8_t> data(name.begin(), name.end());
+        data.push_back(0);
+
+        bam1_t record;
+        memset(&record, 0, sizeof(record));
+        record.core.tid = 0;
+        record.core.pos = pos;
+        record.core.qual = 60;
+        record.core.l_qname = data.size();
+        record.core.flag = BAM_FPAIRED;
+        record.core.mtid = 0;
+        record.core.mpos = mpos;
+        record.core.isize = mpos - pos;
+        record.data_len = data.size();
+        record.m_data = data.size();
+        record.data = &data[0];
+
+        Alignment::Ptr aln(new Alignment(&record, false));
+        aln->set_bdflag(ReadFlag::ARP_LARGE_INSERT);
+        return aln;
+    }
+}
+
+class TestReadRegionData : public ::testing::Test {
+protected:
+    void SetUp() {
+        rdata.reset(new ReadRegionData(opts));
+
+        ReadRegionData::ReadVector reads;
+        reads.push_back(make_read("a", 100, 5000));
+        reads.push_back(make_read("b", 110, 5000));
+        // The mate of this read never makes it into any region
+        reads.push_back(make_read("orphan", 120, 300));
+
+        rdata->set_stream_position(0, 100);
+        rdata->add_region(0, 100, 120, 0, reads);
+    }
+
+    void add_mate_region() {
+        ReadRegionData::ReadVector reads;
+        reads.push_back(make_read("a", 5000, 100));
+        reads.push_back(make_read("b", 5000, 110));
+
+        rdata->set_stream_position(0, 5000);
+        rdata->add_region(0, 5000, 5010, 0, reads);
+    }
+
+    Options opts;
+    boost::scoped_ptr<ReadRegionData> rdata;
+};
+
+TEST_F(TestReadRegionData, orphan_evicted_once_stream_passes_mate) {
+    ASSERT_EQ(3u, rdata->num_reads_in_region(0));
+    ASSERT_EQ(1u, rdata->read_regions().count("orphan"));
+
+    rdata->set_stream_position(0, 300);
+    EXPECT_EQ(1u, rdata->read_regions().count("orphan"));
+
+    rdata->set_stream_position(0, 301);
+    EXPECT_EQ(0u, rdata->read_regions().count("orphan"));
+    EXPECT_EQ(2u, rdata->num_reads_in_region(0));
+}
+
+TEST_F(TestReadRegionData, paired_reads_not_evicted) {
+    add_mate_region();
+    rdata->set_end_of_stream();
+
+    EXPECT_EQ(2u, rdata->read_regions().at("a").size());
+    EXPECT_EQ(2u, rdata->read_regions().at("b").size());
+    EXPECT_EQ(2u, rdata->num_reads_in_region(0));
+    EXPECT_EQ(2u, rdata->num_reads_in_region(1));
+}
+
+TEST_F(TestReadRegionData, region_final_after_mate_horizon) {
+    add_mate_region();
+    rdata->set_stream_position(0, 5000);
+    EXPECT_FALSE(rdata->is_region_final(0));
+
+    rdata->set_stream_position(0, 6000);
+    EXPECT_TRUE(rdata->is_region_final(0));
+
+    // The last region may still absorb collapsed data
+    EXPECT_FALSE(rdata->is_region_final(1));
+}
+
+TEST_F(TestReadRegionData, event_driven_candidates) {
+    Options event_opts;
+    event_opts.event_driven = true;
+    rdata.reset(new ReadRegionData(event_opts));
+
+    ReadRegionData::ReadVector reads;
+    reads.push_back(make_read("a", 100, 5000));
+    reads.push_back(make_read("b", 110, 5000));
+    rdata->set_stream_position(0, 100);
+    rdata->add_region(0, 100, 120, 0, reads);
+    add_mate_region();
+
+    vector<vector<int> > ready;
+    rdata->take_ready_candidates(ready);
+    EXPECT_TRUE(ready.empty());
+
+    // Both regions are final, but region 1 is still the last one
+    rdata->set_stream_position(0, 6000);
+    rdata->take_ready_candidates(ready);
+    EXPECT_TRUE(ready.empty());
+
+    ReadRegionData::ReadVector no_reads;
+    rdata->add_region(0, 7000, 7010, 0, no_reads);
+    rdata->take_ready_candidates(ready);
+    ASSERT_EQ(1u, ready.size());
+    ASSERT_EQ(2u, ready[0].size());
+    EXPECT_EQ(0, ready[0][0]);
+    EXPECT_EQ(1, ready[0][1]);
+
+    // Handed out once only, and the regions go once they are processed
+    EXPECT_TRUE(rdata->region_exists(0));
+    rdata->clear_settled_regions();
+    EXPECT_FALSE(rdata->region_exists(0));
+    EXPECT_FALSE(rdata->region_exists(1));
+
+    ready.clear();
+    rdata->set_end_of_stream();
+    rdata->take_ready_candidates(ready);
+    EXPECT_TRUE(ready.empty());
+}
+
+TEST_F(TestReadRegionData, event_driven_flushes_at_end_of_stream) {
+    Options event_opts;
+    event_opts.event_driven = true;
+    rdata.reset(new ReadRegionData(event_opts));
+
+    ReadRegionData::ReadVector reads;
+    reads.push_back(make_read("a", 100, 5000));
+    reads.push_back(make_read("b", 110, 5000));
+    rdata->set_stream_position(0, 100);
+    rdata->add_region(0, 100, 120, 0, reads);
+    add_mate_region();
+
+    vector<vector<int> > ready;
+    rdata->set_end_of_stream();
+    rdata->take_ready_candidates(ready);
+    EXPECT_EQ(1u, ready.size());
+}
+
+TEST_F(TestReadRegionData, accumulate_reads_across_checkpoints) {
+    rdata.reset(new ReadRegionData(opts));
+
+    // Counts as add_region records them, to add up the slow way
+    vector<ReadCountsByLib> roi;
+    vector<ReadCountsByLib> fr;
+    ReadCountsByLib roi_acc;
+    ReadCountsByLib fr_acc;
+
+    size_t const n = ReadRegionData::COUNT_CHECKPOINT_INTERVAL * 5 + 17;
+    ReadRegionData::ReadVector no_reads;
+    for (size_t i = 0; i < n; ++i) {
+        // Some libraries only show up now and then, some with no reads,
+        // one only at the start
+        string lib = i % 3 ? "lib1" : "lib2";
+        uint32_t count = i % 11 == 0 ? 0 : i % 5;
+        rdata->incr_normal_read_count(lib, count);
+        roi_acc[lib] += count;
+        fr_acc[lib] += count;
+        if (i == 0) {
+            rdata->incr_normal_read_count("rare", 1);
+            roi_acc["rare"] += 1;
+            fr_acc["rare"] += 1;
+        }
+
+        if (i % 7 == 3 && !roi.empty()) {
+            rdata->collapse_accumulated_data_into_last_region(no_reads);
+            roi.back() += fr_acc;
+        }
+        else {
+            rdata->add_region(0, i * 100, i * 100 + 10, 0, no_reads);
+            roi.push_back(roi_acc);
+            fr.push_back(fr_acc - roi_acc);
+        }
+
+        rdata->clear_region_accumulator();
+        roi_acc.clear();
+        if (i % 13 == 0) {
+            rdata->clear_flanking_region_accumulator();
+            fr_acc.clear();
+        }
+    }
+
+    size_t const num_regions = rdata->num_regions();
+    ASSERT_EQ(roi.size(), num_regions);
+    ASSERT_GT(num_regions, size_t(ReadRegionData::COUNT_CHECKPOINT_INTERVAL * 3));
+
+    size_t const ranges[][2] = {
+        {0, num_regions},
+        {0, 1},
+        {3, 40},
+        {1, ReadRegionData::COUNT_CHECKPOINT_INTERVAL},
+        {ReadRegionData::COUNT_CHECKPOINT_INTERVAL, ReadRegionData::COUNT_CHECKPOINT_INTERVAL * 2},
+        {ReadRegionData::COUNT_CHECKPOINT_INTERVAL - 1, ReadRegionData::COUNT_CHECKPOINT_INTERVAL * 3 + 5},
+        {5, num_regions - 3},
+        {301, num_regions},
+        {17, num_regions + 1000},
+        {40, 3},
+    };
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+        size_t begin = ranges[r][0];
+        size_t end = ranges[r][1];
+
+        ReadCountsByLib expected;
+        for (size_t i = begin; i < min(end, num_regions); ++i) {
+            expected += roi[i];
+            if (i > begin)
+                expected += fr[i];
+        }
+
+        ReadCountsByLib observed;
+        rdata->accumulate_reads_between_regions(observed, begin, end);
+        EXPECT_EQ(expected, observed) << "regions " << begin << " to " << end;
+    }
+}
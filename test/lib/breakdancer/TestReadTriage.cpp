@@ -0,0 +1,110 @@
+#include "breakdancer/ReadTriage.hpp"
+
+#include "common/Options.hpp"
+#include "common/TaskExecutor.hpp"
+#include "io/AlignmentSource.hpp"
+#include "io/BamConfig.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamSummary.hpp"
+#include "io/IlluminaPEReadClassifier.hpp"
+#include "io/LibraryInfo.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    // Discordant pairs (5kb apart, insert size cutoff 500): P1's second
+    // end fails -q, P2 passes at both ends. P3 and P4 only have their
+    // first end, and say what their mate's quality is in MQ.
+    string const samData =
+        "@HD\tVN:1.0\tSO:coordinate\n"
+        "@SQ\tSN:21\tLN:46944323\n"
+        "@RG\tID:rg1\n"
+        "P1\t97\t21\t100\t60\t10M\t=\t5100\t5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n"
+        "P2\t97\t21\t200\t60\t10M\t=\t5200\t5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n"
+        "P3\t97\t21\t300\t60\t10M\t=\t5300\t5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\tMQ:i:10\n"
+        "P4\t97\t21\t400\t60\t10M\t=\t5400\t5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\tMQ:i:60\n"
+        "P1\t145\t21\t5100\t10\t10M\t=\t100\t-5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n"
+        "P2\t145\t21\t5200\t60\t10M\t=\t200\t-5010\tGTTTTTTTTT\tHHHHHHHHHH\tRG:Z:rg1\n"
+        ;
+}
+
+class TestReadTriage : public ::testing::Test {
+protected:
+    void SetUp() {
+        _sam_path = (bfs::temp_directory_path()
+            / bfs::unique_path("breakdancer-unit-test%%%%-%%%%-%%%%-%%%%.sam")).native();
+        ofstream out(_sam_path.c_str());
+        out << samData;
+        out.close();
+
+        stringstream cfg;
+        cfg << "readgroup:rg1\tplatform:illumina\tmap:" << _sam_path
+            << "\treadlen:10.00\tlib:lib1\tnum:10001\tlower:50.00\tupper:500.00"
+            << "\tmean:300.00\tstd:30.00\n";
+        _cfg.reset(new BamConfig(cfg, 3));
+        _classifier.reset(new IlluminaPEReadClassifier(*_cfg));
+    }
+
+    void TearDown() {
+        bfs::remove(_sam_path);
+    }
+
+    // The fate of each read, by name and end (see passing_read_key)
+    map<string, ReadTriage::Fate> triage(Options const& opts) {
+        TaskExecutor executor(0);
+        BamSummary summary(opts, *_cfg, *_classifier, executor);
+        LibraryInfo lib_info(*_cfg, summary);
+        ReadTriage triage(opts, lib_info);
+
+        boost::shared_ptr<BamReaderBase> reader(openBam(_sam_path));
+        AlignmentSource src(*reader, *_classifier, *_cfg, false);
+        map<string, ReadTriage::Fate> fates;
+        vector<Alignment::Ptr> alns;
+        while (src.next_batch(alns)) {
+            for (size_t i = 0; i < alns.size(); ++i)
+                fates[BamSummary::passing_read_key(*alns[i])] = triage(*alns[i]);
+        }
+        return fates;
+    }
+
+    string _sam_path;
+    boost::shared_ptr<BamConfig> _cfg;
+    boost::shared_ptr<IlluminaPEReadClassifier> _classifier;
+};
+
+TEST_F(TestReadTriage, mateQualPrefilter) {
+    Options opts;
+    opts.mate_qual_prefilter = true;
+    map<string, ReadTriage::Fate> fates = triage(opts);
+    ASSERT_EQ(6u, fates.size());
+
+    // Mates that fail -q, known from the summary pass or from MQ
+    EXPECT_EQ(ReadTriage::IGNORED, fates["P1/2"]);
+    EXPECT_EQ(ReadTriage::FILTERED, fates["P1/1"]);
+    EXPECT_EQ(ReadTriage::FILTERED, fates["P3/1"]);
+
+    // Mates that pass
+    EXPECT_EQ(ReadTriage::DISCORDANT, fates["P2/1"]);
+    EXPECT_EQ(ReadTriage::DISCORDANT, fates["P2/2"]);
+    EXPECT_EQ(ReadTriage::DISCORDANT, fates["P4/1"]);
+}
+
+TEST_F(TestReadTriage, noPrefilter) {
+    Options opts;
+    map<string, ReadTriage::Fate> fates = triage(opts);
+    EXPECT_EQ(ReadTriage::IGNORED, fates["P1/2"]);
+    EXPECT_EQ(ReadTriage::DISCORDANT, fates["P1/1"]);
+    EXPECT_EQ(ReadTriage::DISCORDANT, fates["P3/1"]);
+}
@@ -0,0 +1,30 @@
+#include "common/AllocationCounter.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    // Keeps the compiler from leaving out allocations that go unused
+    int* volatile sink;
+}
+
+TEST(TestAllocationCounter, counts_only_while_on) {
+    count_allocations(true);
+    uint64_t before = allocation_count();
+    int* one = new int(1);
+    sink = one;
+    int* many = new int[10];
+    sink = many;
+    EXPECT_EQ(before + 2, allocation_count());
+    count_allocations(false);
+    delete one;
+    delete[] many;
+
+    before = allocation_count();
+    vector<int> v(100);
+    sink = &v[0];
+    EXPECT_EQ(before, allocation_count());
+}
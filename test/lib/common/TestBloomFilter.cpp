@@ -0,0 +1,62 @@
+#include "common/BloomFilter.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+using boost::lexical_cast;
+using namespace std;
+
+TEST(BloomFilter, no_false_negatives) {
+    BloomFilter filter(1 << 16, 4);
+    for (int i = 0; i < 1000; ++i)
+        filter.insert("read" + lexical_cast<string>(i));
+
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_TRUE(filter.maybe_contains("read" + lexical_cast<string>(i)));
+}
+
+TEST(BloomFilter, few_false_positives) {
+    BloomFilter filter(1 << 16, 4);
+    for (int i = 0; i < 1000; ++i)
+        filter.insert("read" + lexical_cast<string>(i));
+
+    // ~65 bits per key and 4 hashes gives a false positive rate well
+    // under 0.1%.
+    int false_positives = 0;
+    for (int i = 1000; i < 11000; ++i)
+        false_positives += filter.maybe_contains("read" + lexical_cast<string>(i));
+
+    EXPECT_LT(false_positives, 10);
+}
+
+TEST(BloomFilter, merge) {
+    BloomFilter a(1024, 3);
+    BloomFilter b(1024, 3);
+    a.insert("x");
+    b.insert("y");
+    EXPECT_FALSE(a.maybe_contains("y"));
+
+    a |= b;
+    EXPECT_TRUE(a.maybe_contains("x"));
+    EXPECT_TRUE(a.maybe_contains("y"));
+
+    BloomFilter c(2048, 3);
+    EXPECT_THROW(a |= c, std::invalid_argument);
+}
+
+TEST(BloomFilter, concurrent_inserts) {
+    // Threads filling in one filter lose none of each other's bits
+    BloomFilter filter(1 << 12, 4);
+    TaskExecutor executor(4);
+    executor.parallel_for(4000, [&](size_t i) {
+        filter.insert("read" + lexical_cast<string>(i));
+    });
+
+    for (int i = 0; i < 4000; ++i)
+        EXPECT_TRUE(filter.maybe_contains("read" + lexical_cast<string>(i)));
+}
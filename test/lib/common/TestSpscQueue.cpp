@@ -0,0 +1,59 @@
+#include "common/SpscQueue.hpp"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+TEST(TestSpscQueue, capacity_rounds_up) {
+    SpscQueue<int> q(5);
+    EXPECT_EQ(8u, q.capacity());
+}
+
+TEST(TestSpscQueue, fifo_and_bounds) {
+    SpscQueue<int> q(4);
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(q.try_push(i));
+    EXPECT_FALSE(q.try_push(4));
+    EXPECT_EQ(4u, q.size());
+
+    int x = -1;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.try_pop(x));
+        EXPECT_EQ(i, x);
+    }
+    EXPECT_FALSE(q.try_pop(x));
+    EXPECT_EQ(0u, q.size());
+}
+
+TEST(TestSpscQueue, two_threads) {
+    SpscQueue<int> q(16);
+    int const n = 100000;
+
+    thread producer([&q]() {
+        for (int i = 0; i < n; ++i) {
+            while (!q.try_push(i))
+                this_thread::yield();
+        }
+    });
+
+    long long sum = 0;
+    int expected = 0;
+    bool in_order = true;
+    while (expected < n) {
+        int x;
+        if (q.try_pop(x)) {
+            in_order = in_order && x == expected;
+            sum += x;
+            ++expected;
+        }
+        else {
+            this_thread::yield();
+        }
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ((long long)n * (n - 1) / 2, sum);
+}
@@ -0,0 +1,107 @@
+#include "common/TaskExecutor.hpp"
+
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+TEST(TestTaskExecutor, parallel_for_runs_every_index_once) {
+    TaskExecutor executor(3);
+    EXPECT_EQ(3u, executor.num_workers());
+
+    // Reuse the executor for several loops of different sizes
+    for (size_t n = 0; n < 50; n += 7) {
+        vector<int> hits(n, 0);
+        executor.parallel_for(n, [&hits](size_t i) { ++hits[i]; });
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_EQ(1, hits[i]) << "n=" << n << ", i=" << i;
+    }
+}
+
+TEST(TestTaskExecutor, no_workers) {
+    TaskExecutor executor(0);
+    atomic<int> sum(0);
+    executor.parallel_for(10, [&sum](size_t i) { sum += int(i); });
+    EXPECT_EQ(45, sum);
+
+    TaskGroup group(executor);
+    group.run([&sum]() { sum = 0; });
+    // Ran on the spot
+    EXPECT_EQ(0, sum);
+    group.wait();
+}
+
+TEST(TestTaskExecutor, parallel_for_rethrows) {
+    TaskExecutor executor(2);
+    EXPECT_THROW(
+        executor.parallel_for(100, [](size_t i) {
+            if (i == 17)
+                throw runtime_error("task failed");
+        }),
+        runtime_error);
+
+    // Still usable afterwards
+    atomic<int> count(0);
+    executor.parallel_for(5, [&count](size_t) { ++count; });
+    EXPECT_EQ(5, count);
+}
+
+TEST(TestTaskExecutor, group_cancels_on_error) {
+    TaskExecutor executor(1);
+    TaskGroup group(executor);
+    atomic<int> ran(0);
+
+    group.run([]() { throw runtime_error("first"); });
+    for (int i = 0; i < 100; ++i)
+        group.run([&ran]() { ++ran; });
+
+    EXPECT_THROW(group.wait(), runtime_error);
+    TaskGroup::Stats stats = group.stats();
+    EXPECT_EQ(101u, stats.tasks_run + stats.tasks_skipped);
+    EXPECT_EQ(100u - ran, stats.tasks_skipped);
+}
+
+TEST(TestTaskExecutor, nested_groups) {
+    // Tasks that wait on tasks of their own must not deadlock, even when
+    // there are more of them than workers
+    TaskExecutor executor(2);
+    atomic<int> leaves(0);
+    executor.parallel_for(8, [&](size_t) {
+        TaskGroup inner(executor);
+        for (int i = 0; i < 10; ++i)
+            inner.run([&leaves]() { ++leaves; });
+        inner.wait();
+    });
+    EXPECT_EQ(80, leaves);
+}
+
+TEST(TestTaskExecutor, bounded_queue_runs_inline) {
+    TaskExecutor executor(1, 4);
+    TaskGroup group(executor);
+    atomic<int> count(0);
+    for (int i = 0; i < 1000; ++i)
+        group.run([&count]() { ++count; });
+    group.wait();
+    EXPECT_EQ(1000, count);
+    EXPECT_EQ(1000u, group.stats().tasks_run);
+
+    stringstream stats;
+    executor.report_stats(stats);
+    EXPECT_NE(string::npos, stats.str().find("caller"));
+}
+
+TEST(TestTaskExecutor, worker_local) {
+    TaskExecutor executor(3);
+    WorkerLocal<int> sums(executor, 0);
+    executor.parallel_for(1000, [&sums](size_t i) { sums.local() += int(i); });
+
+    int total = 0;
+    for (WorkerLocal<int>::iterator i = sums.begin(); i != sums.end(); ++i)
+        total += *i;
+    EXPECT_EQ(999 * 1000 / 2, total);
+    EXPECT_EQ(3u, executor.current_worker());
+}
@@ -0,0 +1,67 @@
+#include "common/Trace.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    // Whether tracing is on is settled the first time anything asks, so
+    // the traced run happens in a fresh copy of this test binary.
+    void traced_run(string const& path) {
+        setenv("BD_TRACE", path.c_str(), 1);
+        trace_thread_name("main \"thread\"");
+        {
+            TraceSpan span("outer", "records", 42);
+            TraceSpan inner("inner");
+        }
+        thread worker([]() {
+            trace_thread_name("worker");
+            TraceSpan span("work");
+            span.set_arg("items", -3);
+        });
+        worker.join();
+        exit(0);
+    }
+}
+
+TEST(TestTrace, writes_chrome_trace_at_exit) {
+    // The copy running traced_run repeats this, so it is told the name
+    char const* env_path = getenv("BD_TEST_TRACE_PATH");
+    string path = env_path ? env_path : (bfs::temp_directory_path()
+        / bfs::unique_path("breakdancer-trace-%%%%-%%%%.json")).native();
+    setenv("BD_TEST_TRACE_PATH", path.c_str(), 1);
+
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_EXIT(traced_run(path), ::testing::ExitedWithCode(0), "");
+
+    ifstream in(path.c_str());
+    ASSERT_TRUE(in.good());
+    string trace((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    bfs::remove(path);
+    unsetenv("BD_TEST_TRACE_PATH");
+
+    EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(string::npos, trace.find("\"args\":{\"name\":\"main \\\"thread\\\"\"}"));
+    EXPECT_NE(string::npos, trace.find("\"args\":{\"name\":\"worker\"}"));
+    EXPECT_NE(string::npos, trace.find("{\"name\":\"outer\",\"ph\":\"X\""));
+    EXPECT_NE(string::npos, trace.find("\"args\":{\"records\":42}"));
+    EXPECT_NE(string::npos, trace.find("{\"name\":\"inner\",\"ph\":\"X\""));
+    EXPECT_NE(string::npos, trace.find("\"args\":{\"items\":-3}"));
+    EXPECT_NE(string::npos, trace.find("\"dropped_events\":0}}"));
+}
+
+TEST(TestTrace, off_without_env) {
+    // BD_TRACE is not set when the tests run
+    EXPECT_FALSE(trace_enabled());
+    TraceSpan span("ignored");
+    trace_flush();
+}
@@ -93,3 +93,8 @@ TEST_F(TestAlignment, set_bdflag) {
     test_read->set_bdflag(ReadFlag::NORMAL_FR);
     ASSERT_EQ(ReadFlag::NORMAL_FR, test_read->bdflag());
 }
+
+TEST_F(TestAlignment, mate_bdqual_unknown_with_am) {
+    // The record carries AM, so MQ (if any) would not tell us the mate's AM
+    ASSERT_EQ(-1, test_read->mate_bdqual());
+}
@@ -0,0 +1,119 @@
+#include "io/AlignmentFilter.hpp"
+#include "io/AlignmentPipeline.hpp"
+#include "io/AlignmentSource.hpp"
+#include "io/BamConfig.hpp"
+#include "io/BamReader.hpp"
+#include "io/IAlignmentClassifier.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include "TestData.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    class NullClassifier : public IAlignmentClassifier {
+    public:
+        ReadFlag classify(Alignment const&) const {
+            return ReadFlag::NA;
+        }
+    };
+
+    // Yields a few batches, then fails
+    class FailingReader : public BamReaderBase {
+    public:
+        explicit FailingReader(BamReaderBase& reader)
+            : _reader(reader)
+            , _calls(0)
+        {
+        }
+
+        int next(bam1_t* entry) {
+            if (++_calls > 1000)
+                throw runtime_error("read failed");
+            return _reader.next(entry);
+        }
+
+        bam_header_t* header() const { return _reader.header(); }
+        std::string const& path() const { return _reader.path(); }
+
+    private:
+        BamReaderBase& _reader;
+        int _calls;
+    };
+
+    // Reads with unlisted read groups fall back to the bam's library
+    BamConfig make_config() {
+        stringstream cfg;
+        cfg << "readgroup:rg1\tplatform:illumina\tmap:" << TEST_BAMS[0].path
+            << "\treadlen:90.00\tlib:lib1\tnum:10001\tlower:277.03\tupper:525.50"
+            << "\tmean:467.59\tstd:31.91\texe:samtools view\n";
+        return BamConfig(cfg, 3);
+    }
+
+    vector<string> read_names(IAlignmentBatchSource& src) {
+        vector<string> rv;
+        vector<Alignment::Ptr> alns;
+        while (src.next_batch(alns)) {
+            for (size_t i = 0; i < alns.size(); ++i)
+                rv.push_back(alns[i]->query_name());
+        }
+        return rv;
+    }
+}
+
+TEST(TestAlignmentPipeline, same_as_serial) {
+    BamConfig cfg = make_config();
+    NullClassifier classifier;
+    string const& path = TEST_BAMS[0].path;
+
+    BamReader<AlignmentFilter::True> serial_reader(path);
+    AlignmentSource serial(serial_reader, classifier, cfg, true);
+    vector<string> expected = read_names(serial);
+
+    EXPECT_EQ(TEST_BAMS[0].n_reads, expected.size());
+
+    // One combined stage, then separate decode and classify stages
+    size_t const workers[] = {1, AlignmentPipeline::MIN_WORKERS_FOR_TWO_STAGES};
+    for (size_t i = 0; i < 2; ++i) {
+        TaskExecutor executor(workers[i]);
+        BamReader<AlignmentFilter::True> threaded_reader(path);
+        AlignmentPipeline threaded(executor, threaded_reader, classifier, cfg, true, 2);
+        vector<string> observed = read_names(threaded);
+
+        EXPECT_EQ(expected, observed) << workers[i] << " workers";
+
+        // Stays finished
+        vector<Alignment::Ptr> alns;
+        EXPECT_EQ(0u, threaded.next_batch(alns));
+    }
+}
+
+TEST(TestAlignmentPipeline, rethrows_stage_errors) {
+    BamConfig cfg = make_config();
+    NullClassifier classifier;
+    BamReader<AlignmentFilter::True> reader(TEST_BAMS[0].path);
+    FailingReader failing(reader);
+
+    TaskExecutor executor(AlignmentPipeline::MIN_WORKERS_FOR_TWO_STAGES);
+    AlignmentPipeline src(executor, failing, classifier, cfg, false);
+    EXPECT_THROW(read_names(src), runtime_error);
+}
+
+TEST(TestAlignmentPipeline, early_destruction) {
+    BamConfig cfg = make_config();
+    NullClassifier classifier;
+    BamReader<AlignmentFilter::True> reader(TEST_BAMS[0].path);
+
+    // Destroying the pipeline with unread input must not hang
+    TaskExecutor executor(1);
+    AlignmentPipeline src(executor, reader, classifier, cfg, false, 1);
+    vector<Alignment::Ptr> alns;
+    EXPECT_GT(src.next_batch(alns), 0u);
+}
@@ -0,0 +1,181 @@
+#include "io/AsyncFileReader.hpp"
+#include "io/BgzfReader.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    IoOptions ioOptions(size_t depth, IoPolicy policy = IO_NORMAL) {
+        IoOptions rv;
+        rv.depth = depth;
+        rv.policy = policy;
+        return rv;
+    }
+}
+
+class TestAsyncFileReader : public ::testing::Test {
+public:
+    void SetUp() {
+        dir_ = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+        bfs::create_directory(dir_);
+        path_ = (dir_ / "data").native();
+        fd_ = -1;
+        // Not a multiple of any chunk size used below
+        writeData(1000003);
+    }
+
+    void TearDown() {
+        close(fd_);
+        bfs::remove_all(dir_);
+    }
+
+    void writeData(size_t size) {
+        if (fd_ >= 0)
+            close(fd_);
+        data_.resize(size);
+        uint32_t state = 1;
+        for (size_t i = 0; i < data_.size(); ++i) {
+            state = state * 1103515245 + 12345;
+            data_[i] = state >> 16;
+        }
+        FILE* fp = fopen(path_.c_str(), "wb");
+        fwrite(&data_[0], 1, data_.size(), fp);
+        fclose(fp);
+
+        fd_ = open(path_.c_str(), O_RDONLY);
+        ASSERT_GE(fd_, 0);
+    }
+
+    // Reads [offset, offset + n) and checks it against the file
+    void expectRead(AsyncFileReader& in, uint64_t offset, size_t n) {
+        vector<char> buf(n);
+        size_t expected = offset < data_.size() ? min(n, data_.size() - offset) : 0;
+        ASSERT_EQ(expected, in.read(&buf[0], n, offset))
+            << AsyncFileReader::name(in.backend()) << " at " << offset;
+        EXPECT_TRUE(equal(buf.begin(), buf.begin() + expected, data_.begin() + offset))
+            << AsyncFileReader::name(in.backend()) << " at " << offset;
+    }
+
+protected:
+    bfs::path dir_;
+    string path_;
+    vector<char> data_;
+    int fd_;
+};
+
+TEST_F(TestAsyncFileReader, backends) {
+    TaskExecutor executor(2);
+    vector<AsyncFileReader::Backend> backends = AsyncFileReader::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        AsyncFileReader in(fd_, path_, ioOptions(4), &executor, backends[i], 4096);
+        EXPECT_EQ(backends[i] == AsyncFileReader::SYNC ? 0u : 4u, in.depth());
+
+        // Front to back in pieces that straddle the chunks
+        for (uint64_t offset = 0; offset < data_.size(); offset += 3001)
+            expectRead(in, offset, 3001);
+        expectRead(in, data_.size(), 10);
+
+        // Seeks backwards and forwards
+        expectRead(in, 12345, 100000);
+        expectRead(in, 5, 10);
+        expectRead(in, 900000, 200000);
+        expectRead(in, 4096, 4096);
+    }
+}
+
+TEST_F(TestAsyncFileReader, fallback) {
+    // Threads with no pool to run them on read synchronously
+    AsyncFileReader no_pool(fd_, path_, ioOptions(4), 0, AsyncFileReader::THREADS);
+    EXPECT_EQ(AsyncFileReader::SYNC, no_pool.backend());
+
+    TaskExecutor executor(0);
+    AsyncFileReader no_workers(fd_, path_, ioOptions(4), &executor, AsyncFileReader::THREADS);
+    EXPECT_EQ(AsyncFileReader::SYNC, no_workers.backend());
+
+    AsyncFileReader no_depth(fd_, path_, ioOptions(0), 0, AsyncFileReader::IO_URING);
+    EXPECT_EQ(AsyncFileReader::SYNC, no_depth.backend());
+    expectRead(no_depth, 17, 500000);
+}
+
+TEST_F(TestAsyncFileReader, bams) {
+    TaskExecutor executor(1);
+    for (size_t i = 0; i < TEST_BAMS.size(); ++i) {
+        string const& path = TEST_BAMS[i].path;
+        BgzfReader expected(path);
+        vector<char> want(bfs::file_size(path) * 10);
+        want.resize(expected.read(&want[0], want.size()));
+
+        BgzfReader in(path, false, BgzfInflater::default_backend(), ioOptions(3), &executor);
+        EXPECT_EQ(3u, in.file().depth());
+        vector<char> got(want.size() + 1);
+        EXPECT_EQ(want.size(), in.read(&got[0], got.size()));
+        got.resize(want.size());
+        EXPECT_EQ(want, got);
+    }
+}
+
+TEST_F(TestAsyncFileReader, stream) {
+    writeData(3 * AsyncFileReader::DROP_BEHIND + 12345);
+    TaskExecutor executor(1);
+    vector<AsyncFileReader::Backend> backends = AsyncFileReader::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        AsyncFileReader in(fd_, path_, ioOptions(2, IO_STREAM), &executor, backends[i]);
+        EXPECT_EQ(IO_STREAM, in.policy());
+        for (uint64_t offset = 0; offset < data_.size(); offset += 65536)
+            expectRead(in, offset, 65536);
+        EXPECT_EQ(data_.size(), in.bytes_read());
+        // All but about the last DROP_BEHIND bytes
+        EXPECT_GE(in.bytes_dropped(), data_.size() - 2 * AsyncFileReader::DROP_BEHIND)
+            << AsyncFileReader::name(backends[i]);
+        EXPECT_LE(in.bytes_dropped(), data_.size());
+
+        // Going back starts dropping over again
+        expectRead(in, 0, 100);
+    }
+}
+
+TEST_F(TestAsyncFileReader, direct) {
+    TaskExecutor executor(1);
+    vector<AsyncFileReader::Backend> backends = AsyncFileReader::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        for (size_t depth = 0; depth < 3; depth += 2) {
+            AsyncFileReader in(fd_, path_, ioOptions(depth, IO_DIRECT), &executor, backends[i], 10000);
+            // As IO_STREAM where the file system (tmpfs) refuses O_DIRECT
+            EXPECT_NE(IO_NORMAL, in.policy());
+            // Unaligned reads of every size
+            for (uint64_t offset = 0; offset < data_.size(); offset += 3001)
+                expectRead(in, offset, 3001);
+            expectRead(in, 12345, 100000);
+            expectRead(in, 1, 1);
+            expectRead(in, data_.size() - 1, 4096);
+        }
+    }
+}
+
+TEST(IoPolicy, names) {
+    EXPECT_EQ(IO_NORMAL, parse_io_policy("normal"));
+    EXPECT_EQ(IO_STREAM, parse_io_policy("stream"));
+    EXPECT_EQ(IO_DIRECT, parse_io_policy("direct"));
+    EXPECT_THROW(parse_io_policy("fast"), runtime_error);
+    for (int i = IO_NORMAL; i <= IO_DIRECT; ++i)
+        EXPECT_EQ(IoPolicy(i), parse_io_policy(io_policy_name(IoPolicy(i))));
+
+    EXPECT_EQ(0u, IoOptions().depth);
+    EXPECT_EQ(IO_NORMAL, IoOptions().policy);
+}
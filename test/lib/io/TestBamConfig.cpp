@@ -108,3 +108,40 @@ TEST_F(TestConfig, missingBam) {
 
     ASSERT_THROW(BamConfig(cfgss, _cut_sd), runtime_error);
 }
+
+TEST_F(TestConfig, sampleRoles) {
+    BamConfig plain(_cfg_stream, _cut_sd);
+    EXPECT_FALSE(plain.has_sample_roles());
+    EXPECT_EQ(ROLE_NONE, plain.library_config(0).role);
+
+    stringstream cfgss(
+        "map:x.bam\tlib:lib1\treadlen:90\tmean:467.59\tstd:31.91\trole:Tumour\n"
+        "map:y.bam\tlib:lib2\treadlen:90\tmean:475.76\tstd:28.67\trole:normal\n"
+        );
+    BamConfig cfg(cfgss, _cut_sd);
+    EXPECT_TRUE(cfg.has_sample_roles());
+    EXPECT_EQ(ROLE_TUMOR, cfg.library_config("lib1").role);
+    EXPECT_EQ(ROLE_NORMAL, cfg.library_config("lib2").role);
+}
+
+TEST_F(TestConfig, invalidSampleRoles) {
+    // Unknown role
+    stringstream bad_role(
+        "map:x.bam\tlib:lib1\treadlen:90\tmean:467.59\tstd:31.91\trole:blood\n"
+        );
+    EXPECT_THROW(BamConfig(bad_role, _cut_sd), runtime_error);
+
+    // Only some libraries have roles
+    stringstream partial(
+        "map:x.bam\tlib:lib1\treadlen:90\tmean:467.59\tstd:31.91\trole:tumor\n"
+        "map:y.bam\tlib:lib2\treadlen:90\tmean:475.76\tstd:28.67\n"
+        );
+    EXPECT_THROW(BamConfig(partial, _cut_sd), runtime_error);
+
+    // No normal
+    stringstream tumor_only(
+        "map:x.bam\tlib:lib1\treadlen:90\tmean:467.59\tstd:31.91\trole:tumor\n"
+        "map:y.bam\tlib:lib2\treadlen:90\tmean:475.76\tstd:28.67\trole:tumor\n"
+        );
+    EXPECT_THROW(BamConfig(tumor_only, _cut_sd), runtime_error);
+}
@@ -0,0 +1,230 @@
+#include "io/BamIndex.hpp"
+
+#include "io/BamWriter.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    // Names of the reads overlapping tid:beg-end
+    vector<string> query(bamFile in, bam_index_t* index, int tid, int beg, int end) {
+        vector<string> rv;
+        bam1_t* b = bam_init1();
+        bam_iter_t iter = bam_iter_query(index, tid, beg, end);
+        while (bam_iter_read(in, iter, b) > 0)
+            rv.push_back(bam1_qname(b));
+        bam_iter_destroy(iter);
+        bam_destroy1(b);
+        return rv;
+    }
+}
+
+class TestBamIndex : public ::testing::TestWithParam<BamInfo> {
+public:
+    void SetUp() {
+        dir_ = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+        bfs::create_directory(dir_);
+        bamPath_ = (dir_ / "reads.bam").native();
+        bfs::copy_file(GetParam().path, bamPath_);
+    }
+
+    void TearDown() {
+        bfs::remove_all(dir_);
+    }
+
+protected:
+    bfs::path dir_;
+    string bamPath_;
+};
+
+INSTANTIATE_TEST_CASE_P(RC, TestBamIndex, ::testing::ValuesIn(TEST_BAMS));
+
+TEST_P(TestBamIndex, matchesSamtools) {
+    bam_index_t* expected = bam_index_load(GetParam().path.c_str());
+    ASSERT_TRUE(expected);
+    bamFile in = bam_open(bamPath_.c_str(), "r");
+    bam_header_t* header = bam_header_read(in);
+
+    // Pieces smaller than a block, a few blocks each, and the whole file;
+    // serially and in parallel
+    size_t chunk_sizes[] = { 1000, 20000, BAM_INDEX_CHUNK_SIZE };
+    for (size_t workers = 0; workers < 3; workers += 2) {
+        TaskExecutor executor(workers);
+        for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++i) {
+            build_bam_index(bamPath_, bamPath_ + ".bai", executor, chunk_sizes[i]);
+            bam_index_t* index = load_bam_index(bamPath_);
+            ASSERT_TRUE(index);
+
+            for (int tid = 0; tid < header->n_targets; ++tid) {
+                int len = header->target_len[tid];
+                EXPECT_EQ(query(in, expected, tid, 0, len), query(in, index, tid, 0, len));
+                for (int beg = 0; beg < 48000000 && beg < len; beg += 250000) {
+                    EXPECT_EQ(query(in, expected, tid, beg, beg + 300000),
+                        query(in, index, tid, beg, beg + 300000))
+                        << "chunk size " << chunk_sizes[i] << ", " << tid << ":" << beg;
+                }
+            }
+            bam_index_destroy(index);
+        }
+    }
+
+    bam_header_destroy(header);
+    bam_close(in);
+    bam_index_destroy(expected);
+}
+
+TEST_P(TestBamIndex, cache) {
+    // Where it goes when the bam's directory is not writable
+    string prefix = bam_index_cache_prefix(bamPath_);
+    EXPECT_NE(bamPath_, prefix);
+    TaskExecutor executor(0);
+    build_bam_index(bamPath_, prefix + ".bai", executor);
+    EXPECT_EQ(prefix, find_bam_index(bamPath_));
+
+    bam_index_t* index = load_bam_index(bamPath_);
+    EXPECT_TRUE(index);
+    bam_index_destroy(index);
+    bfs::remove(prefix + ".bai");
+}
+
+TEST_P(TestBamIndex, ensure) {
+    EXPECT_EQ("", find_bam_index(bamPath_));
+    EXPECT_FALSE(load_bam_index(bamPath_));
+
+    TaskExecutor executor(0);
+    vector<string> paths(2, bamPath_);
+    ensure_bam_indexes(paths, executor);
+    EXPECT_TRUE(bfs::exists(bamPath_ + ".bai"));
+    EXPECT_EQ(bamPath_, find_bam_index(bamPath_));
+
+    bam_index_t* index = load_bam_index(bamPath_);
+    EXPECT_TRUE(index);
+    bam_index_destroy(index);
+}
+
+TEST(BamIndex, longRecords) {
+    bfs::path dir = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+    bfs::create_directory(dir);
+    string path = (dir / "long.bam").native();
+
+    // Every fifth read is longer than a bgzf block holds, so some pieces
+    // have no record starting in them and some guesses have to be redone
+    bam_header_t* header = bam_header_init();
+    header->n_targets = 1;
+    header->target_len = (uint32_t*)malloc(sizeof(uint32_t));
+    header->target_len[0] = 1000000;
+    header->target_name = (char**)malloc(sizeof(char*));
+    header->target_name[0] = strdup("1");
+    {
+        BamWriter writer(path, header);
+        bam1_t* b = bam_init1();
+        uint32_t state = 1;
+        for (int i = 0; i < 40; ++i) {
+            int32_t len = i % 5 == 0 ? 100000 : 100;
+            string name = "r" + boost::lexical_cast<string>(i);
+            b->core.tid = 0;
+            b->core.pos = 1000 * i;
+            b->core.bin = bam_reg2bin(b->core.pos, b->core.pos + len);
+            b->core.qual = 60;
+            b->core.l_qname = name.size() + 1;
+            b->core.flag = 0;
+            b->core.n_cigar = 1;
+            b->core.l_qseq = len;
+            b->core.mtid = -1;
+            b->core.mpos = -1;
+            b->data_len = b->core.l_qname + 4 + (len + 1) / 2 + len;
+            b->m_data = b->data_len;
+            b->data = (uint8_t*)realloc(b->data, b->m_data);
+            memcpy(b->data, name.c_str(), b->core.l_qname);
+            uint32_t cigar = len << BAM_CIGAR_SHIFT | BAM_CMATCH;
+            memcpy(bam1_cigar(b), &cigar, 4);
+            // Noise, so the long reads do not compress to nothing
+            uint8_t* seq = bam1_seq(b);
+            for (int32_t j = 0; j < (len + 1) / 2 + len; ++j) {
+                state = state * 1103515245 + 12345;
+                seq[j] = state >> 16;
+            }
+            writer.write(b);
+        }
+        bam_destroy1(b);
+        writer.close();
+    }
+    bam_header_destroy(header);
+
+    ASSERT_EQ(0, bam_index_build(path.c_str()));
+    bam_index_t* expected = bam_index_load(path.c_str());
+    ASSERT_TRUE(expected);
+    bfs::remove(path + ".bai");
+    bamFile in = bam_open(path.c_str(), "r");
+
+    size_t chunk_sizes[] = { 1000, 5000 };
+    for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++i) {
+        TaskExecutor executor(2);
+        build_bam_index(path, path + ".bai", executor, chunk_sizes[i]);
+        bam_index_t* index = load_bam_index(path);
+        ASSERT_TRUE(index);
+        for (int beg = 0; beg < 135000; beg += 5000) {
+            vector<string> names = query(in, index, 0, beg, beg + 5000);
+            EXPECT_FALSE(names.empty());
+            EXPECT_EQ(query(in, expected, 0, beg, beg + 5000), names)
+                << "chunk size " << chunk_sizes[i] << ", " << beg;
+        }
+        bam_index_destroy(index);
+    }
+
+    bam_close(in);
+    bam_index_destroy(expected);
+    bfs::remove_all(dir);
+}
+
+TEST(BamIndex, unsorted) {
+    bfs::path dir = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+    bfs::create_directory(dir);
+    string path = (dir / "unsorted.bam").native();
+
+    bam_header_t* header = bam_header_init();
+    header->n_targets = 1;
+    header->target_len = (uint32_t*)malloc(sizeof(uint32_t));
+    header->target_len[0] = 100000;
+    header->target_name = (char**)malloc(sizeof(char*));
+    header->target_name[0] = strdup("1");
+    {
+        BamWriter writer(path, header);
+        bam1_t* b = bam_init1();
+        for (int i = 0; i < 2; ++i) {
+            b->core.tid = 0;
+            b->core.pos = 5000 - 1000 * i;
+            b->core.bin = bam_reg2bin(b->core.pos, b->core.pos + 1);
+            b->core.flag = BAM_FUNMAP;
+            b->core.l_qname = 2;
+            b->core.mtid = -1;
+            b->core.mpos = -1;
+            b->data_len = b->m_data = 2;
+            b->data = (uint8_t*)realloc(b->data, 2);
+            memcpy(b->data, "r", 2);
+            writer.write(b);
+        }
+        bam_destroy1(b);
+        writer.close();
+    }
+    bam_header_destroy(header);
+
+    TaskExecutor executor(0);
+    EXPECT_THROW(build_bam_index(path, path + ".bai", executor), runtime_error);
+    EXPECT_FALSE(bfs::exists(path + ".bai"));
+    bfs::remove_all(dir);
+}
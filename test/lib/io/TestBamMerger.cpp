@@ -45,3 +45,38 @@ TEST(TestBamMerger, read_count) {
 }
 
 
+
+TEST(TestBamMerger, next_batch_matches_next) {
+    vector< boost::shared_ptr<BamReaderBase> > spReaders;
+    vector<BamReaderBase*> readers;
+    vector< boost::shared_ptr<BamReaderBase> > spBatchReaders;
+    vector<BamReaderBase*> batchReaders;
+
+    for (size_t i = 0; i < TEST_BAMS.size(); ++i) {
+        boost::shared_ptr<BamReaderBase> p(new BamReader<AlignmentFilter::True>(TEST_BAMS[i].path));
+        spReaders.push_back(p);
+        readers.push_back(p.get());
+        boost::shared_ptr<BamReaderBase> q(new BamReader<AlignmentFilter::True>(TEST_BAMS[i].path));
+        spBatchReaders.push_back(q);
+        batchReaders.push_back(q.get());
+    }
+
+    BamMerger reader(readers);
+    BamMerger batchReader(batchReaders);
+
+    // Deliberately small and not a divisor of the read counts
+    RecordBatch batch(7);
+    RawBamEntry b;
+    size_t n_reads = 0;
+    while (batchReader.next_batch(batch)) {
+        for (size_t i = 0; i < batch.size(); ++i, ++n_reads) {
+            ASSERT_GT(reader.next(b), 0);
+            EXPECT_EQ(b->core.tid, batch[i]->core.tid);
+            EXPECT_EQ(b->core.pos, batch[i]->core.pos);
+            EXPECT_STREQ(bam1_qname(b), bam1_qname(batch[i]));
+        }
+    }
+
+    EXPECT_LE(reader.next(b), 0);
+    EXPECT_GT(n_reads, 0u);
+}
@@ -0,0 +1,110 @@
+#include "io/BamRecordView.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+    // Builds a record named "r1" with no cigar or sequence and the given aux
+    // data.
+    void make_record(bam1_t* b, vector<uint8_t>& data, string const& aux) {
+        memset(b, 0, sizeof(*b));
+        string const name("r1");
+        data.assign(name.begin(), name.end());
+        data.push_back(0);
+        data.insert(data.end(), aux.begin(), aux.end());
+        b->core.l_qname = name.size() + 1;
+        b->core.qual = 17;
+        b->l_aux = aux.size();
+        b->data_len = data.size();
+        b->m_data = data.size();
+        b->data = &data[0];
+    }
+}
+
+TEST(TestBamRecordView, finds_tags_in_one_pass) {
+    // B array and an H string before the tags we want, and a duplicate AM
+    // that should be ignored in favour of the first.
+    static char const aux_data[] =
+        "XBBC\x03\x00\x00\x00\x01\x02\x03"
+        "XHH0A\x00"
+        "MQC\x2a"
+        "AMC\x25"
+        "RGZrg3\x00"
+        "AMC\x01";
+    string aux(aux_data, sizeof(aux_data) - 1);
+
+    bam1_t b;
+    vector<uint8_t> data;
+    make_record(&b, data, aux);
+
+    BamRecordView view(&b);
+    EXPECT_STREQ("r1", view.query_name());
+    ASSERT_TRUE(view.has_alt_qual());
+    EXPECT_EQ(0x25, view.alt_qual());
+    ASSERT_TRUE(view.has_mate_qual());
+    EXPECT_EQ(0x2a, view.mate_qual());
+    ASSERT_TRUE(view.read_group() != 0);
+    EXPECT_EQ("rg3", string(view.read_group(), view.read_group_length()));
+
+    // Agrees with samtools
+    EXPECT_EQ(bam_aux2i(bam_aux_get(&b, "AM")), view.alt_qual());
+    EXPECT_EQ(bam_aux2i(bam_aux_get(&b, "MQ")), view.mate_qual());
+}
+
+TEST(TestBamRecordView, missing_tags) {
+    bam1_t b;
+    vector<uint8_t> data;
+    make_record(&b, data, string("XIi\x01\x00\x00\x00", 7));
+
+    BamRecordView view(&b);
+    EXPECT_FALSE(view.has_alt_qual());
+    EXPECT_FALSE(view.has_mate_qual());
+    EXPECT_TRUE(view.read_group() == 0);
+    EXPECT_EQ(0u, view.read_group_length());
+}
+
+TEST(TestBamRecordView, truncated_aux) {
+    bam1_t b;
+    vector<uint8_t> data;
+    // RG string is missing its terminator
+    make_record(&b, data, string("AMC\x05RGZrg", 9));
+
+    BamRecordView view(&b);
+    ASSERT_TRUE(view.has_alt_qual());
+    EXPECT_EQ(5, view.alt_qual());
+    EXPECT_TRUE(view.read_group() == 0);
+}
+
+TEST(TestBamRecordView, corrupt_array) {
+    bam1_t b;
+    vector<uint8_t> data;
+
+    // More elements than there are bytes left
+    make_record(&b, data, string("XBBC\x04\x00\x00\x00\x01\x02\x03", 11));
+    EXPECT_THROW(BamRecordView view(&b), runtime_error);
+
+    // A count that only fits if it wraps around
+    make_record(&b, data, string("XBBi\x00\x00\x00\x40\x01\x02\x03\x04", 12));
+    EXPECT_THROW(BamRecordView view(&b), runtime_error);
+
+    // Negative count
+    make_record(&b, data, string("XBBC\xff\xff\xff\xff\x01", 9));
+    EXPECT_THROW(BamRecordView view(&b), runtime_error);
+
+    // Element types that arrays do not have
+    make_record(&b, data, string("XBBA\x01\x00\x00\x00\x01", 9));
+    EXPECT_THROW(BamRecordView view(&b), runtime_error);
+    make_record(&b, data, string("XBBZ\x01\x00\x00\x00\x01", 9));
+    EXPECT_THROW(BamRecordView view(&b), runtime_error);
+
+    // An array that ends exactly at the end of the record is fine
+    make_record(&b, data, string("AMC\x05XBBs\x02\x00\x00\x00\x01\x00\x02\x00", 16));
+    BamRecordView view(&b);
+    EXPECT_EQ(5, view.alt_qual());
+}
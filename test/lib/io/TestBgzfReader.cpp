@@ -0,0 +1,222 @@
+#include "io/BgzfReader.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    // The whole decompressed stream, as samtools reads it
+    string readSamtools(string const& path) {
+        string rv;
+        BGZF* in = bgzf_open(path.c_str(), "r");
+        char buf[4096];
+        int n;
+        while ((n = bgzf_read(in, buf, sizeof(buf))) > 0)
+            rv.append(buf, n);
+        bgzf_close(in);
+        return rv;
+    }
+
+    string readAll(BgzfReader& in, size_t chunk) {
+        string rv;
+        vector<char> buf(chunk);
+        size_t n;
+        while ((n = in.read(&buf[0], chunk)) > 0)
+            rv.append(&buf[0], n);
+        return rv;
+    }
+
+    vector<unsigned char> slurp(string const& path) {
+        vector<unsigned char> rv(bfs::file_size(path));
+        FILE* fp = fopen(path.c_str(), "rb");
+        EXPECT_EQ(rv.size(), fread(&rv[0], 1, rv.size(), fp));
+        fclose(fp);
+        return rv;
+    }
+
+    void spew(string const& path, vector<unsigned char> const& data) {
+        FILE* fp = fopen(path.c_str(), "wb");
+        fwrite(&data[0], 1, data.size(), fp);
+        fclose(fp);
+    }
+}
+
+class TestBgzfReader : public ::testing::TestWithParam<BamInfo> {
+public:
+    void SetUp() {
+        dir_ = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+        bfs::create_directory(dir_);
+    }
+
+    void TearDown() {
+        bfs::remove_all(dir_);
+    }
+
+protected:
+    bfs::path dir_;
+};
+
+INSTANTIATE_TEST_CASE_P(RC, TestBgzfReader, ::testing::ValuesIn(TEST_BAMS));
+
+TEST_P(TestBgzfReader, matchesSamtools) {
+    string const& path = GetParam().path;
+    string expected = readSamtools(path);
+    ASSERT_FALSE(expected.empty());
+
+    vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        for (int verify = 0; verify < 2; ++verify) {
+            BgzfReader in(path, verify, backends[i]);
+            EXPECT_EQ(backends[i], in.inflater().backend());
+            EXPECT_EQ(expected, readAll(in, 7))
+                << BgzfInflater::name(backends[i]) << ", verify " << verify;
+
+            BgzfReader whole(path, verify, backends[i]);
+            EXPECT_EQ(expected, readAll(whole, 1 << 20));
+        }
+    }
+}
+
+TEST_P(TestBgzfReader, tellAndSeek) {
+    string const& path = GetParam().path;
+    BGZF* expected = bgzf_open(path.c_str(), "r");
+    BgzfReader in(path);
+
+    // Offsets of every thousandth byte, crossing many block boundaries
+    vector<int64_t> offsets;
+    char buf[1000];
+    char observed[1000];
+    while (bgzf_read(expected, buf, sizeof(buf)) == int(sizeof(buf))) {
+        ASSERT_EQ(sizeof(buf), in.read(observed, sizeof(observed)));
+        ASSERT_EQ(string(buf, sizeof(buf)), string(observed, sizeof(observed)));
+        EXPECT_EQ(uint64_t(bgzf_tell(expected)), in.tell());
+        offsets.push_back(bgzf_tell(expected));
+    }
+    ASSERT_GT(offsets.size(), 10u);
+
+    // Backwards, so that every seek moves to another place
+    for (size_t i = offsets.size() - 2; i > 0; i -= 3) {
+        bgzf_seek(expected, offsets[i], SEEK_SET);
+        in.seek(offsets[i]);
+        EXPECT_EQ(uint64_t(offsets[i]), in.tell());
+        ASSERT_EQ(int(sizeof(buf)), bgzf_read(expected, buf, sizeof(buf)));
+        ASSERT_EQ(sizeof(buf), in.read(observed, sizeof(observed)));
+        EXPECT_EQ(string(buf, sizeof(buf)), string(observed, sizeof(observed)));
+        if (i < 3)
+            break;
+    }
+    bgzf_close(expected);
+}
+
+TEST_P(TestBgzfReader, records) {
+    string const& path = GetParam().path;
+    bamFile expected_in = bam_open(path.c_str(), "r");
+    bam_header_t* header = bam_header_read(expected_in);
+    BgzfReader in(path);
+    in.seek(bam_tell(expected_in));
+
+    bam1_t* expected = bam_init1();
+    bam1_t* observed = bam_init1();
+    size_t n = 0;
+    while (bam_read1(expected_in, expected) > 0) {
+        ASSERT_GT(read_bam_record(in, observed), 0);
+        EXPECT_EQ(0, memcmp(&expected->core, &observed->core, sizeof(bam1_core_t)));
+        EXPECT_EQ(expected->data_len, observed->data_len);
+        EXPECT_EQ(expected->l_aux, observed->l_aux);
+        EXPECT_EQ(0, memcmp(expected->data, observed->data, expected->data_len));
+        ++n;
+    }
+    EXPECT_EQ(0, read_bam_record(in, observed));
+    EXPECT_EQ(GetParam().n_reads, n);
+
+    bam_destroy1(expected);
+    bam_destroy1(observed);
+    bam_header_destroy(header);
+    bam_close(expected_in);
+}
+
+TEST_P(TestBgzfReader, badCrc) {
+    vector<unsigned char> data = slurp(GetParam().path);
+    size_t size = BgzfInflater::block_size(&data[0]);
+    ASSERT_GT(size, 0u);
+    // The first byte of the first block's crc32
+    data[size - BgzfInflater::BLOCK_FOOTER_SIZE] ^= 0xff;
+    string path = (dir_ / "bad-crc.bam").native();
+    spew(path, data);
+
+    vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        BgzfReader in(path, false, backends[i]);
+        EXPECT_EQ(readSamtools(GetParam().path), readAll(in, 4096));
+
+        BgzfReader verifying(path, true, backends[i]);
+        char c;
+        EXPECT_THROW(verifying.read(&c, 1), runtime_error)
+            << BgzfInflater::name(backends[i]);
+    }
+}
+
+TEST_P(TestBgzfReader, corrupt) {
+    vector<unsigned char> data = slurp(GetParam().path);
+    size_t size = BgzfInflater::block_size(&data[0]);
+    ASSERT_GT(size, 0u);
+    // Zeroed deflate data is a stored block with a bad length
+    for (size_t i = BgzfInflater::BLOCK_HEADER_SIZE; i < size - BgzfInflater::BLOCK_FOOTER_SIZE; ++i)
+        data[i] = 0;
+    string corrupt = (dir_ / "corrupt.bam").native();
+    spew(corrupt, data);
+
+    vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        BgzfReader in(corrupt, false, backends[i]);
+        char c;
+        EXPECT_THROW(in.read(&c, 1), runtime_error) << BgzfInflater::name(backends[i]);
+    }
+
+    // Cut off in the middle of a block
+    data = slurp(GetParam().path);
+    data.resize(size + 100);
+    string truncated = (dir_ / "truncated.bam").native();
+    spew(truncated, data);
+    BgzfReader in(truncated);
+    EXPECT_THROW(readAll(in, 4096), runtime_error);
+}
+
+TEST(BgzfInflater, backends) {
+    vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+    ASSERT_FALSE(backends.empty());
+    EXPECT_EQ(BgzfInflater::ZLIB, backends[0]);
+    EXPECT_EQ(string("zlib"), BgzfInflater::name(BgzfInflater::ZLIB));
+    EXPECT_EQ(string("libdeflate"), BgzfInflater::name(BgzfInflater::LIBDEFLATE));
+#ifndef BD_HAVE_LIBDEFLATE
+    EXPECT_THROW(BgzfInflater inflater(BgzfInflater::LIBDEFLATE), runtime_error);
+#endif
+}
+
+TEST(BgzfInflater, emptyBlock) {
+    // The block every bam ends with, inflated into no buffer at all
+    static unsigned char const eof[] = {
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+        0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+    ASSERT_EQ(sizeof(eof), BgzfInflater::block_size(eof));
+
+    vector<BgzfInflater::Backend> backends = BgzfInflater::available_backends();
+    for (size_t i = 0; i < backends.size(); ++i) {
+        BgzfInflater inflater(backends[i], true);
+        EXPECT_EQ(0u, inflater.inflate(eof, sizeof(eof), 0, 0))
+            << BgzfInflater::name(backends[i]);
+    }
+}
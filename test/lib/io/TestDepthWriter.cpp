@@ -0,0 +1,119 @@
+#include "io/DepthWriter.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    string read_file(string const& path) {
+        ifstream in(path.c_str(), ios::binary);
+        stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    uint32_t u32_at(string const& data, size_t offset) {
+        uint32_t rv = 0;
+        for (int i = 0; i < 4; ++i)
+            rv |= uint32_t(uint8_t(data[offset + i])) << (8 * i);
+        return rv;
+    }
+}
+
+class TestDepthWriter : public ::testing::Test {
+public:
+    void SetUp() {
+        _prefix = (bfs::temp_directory_path()
+            / bfs::unique_path("breakdancer-unit-test%%%%-%%%%-%%%%-%%%%")).native();
+
+        _header = bam_header_init();
+        _header->n_targets = 2;
+        _header->target_name = (char**)malloc(2 * sizeof(char*));
+        _header->target_name[0] = strdup("1");
+        _header->target_name[1] = strdup("2");
+        _header->target_len = (uint32_t*)malloc(2 * sizeof(uint32_t));
+        _header->target_len[0] = 2500;
+        _header->target_len[1] = 900;
+
+        _libs.push_back("libA");
+        _libs.push_back("libB");
+    }
+
+    void TearDown() {
+        bam_header_destroy(_header);
+        for (size_t i = 0; i < _libs.size(); ++i) {
+            bfs::remove(_prefix + "." + _libs[i] + ".bedGraph");
+            bfs::remove(_prefix + "." + _libs[i] + ".depth");
+        }
+    }
+
+    void add_reads(DepthWriter& writer) {
+        writer.add(0, 0, 10);
+        writer.add(1, 0, 20);
+        writer.add(0, 0, 999);
+        writer.add(0, 0, 2400, 3);
+        writer.add(0, 1, 5);
+        writer.add(1, 1, 850, 2);
+    }
+
+protected:
+    string _prefix;
+    bam_header_t* _header;
+    vector<string> _libs;
+};
+
+TEST_F(TestDepthWriter, bedGraph) {
+    DepthWriter writer(_prefix, _libs, _header, 1000, false);
+    add_reads(writer);
+    writer.close();
+
+    EXPECT_EQ(
+        "1\t0\t1000\t2\n"
+        "1\t2000\t2500\t3\n"
+        "2\t0\t900\t1\n",
+        read_file(_prefix + ".libA.bedGraph"));
+
+    EXPECT_EQ(
+        "1\t0\t1000\t1\n"
+        "2\t0\t900\t2\n",
+        read_file(_prefix + ".libB.bedGraph"));
+}
+
+TEST_F(TestDepthWriter, binary) {
+    DepthWriter writer(_prefix, _libs, _header, 1000, true);
+    add_reads(writer);
+    writer.close();
+
+    string data = read_file(_prefix + ".libA.depth");
+    ASSERT_EQ("BDDP", data.substr(0, 4));
+    EXPECT_EQ(1u, u32_at(data, 4));
+    EXPECT_EQ(1000u, u32_at(data, 8));
+    EXPECT_EQ(2u, u32_at(data, 12));
+    // Sequence names "1" and "2"
+    EXPECT_EQ(1u, u32_at(data, 16));
+    EXPECT_EQ('1', data[20]);
+    EXPECT_EQ(1u, u32_at(data, 21));
+    EXPECT_EQ('2', data[25]);
+
+    size_t records = 26;
+    ASSERT_EQ(records + 3 * 12, data.size());
+    uint32_t expected[3][3] = {{0, 0, 2}, {0, 2, 3}, {1, 0, 1}};
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            EXPECT_EQ(expected[i][j], u32_at(data, records + 12 * i + 4 * j));
+    }
+}
+
+TEST_F(TestDepthWriter, badBinSize) {
+    EXPECT_THROW(DepthWriter(_prefix, _libs, _header, 0, false), runtime_error);
+}
@@ -0,0 +1,198 @@
+#include "io/EvidenceFile.hpp"
+#include "io/Alignment.hpp"
+#include "io/AlignmentBuilder.hpp"
+#include "io/BamConfig.hpp"
+#include "io/BamIo.hpp"
+#include "io/IlluminaPEReadClassifier.hpp"
+#include "io/RawBamEntry.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    std::string tempPath(std::string const& prefix, std::string const& suffix) {
+        bfs::path tmpdir = bfs::temp_directory_path();
+        std::string tmpl(prefix);
+        tmpl += "%%%%-%%%%-%%%%-%%%%";
+        tmpl += suffix;
+        bfs::path rv = tmpdir / bfs::unique_path(tmpl);
+        return rv.native();
+    }
+
+    std::string samData =
+        "@HD\tVN:1.0\tGO:none\tSO:coordinate\n"
+        "@SQ\tSN:21\tLN:46944323\n"
+        "P1\t99\t21\t10\t60\t10M\t=\t15\t15\tGTTTTTTTTT\tHHHHHHHHHH\n"
+        "P1\t147\t21\t15\t60\t10M\t=\t10\t-15\tGCCCCTTTTT\tHHHHHHHHHH\n"
+        "P2\t97\t21\t20\t60\t10M\t=\t900\t890\tTGTTTTTTTT\tHHHHHHHHHH\n"
+        "P3\t99\t21\t30\t60\t10M\t=\t35\t15\tTTGTTTTTTT\tHHHHHHHHHH\n"
+        "P3\t147\t21\t35\t60\t10M\t=\t30\t-15\tCCGCCTTTTT\tHHHHHHHHHH\n"
+        ;
+
+    EvidenceSummary make_summary() {
+        EvidenceSummary summary;
+        summary.bin_size = 100;
+        summary.covered_ref_len = 12345;
+        summary.read_count = 678;
+        LibraryFlagDistribution& lib = summary.libraries["lib1"];
+        lib.read_count = 9;
+        lib.read_counts_by_flag[ReadFlag::ARP_LARGE_INSERT] = 3;
+        lib.read_counts_by_flag[ReadFlag::ARP_CTX] = 4;
+        summary.libraries["lib2"].read_count = 1;
+        return summary;
+    }
+}
+
+class TestEvidenceFile : public ::testing::Test {
+public:
+    void SetUp() {
+        samPath_ = tempPath("breakdancer-unit-test", ".sam");
+        evidencePath_ = tempPath("breakdancer-unit-test", ".bde");
+        std::ofstream out(samPath_.c_str());
+        out << samData;
+        out.close();
+
+        reader.reset(openBam(samPath_));
+
+        boost::shared_ptr<RawBamEntry> entry(new RawBamEntry);
+        while (reader->next(*entry) > 0) {
+            rawEntries.push_back(entry);
+            entry.reset(new RawBamEntry);
+        }
+        ASSERT_EQ(5u, rawEntries.size());
+    }
+
+    void TearDown() {
+        bfs::remove(samPath_);
+        bfs::remove(evidencePath_);
+    }
+
+protected:
+    std::string samPath_;
+    std::string evidencePath_;
+    std::vector<boost::shared_ptr<RawBamEntry> > rawEntries;
+    boost::shared_ptr<BamReaderBase> reader;
+};
+
+TEST(EvidenceSummary, headerRoundTrip) {
+    EvidenceSummary summary = make_summary();
+
+    std::string text("@HD\tVN:1.0\n@CO\tsomething else\n");
+    summary.append_header_lines(text);
+
+    bam_header_t* header = bam_header_init();
+    header->l_text = text.size();
+    header->text = (char*)malloc(text.size() + 1);
+    memcpy(header->text, text.c_str(), text.size() + 1);
+
+    EvidenceSummary parsed;
+    ASSERT_TRUE(parsed.parse_header(header));
+    EXPECT_EQ(100, parsed.bin_size);
+    EXPECT_EQ(12345u, parsed.covered_ref_len);
+    EXPECT_EQ(678u, parsed.read_count);
+    EXPECT_EQ(summary.libraries, parsed.libraries);
+    bam_header_destroy(header);
+}
+
+TEST(EvidenceSummary, notEvidence) {
+    std::string text("@HD\tVN:1.0\n@CO\tsomething else\n");
+    bam_header_t* header = bam_header_init();
+    header->l_text = text.size();
+    header->text = (char*)malloc(text.size() + 1);
+    memcpy(header->text, text.c_str(), text.size() + 1);
+
+    EvidenceSummary parsed;
+    EXPECT_FALSE(parsed.parse_header(header));
+    bam_header_destroy(header);
+}
+
+TEST(EvidenceSummary, path) {
+    EXPECT_EQ("out/x.sample1.bde", evidence_path("out/x", "/data/sample1.bam"));
+    EXPECT_EQ("x.reads.sam.gz.bde", evidence_path("x", "reads.sam.gz"));
+}
+
+TEST_F(TestEvidenceFile, writeAndReadBack) {
+    EvidenceWriter writer(evidencePath_, reader->header(), make_summary(), 2);
+    // P1 is a normal pair in library 1, counted around the discordant P2.
+    // P3 is counted after it, in a bin of its own.
+    writer.count_read(*rawEntries[0], 1, true, true);
+    writer.count_read(*rawEntries[1], 1, true, false);
+    writer.add_read(*rawEntries[2]);
+    writer.count_read(*rawEntries[3], 0, true, true);
+    writer.count_read(*rawEntries[4], 0, false, false); // counts nothing
+    writer.close();
+
+    boost::shared_ptr<BamReaderBase> evidence(openBam(evidencePath_));
+    EvidenceSummary summary;
+    ASSERT_TRUE(summary.parse_header(evidence->header()));
+    EXPECT_EQ(make_summary().libraries, summary.libraries);
+
+    std::vector<Alignment::Ptr> alns;
+    RawBamEntry entry;
+    while (evidence->next(entry) > 0) {
+        alns.emplace_back(new Alignment(entry));
+        alns.back()->set_read_counts(BamRecordView(entry));
+    }
+    ASSERT_EQ(4u, alns.size());
+
+    // Forward then reverse strand counts for P1, at its first read
+    EXPECT_TRUE(alns[0]->is_read_counts());
+    EXPECT_EQ(9, alns[0]->pos());
+    EXPECT_EQ(FWD, alns[0]->ori());
+    EXPECT_EQ(1, alns[0]->proper_pair_count());
+    EXPECT_EQ(1, alns[0]->normal_read_count());
+
+    EXPECT_TRUE(alns[1]->is_read_counts());
+    EXPECT_EQ(9, alns[1]->pos());
+    EXPECT_EQ(REV, alns[1]->ori());
+    EXPECT_EQ(1, alns[1]->proper_pair_count());
+    EXPECT_EQ(0, alns[1]->normal_read_count());
+
+    // The discordant read as it was
+    EXPECT_FALSE(alns[2]->is_read_counts());
+    EXPECT_EQ("P2", alns[2]->query_name());
+    EXPECT_EQ(19, alns[2]->pos());
+
+    EXPECT_TRUE(alns[3]->is_read_counts());
+    EXPECT_EQ(29, alns[3]->pos());
+    EXPECT_EQ(1, alns[3]->proper_pair_count());
+    EXPECT_EQ(1, alns[3]->normal_read_count());
+}
+
+TEST_F(TestEvidenceFile, countsOnlyFromEvidenceFiles) {
+    EvidenceWriter writer(evidencePath_, reader->header(), make_summary(), 1);
+    writer.count_read(*rawEntries[0], 0, true, true);
+    writer.close();
+
+    stringstream cfg_text;
+    cfg_text << "readgroup:rg1\tplatform:illumina\tmap:" << evidencePath_
+        << "\treadlen:10.00\tlib:lib1\tnum:10001\tlower:50.00\tupper:500.00"
+        << "\tmean:300.00\tstd:30.00\n";
+    BamConfig cfg(cfg_text, 3);
+    IlluminaPEReadClassifier classifier(cfg);
+
+    boost::shared_ptr<BamReaderBase> evidence(openBam(evidencePath_));
+    RawBamEntry entry;
+    ASSERT_GT(evidence->next(entry), 0);
+
+    // The same tags in a file not known to be an evidence file are just
+    // tags on a read
+    EXPECT_FALSE(AlignmentBuilder(classifier, cfg, false)(entry)->is_read_counts());
+
+    cfg.set_evidence_files(vector<bool>(1, true));
+    Alignment::Ptr aln = AlignmentBuilder(classifier, cfg, false)(entry);
+    EXPECT_TRUE(aln->is_read_counts());
+    EXPECT_EQ(1, aln->proper_pair_count());
+}
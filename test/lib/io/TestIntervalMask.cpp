@@ -0,0 +1,112 @@
+#include "io/IntervalMask.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class TestIntervalMask : public ::testing::Test {
+public:
+    void SetUp() {
+        header = bam_header_init();
+        header->n_targets = 2;
+        header->target_len = (uint32_t*)malloc(sizeof(uint32_t) * 2);
+        header->target_name = (char**)malloc(sizeof(char*) * 2);
+        header->target_len[0] = 1000000;
+        header->target_len[1] = 2000000;
+        header->target_name[0] = strdup("1");
+        header->target_name[1] = strdup("2");
+    }
+
+    void TearDown() {
+        bam_header_destroy(header);
+    }
+
+protected:
+    bam_header_t* header;
+};
+
+TEST_F(TestIntervalMask, parseAndMerge) {
+    stringstream bed(
+        "# comment\n"
+        "track name=blacklist\n"
+        "2\t500\t600\tsatellite\n"
+        "1\t100\t200\n"
+        "1\t150\t300\n"
+        "1\t300\t310\n"
+        "X\t0\t1000\n"
+        "2\t10\t20\n"
+        );
+    IntervalMask mask(bed, header);
+    EXPECT_FALSE(mask.empty());
+    EXPECT_EQ(3u, mask.size());
+
+    EXPECT_FALSE(mask.contains(0, 99));
+    EXPECT_TRUE(mask.contains(0, 100));
+    EXPECT_TRUE(mask.contains(0, 250));
+    EXPECT_TRUE(mask.contains(0, 309));
+    EXPECT_FALSE(mask.contains(0, 310));
+    EXPECT_EQ(310, mask.masked_until(0, 120));
+    EXPECT_EQ(400, mask.masked_until(0, 400));
+
+    EXPECT_TRUE(mask.contains(1, 10));
+    EXPECT_FALSE(mask.contains(1, 20));
+    EXPECT_TRUE(mask.contains(1, 599));
+    EXPECT_FALSE(mask.contains(1, 600));
+
+    EXPECT_FALSE(mask.contains(2, 10));
+    EXPECT_FALSE(mask.contains(-1, 10));
+}
+
+TEST_F(TestIntervalMask, add) {
+    IntervalMask mask;
+    EXPECT_TRUE(mask.empty());
+    mask.add(0, 100, 200);
+    mask.add(0, 200, 250);
+    mask.add(0, 50, 60);
+    mask.add(0, 300, 300); // empty
+    EXPECT_EQ(2u, mask.size());
+    EXPECT_TRUE(mask.contains(0, 55));
+    EXPECT_EQ(250, mask.masked_until(0, 100));
+    EXPECT_FALSE(mask.contains(0, 300));
+}
+
+TEST_F(TestIntervalMask, padding) {
+    stringstream bed(
+        "1\t100\t200\n"
+        "1\t190\t200\n"
+        "1\t450\t451\n"
+        "1\t999990\t1000000\n"
+        "2\t500\t500\n"
+        );
+    IntervalMask targets(bed, header, 50);
+
+    // Overlaps merged, and padding kept within the sequence
+    vector<IntervalMask::Interval> const& ivs = targets.intervals(0);
+    ASSERT_EQ(3u, ivs.size());
+    EXPECT_EQ(IntervalMask::Interval(50, 250), ivs[0]);
+    EXPECT_EQ(IntervalMask::Interval(400, 501), ivs[1]);
+    EXPECT_EQ(IntervalMask::Interval(999940, 1000000), ivs[2]);
+    EXPECT_EQ(4u, targets.size());
+
+    // An empty interval still covers its padding
+    ASSERT_EQ(1u, targets.intervals(1).size());
+    EXPECT_EQ(IntervalMask::Interval(450, 550), targets.intervals(1)[0]);
+
+    EXPECT_TRUE(targets.intervals(2).empty());
+    EXPECT_TRUE(targets.intervals(-1).empty());
+}
+
+TEST_F(TestIntervalMask, badLines) {
+    stringstream short_line("1\t100\n");
+    EXPECT_THROW(IntervalMask(short_line, header), runtime_error);
+
+    stringstream bad_number("1\t100\tabc\n");
+    EXPECT_THROW(IntervalMask(bad_number, header), runtime_error);
+}
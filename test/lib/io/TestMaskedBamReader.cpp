@@ -0,0 +1,112 @@
+#include "io/MaskedBamReader.hpp"
+#include "io/BamIo.hpp"
+#include "io/RecordBatch.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/shared_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    typedef vector<pair<int32_t, int32_t> > Positions;
+
+    Positions readAll(BamReaderBase& reader) {
+        Positions rv;
+        RecordBatch batch(16);
+        while (reader.next_batch(batch) > 0) {
+            for (size_t i = 0; i < batch.size(); ++i)
+                rv.push_back(make_pair(batch[i]->core.tid, batch[i]->core.pos));
+        }
+        return rv;
+    }
+
+    // Both test bams have reads around 21:29.18M and 21:34.8M
+    IntervalMask makeMask(string const& path) {
+        boost::shared_ptr<BamReaderBase> in(openBam(path));
+        stringstream bed(
+            "21\t29000000\t30000000\n"
+            "21\t34808000\t34808100\n"
+            );
+        return IntervalMask(bed, in->header());
+    }
+}
+
+class TestMaskedBamReader : public ::testing::TestWithParam<BamInfo> {
+};
+
+INSTANTIATE_TEST_CASE_P(Masked, TestMaskedBamReader, ::testing::ValuesIn(TEST_BAMS));
+
+TEST_P(TestMaskedBamReader, batches) {
+    string const& path = GetParam().path;
+    IntervalMask mask = makeMask(path);
+
+    boost::shared_ptr<BamReaderBase> plain(openBam(path));
+    Positions expected;
+    Positions all = readAll(*plain);
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (!mask.contains(all[i].first, all[i].second))
+            expected.push_back(all[i]);
+    }
+    ASSERT_LT(expected.size(), all.size());
+
+    boost::shared_ptr<BamReaderBase> in(openBam(path));
+    MaskedBamReader masked(*in, mask);
+    EXPECT_EQ(expected, readAll(masked));
+    // The test bams are indexed, so most of the megabase is never read
+    EXPECT_EQ(1u, masked.skip_count());
+    EXPECT_GT(masked.masked_count(), 0u);
+    EXPECT_LT(masked.masked_count(), all.size() - expected.size());
+}
+
+TEST_P(TestMaskedBamReader, records) {
+    string const& path = GetParam().path;
+    IntervalMask mask = makeMask(path);
+
+    boost::shared_ptr<BamReaderBase> plain(openBam(path));
+    boost::shared_ptr<BamReaderBase> in(openBam(path));
+    MaskedBamReader masked(*in, mask);
+
+    bam1_t* expected = bam_init1();
+    bam1_t* observed = bam_init1();
+    size_t n = 0;
+    while (plain->next(expected) > 0) {
+        if (mask.contains(expected->core.tid, expected->core.pos))
+            continue;
+        ASSERT_GT(masked.next(observed), 0);
+        EXPECT_EQ(expected->core.tid, observed->core.tid);
+        EXPECT_EQ(expected->core.pos, observed->core.pos);
+        EXPECT_STREQ(bam1_qname(expected), bam1_qname(observed));
+        ++n;
+    }
+    EXPECT_EQ(0, masked.next(observed));
+    EXPECT_LT(n, GetParam().n_reads);
+    EXPECT_GT(n, 0u);
+    bam_destroy1(expected);
+    bam_destroy1(observed);
+}
+
+TEST_P(TestMaskedBamReader, regionLimited) {
+    string const& path = GetParam().path;
+    IntervalMask mask = makeMask(path);
+
+    boost::shared_ptr<BamReaderBase> plain(openBam(path, "21:29100000-34900000"));
+    Positions expected;
+    Positions all = readAll(*plain);
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (!mask.contains(all[i].first, all[i].second))
+            expected.push_back(all[i]);
+    }
+    ASSERT_LT(expected.size(), all.size());
+
+    boost::shared_ptr<BamReaderBase> in(openBam(path, "21:29100000-34900000"));
+    MaskedBamReader masked(*in, mask);
+    EXPECT_EQ(expected, readAll(masked));
+}
@@ -122,3 +122,28 @@ TEST_P(TestRegionLimitedBamReader, read_count) {
 
 INSTANTIATE_TEST_CASE_P(RC, TestRegionLimitedBamReader,
     ::testing::ValuesIn(TEST_BAMS));
+
+TEST_P(TestRegionLimitedBamReader, set_region) {
+    string const& path = GetParam().path;
+    RegionCount rc = getTestRegion(path, 104);
+    string region = make_region(rc.seq, rc.begin + 1, rc.end + 1);
+
+    // Start out elsewhere on the sequence, then move to the region
+    RegionLimitedBamReader<AlignmentFilter::True> reader(path, rc.seq.c_str());
+    int tid = reader.tid();
+    ASSERT_TRUE(reader.set_region(tid, rc.begin, rc.end + 1));
+    EXPECT_EQ(path + " (region: " + region + ")", reader.description());
+
+    vector<string> observed_read_names;
+    RawBamEntry b;
+    while (reader.next(b) > 0)
+        observed_read_names.push_back(bam1_qname(b));
+    EXPECT_EQ(rc.read_names, observed_read_names);
+
+    // And back again, with the same index and handle
+    ASSERT_TRUE(reader.set_region(tid, rc.begin, rc.end + 1));
+    observed_read_names.clear();
+    while (reader.next(b) > 0)
+        observed_read_names.push_back(bam1_qname(b));
+    EXPECT_EQ(rc.read_names, observed_read_names);
+}
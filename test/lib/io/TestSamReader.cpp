@@ -0,0 +1,232 @@
+#include "io/SamReader.hpp"
+
+#include "io/AlignmentFilter.hpp"
+#include "io/BamIo.hpp"
+#include "io/BamReader.hpp"
+#include "io/BamRecordView.hpp"
+#include "io/BamWriter.hpp"
+#include "common/TaskExecutor.hpp"
+
+#include "TestData.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace bfs = boost::filesystem;
+using namespace std;
+
+namespace {
+    string aux_string(BamRecordView const& view) {
+        stringstream ss;
+        if (view.read_group())
+            ss << string(view.read_group(), view.read_group_length());
+        ss << ";";
+        if (view.has_alt_qual())
+            ss << view.alt_qual();
+        ss << ";";
+        if (view.has_mate_qual())
+            ss << view.mate_qual();
+        ss << ";";
+        if (view.has_read_counts())
+            ss << view.proper_pair_count() << "," << view.normal_read_count();
+        return ss.str();
+    }
+
+    // Everything but the aux data, and the aux data we keep
+    void expect_same(bam1_t const* expected, bam1_t const* actual, size_t i) {
+        bam1_core_t const& x = expected->core;
+        bam1_core_t const& y = actual->core;
+        EXPECT_EQ(x.tid, y.tid) << "record " << i;
+        EXPECT_EQ(x.pos, y.pos) << "record " << i;
+        EXPECT_EQ(x.bin, y.bin) << "record " << i;
+        EXPECT_EQ(x.qual, y.qual) << "record " << i;
+        EXPECT_EQ(x.l_qname, y.l_qname) << "record " << i;
+        EXPECT_EQ(x.flag, y.flag) << "record " << i;
+        EXPECT_EQ(x.n_cigar, y.n_cigar) << "record " << i;
+        EXPECT_EQ(x.l_qseq, y.l_qseq) << "record " << i;
+        EXPECT_EQ(x.mtid, y.mtid) << "record " << i;
+        EXPECT_EQ(x.mpos, y.mpos) << "record " << i;
+        EXPECT_EQ(x.isize, y.isize) << "record " << i;
+
+        size_t fixed = bam1_aux(expected) - expected->data;
+        ASSERT_EQ(fixed, size_t(bam1_aux(actual) - actual->data)) << "record " << i;
+        EXPECT_EQ(0, memcmp(expected->data, actual->data, fixed)) << "record " << i;
+        EXPECT_EQ(aux_string(BamRecordView(expected)), aux_string(BamRecordView(actual)))
+            << "record " << i;
+    }
+
+    void gzip(string const& from, string const& to) {
+        ifstream in(from.c_str());
+        stringstream ss;
+        ss << in.rdbuf();
+        string data = ss.str();
+        gzFile out = gzopen(to.c_str(), "wb");
+        ASSERT_TRUE(out);
+        ASSERT_EQ(int(data.size()), gzwrite(out, data.data(), data.size()));
+        gzclose(out);
+    }
+}
+
+class TestSamReader : public ::testing::TestWithParam<BamInfo> {
+public:
+    void SetUp() {
+        dir_ = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+        bfs::create_directory(dir_);
+        samPath_ = (dir_ / "reads.sam").native();
+
+        BamReader<AlignmentFilter::True> in(GetParam().path);
+        BamWriter out(samPath_, in.header(), true);
+        bam1_t* b = bam_init1();
+        while (in.next(b) > 0)
+            out.write(b);
+        bam_destroy1(b);
+        out.close();
+
+        gzip(samPath_, samPath_ + ".gz");
+    }
+
+    void TearDown() {
+        bfs::remove_all(dir_);
+    }
+
+    // Reads path and compares it with what samtools makes of the sam file
+    void compare(string const& path, TaskExecutor* executor, size_t chunk_size) {
+        BamReader<AlignmentFilter::True> expected(samPath_);
+        SamParser actual(path, executor, chunk_size);
+        EXPECT_EQ(expected.header()->n_targets, actual.header()->n_targets);
+        EXPECT_EQ(string(expected.header()->text, expected.header()->l_text),
+            string(actual.header()->text, actual.header()->l_text));
+
+        bam1_t* x = bam_init1();
+        bam1_t* y = bam_init1();
+        size_t n = 0;
+        while (expected.next(x) > 0) {
+            ASSERT_TRUE(actual.next(y)) << "chunk size " << chunk_size;
+            expect_same(x, y, n++);
+        }
+        EXPECT_FALSE(actual.next(y));
+        EXPECT_EQ(GetParam().n_reads, n);
+        bam_destroy1(x);
+        bam_destroy1(y);
+    }
+
+protected:
+    bfs::path dir_;
+    string samPath_;
+};
+
+INSTANTIATE_TEST_CASE_P(RC, TestSamReader, ::testing::ValuesIn(TEST_BAMS));
+
+TEST_P(TestSamReader, matchesSamtools) {
+    // Chunks shorter than a line, a few lines each, and the default
+    size_t chunk_sizes[] = { 10, 5000, SamParser::DEFAULT_CHUNK_SIZE };
+    for (size_t workers = 0; workers < 3; workers += 2) {
+        TaskExecutor executor(workers);
+        for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++i) {
+            compare(samPath_, &executor, chunk_sizes[i]);
+            compare(samPath_ + ".gz", &executor, chunk_sizes[i]);
+        }
+    }
+    compare(samPath_, 0, 5000);
+}
+
+TEST_P(TestSamReader, openBam) {
+    TaskExecutor executor(2);
+    boost::scoped_ptr<BamReaderBase> expected(openBam(GetParam().path));
+    boost::scoped_ptr<BamReaderBase> actual(openBam(samPath_ + ".gz", "", &executor));
+    RecordBatch x;
+    RecordBatch y;
+    size_t n = 0;
+    while (expected->next_batch(x)) {
+        ASSERT_EQ(x.size(), actual->next_batch(y));
+        for (size_t i = 0; i < x.size(); ++i)
+            expect_same(x[i], y[i], n++);
+    }
+    EXPECT_EQ(0u, actual->next_batch(y));
+
+    EXPECT_THROW(openBam(samPath_, "21"), runtime_error);
+}
+
+TEST(SamReader, badLines) {
+    bfs::path dir = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+    bfs::create_directory(dir);
+    string path = (dir / "bad.sam").native();
+
+    string header = "@SQ\tSN:1\tLN:1000\n";
+    string good = "r1\t99\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\tRG:Z:rg1\n";
+    char const* bad[] = {
+        "r2\t99\t1\t10\t60\n",
+        "r2\tpaired\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\n",
+        "r2\t99\t2\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\n",
+        "r2\t99\t1\t10\t60\t10Q\t=\t100\t100\tACGTACGTAC\t*\n",
+        "r2\t99\t1\t10\t60\t9M\t=\t100\t100\tACGTACGTAC\t*\n",
+        "r2\t99\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\tIII\n",
+        "r2\t99\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\tRG\n",
+        "r2\t99\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\tMQ:i:\n",
+    };
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        ofstream out(path.c_str());
+        out << header << good << good << bad[i] << good;
+        out.close();
+
+        SamParser parser(path);
+        bam1_t* b = bam_init1();
+        try {
+            while (parser.next(b))
+                ;
+            ADD_FAILURE() << "no error for " << bad[i];
+        }
+        catch (runtime_error const& e) {
+            EXPECT_NE(string::npos, string(e.what()).find("line 4")) << e.what();
+        }
+        bam_destroy1(b);
+    }
+
+    // A last line without a newline, and windows line endings
+    ofstream out(path.c_str());
+    string line = good.substr(0, good.size() - 1);
+    out << header << line << "\r\n" << line;
+    out.close();
+    SamParser parser(path);
+    bam1_t* b = bam_init1();
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(parser.next(b));
+        EXPECT_STREQ("r1", bam1_qname(b));
+        EXPECT_EQ(9, b->core.pos);
+        EXPECT_EQ(b->core.tid, b->core.mtid);
+        EXPECT_STREQ("rg1", bam_aux2Z(bam_aux_get(b, "RG")));
+    }
+    EXPECT_FALSE(parser.next(b));
+    bam_destroy1(b);
+    bfs::remove_all(dir);
+}
+
+TEST(SamReader, emptyStringTags) {
+    bfs::path dir = bfs::temp_directory_path() / bfs::unique_path("breakdancer-unit-test-%%%%-%%%%");
+    bfs::create_directory(dir);
+    string path = (dir / "empty.sam").native();
+
+    ofstream out(path.c_str());
+    out << "@SQ\tSN:1\tLN:1000\n"
+        << "r1\t99\t1\t10\t60\t10M\t=\t100\t100\tACGTACGTAC\t*\tXX:Z:\tYY:H:\tRG:Z:\tMQ:i:20\n";
+    out.close();
+
+    SamParser parser(path);
+    bam1_t* b = bam_init1();
+    ASSERT_TRUE(parser.next(b));
+    EXPECT_STREQ("", bam_aux2Z(bam_aux_get(b, "RG")));
+    EXPECT_EQ(20, bam_aux2i(bam_aux_get(b, "MQ")));
+    EXPECT_FALSE(parser.next(b));
+    bam_destroy1(b);
+    bfs::remove_all(dir);
+}